@@ -1,10 +1,12 @@
 # Made by Hans V. Rasmussen for EcoDome Bachelor Project.
 # Heavily inspired by https://www.summet.com/dmsi/html/readingTheWeb.html
-# Version:          1.1
+# Version:          1.3
 # Creation Date:    19/02/2018 14:30
-# Last Edit:        18/05/2018 19:30
+# Last Edit:        19/10/2026 16:00
 
 import urllib.request
+import urllib.error
+import email.utils
 from re import findall
 import os, errno
 import argparse
@@ -14,6 +16,9 @@ import argparse
 parser = argparse.ArgumentParser(description='Downloads weather prognosis from yr.no, note that the webpage reffered to must be the .xml')
 
 parser.add_argument('-dn', default='./data/wdata', help='Name as which the data should be saved, should be a path')
+parser.add_argument('-to', default=60, type=float, help='Seconds to wait for the webpage before giving up')
+parser.add_argument('-raw', action='store_true', help='Save the downloaded document as it is to the path given by -dn instead of splitting it into files')
+parser.add_argument('-cache', action='store_true', help='With -raw, only download the document if it changed since last time. Exits with 3 if it did not')
 parser.add_argument('-wl', default='https://www.yr.no/place/Denmark/South_Denmark/S%C3%B8nderborg/forecast.xml', help='Address of the webpage to download data from')
 
 args = parser.parse_args()
@@ -37,10 +42,65 @@ datName = pathtmp[len(pathtmp)-1]
 # windDir_compact = findall(r'\d+[.]?\d*', windDir[0])  # how to extract actual value from saved data
 
 
+## Cache validators from the last download, saved next to the document as 'key=value' lines:
+cache = {}
+if args.raw and args.cache and os.path.exists(args.dn) and os.path.exists(args.dn + '.cache'):
+    for line in open(args.dn + '.cache'):
+        key, sep, value = line.rstrip('\n').partition('=')
+        if sep:
+            cache[key] = value
+
+def http_time(value):
+    # seconds since epoch of a HTTP date, 0 if missing or malformed
+    try:
+        return int(email.utils.parsedate_to_datetime(value).timestamp())
+    except (TypeError, ValueError, IndexError):
+        return 0
+
+
 ## Read the webpage:
 # https://www.yr.no/place/Denmark/South_Denmark/S%C3%B8nderborg/forecast.xml
-response = urllib.request.urlopen(args.wl)
-html = response.read()
+request = urllib.request.Request(args.wl)
+if cache.get('etag'):
+    request.add_header('If-None-Match', cache['etag'])
+if cache.get('last_modified'):
+    request.add_header('If-Modified-Since', cache['last_modified'])
+
+try:
+    response = urllib.request.urlopen(request, timeout=args.to)
+except urllib.error.HTTPError as e:
+    if e.code != 304:
+        raise
+    # Not modified, only remember the new expiry time
+    cache['expires'] = str(http_time(e.headers.get('Expires')))
+    cache['bytes'] = '0'
+    response = None
+
+if response is not None:
+    html = response.read()
+    cache['etag'] = response.headers.get('ETag', '')
+    cache['last_modified'] = response.headers.get('Last-Modified', '')
+    cache['expires'] = str(http_time(response.headers.get('Expires')))
+    cache['bytes'] = str(len(html))
+
+## Save the document as it is if it is parsed by the caller:
+if args.raw:
+    if path and not os.path.exists(path):
+        os.makedirs(path)
+    if response is not None:
+        # write to a temporary file first so a reader never sees half a document
+        file = open(args.dn + '.tmp', "wb")
+        file.write(html)
+        file.close()
+        os.replace(args.dn + '.tmp', args.dn)
+    if args.cache:
+        file = open(args.dn + '.cache.tmp', "w")
+        for key in cache:
+            file.write(key + '=' + cache[key].replace('\n', '') + '\n')
+        file.close()
+        os.replace(args.dn + '.cache.tmp', args.dn + '.cache')
+    raise SystemExit(0 if response is not None else 3)
+
 text = html.decode()
 
 
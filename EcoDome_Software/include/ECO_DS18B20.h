@@ -2,11 +2,13 @@
 * ECO_DS18B20.h
 * Author:		Hans V. Rasmussen
 * Created:		07/05-2018 13:00
-* Modified:		16/05-2018 14:30
-* Version:		1.1
+* Modified:		19/10-2026 06:12
+* Version:		1.2
 *
 * Description:
 *	This header includes a class used for measuring and storing the output from the DS18B20 temperature sensors
+*	Since version 1.2 the readings feed the rolling windows of slidewin.h and the metrics, and failed reads are
+*	counted and flagged.
 *
 * NOTE:
 *
@@ -31,6 +33,7 @@
 
 #include "mythread.h"
 #include "debug_logger.h"
+#include "metrics.h"
 
 using namespace std;
 
@@ -46,6 +49,7 @@ struct Temp_measurement
 	float T_stoneF = 0;
 	float T_stonemean = 0;
 	float T_extra1 = 0;
+	bool T_out_failed = false;		// the outside sensor could not be read, T_out2 and T_outmean are not a temperature
 };
 
 	/*! @brief	Class that reads data from sensors, builds upon the mythread class.
@@ -66,13 +70,20 @@ public:
 	* 
 	*
 	* @param 
-	*		TERMINAL_CONTROLLER*, sem_t*, sem_t*, vector < string >*
+	*		TERMINAL_CONTROLLER*, sem_t*, sem_t*, vector < string >*, SLIDE_SET* (rolling windows fed by update(), NULL for none)
 	*
 	* @returns void
 	*
 	*/
-    DS18B20(TERMINAL_CONTROLLER* _tc, sem_t* _st, sem_t* _sc, vector < string >* _dev) : tercon(_tc), sem_temp(_st), sem_control(_sc), temp_devices(*_dev)
+    DS18B20(TERMINAL_CONTROLLER* _tc, sem_t* _st, sem_t* _sc, vector < string >* _dev, SLIDE_SET* _sw = NULL) : tercon(_tc), sem_temp(_st), sem_control(_sc), temp_devices(*_dev), windows(_sw)
     {
+		// a temperature and an error counter per sensor for the metrics endpoint
+		for(size_t i = 0; i < temp_devices.size(); i++)
+		{
+			string label = "device=\"" + temp_devices[i] + "\"";
+			temp_gauges.push_back(metrics().gauge("ecodome_temperature_celsius", "Last temperature read from a DS18B20 sensor", label));
+			read_errors.push_back(metrics().counter("ecodome_sensor_read_errors_total", "Failed reads of a DS18B20 sensor", label));
+		}
 		update();
     }
 
@@ -92,6 +103,21 @@ public:
 		meas_get_mutex.unlock();
 	}
 
+	/*! @brief Function that gives the rolling statistics of a sensor, e.g. window("outside_2", 86400, s) for the
+	*	last 24 hours. The windows are set in the windows list of the config.
+	*
+	* 
+	*
+	* @param const string& channel, int seconds, slide_stats&
+	*
+	* @returns bool, false if there is no such window
+	*
+	*/
+	bool window(const string& _channel, int _seconds, slide_stats& _s)
+	{
+		return windows && windows->get(_channel, _seconds, _s);
+	}
+
 	/*! @brief Function to be called when alarm happens
 	*
 	* 
@@ -105,10 +131,19 @@ public:
 	{
 		meas_get_mutex.lock();
 		temp_meas.clear();
+		vector < bool > failed;
 		for(int i=0; i < temp_devices.size(); i++)
 		{
+			read_failed = false;
 			temp_meas.push_back(Read_DS18B20(temp_devices[i]));
+			temp_gauges[i]->set(temp_meas.back());
+			failed.push_back(read_failed);
+			if(read_failed)
+			{
+				read_errors[i]->inc();
+			}
 		}
+		tm.T_out_failed = failed.at(3);
 		tm.T_inside = temp_meas.at(0);
 		tm.T_in_window = temp_meas.at(1);
 		tm.T_out2 = temp_meas.at(3);
@@ -118,6 +153,10 @@ public:
 		tm.T_stonemean = (temp_meas.at(4)+temp_meas.at(5))/2;
 		tm.T_stoneF = temp_meas.at(2);
 		//tm.T_extra1 = temp_meas.at(6);
+		if(windows)
+		{
+			windows->add(time(0), temp_meas.data(), temp_meas.size());
+		}
 		meas_get_mutex.unlock();
 	}
 
@@ -169,6 +208,7 @@ private:
 		if(-1 == fd)
 		{
 			perror("open device file error");
+			read_failed = true;
 			return 1;
 		}
 
@@ -187,6 +227,7 @@ private:
 				}
 				perror("read()");
 				close(fd);
+				read_failed = true;
 				return 0;
 			}
 		}
@@ -206,6 +247,10 @@ private:
 	vector < string > temp_devices;	// string vector containing the addresses of the sensors
 	vector < float > temp_meas;		// float vector for temporarely storing the data from the sensors.
 	Temp_measurement tm;			// structure to hold the data once processed.
+	SLIDE_SET* windows;				// rolling windows of the sensors, in the order of temp_devices
+	vector < METRIC_GAUGE* > temp_gauges;		// metrics of the sensors, in the order of temp_devices
+	vector < METRIC_COUNTER* > read_errors;
+	bool read_failed = false;		// set by Read_DS18B20() when the sensor could not be read
 
 	std::mutex meas_get_mutex;		// mutex for protecting teh temp_measurement structure.
 };
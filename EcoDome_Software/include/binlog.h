@@ -0,0 +1,677 @@
+#pragma once
+
+/*
+* binlog.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:33
+* Modified:		19/10-2026 05:58
+* Version:		1.4
+*
+* Description:
+*	This header includes the binary log format: a header with the schema (the name and type of every channel),
+*	followed by fixed size records holding the epoch and monotonic time stamps and the raw values. Floats are stored
+*	as they are, bools as bits.
+*
+* NOTE:
+*	A record is appended as it is, nothing is formatted while logging. The logconv tool turns a log into TSV or CSV.
+*	A record cut short by a power cut is ignored by LOG_READER.
+*	Closed logs are gzip compressed by LOGGER (logdataN.ecl.gz) with the record bytes shuffled, so the bytes that
+*	change slowly end up next to each other. LOG_READER inflates and unshuffles those into memory.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <zlib.h>
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define LOG_DIR				"./logs/"
+#define LOG_MAGIC			"ECOLOG1"
+#define LOG_VERSION			1
+#define LOG_EXTENSION		".ecl"
+#define LOG_COMPRESSED		".gz"		// added to LOG_EXTENSION when a closed log is compressed
+#define LOG_NAME_MAX		32			// bytes of a channel name, including the terminating 0
+
+// header flags
+#define LOG_FLAG_SHUFFLED	1			// the records are stored byte by byte: byte 0 of every record, then byte 1...
+
+// channel types
+#define LOG_FLOAT			0
+#define LOG_BOOL			1
+
+// one channel of the schema, as given by the program
+struct log_channel
+{
+	string name;
+	int type;
+
+	log_channel(const string& _name, int _type = LOG_FLOAT) : name(_name), type(_type)
+	{
+
+	}
+};
+
+// start of a log file, followed by 'channels' log_channel_desc and then the records
+struct log_file_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;			// bytes before the first record
+	uint32_t record_size;
+	uint32_t channels;
+	uint32_t floats;				// float channels, stored first in a record
+	uint32_t bools;					// bool channels, stored as bits after the floats
+	uint32_t time_step;				// intended seconds between records
+	uint32_t flags;					// LOG_FLAG_*, 0 in a log as it is written
+	int64_t started;				// when the log was started [unix time]
+};
+
+struct log_channel_desc
+{
+	char name[LOG_NAME_MAX];
+	uint32_t type;					// LOG_FLOAT or LOG_BOOL
+	uint32_t index;					// index among the channels of the same type
+};
+
+// one value of one channel, as returned by range queries
+struct log_sample
+{
+	int64_t epoch_us;
+	float value;
+};
+
+// start of every record, the floats and then the bool words follow
+struct log_record_head
+{
+	int64_t epoch_us;				// CLOCK_REALTIME [us]
+	int64_t mono_ns;				// CLOCK_MONOTONIC [ns], not affected by changes to the clock
+};
+
+
+// ###############################################		FUNCTIONS	#################################################### //
+
+	/*! @brief Checks if a file name ends with _suffix
+	*
+	*
+	*
+	* @param const string& _name, const string& _suffix
+	*
+	* @returns bool
+	*
+	*/
+bool log_ends_with(const string& _name, const string& _suffix)
+{
+	return _name.size() >= _suffix.size() && _name.compare(_name.size() - _suffix.size(), _suffix.size(), _suffix) == 0;
+}
+
+	/*! @brief Checks if a file is a binary log, compressed or not
+	*
+	*
+	*
+	* @param const string& _fpath
+	*
+	* @returns bool
+	*
+	*/
+bool log_is_binary(const string& _fpath)
+{
+	return log_ends_with(_fpath, LOG_EXTENSION) || log_ends_with(_fpath, LOG_EXTENSION LOG_COMPRESSED);
+}
+
+	/*! @brief Shuffles _n records of _size bytes in place, so byte k of every record is stored together, or the
+	*	reverse. Fixed size records of slowly changing values compress about twice as well like this.
+	*
+	*
+	*
+	* @param uint8_t* _p, size_t _n, size_t _size, bool _forward (false to unshuffle)
+	*
+	* @returns void
+	*
+	*/
+void log_shuffle(uint8_t* _p, size_t _n, size_t _size, bool _forward)
+{
+	vector< uint8_t > tmp(_p, _p + _n * _size);
+	for(size_t i = 0; i < _n; i++)
+	{
+		for(size_t k = 0; k < _size; k++)
+		{
+			if(_forward)
+			{
+				_p[k * _n + i] = tmp[i * _size + k];
+			}
+			else
+			{
+				_p[i * _size + k] = tmp[k * _n + i];
+			}
+		}
+	}
+}
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Writes a binary log, the record is prepared once and only the values change
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	vector< log_channel > ch;
+	*	ch.push_back(log_channel("in_soil__"));
+	*	ch.push_back(log_channel("M_F", LOG_BOOL));
+	*	LOG_WRITER lw;
+	*	lw.open("./logs/logdata0.ecl", ch, 10);
+	*	float v[] = {21.5, 1};
+	*	lw.append(v, 2);
+	* @endcode
+	*
+	*/
+class LOG_WRITER
+{
+public:
+	LOG_WRITER() : fd(-1)
+	{
+
+	}
+
+	~LOG_WRITER()
+	{
+		close();
+	}
+
+	/*! @brief builds the header and the record layout for a schema, without creating a file. Used by open() and by
+	*	writers that do their own I/O, see LOG_ASYNC_WRITER.
+	*
+	*
+	*
+	* @param const vector< log_channel >& _channels, int _time_step
+	*
+	* @returns const vector< uint8_t >&, the header as it goes at the start of the file
+	*
+	*/
+	const vector< uint8_t >& prepare(const vector< log_channel >& _channels, int _time_step)
+	{
+		types.clear();
+		index.clear();
+
+		log_file_header h;
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, LOG_MAGIC, sizeof(h.magic));
+		h.version = LOG_VERSION;
+		h.channels = _channels.size();
+		h.time_step = _time_step;
+		h.started = time(0);
+
+		vector< log_channel_desc > desc(_channels.size());
+		for(size_t i = 0; i < _channels.size(); i++)
+		{
+			memset(&desc[i], 0, sizeof(desc[i]));
+			strncpy(desc[i].name, _channels[i].name.c_str(), LOG_NAME_MAX - 1);
+			desc[i].type = _channels[i].type;
+			desc[i].index = (_channels[i].type == LOG_BOOL) ? h.bools++ : h.floats++;
+			types.push_back(desc[i].type);
+			index.push_back(desc[i].index);
+		}
+		h.header_size = sizeof(h) + desc.size() * sizeof(log_channel_desc);
+		h.record_size = sizeof(log_record_head) + h.floats * sizeof(float) + ((h.bools + 31) / 32) * sizeof(uint32_t);
+		floats = h.floats;
+		record.assign(h.record_size, 0);
+
+		header_buf.assign(h.header_size, 0);
+		memcpy(header_buf.data(), &h, sizeof(h));
+		if(!desc.empty())
+		{
+			memcpy(header_buf.data() + sizeof(h), desc.data(), desc.size() * sizeof(log_channel_desc));
+		}
+		return header_buf;
+	}
+
+	/*! @brief creates the log and writes the header
+	*
+	*
+	*
+	* @param const string& _fpath, const vector< log_channel >& _channels, int _time_step
+	*
+	* @returns bool
+	*
+	*/
+	bool open(const string& _fpath, const vector< log_channel >& _channels, int _time_step)
+	{
+		close();
+		prepare(_channels, _time_step);
+
+		fd = ::open(_fpath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+		if(fd == -1)
+		{
+			perror("open()");
+			return false;
+		}
+		if(!write_all(header_buf.data(), header_buf.size()))
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	/*! @brief fills in the record with the time stamps and _values, one per channel in schema order, bools are
+	*	true when not 0. Missing values are stored as NAN / false.
+	*
+	*
+	*
+	* @param const float* _values, size_t _n, int64_t _epoch_us (the time stamp, the clock is used if < 0)
+	*
+	* @returns const vector< uint8_t >&, the record
+	*
+	*/
+	const vector< uint8_t >& pack(const float* _values, size_t _n, int64_t _epoch_us = -1)
+	{
+		struct timespec rt, mt;
+		clock_gettime(CLOCK_REALTIME, &rt);
+		clock_gettime(CLOCK_MONOTONIC, &mt);
+		log_record_head head;
+		head.epoch_us = _epoch_us >= 0 ? _epoch_us : (int64_t)rt.tv_sec * 1000000 + rt.tv_nsec / 1000;
+		head.mono_ns = (int64_t)mt.tv_sec * 1000000000 + mt.tv_nsec;
+
+		uint8_t* p = record.data();
+		memcpy(p, &head, sizeof(head));
+		float* f = (float*)(p + sizeof(head));
+		uint32_t* b = (uint32_t*)(f + floats);
+		memset(b, 0, record.size() - sizeof(head) - floats * sizeof(float));
+		for(size_t i = 0; i < types.size(); i++)
+		{
+			float v = i < _n ? _values[i] : NAN;
+			if(types[i] == LOG_FLOAT)
+			{
+				f[index[i]] = v;
+			}
+			else if(i < _n && v != 0)
+			{
+				b[index[i] / 32] |= 1u << (index[i] % 32);
+			}
+		}
+		return record;
+	}
+
+	/*! @brief appends one record, see pack()
+	*
+	*
+	*
+	* @param const float* _values, size_t _n
+	*
+	* @returns bool
+	*
+	*/
+	bool append(const float* _values, size_t _n)
+	{
+		if(fd == -1)
+		{
+			return false;
+		}
+		pack(_values, _n);
+		return write_all(record.data(), record.size());
+	}
+
+	void close(void)
+	{
+		if(fd != -1)
+		{
+			::close(fd);
+		}
+		fd = -1;
+	}
+
+	size_t record_size(void) const
+	{
+		return record.size();
+	}
+
+private:
+	bool write_all(const void* _buf, size_t _n)
+	{
+		const char* p = (const char*)_buf;
+		while(_n)
+		{
+			ssize_t w = write(fd, p, _n);
+			if(w == -1 && errno == EINTR)
+			{
+				continue;
+			}
+			if(w <= 0)
+			{
+				perror("write()");
+				return false;
+			}
+			p += w;
+			_n -= w;
+		}
+		return true;
+	}
+
+	int fd;
+	vector< int > types;
+	vector< uint32_t > index;
+	uint32_t floats = 0;
+	vector< uint8_t > record;
+	vector< uint8_t > header_buf;
+};
+
+
+	/*! @brief	Reads a binary log, the file is memory mapped and records are read in place. A compressed log is
+	*	inflated into memory instead.
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	LOG_READER lr;
+	*	if(lr.open("./logs/logdata0.ecl"))
+	*	{
+	*		int c = lr.channel("outside_2");
+	*		for(size_t i = 0; i < lr.size(); i++)
+	*			cout << lr.epoch_us(i) << " " << lr.value(i, c) << endl;
+	*	}
+	* @endcode
+	*
+	*/
+class LOG_READER
+{
+public:
+	LOG_READER() : base(NULL), len(0), count(0), mapped(false)
+	{
+
+	}
+
+	~LOG_READER()
+	{
+		close();
+	}
+
+	/*! @brief maps or inflates a log and checks its header
+	*
+	*
+	*
+	* @param const string& _fpath
+	*
+	* @returns bool
+	*
+	*/
+	bool open(const string& _fpath)
+	{
+		close();
+		if(log_ends_with(_fpath, LOG_COMPRESSED))
+		{
+			return inflate(_fpath) && check();
+		}
+		int fd = ::open(_fpath.c_str(), O_RDONLY);
+		if(fd == -1)
+		{
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(log_file_header))
+		{
+			::close(fd);
+			return false;
+		}
+		void* m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if(m == MAP_FAILED)
+		{
+			perror("mmap()");
+			return false;
+		}
+		madvise(m, st.st_size, MADV_SEQUENTIAL);
+		base = (const uint8_t*)m;
+		len = st.st_size;
+		mapped = true;
+		return check();
+	}
+
+	void close(void)
+	{
+		if(base && mapped)
+		{
+			munmap((void*)base, len);
+		}
+		inflated.clear();
+		inflated.shrink_to_fit();
+		base = NULL;
+		mapped = false;
+		len = 0;
+		count = 0;
+		desc.clear();
+	}
+
+	/*! @brief finds a channel by name
+	*
+	*
+	*
+	* @param const string& _name
+	*
+	* @returns int, -1 if there is no such channel
+	*
+	*/
+	int channel(const string& _name) const
+	{
+		for(size_t i = 0; i < desc.size(); i++)
+		{
+			if(_name == desc[i].name)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	size_t size(void) const
+	{
+		return count;
+	}
+
+	size_t channels(void) const
+	{
+		return desc.size();
+	}
+
+	const log_channel_desc& get_channel(int _c) const
+	{
+		return desc[_c];
+	}
+
+	const log_file_header& header(void) const
+	{
+		return head;
+	}
+
+	int64_t epoch_us(size_t _i) const
+	{
+		log_record_head h;
+		memcpy(&h, rec(_i), sizeof(h));
+		return h.epoch_us;
+	}
+
+	int64_t mono_ns(size_t _i) const
+	{
+		log_record_head h;
+		memcpy(&h, rec(_i), sizeof(h));
+		return h.mono_ns;
+	}
+
+	/*! @brief value of channel _c in record _i, bools are 0 or 1
+	*
+	*
+	*
+	* @param size_t _i, int _c
+	*
+	* @returns float
+	*
+	*/
+	float value(size_t _i, int _c) const
+	{
+		const uint8_t* p = rec(_i) + sizeof(log_record_head);
+		const log_channel_desc& d = desc[_c];
+		if(d.type == LOG_FLOAT)
+		{
+			float v;
+			memcpy(&v, p + d.index * sizeof(float), sizeof(v));
+			return v;
+		}
+		uint32_t w;
+		memcpy(&w, p + head.floats * sizeof(float) + (d.index / 32) * sizeof(uint32_t), sizeof(w));
+		return (w >> (d.index % 32)) & 1;
+	}
+
+	/*! @brief adds the values of channel _c in records _first to _first + _n that lie between _from_us and _to_us
+	*	(both included) to _out, NAN values are skipped. Only the pages of those records are touched.
+	*
+	*
+	*
+	* @param size_t _first, size_t _n, int _c, int64_t _from_us, int64_t _to_us, vector< log_sample >& _out
+	*
+	* @returns size_t, values added
+	*
+	*/
+	size_t samples(size_t _first, size_t _n, int _c, int64_t _from_us, int64_t _to_us, vector< log_sample >& _out) const
+	{
+		if(_first >= count)
+		{
+			return 0;
+		}
+		if(_n > count - _first)
+		{
+			_n = count - _first;
+		}
+		// the channel is at a fixed offset in every record, for a bool it is one bit of a word
+		const log_channel_desc& d = desc[_c];
+		bool is_bool = (d.type == LOG_BOOL);
+		size_t off = sizeof(log_record_head) + (is_bool ? head.floats * sizeof(float) + (d.index / 32) * sizeof(uint32_t) : d.index * sizeof(float));
+		uint32_t bit = d.index % 32;
+
+		size_t before = _out.size();
+		const uint8_t* p = rec(_first);
+		for(size_t i = 0; i < _n; i++, p += head.record_size)
+		{
+			int64_t t;
+			memcpy(&t, p, sizeof(t));
+			if(t < _from_us || t > _to_us)
+			{
+				continue;
+			}
+			log_sample s;
+			s.epoch_us = t;
+			if(is_bool)
+			{
+				uint32_t w;
+				memcpy(&w, p + off, sizeof(w));
+				s.value = (w >> bit) & 1;
+			}
+			else
+			{
+				memcpy(&s.value, p + off, sizeof(s.value));
+				if(isnan(s.value))
+				{
+					continue;
+				}
+			}
+			_out.push_back(s);
+		}
+		return _out.size() - before;
+	}
+
+private:
+	// checks the header at base and reads the schema
+	bool check(void)
+	{
+		if(len < sizeof(head))
+		{
+			close();
+			return false;
+		}
+		memcpy(&head, base, sizeof(head));
+		if(memcmp(head.magic, LOG_MAGIC, sizeof(head.magic)) != 0 || head.version != LOG_VERSION || head.record_size < sizeof(log_record_head)
+			|| head.header_size != sizeof(head) + head.channels * sizeof(log_channel_desc) || head.header_size > len)
+		{
+			close();
+			return false;
+		}
+		desc.resize(head.channels);
+		if(head.channels)
+		{
+			memcpy(desc.data(), base + sizeof(head), head.channels * sizeof(log_channel_desc));
+		}
+		for(size_t i = 0; i < desc.size(); i++)
+		{
+			desc[i].name[LOG_NAME_MAX - 1] = 0;
+		}
+		// a torn last record is left out
+		count = (len - head.header_size) / head.record_size;
+		return true;
+	}
+
+	// reads a gzip compressed log into memory
+	bool inflate(const string& _fpath)
+	{
+		gzFile gz = gzopen(_fpath.c_str(), "rb");
+		if(!gz)
+		{
+			return false;
+		}
+		gzbuffer(gz, 1 << 16);
+		int r;
+		do
+		{
+			size_t at = inflated.size();
+			inflated.resize(at + (1 << 16));
+			r = gzread(gz, inflated.data() + at, 1 << 16);
+			inflated.resize(at + (r > 0 ? r : 0));
+		}
+		while(r > 0);
+		gzclose(gz);
+		base = inflated.data();
+		len = inflated.size();
+		if(r != 0 || len < sizeof(log_file_header))
+		{
+			return false;
+		}
+
+		log_file_header h;
+		memcpy(&h, base, sizeof(h));
+		if((h.flags & LOG_FLAG_SHUFFLED) && h.header_size <= len && h.record_size)
+		{
+			log_shuffle(inflated.data() + h.header_size, (len - h.header_size) / h.record_size, h.record_size, false);
+			h.flags &= ~LOG_FLAG_SHUFFLED;
+			memcpy(inflated.data(), &h, sizeof(h));
+		}
+		return true;
+	}
+
+	const uint8_t* rec(size_t _i) const
+	{
+		return base + head.header_size + _i * head.record_size;
+	}
+
+	const uint8_t* base;
+	size_t len;
+	size_t count;
+	bool mapped;					// base is a mapping of the file, otherwise it points into inflated
+	vector< uint8_t > inflated;
+	log_file_header head;
+	vector< log_channel_desc > desc;
+};
@@ -0,0 +1,774 @@
+#pragma once
+
+/*
+* ctlserver.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:23
+* Modified:		19/10-2026 06:13
+* Version:		1.2
+*
+* Description:
+*	This header includes the control server: a Unix domain socket (./ecodome.sock) that any number of local clients
+*	can connect to, e.g. with socat - UNIX-CONNECT:./ecodome.sock, to look at the controller and change it without
+*	a restart. The protocol is one line per command and one line per answer, see CONTROL_HELP.
+*	One thread serves all clients with epoll and non-blocking sockets, a slow client never holds up the others.
+*
+* NOTE:
+*	Commands that change the controller (set, override, refresh) are queued, Main_Controller takes them at the start
+*	of its next step and the answer is sent once they are applied, so they take effect within one step.
+*	status and stream answer from the last step the controller published, they never wait for it.
+*	history answers from the in-memory history of tsstore.h, if the logger keeps one (log.history_days).
+*	A client that does not read its stream has its stream lines dropped once CONTROL_MAX_BACKLOG bytes are waiting,
+*	it is told how many with the next line it gets.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "mythread.h"
+#include "flightrec.h"
+#include "tsstore.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define CONTROL_SOCKET			"./ecodome.sock"
+#define CONTROL_MAX_CLIENTS		256
+#define CONTROL_MAX_LINE		256			// longer commands are refused
+#define CONTROL_MAX_BACKLOG		65536		// bytes waiting for a client before its stream lines are dropped
+#define CONTROL_EVENTS			64
+
+#define CONTROL_HELP \
+	"ok commands:\n" \
+	"  status                              the last step, setpoints, gains and overrides\n" \
+	"  stream on|off                       a status line every step\n" \
+	"  set tdes|tmax|tmin|k|ke <value>     change a setpoint [C] or a gain of the PI controller\n" \
+	"  override stone_fan|main_fan on|off|auto\n" \
+	"  refresh                             download the prognosis now\n" \
+	"  history <channel> <hours>           count, mean, minimum and maximum of a logged channel\n" \
+	"  help, quit\n" \
+	"  answers start with ok or err, set, override and refresh are answered when the next step has applied them\n"
+
+// what a queued command does
+enum
+{
+	CONTROL_SET = 0,
+	CONTROL_OVERRIDE,
+	CONTROL_REFRESH
+};
+
+// what set and override change
+enum
+{
+	CONTROL_TDES = 0,
+	CONTROL_TMAX,
+	CONTROL_TMIN,
+	CONTROL_K,
+	CONTROL_KE,
+	CONTROL_STONE_FAN,
+	CONTROL_MAIN_FAN,
+	CONTROL_TARGETS
+};
+const char* const control_target_names[CONTROL_TARGETS] = {"tdes", "tmax", "tmin", "k", "ke", "stone_fan", "main_fan"};
+
+// values of an override
+#define CONTROL_AUTO			-1
+#define CONTROL_OFF				0
+#define CONTROL_ON				1
+
+// a command for the controller
+struct control_command
+{
+	uint64_t client;				// who gets the answer
+	int type;						// CONTROL_SET, CONTROL_OVERRIDE or CONTROL_REFRESH
+	int target;						// CONTROL_TDES ... CONTROL_MAIN_FAN
+	float value;					// the setpoint or gain, or CONTROL_AUTO, CONTROL_OFF or CONTROL_ON
+};
+
+// what the controller publishes every step
+struct control_status
+{
+	flight_record step = flight_record();
+	float Tdes = 0;
+	float Tmax = 0;
+	float Tmin = 0;
+	float K = 0;
+	float Ke = 0;
+	int stone_fan = CONTROL_AUTO;	// overrides
+	int main_fan = CONTROL_AUTO;
+};
+
+// the name of an override value
+inline const char* control_override_name(int _v)
+{
+	return _v == CONTROL_AUTO ? "auto" : (_v == CONTROL_ON ? "on" : "off");
+}
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Serves the control socket
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	CONTROL_SERVER cs;
+	*	cs.open(CONTROL_SOCKET);
+	*	// every step of the controller:
+	*	vector< control_command > cmds;
+	*	cs.take(cmds);
+	*	... apply them, cs.reply(cmds[i].client, "ok ...") ...
+	*	cs.publish(status);
+	*	cs.close();
+	* @endcode
+	*
+	*/
+class CONTROL_SERVER : public MyThreadClass
+{
+public:
+	/*! @brief Constructor
+	*
+	*
+	*
+	* @param TS_STORE* _history, the history of the logged channels for the history command, NULL if there is none
+	*
+	* @returns void
+	*
+	*/
+	CONTROL_SERVER(TS_STORE* _history = NULL) : history(_history), running(false), nclients(0), streamers(0)
+	{
+
+	}
+
+	~CONTROL_SERVER()
+	{
+		close();
+	}
+
+	/*! @brief starts listening on the Unix socket _path, an old socket file is replaced
+	*
+	*
+	*
+	* @param const string& _path
+	*
+	* @returns bool
+	*
+	*/
+	bool open(const string& _path)
+	{
+		close();
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if(_path.size() >= sizeof(addr.sun_path))
+		{
+			cout << "Control socket path too long: " << _path << endl;
+			return false;
+		}
+		strcpy(addr.sun_path, _path.c_str());
+		unlink(addr.sun_path);
+
+		fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(fd == -1 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, 64) == -1)
+		{
+			return fail("CONTROL_SERVER bind() " + _path);
+		}
+		path = _path;
+		wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		ep = epoll_create1(EPOLL_CLOEXEC);
+		if(wake == -1 || ep == -1)
+		{
+			return fail("CONTROL_SERVER epoll");
+		}
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.u64 = LISTEN_ID;
+		epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+		ev.data.u64 = WAKE_ID;
+		epoll_ctl(ep, EPOLL_CTL_ADD, wake, &ev);
+
+		running = true;
+		if(!StartInternalThread())
+		{
+			running = false;
+			return fail("CONTROL_SERVER thread");
+		}
+		started = true;
+		return true;
+	}
+
+	/*! @brief disconnects all clients, stops the thread and removes the socket file
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void close(void)
+	{
+		if(started)
+		{
+			running = false;
+			signal();
+			WaitForInternalThreadToExit();
+			started = false;
+		}
+		for(map< uint64_t, client >::iterator it = clients.begin(); it != clients.end(); ++it)
+		{
+			::close(it->second.fd);
+		}
+		clients.clear();
+		cleanup();
+	}
+
+	/*! @brief the commands that came in since the last call, for the controller. Holds the lock for a swap.
+	*
+	*
+	*
+	* @param vector< control_command >& _out
+	*
+	* @returns bool, false if there were none
+	*
+	*/
+	bool take(vector< control_command >& _out)
+	{
+		_out.clear();
+		lock_guard <mutex> cs_lock(cs_mutex);
+		_out.swap(commands);
+		return !_out.empty();
+	}
+
+	/*! @brief sends the answer to a command once it is applied
+	*
+	*
+	*
+	* @param uint64_t _client, const string& _line (without newline)
+	*
+	* @returns void
+	*
+	*/
+	void reply(uint64_t _client, const string& _line)
+	{
+		{
+			lock_guard <mutex> cs_lock(cs_mutex);
+			replies.push_back(make_pair(_client, _line));
+		}
+		signal();
+	}
+
+	/*! @brief the state after a step, for status and stream. The thread is only woken if some client streams.
+	*
+	*
+	*
+	* @param const control_status& _st
+	*
+	* @returns void
+	*
+	*/
+	void publish(const control_status& _st)
+	{
+		{
+			lock_guard <mutex> cs_lock(cs_mutex);
+			status = _st;
+			have_status = true;
+			new_status = true;
+		}
+		if(streamers.load(memory_order_relaxed) > 0)
+		{
+			signal();
+		}
+	}
+
+	// clients connected now
+	size_t get_clients(void) const
+	{
+		return nclients.load(memory_order_relaxed);
+	}
+
+protected:
+	/** Implement this method in your subclass with the code you want your thread to run. */
+	void InternalThreadEntry()
+	{
+		struct epoll_event events[CONTROL_EVENTS];
+		while(running)
+		{
+			int n = epoll_wait(ep, events, CONTROL_EVENTS, -1);
+			if(n == -1)
+			{
+				if(errno != EINTR)
+				{
+					perror("CONTROL_SERVER epoll_wait()");
+					return;
+				}
+				continue;
+			}
+			for(int i = 0; i < n; i++)
+			{
+				uint64_t id = events[i].data.u64;
+				if(id == LISTEN_ID)
+				{
+					accept_clients();
+				}
+				else if(id == WAKE_ID)
+				{
+					uint64_t v;
+					if(read(wake, &v, sizeof(v)) == -1 && errno != EAGAIN)
+					{
+						perror("CONTROL_SERVER eventfd");
+					}
+					deliver();
+				}
+				else
+				{
+					map< uint64_t, client >::iterator it = clients.find(id);
+					if(it == clients.end())
+					{
+						continue;
+					}
+					if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+					{
+						receive(it->second);
+					}
+					if(events[i].events & EPOLLOUT)
+					{
+						flush(it->second);
+					}
+					if(it->second.closing && it->second.out.empty())
+					{
+						drop(it);
+					}
+				}
+			}
+		}
+	}
+
+private:
+	static const uint64_t LISTEN_ID = 0;
+	static const uint64_t WAKE_ID = 1;
+
+	struct client
+	{
+		int fd = -1;
+		uint64_t id = 0;
+		string in;					// start of a line that has not ended yet
+		string out;					// waiting to be sent
+		bool stream = false;
+		bool writing = false;		// EPOLLOUT is on
+		bool closing = false;		// closed once out is sent
+		unsigned long dropped = 0;	// stream lines dropped since the last one sent
+	};
+
+	void signal(void)
+	{
+		uint64_t one = 1;
+		if(wake != -1 && write(wake, &one, sizeof(one)) == -1 && errno != EAGAIN)
+		{
+			perror("CONTROL_SERVER eventfd");
+		}
+	}
+
+	void accept_clients(void)
+	{
+		while(true)
+		{
+			int c = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if(c == -1)
+			{
+				if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				{
+					perror("CONTROL_SERVER accept()");
+				}
+				return;
+			}
+			if(clients.size() >= CONTROL_MAX_CLIENTS)
+			{
+				const char msg[] = "err too many clients\n";
+				if(send(c, msg, sizeof(msg) - 1, MSG_NOSIGNAL) == -1)
+				{
+					// nothing to do, it is closed anyway
+				}
+				::close(c);
+				continue;
+			}
+			client cl;
+			cl.fd = c;
+			cl.id = next_id++;
+			struct epoll_event ev;
+			ev.events = EPOLLIN;
+			ev.data.u64 = cl.id;
+			epoll_ctl(ep, EPOLL_CTL_ADD, c, &ev);
+			clients.insert(make_pair(cl.id, cl));
+			nclients.store(clients.size(), memory_order_relaxed);
+		}
+	}
+
+	void drop(map< uint64_t, client >::iterator _it)
+	{
+		if(_it->second.stream)
+		{
+			streamers.fetch_sub(1, memory_order_relaxed);
+		}
+		epoll_ctl(ep, EPOLL_CTL_DEL, _it->second.fd, NULL);
+		::close(_it->second.fd);
+		clients.erase(_it);
+		nclients.store(clients.size(), memory_order_relaxed);
+	}
+
+	// reads what the client sent and handles every whole line
+	void receive(client& _c)
+	{
+		char buf[1024];
+		while(true)
+		{
+			ssize_t r = recv(_c.fd, buf, sizeof(buf), 0);
+			if(r > 0)
+			{
+				_c.in.append(buf, r);
+				continue;
+			}
+			if(r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+			{
+				_c.closing = true;
+				_c.out.clear();
+			}
+			if(r == -1 && errno == EINTR)
+			{
+				continue;
+			}
+			break;
+		}
+		size_t start = 0;
+		size_t nl;
+		while(!_c.closing && (nl = _c.in.find('\n', start)) != string::npos)
+		{
+			string line = _c.in.substr(start, nl - start);
+			start = nl + 1;
+			if(!line.empty() && line[line.size() - 1] == '\r')
+			{
+				line.erase(line.size() - 1);
+			}
+			command(_c, line);
+		}
+		_c.in.erase(0, start);
+		if(_c.in.size() > CONTROL_MAX_LINE)
+		{
+			_c.in.clear();
+			send_line(_c, "err line too long");
+		}
+	}
+
+	// handles one line of a client
+	void command(client& _c, const string& _line)
+	{
+		char word[32] = "", what[32] = "", arg[32] = "";
+		int n = sscanf(_line.c_str(), "%31s %31s %31s", word, what, arg);
+		string w = word;
+		if(n <= 0)
+		{
+			return;
+		}
+		if(w == "help" || w == "?")
+		{
+			send_text(_c, CONTROL_HELP);
+		}
+		else if(w == "quit" || w == "exit")
+		{
+			send_line(_c, "ok bye");
+			_c.closing = true;
+		}
+		else if(w == "status")
+		{
+			string s = "err no step yet";
+			{
+				lock_guard <mutex> cs_lock(cs_mutex);
+				if(have_status)
+				{
+					format(status, "ok", s);
+				}
+			}
+			send_line(_c, s);
+		}
+		else if(w == "stream" && n == 2 && (string(what) == "on" || string(what) == "off"))
+		{
+			bool on = string(what) == "on";
+			if(on != _c.stream)
+			{
+				streamers.fetch_add(on ? 1 : -1, memory_order_relaxed);
+			}
+			_c.stream = on;
+			send_line(_c, on ? "ok stream on" : "ok stream off");
+		}
+		else if(w == "set" && n == 3)
+		{
+			int t = target(what, CONTROL_TDES, CONTROL_KE);
+			char* end;
+			float v = strtof(arg, &end);
+			if(t < 0 || *end || !isfinite(v))
+			{
+				send_line(_c, "err set tdes|tmax|tmin|k|ke <value>");
+				return;
+			}
+			queue(_c, CONTROL_SET, t, v);
+		}
+		else if(w == "override" && n == 3)
+		{
+			int t = target(what, CONTROL_STONE_FAN, CONTROL_MAIN_FAN);
+			string a = arg;
+			int v = a == "on" ? CONTROL_ON : (a == "off" ? CONTROL_OFF : (a == "auto" ? CONTROL_AUTO : -2));
+			if(t < 0 || v == -2)
+			{
+				send_line(_c, "err override stone_fan|main_fan on|off|auto");
+				return;
+			}
+			queue(_c, CONTROL_OVERRIDE, t, v);
+		}
+		else if(w == "refresh" && n == 1)
+		{
+			queue(_c, CONTROL_REFRESH, 0, 0);
+		}
+		else if(w == "history" && n == 3)
+		{
+			send_line(_c, history_line(what, arg));
+		}
+		else
+		{
+			send_line(_c, "err unknown command, try help");
+		}
+	}
+
+	static int target(const string& _name, int _first, int _last)
+	{
+		for(int t = _first; t <= _last; t++)
+		{
+			if(_name == control_target_names[t])
+			{
+				return t;
+			}
+		}
+		return -1;
+	}
+
+	void queue(client& _c, int _type, int _target, float _value)
+	{
+		control_command cmd;
+		cmd.client = _c.id;
+		cmd.type = _type;
+		cmd.target = _target;
+		cmd.value = _value;
+		lock_guard <mutex> cs_lock(cs_mutex);
+		commands.push_back(cmd);
+	}
+
+	// hands out the answers of the controller and the newest step to the streaming clients
+	void deliver(void)
+	{
+		vector< pair< uint64_t, string > > r;
+		string line;
+		bool fresh;
+		{
+			lock_guard <mutex> cs_lock(cs_mutex);
+			r.swap(replies);
+			fresh = new_status && streamers.load(memory_order_relaxed) > 0;
+			if(fresh)
+			{
+				format(status, "step", line);
+			}
+			new_status = false;
+		}
+		for(size_t i = 0; i < r.size(); i++)
+		{
+			map< uint64_t, client >::iterator it = clients.find(r[i].first);
+			if(it != clients.end() && !it->second.closing)
+			{
+				send_line(it->second, r[i].second);
+			}
+		}
+		for(map< uint64_t, client >::iterator it = clients.begin(); fresh && it != clients.end(); ++it)
+		{
+			client& c = it->second;
+			if(!c.stream || c.closing)
+			{
+				continue;
+			}
+			if(c.out.size() > CONTROL_MAX_BACKLOG)
+			{
+				c.dropped++;
+				continue;
+			}
+			if(c.dropped)
+			{
+				send_line(c, "dropped " + to_string(c.dropped));
+				c.dropped = 0;
+			}
+			send_line(c, line);
+		}
+	}
+
+	void send_line(client& _c, const string& _line)
+	{
+		_c.out += _line;
+		_c.out += '\n';
+		flush(_c);
+	}
+
+	void send_text(client& _c, const char* _text)
+	{
+		_c.out += _text;
+		flush(_c);
+	}
+
+	// sends what it can without blocking, EPOLLOUT tells when the rest can go
+	void flush(client& _c)
+	{
+		size_t sent = 0;
+		while(sent < _c.out.size())
+		{
+			ssize_t w = send(_c.fd, _c.out.data() + sent, _c.out.size() - sent, MSG_NOSIGNAL);
+			if(w > 0)
+			{
+				sent += w;
+				continue;
+			}
+			if(w == -1 && errno == EINTR)
+			{
+				continue;
+			}
+			if(w == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				_c.closing = true;
+				_c.out.clear();
+				sent = 0;
+			}
+			break;
+		}
+		_c.out.erase(0, sent);
+		bool want = !_c.out.empty();
+		if(want != _c.writing)
+		{
+			struct epoll_event ev;
+			ev.events = EPOLLIN | (want ? (uint32_t)EPOLLOUT : (uint32_t)0);
+			ev.data.u64 = _c.id;
+			epoll_ctl(ep, EPOLL_CTL_MOD, _c.fd, &ev);
+			_c.writing = want;
+		}
+		if(_c.closing && _c.out.empty())
+		{
+			// closed by the next event of the client, shutdown() makes sure there is one
+			shutdown(_c.fd, SHUT_RDWR);
+		}
+	}
+
+	// the answer to history, the summary does not hold the lock of the store while it decodes
+	string history_line(const string& _channel, const char* _hours)
+	{
+		char* end;
+		double hours = strtod(_hours, &end);
+		if(*end || !(hours > 0))
+		{
+			return "err history <channel> <hours>";
+		}
+		if(!history)
+		{
+			return "err no history, log.history_days is 0";
+		}
+		int c = history->channel_index(_channel);
+		if(c < 0)
+		{
+			return "err no channel " + _channel;
+		}
+		int64_t now = time(0);
+		ts_summary s;
+		history->summary(c, now - (int64_t)(hours * 3600), now, s);
+		char buf[256];
+		snprintf(buf, sizeof(buf), "ok history channel=%s hours=%g n=%lu mean=%.2f min=%.2f max=%.2f", _channel.c_str(),
+			hours, s.n, s.mean(), s.n ? s.min : NAN, s.n ? s.max : NAN);
+		return buf;
+	}
+
+	static void format(const control_status& _st, const char* _prefix, string& _out)
+	{
+		const flight_record& r = _st.step;
+		char buf[512];
+		snprintf(buf, sizeof(buf), "%s step=%llu time=%lld T_inside=%.2f T_in_window=%.2f T_outmean=%.2f T_stonemean=%.2f "
+			"u=%.3f r=%.3f y=%.3f integral=%.3f nowcast_1h=%.2f stone_fan=%d main_fan=%d fan_high=%d step_us=%u "
+			"tdes=%.2f tmax=%.2f tmin=%.2f k=%.3f ke=%.3f override_stone_fan=%s override_main_fan=%s",
+			_prefix, (unsigned long long)r.seq_end, (long long)(r.epoch_us / 1000000), r.T_inside, r.T_in_window, r.T_outmean,
+			r.T_stonemean, r.u, r.r, r.y, r.integral, r.nowcast_1h, (r.actuators & FLIGHT_STONE_FAN) != 0,
+			(r.actuators & FLIGHT_MAIN_FAN) != 0, (r.actuators & FLIGHT_FAN_HIGH) != 0, r.stage_us[FLIGHT_STAGE_STEP],
+			_st.Tdes, _st.Tmax, _st.Tmin, _st.K, _st.Ke, control_override_name(_st.stone_fan), control_override_name(_st.main_fan));
+		_out = buf;
+	}
+
+	bool fail(const string& _what)
+	{
+		perror(_what.c_str());
+		cleanup();
+		return false;
+	}
+
+	void cleanup(void)
+	{
+		if(fd != -1)
+		{
+			::close(fd);
+		}
+		if(wake != -1)
+		{
+			::close(wake);
+		}
+		if(ep != -1)
+		{
+			::close(ep);
+		}
+		if(!path.empty())
+		{
+			unlink(path.c_str());
+		}
+		fd = wake = ep = -1;
+		path.clear();
+	}
+
+	TS_STORE* history;
+	int fd = -1;
+	int wake = -1;					// eventfd, wakes the thread for replies, steps and close()
+	int ep = -1;
+	string path;
+	atomic<bool> running;
+	bool started = false;
+
+	map< uint64_t, client > clients;	// only used by the thread
+	uint64_t next_id = 2;			// 0 and 1 are the listening socket and the eventfd
+	atomic<size_t> nclients;
+	atomic<int> streamers;			// clients with stream on
+
+	mutex cs_mutex;					// everything below
+	vector< control_command > commands;
+	vector< pair< uint64_t, string > > replies;
+	control_status status;
+	bool have_status = false;
+	bool new_status = false;
+};
@@ -0,0 +1,180 @@
+#pragma once
+
+/*
+* daemon.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:32
+* Modified:		19/10-2026 05:58
+* Version:		1.1
+*
+* Description:
+*	This header includes what Eco_Soft needs to run as a service without a terminal (Eco_Soft -d): the signals of
+*	the main loop through a signalfd, readiness and watchdog notifications to systemd (sd_notify() without
+*	libsystemd) and sending the output to a log file that is opened again on SIGHUP, e.g. after logrotate.
+*	Without a log file the output stays on stdout/stderr, which systemd puts in the journal.
+*
+*	[Service]
+*	Type=notify
+*	WorkingDirectory=/home/pi/EcoDome_Software
+*	ExecStart=/home/pi/EcoDome_Software/Eco_Soft -d
+*	WatchdogSec=60
+*	TimeoutStopSec=90
+*
+* NOTE:
+*	daemon_stdio() must be called before anything is written to stdout, daemon_signals() before any thread is
+*	started, the threads inherit the blocked signals so that only the signalfd gets them.
+*	The watchdog is fed every control step, WatchdogSec must be well above TIME_STEP.
+*	After SIGTERM the window is driven open for WINDOW_TIME before the program ends, TimeoutStopSec must be above it.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/signalfd.h>
+
+using namespace std;
+
+
+// ###############################################		FUNCTIONS		#################################################### //
+
+/*! @brief makes stdout line buffered also when it is a pipe (the journal) or a log file, so every line is out as
+*	soon as it is written. setvbuf() may only be used before the first output, so this is done once at the start.
+*
+*
+*
+* @param void
+*
+* @returns void
+*
+*/
+inline void daemon_stdio(void)
+{
+	setvbuf(stdout, NULL, _IOLBF, 0);
+}
+
+/*! @brief blocks SIGALRM, SIGTERM, SIGINT and SIGHUP in this thread and the threads started after it and returns a
+*	signalfd that reads them instead
+*
+*
+*
+* @param void
+*
+* @returns int, the signalfd, -1 on failure
+*
+*/
+inline int daemon_signals(void)
+{
+	sigset_t set;
+	sigemptyset(&set);
+	sigaddset(&set, SIGALRM);
+	sigaddset(&set, SIGTERM);
+	sigaddset(&set, SIGINT);
+	sigaddset(&set, SIGHUP);
+	if(pthread_sigmask(SIG_BLOCK, &set, NULL) != 0)
+	{
+		perror("pthread_sigmask()");
+		return -1;
+	}
+	int fd = signalfd(-1, &set, SFD_CLOEXEC);
+	if(fd == -1)
+	{
+		perror("signalfd()");
+	}
+	return fd;
+}
+
+/*! @brief tells systemd about the state of the service, e.g. "READY=1", "STOPPING=1" or "WATCHDOG=1". Does nothing
+*	when not started by systemd with Type=notify (no NOTIFY_SOCKET).
+*
+*
+*
+* @param const string& _state
+*
+* @returns bool, false if there is no NOTIFY_SOCKET or it could not be sent
+*
+*/
+inline bool daemon_notify(const string& _state)
+{
+	const char* e = getenv("NOTIFY_SOCKET");
+	if(!e || (e[0] != '/' && e[0] != '@') || strlen(e) >= sizeof(((struct sockaddr_un*)0)->sun_path))
+	{
+		return false;
+	}
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, e);
+	socklen_t len = offsetof(struct sockaddr_un, sun_path) + strlen(e);
+	if(e[0] == '@')
+	{
+		// an abstract socket, the name starts with a 0 byte
+		addr.sun_path[0] = 0;
+	}
+	int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if(fd == -1)
+	{
+		return false;
+	}
+	bool ok = sendto(fd, _state.data(), _state.size(), MSG_NOSIGNAL, (struct sockaddr*)&addr, len) == (ssize_t)_state.size();
+	close(fd);
+	return ok;
+}
+
+/*! @brief whether systemd wants WATCHDOG=1 notifications
+*
+*
+*
+* @param void
+*
+* @returns bool
+*
+*/
+inline bool daemon_watchdog(void)
+{
+	const char* usec = getenv("WATCHDOG_USEC");
+	const char* pid = getenv("WATCHDOG_PID");
+	return usec && atoll(usec) > 0 && (!pid || atol(pid) == getpid());
+}
+
+/*! @brief sends stdout and stderr to the end of a log file, called again on SIGHUP to start on a new file after it
+*	was rotated. The buffering of stdout stays as daemon_stdio() set it.
+*
+*
+*
+* @param const string& _path
+*
+* @returns bool
+*
+*/
+inline bool daemon_log_open(const string& _path)
+{
+	int fd = open(_path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+	if(fd == -1)
+	{
+		perror(("open() " + _path).c_str());
+		return false;
+	}
+	fflush(stdout);
+	cout.flush();
+	if(dup2(fd, STDOUT_FILENO) == -1 || dup2(fd, STDERR_FILENO) == -1)
+	{
+		perror("dup2()");
+		close(fd);
+		return false;
+	}
+	close(fd);
+	return true;
+}
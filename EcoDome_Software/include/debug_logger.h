@@ -4,11 +4,24 @@
 * debug_logger.h
 * Author:		Hans V. Rasmussen
 * Created:		07/05-2018 13:00
-* Modified:		16/05-2018 14:30
-* Version:		1.2
+* Modified:		19/10-2026 06:04
+* Version:		1.15
 *
 * Description:
 *	This header includes functionality to syncronize threads, as well as controlling the terminal and logging data to a file.
+*	The log is binary since version 1.3, use logconv to turn it into TSV or CSV.
+*	Since version 1.4 the log is written by a background thread in 4 KiB pages, see logwriter.h.
+*	Since version 1.5 the log is rotated by age and size, and the closed logs are gzip compressed.
+*	Since version 1.6 rollups at 1 minute, 1 hour and 1 day are kept while logging, see rollup.h.
+*	Since version 1.7 the config has the settings of the flight recorder, see flightrec.h.
+*	Since version 1.8 the last days of all channels are kept in memory, see tsstore.h.
+*	Since version 1.9 the config has the rolling windows of the sensors, see slidewin.h.
+*	Since version 1.10 the config has where the metrics are served, see metrics.h.
+*	Since version 1.11 the config has the telemetry segment, see telemetry.h.
+*	Since version 1.12 the config has the control socket, see ctlserver.h.
+*	Since version 1.13 the terminal controller can run without the terminal, for the daemon mode of daemon.h.
+*	Since version 1.14 the terminal is written by a background thread that never holds up the others, see termqueue.h.
+*	Since version 1.15 a rotated log is closed by the compressor thread also when it is not compressed.
 *
 * NOTE:
 *
@@ -25,6 +38,11 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <ctype.h>
+#include <string.h>
 #include <thread>
 #include <mutex>
 #include<semaphore.h>
@@ -35,6 +53,12 @@
 #include <libconfig.h++>
 
 #include "mythread.h"
+#include "binlog.h"
+#include "logwriter.h"
+#include "rollup.h"
+#include "tsstore.h"
+#include "slidewin.h"
+#include "termqueue.h"
 
 using namespace std;
 using namespace libconfig;
@@ -43,6 +67,7 @@ using namespace libconfig;
 // ###############################################		DEFINES		#################################################### //
 
 #define TIME_STEP		10
+#define LOG_SEQUENCE_FILE	LOG_DIR "logseq"		// number of the next log
 
 mutex mux_log;
 
@@ -54,6 +79,19 @@ struct destemp
 	float T_min = 0;
 };
 
+struct log_settings
+{
+	int sync_interval = LOG_SYNC_INTERVAL;	// seconds between fdatasync(), the most a power cut can lose
+	string staging;							// folder on a tmpfs for a copy of the log, empty for none
+	int rotate_hours = 24;					// age at which a new log is started, 0 for never
+	int rotate_mb = 16;						// size at which a new log is started, 0 for no limit
+	bool compress = true;					// gzip closed logs
+	bool rollup = true;						// keep the rollups of rollup.h
+	int flight_minutes = 30;				// steps kept by the flight recorder of flightrec.h, 0 for none
+	int flight_sync = 10;					// seconds between msync() of the flight recorder
+	int history_days = TS_RETENTION_DAYS;	// days of all channels kept in memory by tsstore.h, 0 for none
+};
+
 
 // ###############################################		CLASSES		#################################################### //
 
@@ -141,6 +179,9 @@ public:
 				const Setting &dataset = progdat[i];
 				dataset.lookupValue("dataset" + to_string(i+1), url);
 				tmp_path = _path + "/dataset" + to_string(i+1) + "/";
+				// weight in the ensemble is optional
+				_progtmp.weight = 1;
+				dataset.lookupValue("weight", _progtmp.weight);
 
 				// Load tmp into our string vector
 			    for(int k = 0; k < 2; ++k)
@@ -238,12 +279,164 @@ public:
 		}
 	}
 
+	/*! @brief looks in the config for how the log is written, both settings are optional
+	*
+	* 
+	*
+	* @param log_settings&
+	*
+	* @returns void
+	*
+	*/
+	void get_logsettings(log_settings& _ls)
+	{
+		const Setting& root = cfg.getRoot();
+		try
+		{
+			const Setting& log = root["log"];
+			log.lookupValue("sync_interval", _ls.sync_interval);
+			log.lookupValue("staging", _ls.staging);
+			log.lookupValue("rotate_hours", _ls.rotate_hours);
+			log.lookupValue("rotate_mb", _ls.rotate_mb);
+			log.lookupValue("compress", _ls.compress);
+			log.lookupValue("rollup", _ls.rollup);
+			log.lookupValue("flight_minutes", _ls.flight_minutes);
+			log.lookupValue("flight_sync", _ls.flight_sync);
+			log.lookupValue("history_days", _ls.history_days);
+		}
+		catch(const SettingNotFoundException &nfex)
+		{
+			// Ignore, the defaults are used.
+		}
+	}
+
+	/*! @brief looks in the config for the rolling windows of the sensors, the list is optional
+	*
+	* 
+	*
+	* @param vector< slide_spec >&
+	*
+	* @returns void
+	*
+	*/
+	void get_windows(vector< slide_spec >& _sw)
+	{
+		const Setting& root = cfg.getRoot();
+		try
+		{
+			const Setting& windows = root["windows"];
+			int count = windows.getLength();
+			for(int i = 0; i < count; i++)
+			{
+				slide_spec spec;
+				if(!windows[i].lookupValue("channel", spec.channel) || !windows[i].lookupValue("seconds", spec.seconds))
+				{
+					cout << "Rolling window " << i << " needs a channel and seconds, it is left out." << endl;
+					continue;
+				}
+				windows[i].lookupValue("resolution", spec.resolution);
+				_sw.push_back(spec);
+			}
+		}
+		catch(const SettingNotFoundException &nfex)
+		{
+			// Ignore, there are no windows.
+		}
+	}
+
+	/*! @brief looks in the config for where the metrics are served, a port on 127.0.0.1 or the path of a Unix
+	*	socket. Empty if there is no metrics group, then they are not served.
+	*
+	* 
+	*
+	* @param string&
+	*
+	* @returns void
+	*
+	*/
+	void get_metrics(string& _listen)
+	{
+		const Setting& root = cfg.getRoot();
+		try
+		{
+			root["metrics"].lookupValue("listen", _listen);
+		}
+		catch(const SettingNotFoundException &nfex)
+		{
+			// Ignore, the metrics are not served.
+		}
+	}
+
+	/*! @brief looks in the config for the telemetry segment, its shm_open() name and the steps in its ring. The
+	*	name is left empty if there is no telemetry group, then there is no segment.
+	*
+	* 
+	*
+	* @param string&, int&
+	*
+	* @returns void
+	*
+	*/
+	void get_telemetry(string& _name, int& _ticks)
+	{
+		const Setting& root = cfg.getRoot();
+		try
+		{
+			const Setting& tel = root["telemetry"];
+			tel.lookupValue("name", _name);
+			tel.lookupValue("ticks", _ticks);
+		}
+		catch(const SettingNotFoundException &nfex)
+		{
+			// Ignore, there is no segment.
+		}
+	}
+
+	/*! @brief looks in the config for the path of the control socket of ctlserver.h. Empty if there is no control
+	*	group, then there is no socket.
+	*
+	* 
+	*
+	* @param string&
+	*
+	* @returns void
+	*
+	*/
+	void get_control(string& _socket)
+	{
+		const Setting& root = cfg.getRoot();
+		try
+		{
+			root["control"].lookupValue("socket", _socket);
+		}
+		catch(const SettingNotFoundException &nfex)
+		{
+			// Ignore, there is no socket.
+		}
+	}
+
 private:
 	string conf_file;
 	Config cfg;
 };
 
 
+	/*! @brief	Class that logs the measurements to a binary log in ./logs/, see binlog.h for the format.
+	*	The log is rotated by age and size, closed logs are compressed in the background.
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	vector< log_channel > ch;
+	*	ch.push_back(log_channel("in_soil__"));
+	*	LOGGER log(ch);
+	*	float v[] = {21.5};
+	*	log.update(v, 1);
+	*	log.close();					// writes what is still in memory
+	* @endcode
+	*
+	*/
 class LOGGER
 {
 public:
@@ -251,89 +444,155 @@ public:
 	*
 	* 
 	*
-	* @param vector< string > _det
+	* @param const vector< log_channel >& _channels, const log_settings& _settings
 	*
 	* @returns void
 	*
 	*/
-    LOGGER(vector < string >* _des) : data_descriptor(*_des)
+    LOGGER(const vector< log_channel >& _channels, const log_settings& _settings = log_settings()) : channels(_channels), settings(_settings)
     {
-    	logdata.open (prepare_file_name());
-    	logdata << "Test started at " << currentDateTime() << endl << "Time step is " << TIME_STEP << endl << "TimeStamp_DateTime";
-		for (int i=0; i < data_descriptor.size(); i++)
+		// Make sure that there is a folder for the logs
+		if(mkdir(LOG_DIR, 0755) == -1 && errno != EEXIST)
 		{
-			logdata << "\t" << data_descriptor[i];
+			perror("mkdir() " LOG_DIR);
+			exit(1);
+		}
+
+		// logs of a run that did not close its log, before numbering the new one
+		if(!settings.staging.empty())
+		{
+			int recovered = log_recover_staged(settings.staging, LOG_DIR);
+			if(recovered)
+			{
+				cout << "Recovered " << recovered << " log(s) from " << settings.staging << endl;
+			}
 		}
-		logdata << endl;
+
+		sequence = load_sequence();
+		// the thread also closes the rotated logs when they are not compressed
+		compressor.start();
+		if(settings.compress)
+		{
+			// the last log of the previous run is closed but not compressed yet
+			if(sequence > 0 && file_exists(file_name(sequence - 1)))
+			{
+				compressor.add(NULL, file_name(sequence - 1));
+			}
+		}
+		open_next();
+		if(settings.rollup)
+		{
+			rollup = new LOG_ROLLUP(channels);
+		}
+		if(settings.history_days > 0)
+		{
+			vector< string > names;
+			for(size_t c = 0; c < channels.size(); c++)
+			{
+				names.push_back(channels[c].name);
+			}
+			history = new TS_STORE(names, (int64_t)settings.history_days * 86400);
+		}
+    }
+
+    ~LOGGER()
+    {
+    	close();
     }
 
-    /*! @brief Function to update the logfile
+    /*! @brief Function to update the logfile, starts a new log first when the current one is too old or too big
 	*
 	* 
 	*
-	* @param vector< string > _det
+	* @param const float* _dat (one value per channel, in the order given to the constructor), size_t _n
 	*
 	* @returns void
 	*
 	*/
-    void update(vector< string > _dat)
+    void update(const float* _dat, size_t _n)
     {
-		logdata << currentDateTime();
-        for(int i=0; i < _dat.size(); i++)
+    	if(!logdata)
+    	{
+    		return;
+    	}
+    	if((settings.rotate_hours > 0 && time(0) - opened >= settings.rotate_hours * 3600)
+    		|| (settings.rotate_mb > 0 && logdata->size() >= (uint64_t)settings.rotate_mb * 1024 * 1024))
+    	{
+    		rotate();
+    	}
+		logdata->append(_dat, _n);
+		time_t now = time(0);
+		if(rollup)
+		{
+			rollup->add(now, _dat, _n);
+		}
+		if(history)
 		{
-			logdata << "\t" << _dat[i];
+			history->append(now, _dat, _n);
 		}
-        logdata << endl;
     }
 
+    /*! @brief Function to write what is left to the card and close the log, prints what the writer did. The log
+	*	is compressed at the next start.
+	*
+	* 
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+    void close(void)
+    {
+    	if(!logdata)
+    	{
+    		return;
+    	}
+    	logdata->close();
+    	log_writer_stats s = logdata->get_stats();
+    	cout << "Log closed: " << s.records << " records, " << s.dropped << " dropped, " << s.writes << " writes, " << s.syncs << " syncs, "
+    		<< s.errors << " errors, longest flush " << s.flush_max * 1000 << " ms" << endl;
+    	delete logdata;
+    	logdata = NULL;
+    	compressor.stop();
+    	delete rollup;
+    	rollup = NULL;
+    	delete history;
+    	history = NULL;
+    }
 
-protected:
-
-private:
-
-    /*! @brief Function to print the date and time
+    /*! @brief statistics of the current log
 	*
 	* 
 	*
 	* @param void
 	*
-	* @returns const string
+	* @returns log_writer_stats
 	*
 	*/
-    const string currentDateTime()
-	{
-    	time_t     now = time(0);
-    	struct tm  tstruct;
-    	char       buf[80];
-    	tstruct = *localtime(&now);
-    	// Visit http://en.cppreference.com/w/cpp/chrono/c/strftime
-    	// for more information about date/time format
-    	strftime(buf, sizeof(buf), "%Y-%m-%d %X", &tstruct);
-
-    	return buf;
-	}
+    log_writer_stats get_stats(void)
+    {
+    	return logdata ? logdata->get_stats() : log_writer_stats();
+    }
 
-	/*! @brief Function to print the time
+    /*! @brief the in-memory history of the channels, for trends and statistics without reading the logs
 	*
 	* 
 	*
 	* @param void
 	*
-	* @returns const string
+	* @returns TS_STORE*, NULL if it is turned off
 	*
 	*/
-    const string currentTime()
-	{
-    	time_t     now = time(0);
-    	struct tm  tstruct;
-    	char       buf[80];
-    	tstruct = *localtime(&now);
-    	// Visit http://en.cppreference.com/w/cpp/chrono/c/strftime
-    	// for more information about date/time format
-    	strftime(buf, sizeof(buf), "%X", &tstruct);
-
-    	return buf;
-	}
+    TS_STORE* get_history(void)
+    {
+    	return history;
+    }
+
+
+protected:
+
+private:
 
     /*! @brief Function to check if file exists
 	*
@@ -350,56 +609,124 @@ private:
 		return (stat (name.c_str(), &buffer) == 0);
 	}
 
-    /*! @brief Function to check if the folder to store old log data exists, and create it if not
+	string file_name(unsigned long _n)
+	{
+		return LOG_DIR "logdata" + to_string(_n) + LOG_EXTENSION;
+	}
+
+    /*! @brief Function to find the number of the next log. It is kept in LOG_SEQUENCE_FILE, only when that is
+	*	missing (the first start, or the file was lost) the log folder is read once to find the highest number.
 	*
 	* 
 	*
 	* @param void
 	*
-	* @returns void
+	* @returns unsigned long
 	*
 	*/
-	string prepare_file_name(void)
+	unsigned long load_sequence(void)
 	{
-		// Make sure that there is file structure for old logs
-	    struct stat statbuf;
-		int isDir = 0;
-		if (stat("./logs/", &statbuf) != -1) 
+		unsigned long n = 0;
+		FILE* f = fopen(LOG_SEQUENCE_FILE, "r");
+		if(!f || fscanf(f, "%lu", &n) != 1)
 		{
-			if (S_ISDIR(statbuf.st_mode))
+			n = 0;
+			DIR* dir = opendir(LOG_DIR);
+			struct dirent* ent;
+			while(dir && (ent = readdir(dir)) != NULL)
 			{
-	    		isDir = 1;
+				// logdataN.txt, logdataN.ecl and logdataN.ecl.gz
+				if(strncmp(ent->d_name, "logdata", 7) == 0 && isdigit(ent->d_name[7]))
+				{
+					unsigned long k = strtoul(ent->d_name + 7, NULL, 10) + 1;
+					n = k > n ? k : n;
+				}
 			}
-		}	
-		else 
-		{
-			if(system("mkdir ./logs/"))
+			if(dir)
 			{
-				exit(1);
+				closedir(dir);
 			}
 		}
+		if(f)
+		{
+			fclose(f);
+		}
+		return n;
+	}
 
-		// if a logfile already exists, copy it to a safe space
-		int file_counter = 0;
-		bool file_count = 1;
+	// written to a temporary file and renamed, not synced as a number that is behind is corrected by open_next()
+	void save_sequence(unsigned long _n)
+	{
+		FILE* f = fopen(LOG_SEQUENCE_FILE ".tmp", "w");
+		if(!f)
+		{
+			return;
+		}
+		bool ok = fprintf(f, "%lu\n", _n) > 0;
+		ok = (fflush(f) == 0) && ok;
+		fclose(f);
+		if(!ok || rename(LOG_SEQUENCE_FILE ".tmp", LOG_SEQUENCE_FILE) == -1)
+		{
+			perror("LOGGER::save_sequence()");
+		}
+	}
+
+    /*! @brief Function to open the log with the next number
+	*
+	* 
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void open_next(void)
+	{
+		// a number in use means the sequence file is behind, e.g. after a power cut
+		while(file_exists(file_name(sequence)) || file_exists(file_name(sequence) + LOG_COMPRESSED)
+			|| file_exists(LOG_DIR "logdata" + to_string(sequence) + ".txt"))
+		{
+			sequence++;
+		}
+		string fname = file_name(sequence);
+		save_sequence(++sequence);
 
-		while(file_count)
+		logdata = new LOG_ASYNC_WRITER(settings.sync_interval, settings.staging);
+		opened = time(0);
+		if(!logdata->open(fname, channels, TIME_STEP))
 		{
-			if(file_exists("./logs/logdata" + to_string(file_counter) + ".txt"))
-			{
-				file_counter++;
-			}
-			else
-			{
-				file_count = 0;
-			}
+			cout << "Could not create the log file, nothing will be logged" << endl;
 		}
+		current = fname;
+	}
 
-		return "./logs/logdata" + to_string(file_counter) + ".txt";
+    /*! @brief Function to start a new log, the old one is closed (and compressed if log.compress is set) by the
+	*	compressor thread so the tick does not wait for its last write
+	*
+	* 
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void rotate(void)
+	{
+		// the final sync of the old log is done by the compressor thread, not in this tick
+		compressor.add(logdata, current, settings.compress);
+		logdata = NULL;
+		open_next();
 	}
 
-    vector < string > data_descriptor;
-    ofstream logdata;
+    vector < log_channel > channels;
+    log_settings settings;
+    LOG_ASYNC_WRITER* logdata = NULL;
+    LOG_COMPRESSOR compressor;
+    LOG_ROLLUP* rollup = NULL;
+    TS_STORE* history = NULL;				// NULL if log.history_days is 0
+    string current;
+    unsigned long sequence = 0;
+    time_t opened = 0;
 	int tcounter = 0;
 	std::mutex data_allocation_mutex;
 
@@ -424,17 +751,17 @@ public:
 	*
 	* 
 	*
-	* @param void
+	* @param bool _interactive, false for a daemon: plain lines without the prompt, the thread is not started
 	*
 	* @returns void
 	*
 	*/
-	TERMINAL_CONTROLLER()
+	TERMINAL_CONTROLLER(bool _interactive = true) : output(_interactive)
 	{
-
+		output.start();
 	}
 
-    /*! @brief Function to write to terminal
+    /*! @brief Function to write to terminal, never waits for it: the message is queued for the output thread
 	*
 	* 
 	*
@@ -445,11 +772,21 @@ public:
 	*/
 	void term_write(string _str)
 	{
-		lock_guard <mutex> terminal_lock(terminal_mutex);
+		output.push(_str, TERMQ_WRITE);
+	}
 
-		cout << '\b' << '\b';
-		cout << _str;
-		cout << "\n> ";
+    /*! @brief Function that prints the messages still waiting and stops the output thread, at the end of the program
+	*
+	* 
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void term_flush(void)
+	{
+		output.close();
 	}
 
     /*! @brief Function to retrieve current program status, should be checked by all while(1) loops.
@@ -467,6 +804,21 @@ public:
 		return program_operation_state;
 	}
 
+    /*! @brief Function that stops the program, the threads end at their next iteration
+	*
+	* 
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void stop(void)
+	{
+		lock_guard <mutex> pos_lock(pos_mutex);
+		program_operation_state = false;
+	}
+
 protected:
 	/** Implement this method in your subclass with the code you want your thread to run. */
     void InternalThreadEntry()
@@ -474,7 +826,18 @@ protected:
 		help_msg();
 		while(this->pos())
 		{
-			getline(cin, terminal_input);
+			// wait for a line at most a second at a time, so the thread ends when the program is stopped otherwise
+			struct pollfd p = {STDIN_FILENO, POLLIN, 0};
+			if(cin.rdbuf()->in_avail() <= 0 && poll(&p, 1, 1000) <= 0)
+			{
+				continue;
+			}
+			if(!getline(cin, terminal_input))
+			{
+				// stdin is closed (e.g. /dev/null or a service), stop with SIGTERM instead
+				term_write_control("No more terminal input, commands are off.");
+				return;
+			}
 
 			if(terminal_input == "help" || terminal_input == "h" || terminal_input == "?")
 			{
@@ -483,9 +846,7 @@ protected:
 			else if(terminal_input == "q" || terminal_input == "quit" || terminal_input == "exit")
 			{
 				term_write_control("Program shutting down on next iteration...");
-				pos_mutex.lock();
-				program_operation_state = false;
-				pos_mutex.unlock();
+				stop();
 			}
 			else
 			{
@@ -526,17 +887,14 @@ private:
 	*/
 	void term_write_control(string _str)
 	{
-		lock_guard <mutex> terminal_lock(terminal_mutex);
-
-		cout << endl << _str << endl << "> ";
+		output.push(_str, TERMQ_CONTROL);
 	}
 
 	string terminal_input;
+	TERM_QUEUE output;
 
 	std::mutex pos_mutex;
 	bool program_operation_state = true;
-
-	std::mutex terminal_mutex;
 };
 
 
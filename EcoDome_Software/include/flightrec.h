@@ -0,0 +1,527 @@
+#pragma once
+
+/*
+* flightrec.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:11
+* Modified:		19/10-2026 05:58
+* Version:		1.2
+*
+* Description:
+*	This header includes the flight recorder: a fixed size ring file (./logs/flight.rec) that holds the full state
+*	of the last control steps, the measurements, u, r, the integral, the actuators and how long every stage of the
+*	step took. The file is memory mapped, a step is committed with plain stores into the mapping, so if the program
+*	dies the kernel still has every committed step and writes it to the card. A thread msync()s the ring every
+*	few seconds, so a power cut loses at most that much.
+*	FLIGHT_READER and the flightdump tool read the ring after a crash or while the program runs.
+*
+* NOTE:
+*	Every slot starts and ends with the number of its step. A slot is written start number first, then the values,
+*	then the end number, so a slot where the two differ was being written when the program died (or is being
+*	written right now) and is left out by the reader.
+*	The ring is continued at the next start, so the steps before a crash are kept until they are overwritten.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "mythread.h"
+#include "binlog.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define FLIGHT_FILE				LOG_DIR "flight.rec"
+#define FLIGHT_MAGIC			"ECOFLT1"
+#define FLIGHT_VERSION			1
+#define FLIGHT_HEADER_SIZE		4096		// the slots start on the second page
+#define FLIGHT_MINUTES			30			// how far back the ring goes
+#define FLIGHT_SYNC_INTERVAL	10			// seconds between msync()
+
+// actuator bits of flight_record::actuators
+#define FLIGHT_STONE_FAN		0x1
+#define FLIGHT_MAIN_FAN			0x2			// main fan on and window open
+#define FLIGHT_FAN_HIGH			0x4			// main fan relay on full speed
+
+// stages of a control step, flight_record::stage_us
+enum
+{
+	FLIGHT_STAGE_PROGNOSIS = 0,		// picking up a new prognosis
+	FLIGHT_STAGE_SENSORS,			// waiting for the sensors to be read
+	FLIGHT_STAGE_MODELS,			// corrector and nowcaster
+	FLIGHT_STAGE_TRAJECTORY,		// correcting, blending and the reference trajectory
+	FLIGHT_STAGE_CONTROL,			// the PI controller
+	FLIGHT_STAGE_PLANT,				// fans, window and stone beds
+	FLIGHT_STAGE_STEP,				// the whole step
+	FLIGHT_STAGES
+};
+const char* const flight_stage_names[FLIGHT_STAGES] = {"prognosis", "sensors", "models", "trajectory", "control", "plant", "step"};
+
+// start of the ring file, the rest of the first page is unused
+struct flight_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t slots;
+	uint32_t time_step;				// [s]
+	int64_t created;				// [unix time]
+	uint64_t head;					// number of the newest committed step
+};
+
+// one control step, 128 bytes so two slots never share a cache line and a slot never crosses a page
+struct flight_record
+{
+	uint64_t seq_begin;				// number of the step, written first
+	int64_t epoch_us;				// start of the step
+	int64_t mono_ns;				// start of the step, CLOCK_MONOTONIC
+	float T_inside;
+	float T_in_window;
+	float T_out1;
+	float T_out2;
+	float T_outmean;
+	float T_stone1;
+	float T_stone2;
+	float T_stoneF;
+	float T_stonemean;
+	float T_extra1;
+	float u;
+	float r;
+	float y;
+	float integral;
+	float nowcast_1h;
+	uint32_t actuators;				// FLIGHT_* bits
+	uint32_t stage_us[FLIGHT_STAGES];
+	uint32_t reserved;
+	uint64_t seq_end;				// number of the step, written last
+};
+static_assert(sizeof(flight_record) == 128, "flight_record must be 128 bytes");
+static_assert(FLIGHT_HEADER_SIZE % sizeof(flight_record) == 0, "the slots must not cross a page");
+
+
+// ###############################################		FUNCTIONS		#################################################### //
+
+/*! @brief writes step _s to its slot of a ring: start number, values, end number
+*
+*
+*
+* @param flight_record* _slot, uint64_t _s, const flight_record& _rec
+*
+* @returns void
+*
+*/
+inline void flight_write_slot(flight_record* _slot, uint64_t _s, const flight_record& _rec)
+{
+	__atomic_store_n(&_slot->seq_begin, _s, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy((uint8_t*)_slot + sizeof(_slot->seq_begin), (const uint8_t*)&_rec + sizeof(_rec.seq_begin),
+		sizeof(flight_record) - sizeof(_slot->seq_begin) - sizeof(_slot->seq_end));
+	__atomic_store_n(&_slot->seq_end, _s, __ATOMIC_RELEASE);
+}
+
+/*! @brief copies the whole steps of a ring newer than _after, oldest first. A slot is copied between reading its end
+*	and its start number, so a step that is overwritten meanwhile is left out.
+*
+*
+*
+* @param const flight_record* _ring, uint32_t _slots, uint64_t _after, vector< flight_record >& _out
+*
+* @returns size_t, the number of torn slots that were left out
+*
+*/
+inline size_t flight_read_ring(const flight_record* _ring, uint32_t _slots, uint64_t _after, vector< flight_record >& _out)
+{
+	_out.clear();
+	size_t torn = 0;
+	for(uint32_t i = 0; i < _slots; i++)
+	{
+		flight_record r;
+		uint64_t e = __atomic_load_n(&_ring[i].seq_end, __ATOMIC_ACQUIRE);
+		memcpy(&r, &_ring[i], sizeof(r));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		uint64_t b = __atomic_load_n(&_ring[i].seq_begin, __ATOMIC_RELAXED);
+		if(b != e)
+		{
+			torn++;
+			continue;
+		}
+		if(e > _after && e % _slots == i)
+		{
+			r.seq_begin = r.seq_end = e;
+			_out.push_back(r);
+		}
+	}
+	sort(_out.begin(), _out.end(), [](const flight_record& a, const flight_record& b)
+	{
+		return a.seq_end < b.seq_end;
+	});
+	return torn;
+}
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Writes the control steps to the flight recorder ring
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	FLIGHT_RECORDER fr;
+	*	fr.open(FLIGHT_FILE, FLIGHT_MINUTES, TIME_STEP);
+	*	flight_record rec;
+	*	rec.epoch_us = ...; rec.u = u; ...
+	*	fr.commit(rec);					// every step
+	*	fr.close();
+	* @endcode
+	*
+	*/
+class FLIGHT_RECORDER : public MyThreadClass
+{
+public:
+	/*! @brief Constructor
+	*
+	*
+	*
+	* @param int _sync_interval [s]
+	*
+	* @returns void
+	*
+	*/
+	FLIGHT_RECORDER(int _sync_interval = FLIGHT_SYNC_INTERVAL) : sync_interval(_sync_interval > 0 ? _sync_interval : 1)
+	{
+
+	}
+
+	~FLIGHT_RECORDER()
+	{
+		close();
+	}
+
+	/*! @brief maps the ring file and starts the msync() thread. A ring of the same size is continued after its
+	*	newest step, anything else is started over. The file is allocated in full here, so a full card shows up
+	*	now and not as a SIGBUS in commit().
+	*
+	*
+	*
+	* @param const string& _fpath, int _minutes, int _time_step [s]
+	*
+	* @returns bool
+	*
+	*/
+	bool open(const string& _fpath, int _minutes, int _time_step)
+	{
+		close();
+		uint32_t slots = (_minutes * 60) / _time_step;
+		slots = slots < 2 ? 2 : slots;
+		size_t len = FLIGHT_HEADER_SIZE + slots * sizeof(flight_record);
+
+		fd = ::open(_fpath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if(fd == -1)
+		{
+			perror(("open() " + _fpath).c_str());
+			return false;
+		}
+		struct stat st;
+		bool fresh = fstat(fd, &st) == -1 || (size_t)st.st_size != len;
+		if(fresh && (ftruncate(fd, 0) == -1 || posix_fallocate(fd, 0, len) != 0))
+		{
+			perror("FLIGHT_RECORDER::open()");
+			::close(fd);
+			fd = -1;
+			return false;
+		}
+		void* m = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if(m == MAP_FAILED)
+		{
+			perror("mmap()");
+			::close(fd);
+			fd = -1;
+			return false;
+		}
+		base = (uint8_t*)m;
+		map_len = len;
+		hdr = (flight_header*)base;
+		ring = (flight_record*)(base + FLIGHT_HEADER_SIZE);
+
+		if(fresh || memcmp(hdr->magic, FLIGHT_MAGIC, sizeof(hdr->magic)) != 0 || hdr->version != FLIGHT_VERSION
+			|| hdr->record_size != sizeof(flight_record) || hdr->slots != slots)
+		{
+			memset(base, 0, len);
+			memcpy(hdr->magic, FLIGHT_MAGIC, sizeof(hdr->magic));
+			hdr->version = FLIGHT_VERSION;
+			hdr->record_size = sizeof(flight_record);
+			hdr->slots = slots;
+			hdr->time_step = _time_step;
+			hdr->created = time(0);
+			hdr->head = 0;
+			msync(base, len, MS_SYNC);
+		}
+
+		// continue after the newest whole step, the head may be older if the program died between the two stores
+		seq = hdr->head;
+		for(uint32_t i = 0; i < slots; i++)
+		{
+			if(ring[i].seq_begin == ring[i].seq_end && ring[i].seq_end > seq)
+			{
+				seq = ring[i].seq_end;
+			}
+		}
+		// the pages are touched now, not at the first steps
+		for(size_t p = 0; p < len; p += 4096)
+		{
+			((volatile uint8_t*)base)[p] = base[p];
+		}
+
+		synced = seq;
+		running = true;
+		if(!StartInternalThread())
+		{
+			perror("FLIGHT_RECORDER::open()");
+			running = false;
+			unmap();
+			return false;
+		}
+		started = true;
+		return true;
+	}
+
+	/*! @brief commits one step to the ring, plain stores into the mapping and no system call. The numbers of the
+	*	step in _rec are ignored, its time stamps are the caller's.
+	*
+	*
+	*
+	* @param const flight_record& _rec
+	*
+	* @returns uint64_t, the number of the step, 0 if the recorder is not open
+	*
+	*/
+	uint64_t commit(const flight_record& _rec)
+	{
+		if(!ring)
+		{
+			return 0;
+		}
+		uint64_t s = seq + 1;
+		flight_write_slot(ring + s % hdr->slots, s, _rec);
+		__atomic_store_n(&hdr->head, s, __ATOMIC_RELEASE);
+		seq = s;
+		return s;
+	}
+
+	/*! @brief stops the msync() thread, syncs the ring a last time and unmaps it
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void close(void)
+	{
+		if(started)
+		{
+			fr_mutex.lock();
+			running = false;
+			fr_mutex.unlock();
+			fr_cond.notify_all();
+			WaitForInternalThreadToExit();
+			started = false;
+		}
+		unmap();
+	}
+
+	// number of the newest committed step
+	uint64_t get_seq(void) const
+	{
+		return seq;
+	}
+
+protected:
+	/** Implement this method in your subclass with the code you want your thread to run. */
+	void InternalThreadEntry()
+	{
+		unique_lock<mutex> fr_lock(fr_mutex);
+		while(running)
+		{
+			fr_cond.wait_for(fr_lock, chrono::seconds(sync_interval));
+			// only when something was committed, an idle ring costs no writes to the card
+			uint64_t h = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+			if(h != synced)
+			{
+				fr_lock.unlock();
+				if(msync(base, map_len, MS_SYNC) == -1)
+				{
+					perror("FLIGHT_RECORDER msync()");
+				}
+				fr_lock.lock();
+				synced = h;
+			}
+		}
+	}
+
+private:
+	void unmap(void)
+	{
+		if(base)
+		{
+			msync(base, map_len, MS_SYNC);
+			munmap(base, map_len);
+		}
+		if(fd != -1)
+		{
+			::close(fd);
+		}
+		base = NULL;
+		hdr = NULL;
+		ring = NULL;
+		map_len = 0;
+		fd = -1;
+	}
+
+	int sync_interval;
+	int fd = -1;
+	uint8_t* base = NULL;
+	size_t map_len = 0;
+	flight_header* hdr = NULL;
+	flight_record* ring = NULL;
+	uint64_t seq = 0;				// number of the newest committed step, only used by the committing thread
+	uint64_t synced = 0;			// head at the last msync()
+	bool running = false;
+	bool started = false;
+
+	mutex fr_mutex;
+	condition_variable fr_cond;
+};
+
+
+	/*! @brief	Reads the flight recorder ring, after a crash or while the program writes it
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	FLIGHT_READER rd;
+	*	rd.open(FLIGHT_FILE);
+	*	vector< flight_record > steps;
+	*	rd.read(0, steps);				// all whole steps, oldest first
+	* @endcode
+	*
+	*/
+class FLIGHT_READER
+{
+public:
+	FLIGHT_READER()
+	{
+
+	}
+
+	~FLIGHT_READER()
+	{
+		close();
+	}
+
+	/*! @brief maps a ring file read only and checks its header
+	*
+	*
+	*
+	* @param const string& _fpath
+	*
+	* @returns bool
+	*
+	*/
+	bool open(const string& _fpath)
+	{
+		close();
+		int fd = ::open(_fpath.c_str(), O_RDONLY);
+		if(fd == -1)
+		{
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) == -1 || (size_t)st.st_size < FLIGHT_HEADER_SIZE)
+		{
+			::close(fd);
+			return false;
+		}
+		void* m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if(m == MAP_FAILED)
+		{
+			perror("mmap()");
+			return false;
+		}
+		base = (const uint8_t*)m;
+		map_len = st.st_size;
+		hdr = (const flight_header*)base;
+		if(memcmp(hdr->magic, FLIGHT_MAGIC, sizeof(hdr->magic)) != 0 || hdr->version != FLIGHT_VERSION
+			|| hdr->record_size != sizeof(flight_record) || FLIGHT_HEADER_SIZE + (size_t)hdr->slots * sizeof(flight_record) > map_len)
+		{
+			cout << _fpath << " is not a flight recorder ring" << endl;
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close(void)
+	{
+		if(base)
+		{
+			munmap((void*)base, map_len);
+		}
+		base = NULL;
+		hdr = NULL;
+		map_len = 0;
+	}
+
+	/*! @brief copies the whole steps newer than _after, oldest first, see flight_read_ring()
+	*
+	*
+	*
+	* @param uint64_t _after, vector< flight_record >& _out
+	*
+	* @returns size_t, the number of torn slots that were left out
+	*
+	*/
+	size_t read(uint64_t _after, vector< flight_record >& _out) const
+	{
+		return flight_read_ring((const flight_record*)(base + FLIGHT_HEADER_SIZE), hdr->slots, _after, _out);
+	}
+
+	const flight_header& header(void) const
+	{
+		return *hdr;
+	}
+
+	// number of the newest committed step
+	uint64_t head(void) const
+	{
+		return __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+	}
+
+private:
+	const uint8_t* base = NULL;
+	size_t map_len = 0;
+	const flight_header* hdr = NULL;
+};
@@ -0,0 +1,442 @@
+#pragma once
+
+/*
+* gorilla.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:26
+* Modified:		19/10-2026 05:43
+* Version:		1.1
+*
+* Description:
+*	This header includes the bit level encoders used to store time series compactly, as described in
+*	"Gorilla: A Fast, Scalable, In-Memory Time Series Database" (Facebook, 2015):
+*	timestamps are stored as delta-of-delta and floats as the XOR with the previous value (or another reference value).
+*
+* NOTE:
+*	Regular timestamps cost 1 bit each, slowly changing temperatures typically 10-20 bits.
+*
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Appends bits to a byte buffer, most significant bit first
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	BITWRITER bw;
+	*	bw.write(5, 3);		// writes '101'
+	* @endcode
+	*
+	*/
+class BITWRITER
+{
+public:
+	BITWRITER() : nbits(0)
+	{
+
+	}
+
+	/*! @brief writes the _n lowest bits of _val
+	*
+	* @param uint64_t _val, int _n (0-64)
+	*
+	* @returns void
+	*
+	*/
+	void write(uint64_t _val, int _n)
+	{
+		while(_n > 0)
+		{
+			if((nbits & 7) == 0)
+			{
+				buf.push_back(0);
+			}
+			int room = 8 - (nbits & 7);
+			int take = _n < room ? _n : room;
+			uint8_t bits = (uint8_t)((_val >> (_n - take)) & ((1u << take) - 1));
+			buf.back() |= bits << (room - take);
+			nbits += take;
+			_n -= take;
+		}
+	}
+
+	void write_bit(bool _b)
+	{
+		write(_b ? 1 : 0, 1);
+	}
+
+	size_t bits(void) const
+	{
+		return nbits;
+	}
+
+	const vector< uint8_t >& bytes(void) const
+	{
+		return buf;
+	}
+
+	void clear(void)
+	{
+		buf.clear();
+		nbits = 0;
+	}
+
+private:
+	vector< uint8_t > buf;
+	size_t nbits;
+};
+
+
+	/*! @brief	Reads bits written by BITWRITER, reading past the end gives zeros
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	BITREADER br(bw.bytes().data(), bw.bytes().size());
+	*	br.read(3);			// 5
+	* @endcode
+	*
+	*/
+class BITREADER
+{
+public:
+	BITREADER(const uint8_t* _buf, size_t _len) : buf(_buf), len(_len), pos(0)
+	{
+
+	}
+
+	uint64_t read(int _n)
+	{
+		uint64_t val = 0;
+		while(_n > 0)
+		{
+			size_t byte = pos >> 3;
+			int room = 8 - (pos & 7);
+			int take = _n < room ? _n : room;
+			uint8_t b = byte < len ? buf[byte] : 0;
+			val = (val << take) | ((b >> (room - take)) & ((1u << take) - 1));
+			pos += take;
+			_n -= take;
+		}
+		return val;
+	}
+
+	bool read_bit(void)
+	{
+		return read(1) != 0;
+	}
+
+	bool overrun(void) const
+	{
+		return pos > len * 8;
+	}
+
+private:
+	const uint8_t* buf;
+	size_t len;
+	size_t pos;
+};
+
+
+	/*! @brief	Delta-of-delta encoder for increasing integer series such as timestamps
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	DOD_ENCODER enc(bw);
+	*	enc.put(t0); enc.put(t0 + 10); enc.put(t0 + 20);	// 64 + 2 + 1 bits
+	* @endcode
+	*
+	*/
+class DOD_ENCODER
+{
+public:
+	DOD_ENCODER(BITWRITER& _bw) : bw(_bw), count(0), prev(0), prev_delta(0)
+	{
+
+	}
+
+	void put(int64_t _val)
+	{
+		if(count++ == 0)
+		{
+			bw.write((uint64_t)_val, 64);
+			prev = _val;
+			return;
+		}
+
+		int64_t delta = _val - prev;
+		int64_t dod = delta - prev_delta;
+		prev = _val;
+		prev_delta = delta;
+
+		// the buckets of the Gorilla paper, values are stored two's complement in the given width
+		if(dod == 0)
+		{
+			bw.write(0, 1);
+		}
+		else if(dod >= -64 && dod <= 63)
+		{
+			bw.write(2, 2);
+			bw.write((uint64_t)dod, 7);
+		}
+		else if(dod >= -256 && dod <= 255)
+		{
+			bw.write(6, 3);
+			bw.write((uint64_t)dod, 9);
+		}
+		else if(dod >= -2048 && dod <= 2047)
+		{
+			bw.write(14, 4);
+			bw.write((uint64_t)dod, 12);
+		}
+		else
+		{
+			bw.write(15, 4);
+			bw.write((uint64_t)dod, 64);
+		}
+	}
+
+private:
+	BITWRITER& bw;
+	size_t count;
+	int64_t prev;
+	int64_t prev_delta;
+};
+
+
+	/*! @brief	Decoder for DOD_ENCODER
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	DOD_DECODER dec(br);
+	*	int64_t t0 = dec.get();
+	* @endcode
+	*
+	*/
+class DOD_DECODER
+{
+public:
+	DOD_DECODER(BITREADER& _br) : br(_br), count(0), prev(0), prev_delta(0)
+	{
+
+	}
+
+	int64_t get(void)
+	{
+		if(count++ == 0)
+		{
+			prev = (int64_t)br.read(64);
+			return prev;
+		}
+
+		int64_t dod = 0;
+		if(!br.read_bit())
+		{
+			dod = 0;
+		}
+		else if(!br.read_bit())
+		{
+			dod = sign_extend(br.read(7), 7);
+		}
+		else if(!br.read_bit())
+		{
+			dod = sign_extend(br.read(9), 9);
+		}
+		else if(!br.read_bit())
+		{
+			dod = sign_extend(br.read(12), 12);
+		}
+		else
+		{
+			dod = (int64_t)br.read(64);
+		}
+
+		prev_delta += dod;
+		prev += prev_delta;
+		return prev;
+	}
+
+private:
+	static int64_t sign_extend(uint64_t _v, int _bits)
+	{
+		uint64_t m = 1ULL << (_bits - 1);
+		return (int64_t)((_v ^ m) - m);
+	}
+
+	BITREADER& br;
+	size_t count;
+	int64_t prev;
+	int64_t prev_delta;
+};
+
+
+	/*! @brief	XOR encoder for float series, a repeated value costs 1 bit
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	XOR_ENCODER enc(bw);
+	*	enc.put(21.5f); enc.put(21.5f); enc.put(21.6f);
+	* @endcode
+	*
+	*/
+class XOR_ENCODER
+{
+public:
+	XOR_ENCODER(BITWRITER& _bw) : bw(_bw), count(0), prev(0), lead(33), trail(0)
+	{
+
+	}
+
+	void put(float _val)
+	{
+		if(count == 0)
+		{
+			uint32_t v;
+			memcpy(&v, &_val, sizeof(v));
+			bw.write(v, 32);
+			prev = v;
+			count++;
+			return;
+		}
+		float p;
+		memcpy(&p, &prev, sizeof(p));
+		put(_val, p);
+	}
+
+	/*! @brief writes _val as the XOR with _ref instead of the previous value, used when a better guess is known,
+	*	e.g. the same point in the last series. The decoder must be given the same _ref.
+	*
+	* @param float _val, float _ref
+	*
+	* @returns void
+	*
+	*/
+	void put(float _val, float _ref)
+	{
+		uint32_t v, r;
+		memcpy(&v, &_val, sizeof(v));
+		memcpy(&r, &_ref, sizeof(r));
+		count++;
+
+		uint32_t x = v ^ r;
+		prev = v;
+		if(x == 0)
+		{
+			bw.write(0, 1);
+			return;
+		}
+
+		int l = __builtin_clz(x);
+		int t = __builtin_ctz(x);
+		if(l > 31)
+		{
+			l = 31;
+		}
+
+		// reuse the previous window if the meaningful bits fit inside it
+		if(lead <= 32 && l >= lead && t >= trail)
+		{
+			bw.write(2, 2);
+			bw.write(x >> trail, 32 - lead - trail);
+		}
+		else
+		{
+			int meaningful = 32 - l - t;
+			bw.write(3, 2);
+			bw.write(l, 5);
+			bw.write(meaningful - 1, 5);
+			bw.write(x >> t, meaningful);
+			lead = l;
+			trail = t;
+		}
+	}
+
+private:
+	BITWRITER& bw;
+	size_t count;
+	uint32_t prev;
+	int lead;
+	int trail;
+};
+
+
+	/*! @brief	Decoder for XOR_ENCODER
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	XOR_DECODER dec(br);
+	*	float v = dec.get();
+	* @endcode
+	*
+	*/
+class XOR_DECODER
+{
+public:
+	XOR_DECODER(BITREADER& _br) : br(_br), count(0), prev(0), lead(0), trail(0)
+	{
+
+	}
+
+	float get(void)
+	{
+		if(count == 0)
+		{
+			count++;
+			prev = (uint32_t)br.read(32);
+			float f;
+			memcpy(&f, &prev, sizeof(f));
+			return f;
+		}
+		float p;
+		memcpy(&p, &prev, sizeof(p));
+		return get(p);
+	}
+
+	// counterpart of XOR_ENCODER::put(_val, _ref)
+	float get(float _ref)
+	{
+		uint32_t r;
+		memcpy(&r, &_ref, sizeof(r));
+		count++;
+		prev = r;
+		if(br.read_bit())
+		{
+			if(br.read_bit())
+			{
+				lead = (int)br.read(5);
+				int meaningful = (int)br.read(5) + 1;
+				trail = 32 - lead - meaningful;
+			}
+			prev ^= (uint32_t)br.read(32 - lead - trail) << trail;
+		}
+
+		float f;
+		memcpy(&f, &prev, sizeof(f));
+		return f;
+	}
+
+private:
+	BITREADER& br;
+	size_t count;
+	uint32_t prev;
+	int lead;
+	int trail;
+};
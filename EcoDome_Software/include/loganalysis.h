@@ -0,0 +1,624 @@
+#pragma once
+
+/*
+* loganalysis.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:53
+* Modified:		19/10-2026 04:53
+* Version:		1.0
+*
+* Description:
+*	This header includes the per day analysis of the logs used by logreport: heating degree-hours of the outside
+*	temperature, run time of the fans and how much heat went into and came out of the stone beds. The logs are
+*	analysed in parallel, one log at a time per thread, and the days of all logs are merged afterwards.
+*	Text logs are memory mapped and the tabs and line ends are found 16 bytes at a time with SSE2 or NEON, only the
+*	columns that are needed are parsed.
+*
+* NOTE:
+*	There is no flow or power measurement on the stone beds, so their heat is given in kelvin-hours: the difference
+*	between the inside and the stone bed temperature while the stone fan runs, integrated over time. The efficiency
+*	is discharge / charge of the same day, it is only a rough measure of what the beds give back.
+*	Define LOG_NO_SIMD to use the plain C delimiter scan on any CPU.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#if !defined(LOG_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define LOG_SCAN_SSE2
+#elif !defined(LOG_NO_SIMD) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define LOG_SCAN_NEON
+#endif
+
+#include "binlog.h"
+#include "logquery.h"
+#include "mythread.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define ANALYSIS_BASE_TEMP		18.0		// base of the heating degree-hours [C]
+#define ANALYSIS_MAX_GAP		3			// a gap longer than this many time steps counts as one time step
+#define ANALYSIS_MAX_COLUMNS	64			// columns of a text log that are looked at
+#define ANALYSIS_TIME_STEP		10			// time step of the logs that do not say [s]
+
+// the channels the analysis uses, the values of a row are in this order
+enum
+{
+	ANALYSIS_INSIDE = 0,
+	ANALYSIS_OUTSIDE,
+	ANALYSIS_STONE_CLOSE,
+	ANALYSIS_STONE_FAR,
+	ANALYSIS_STONE_FAN,
+	ANALYSIS_MAIN_FAN,
+	ANALYSIS_CHANNELS
+};
+const char* const analysis_channels[ANALYSIS_CHANNELS] = {"in_soil__", "outside_2", "stone_close", "stone_far", "Sb_F", "M_F"};
+
+// what one day of logs adds up to, days that are in two logs are merged with add()
+struct log_day
+{
+	unsigned long rows = 0;
+	double seconds = 0;					// time covered by the rows [s]
+	double out_sum = 0;
+	unsigned long out_n = 0;
+	float out_min = INFINITY;
+	float out_max = -INFINITY;
+	double in_sum = 0;
+	unsigned long in_n = 0;
+	float in_min = INFINITY;
+	float in_max = -INFINITY;
+	double hdh = 0;						// heating degree-hours below the base temperature [Kh]
+	double stone_fan_s = 0;				// run time of the stone fan [s]
+	double main_fan_s = 0;				// run time of the main fan [s]
+	double charge_kh = 0;				// inside warmer than the stone beds while the stone fan runs [Kh]
+	double discharge_kh = 0;			// stone beds warmer than the inside while the stone fan runs [Kh]
+
+	void add(const log_day& _d)
+	{
+		rows += _d.rows;
+		seconds += _d.seconds;
+		out_sum += _d.out_sum;
+		out_n += _d.out_n;
+		out_min = _d.out_min < out_min ? _d.out_min : out_min;
+		out_max = _d.out_max > out_max ? _d.out_max : out_max;
+		in_sum += _d.in_sum;
+		in_n += _d.in_n;
+		in_min = _d.in_min < in_min ? _d.in_min : in_min;
+		in_max = _d.in_max > in_max ? _d.in_max : in_max;
+		hdh += _d.hdh;
+		stone_fan_s += _d.stone_fan_s;
+		main_fan_s += _d.main_fan_s;
+		charge_kh += _d.charge_kh;
+		discharge_kh += _d.discharge_kh;
+	}
+};
+
+// days by local date, 20240131 for 31 January 2024
+typedef map< int, log_day > log_days;
+
+// what the analysis of one or more logs read
+struct log_analysis_stats
+{
+	unsigned long files = 0;
+	unsigned long failed = 0;
+	unsigned long rows = 0;
+	uint64_t text_bytes = 0;			// bytes of text logs parsed
+	uint64_t binary_bytes = 0;			// bytes of binary logs decoded, after inflating
+	double busy_s = 0;					// time the threads spent on the logs, summed over the threads
+};
+
+
+// ###############################################		FUNCTIONS	#################################################### //
+
+	/*! @brief Bit i is set if byte i of the 16 bytes at _p is a tab or a line end
+	*
+	*
+	*
+	* @param const char* _p (16 readable bytes)
+	*
+	* @returns uint32_t
+	*
+	*/
+static inline uint32_t log_delim_mask16(const char* _p)
+{
+#if defined(LOG_SCAN_SSE2)
+	__m128i v = _mm_loadu_si128((const __m128i*)_p);
+	__m128i d = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+	return _mm_movemask_epi8(d);
+#elif defined(LOG_SCAN_NEON)
+	// NEON has no movemask, the matches are weighted with their bit and added up per half
+	static const uint8_t weight[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+	uint8x16_t v = vld1q_u8((const uint8_t*)_p);
+	uint8x16_t d = vorrq_u8(vceqq_u8(v, vdupq_n_u8('\t')), vceqq_u8(v, vdupq_n_u8('\n')));
+	d = vandq_u8(d, vld1q_u8(weight));
+	uint8x8_t s = vpadd_u8(vget_low_u8(d), vget_high_u8(d));
+	s = vpadd_u8(s, s);
+	s = vpadd_u8(s, s);
+	return vget_lane_u8(s, 0) | (vget_lane_u8(s, 1) << 8);
+#else
+	uint32_t m = 0;
+	for(int i = 0; i < 16; i++)
+	{
+		m |= (uint32_t)(_p[i] == '\t' || _p[i] == '\n') << i;
+	}
+	return m;
+#endif
+}
+
+	/*! @brief	Walks through the tabs and line ends of a text, 64 bytes at a time
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	LOG_DELIM_SCANNER sc(p, end);
+	*	const char* d;
+	*	while((d = sc.next()) < end) { ... *d is '\t' or '\n' ... }
+	* @endcode
+	*
+	*/
+class LOG_DELIM_SCANNER
+{
+public:
+	LOG_DELIM_SCANNER(const char* _p, const char* _end) : block(_p - 64), end(_end), mask(0)
+	{
+
+	}
+
+	/*! @brief the next tab or line end
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns const char*, the end of the text when there are no more
+	*
+	*/
+	inline const char* next(void)
+	{
+		while(mask == 0)
+		{
+			block += 64;
+			if(block >= end)
+			{
+				return end;
+			}
+			mask = load(block);
+		}
+		const char* d = block + __builtin_ctzll(mask);
+		mask &= mask - 1;
+		return d;
+	}
+
+private:
+	uint64_t load(const char* _p)
+	{
+		if(end - _p >= 64)
+		{
+			return (uint64_t)log_delim_mask16(_p) | ((uint64_t)log_delim_mask16(_p + 16) << 16)
+				| ((uint64_t)log_delim_mask16(_p + 32) << 32) | ((uint64_t)log_delim_mask16(_p + 48) << 48);
+		}
+		// the last bytes of the text, reading past the end of the mapping is not allowed
+		uint64_t m = 0;
+		for(int i = 0; i < end - _p; i++)
+		{
+			m |= (uint64_t)(_p[i] == '\t' || _p[i] == '\n') << i;
+		}
+		return m;
+	}
+
+	const char* block;				// start of the 64 bytes in mask
+	const char* end;
+	uint64_t mask;					// the delimiters in block that are not returned yet
+};
+
+	/*! @brief Adds one row of measurements to its day
+	*
+	*
+	*
+	* @param log_day& _d, const float* _v (ANALYSIS_CHANNELS values, NAN if missing), double _dt [s], double _base [C]
+	*
+	* @returns void
+	*
+	*/
+static inline void log_day_add_row(log_day& _d, const float* _v, double _dt, double _base)
+{
+	_d.rows++;
+	_d.seconds += _dt;
+	float out = _v[ANALYSIS_OUTSIDE];
+	if(!isnan(out))
+	{
+		_d.out_sum += out;
+		_d.out_n++;
+		_d.out_min = out < _d.out_min ? out : _d.out_min;
+		_d.out_max = out > _d.out_max ? out : _d.out_max;
+		if(out < _base)
+		{
+			_d.hdh += (_base - out) * _dt / 3600;
+		}
+	}
+	float in = _v[ANALYSIS_INSIDE];
+	if(!isnan(in))
+	{
+		_d.in_sum += in;
+		_d.in_n++;
+		_d.in_min = in < _d.in_min ? in : _d.in_min;
+		_d.in_max = in > _d.in_max ? in : _d.in_max;
+	}
+	if(_v[ANALYSIS_MAIN_FAN] > 0.5f)
+	{
+		_d.main_fan_s += _dt;
+	}
+	if(_v[ANALYSIS_STONE_FAN] > 0.5f)
+	{
+		_d.stone_fan_s += _dt;
+		float stone = (_v[ANALYSIS_STONE_CLOSE] + _v[ANALYSIS_STONE_FAR]) / 2;
+		if(!isnan(stone) && !isnan(in))
+		{
+			// the same rule as the controller: the fan charges the beds when they are colder than the inside
+			if(stone < in)
+			{
+				_d.charge_kh += (in - stone) * _dt / 3600;
+			}
+			else
+			{
+				_d.discharge_kh += (stone - in) * _dt / 3600;
+			}
+		}
+	}
+}
+
+	/*! @brief Time step of a row, the time since the previous row unless that is a gap in the log
+	*
+	*
+	*
+	* @param int64_t _t, int64_t _prev [s] (-1 for the first row), int _time_step [s]
+	*
+	* @returns double [s]
+	*
+	*/
+static inline double log_row_dt(int64_t _t, int64_t _prev, int _time_step)
+{
+	int64_t dt = _t - _prev;
+	return (_prev < 0 || dt <= 0 || dt > ANALYSIS_MAX_GAP * _time_step) ? _time_step : dt;
+}
+
+	/*! @brief Analyses a text log per day. The columns are found in the header row, the rows are split with
+	*	LOG_DELIM_SCANNER and only the wanted columns are parsed.
+	*
+	*
+	*
+	* @param const string& _fpath, double _base, log_days& _days, log_analysis_stats& _st
+	*
+	* @returns bool, false if the log could not be read or has no header
+	*
+	*/
+bool log_analyse_text(const string& _fpath, double _base, log_days& _days, log_analysis_stats& _st)
+{
+	int fd = open(_fpath.c_str(), O_RDONLY);
+	if(fd == -1)
+	{
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) == -1 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+	void* m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(m == MAP_FAILED)
+	{
+		perror("mmap()");
+		return false;
+	}
+	madvise(m, st.st_size, MADV_SEQUENTIAL);
+	const char* p = (const char*)m;
+	const char* end = p + st.st_size;
+
+	// "Time step is 10" comes before the header row
+	int time_step = ANALYSIS_TIME_STEP;
+	const char* ts = (const char*)memmem(p, end - p < 256 ? end - p : 256, "Time step is ", 13);
+	if(ts && atoi(ts + 13) > 0)
+	{
+		time_step = atoi(ts + 13);
+	}
+
+	// slot of every column, -1 for the columns that are not needed
+	int slot[ANALYSIS_MAX_COLUMNS];
+	for(int c = 0; c < ANALYSIS_MAX_COLUMNS; c++)
+	{
+		slot[c] = -1;
+	}
+	const char* rows = p;
+	bool found = false;
+	for(int k = 0; k < ANALYSIS_CHANNELS; k++)
+	{
+		const char* q = p;
+		int c = log_text_header(q, end, analysis_channels[k]);
+		if(c > 0 && c < ANALYSIS_MAX_COLUMNS)
+		{
+			slot[c] = k;
+			found = true;
+		}
+		rows = q > rows ? q : rows;
+	}
+	if(!found)
+	{
+		munmap(m, st.st_size);
+		return false;
+	}
+
+	log_text_clock clk;
+	char day_key[10] = {0};
+	log_day* day = NULL;
+	int64_t prev = -1;
+	LOG_DELIM_SCANNER sc(rows, end);
+	const char* row = rows;
+	while(row < end)
+	{
+		float v[ANALYSIS_CHANNELS];
+		for(int k = 0; k < ANALYSIS_CHANNELS; k++)
+		{
+			v[k] = NAN;
+		}
+		// the time stamp is the first field
+		const char* f = row;
+		const char* d = sc.next();
+		int64_t t = log_text_time(row, d, clk);
+		int c = 0;
+		while(d < end && *d == '\t')
+		{
+			f = d + 1;
+			d = sc.next();
+			if(++c < ANALYSIS_MAX_COLUMNS && slot[c] >= 0)
+			{
+				v[slot[c]] = log_to_float(f, d);
+			}
+		}
+		if(t >= 0)
+		{
+			if(!day || memcmp(day_key, row, sizeof(day_key)) != 0)
+			{
+				memcpy(day_key, row, sizeof(day_key));
+				day = &_days[atoi(row) * 10000 + atoi(row + 5) * 100 + atoi(row + 8)];
+			}
+			log_day_add_row(*day, v, log_row_dt(t, prev, time_step), _base);
+			prev = t;
+		}
+		row = d + 1;
+	}
+
+	_st.text_bytes += st.st_size;
+	munmap(m, st.st_size);
+	return true;
+}
+
+	/*! @brief Analyses a binary log per day
+	*
+	*
+	*
+	* @param const string& _fpath, double _base, log_days& _days, log_analysis_stats& _st
+	*
+	* @returns bool, false if the log could not be read
+	*
+	*/
+bool log_analyse_binary(const string& _fpath, double _base, log_days& _days, log_analysis_stats& _st)
+{
+	LOG_READER lr;
+	if(!lr.open(_fpath))
+	{
+		return false;
+	}
+	int ch[ANALYSIS_CHANNELS];
+	for(int k = 0; k < ANALYSIS_CHANNELS; k++)
+	{
+		ch[k] = lr.channel(analysis_channels[k]);
+	}
+	int time_step = lr.header().time_step > 0 ? lr.header().time_step : ANALYSIS_TIME_STEP;
+
+	// local midnight before and after the current day, localtime() only runs when a row is outside of them
+	int64_t day_start = 0, day_end = -1;
+	log_day* day = NULL;
+	int64_t prev = -1;
+	for(size_t i = 0; i < lr.size(); i++)
+	{
+		int64_t t = lr.epoch_us(i) / 1000000;
+		if(t < day_start || t >= day_end)
+		{
+			time_t s = t;
+			struct tm tm;
+			localtime_r(&s, &tm);
+			day = &_days[(tm.tm_year + 1900) * 10000 + (tm.tm_mon + 1) * 100 + tm.tm_mday];
+			tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+			tm.tm_isdst = -1;
+			day_start = mktime(&tm);
+			tm.tm_mday++;
+			tm.tm_isdst = -1;
+			day_end = mktime(&tm);
+		}
+		float v[ANALYSIS_CHANNELS];
+		for(int k = 0; k < ANALYSIS_CHANNELS; k++)
+		{
+			v[k] = ch[k] >= 0 ? lr.value(i, ch[k]) : NAN;
+		}
+		log_day_add_row(*day, v, log_row_dt(t, prev, time_step), _base);
+		prev = t;
+	}
+
+	_st.binary_bytes += lr.header().header_size + (uint64_t)lr.size() * lr.header().record_size;
+	return true;
+}
+
+
+// ###############################################		THREADS		#################################################### //
+
+	/*! @brief	Thread of the pool that analyses the logs, every thread takes the next log from the shared list until
+	*	there are none left and keeps its own days, so the threads share nothing but the position in the list
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	atomic< size_t > next(0);
+	*	LOG_ANALYSIS_WORKER w(&files, &next, 18.0);
+	*	w.StartInternalThread();
+	*	w.WaitForInternalThreadToExit();
+	*	w.get_days(); w.get_stats();
+	* @endcode
+	*
+	*/
+class LOG_ANALYSIS_WORKER : public MyThreadClass
+{
+public:
+	/*! @brief Constructor
+	*
+	*
+	*
+	* @param const vector< string >* _files, atomic< size_t >* _next, double _base [C]
+	*
+	* @returns void
+	*
+	*/
+	LOG_ANALYSIS_WORKER(const vector< string >* _files, atomic< size_t >* _next, double _base) : files(_files), next(_next), base(_base)
+	{
+
+	}
+
+	const log_days& get_days(void) const
+	{
+		return days;
+	}
+
+	const log_analysis_stats& get_stats(void) const
+	{
+		return stats;
+	}
+
+private:
+	void InternalThreadEntry()
+	{
+		struct timespec a, b;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &a);
+		size_t i;
+		while((i = next->fetch_add(1)) < files->size())
+		{
+			const string& f = (*files)[i];
+			bool ok = log_is_binary(f) ? log_analyse_binary(f, base, days, stats) : log_analyse_text(f, base, days, stats);
+			stats.files++;
+			stats.failed += !ok;
+		}
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &b);
+		stats.busy_s = (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) / 1e9;
+	}
+
+	const vector< string >* files;
+	atomic< size_t >* next;
+	double base;
+	log_days days;
+	log_analysis_stats stats;
+};
+
+
+// ###############################################		FUNCTIONS	#################################################### //
+
+	/*! @brief Analyses logs per day with a pool of threads, the biggest logs are started first so the threads finish
+	*	at about the same time
+	*
+	*
+	*
+	* @param const vector< string >& _files, int _threads, double _base [C], log_days& _days, log_analysis_stats& _st
+	*
+	* @returns void
+	*
+	*/
+void log_analyse(const vector< string >& _files, int _threads, double _base, log_days& _days, log_analysis_stats& _st)
+{
+	vector< pair< off_t, string > > sized;
+	for(size_t i = 0; i < _files.size(); i++)
+	{
+		struct stat st;
+		// a compressed log is about a fifth of what is decoded
+		off_t size = stat(_files[i].c_str(), &st) == 0 ? st.st_size * (log_ends_with(_files[i], LOG_COMPRESSED) ? 5 : 1) : 0;
+		sized.push_back(make_pair(size, _files[i]));
+	}
+	sort(sized.begin(), sized.end(), [](const pair< off_t, string >& a, const pair< off_t, string >& b)
+	{
+		return a.first > b.first;
+	});
+	vector< string > order;
+	for(size_t i = 0; i < sized.size(); i++)
+	{
+		order.push_back(sized[i].second);
+	}
+
+	if(_threads < 1)
+	{
+		_threads = 1;
+	}
+	atomic< size_t > next(0);
+	vector< LOG_ANALYSIS_WORKER* > pool;
+	for(int t = 0; t < _threads; t++)
+	{
+		pool.push_back(new LOG_ANALYSIS_WORKER(&order, &next, _base));
+		if(!pool.back()->StartInternalThread())
+		{
+			cout << "Could not start analysis thread " << t << endl;
+			delete pool.back();
+			pool.pop_back();
+		}
+	}
+	if(pool.empty())
+	{
+		// no threads, the logs are analysed here
+		for(size_t i = 0; i < order.size(); i++)
+		{
+			bool ok = log_is_binary(order[i]) ? log_analyse_binary(order[i], _base, _days, _st) : log_analyse_text(order[i], _base, _days, _st);
+			_st.files++;
+			_st.failed += !ok;
+		}
+	}
+
+	for(size_t t = 0; t < pool.size(); t++)
+	{
+		pool[t]->WaitForInternalThreadToExit();
+		const log_days& d = pool[t]->get_days();
+		for(log_days::const_iterator it = d.begin(); it != d.end(); ++it)
+		{
+			_days[it->first].add(it->second);
+		}
+		const log_analysis_stats& s = pool[t]->get_stats();
+		_st.files += s.files;
+		_st.failed += s.failed;
+		_st.text_bytes += s.text_bytes;
+		_st.binary_bytes += s.binary_bytes;
+		_st.busy_s += s.busy_s;
+		delete pool[t];
+	}
+	for(log_days::const_iterator it = _days.begin(); it != _days.end(); ++it)
+	{
+		_st.rows += it->second.rows;
+	}
+}
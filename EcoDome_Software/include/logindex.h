@@ -0,0 +1,484 @@
+#pragma once
+
+/*
+* logindex.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:45
+* Modified:		19/10-2026 04:50
+* Version:		1.1
+*
+* Description:
+*	This header includes a sparse time index over the logs and range queries with it. For every log an index
+*	(logdataN.idx, next to the log) holds the first and last time stamp of every block of LOG_INDEX_BLOCK records or
+*	text rows, and where the block starts. A query for one channel between two times only opens the logs whose time
+*	range overlaps, and only decodes the blocks that do.
+*
+* NOTE:
+*	An index is built the first time a log is queried and rebuilt when the size or modification time of the log
+*	has changed, e.g. the log that is being written or a log that has been compressed since.
+*	If the index cannot be written (read only log folder) it is built in memory for every query.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "binlog.h"
+#include "logquery.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define LOG_INDEX_MAGIC		"ECOIDX1"
+#define LOG_INDEX_VERSION	1
+#define LOG_INDEX_EXTENSION	".idx"
+#define LOG_INDEX_BLOCK		256			// records or text rows per block
+
+// start of an index file, followed by 'blocks' log_index_block
+struct log_index_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t block;					// records or rows per block
+	uint64_t source_size;			// size of the log when the index was built [bytes]
+	int64_t source_mtime;			// modification time of the log when the index was built [ns]
+	uint32_t blocks;
+	uint32_t text;					// 1 for a text log, offsets are then in bytes
+	int64_t min_us;					// first and last time stamp in the log [us], min > max for an empty log
+	int64_t max_us;
+};
+
+struct log_index_block
+{
+	int64_t min_us;
+	int64_t max_us;
+	uint64_t offset;				// first record, or the byte the first row starts at in a text log
+	uint32_t count;					// records or rows in the block
+	uint32_t reserved;
+};
+
+// what a range query did, for the tools
+struct log_query_stats
+{
+	unsigned long files = 0;		// logs looked at
+	unsigned long opened = 0;		// logs whose time range overlapped
+	unsigned long built = 0;		// indexes that had to be built
+	unsigned long blocks = 0;		// blocks decoded
+	unsigned long rows = 0;			// records or rows decoded
+};
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Sparse time index of one log
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	LOG_INDEX idx;
+	*	if(idx.load("./logs/logdata3.ecl.gz") && idx.overlaps(from_us, to_us))
+	*		for(size_t b = 0; b < idx.blocks().size(); b++) ...
+	* @endcode
+	*
+	*/
+class LOG_INDEX
+{
+public:
+	/*! @brief loads the index of a log, builds and saves it if it is missing or out of date
+	*
+	*
+	*
+	* @param const string& _log
+	*
+	* @returns bool, false if the log cannot be read
+	*
+	*/
+	bool load(const string& _log)
+	{
+		built = false;
+		struct stat st;
+		if(stat(_log.c_str(), &st) == -1)
+		{
+			return false;
+		}
+		uint64_t size = st.st_size;
+		int64_t mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+		string path = index_path(_log);
+		if(read(path) && head.source_size == size && head.source_mtime == mtime)
+		{
+			return true;
+		}
+
+		bool ok = log_ends_with(_log, ".txt") ? build_text(_log) : build_binary(_log);
+		if(!ok)
+		{
+			return false;
+		}
+		head.source_size = size;
+		head.source_mtime = mtime;
+		write(path);
+		built = true;
+		return true;
+	}
+
+	bool overlaps(int64_t _from_us, int64_t _to_us) const
+	{
+		return head.min_us <= _to_us && head.max_us >= _from_us;
+	}
+
+	const log_index_header& header(void) const
+	{
+		return head;
+	}
+
+	const vector< log_index_block >& blocks(void) const
+	{
+		return block;
+	}
+
+	// true if load() had to build the index
+	bool was_built(void) const
+	{
+		return built;
+	}
+
+	/*! @brief the index file of a log, logdataN.idx for logdataN.txt, logdataN.ecl and logdataN.ecl.gz
+	*
+	*
+	*
+	* @param const string& _log
+	*
+	* @returns string
+	*
+	*/
+	static string index_path(const string& _log)
+	{
+		string base = _log;
+		const char* ext[] = {LOG_EXTENSION LOG_COMPRESSED, LOG_EXTENSION, ".txt"};
+		for(size_t i = 0; i < sizeof(ext) / sizeof(ext[0]); i++)
+		{
+			if(log_ends_with(base, ext[i]))
+			{
+				base.resize(base.size() - strlen(ext[i]));
+				break;
+			}
+		}
+		return base + LOG_INDEX_EXTENSION;
+	}
+
+private:
+	void start(bool _text)
+	{
+		memset(&head, 0, sizeof(head));
+		memcpy(head.magic, LOG_INDEX_MAGIC, sizeof(head.magic));
+		head.version = LOG_INDEX_VERSION;
+		head.block = LOG_INDEX_BLOCK;
+		head.text = _text;
+		head.min_us = INT64_MAX;
+		head.max_us = INT64_MIN;
+		block.clear();
+	}
+
+	// adds a time stamp to the block starting at _offset, a new block is started every LOG_INDEX_BLOCK entries
+	void add(int64_t _t, uint64_t _offset)
+	{
+		if(block.empty() || block.back().count == LOG_INDEX_BLOCK)
+		{
+			log_index_block b;
+			b.min_us = INT64_MAX;
+			b.max_us = INT64_MIN;
+			b.offset = _offset;
+			b.count = 0;
+			b.reserved = 0;
+			block.push_back(b);
+		}
+		log_index_block& b = block.back();
+		b.min_us = _t < b.min_us ? _t : b.min_us;
+		b.max_us = _t > b.max_us ? _t : b.max_us;
+		b.count++;
+		head.min_us = _t < head.min_us ? _t : head.min_us;
+		head.max_us = _t > head.max_us ? _t : head.max_us;
+	}
+
+	bool build_binary(const string& _log)
+	{
+		LOG_READER lr;
+		if(!lr.open(_log))
+		{
+			return false;
+		}
+		start(false);
+		for(size_t i = 0; i < lr.size(); i++)
+		{
+			add(lr.epoch_us(i), i);
+		}
+		head.blocks = block.size();
+		return true;
+	}
+
+	// rows without a time stamp are not counted, the block of a row is found by its byte offset
+	bool build_text(const string& _log)
+	{
+		int fd = open(_log.c_str(), O_RDONLY);
+		if(fd == -1)
+		{
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) == -1 || st.st_size == 0)
+		{
+			close(fd);
+			return false;
+		}
+		void* m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if(m == MAP_FAILED)
+		{
+			perror("mmap()");
+			return false;
+		}
+		madvise(m, st.st_size, MADV_SEQUENTIAL);
+		const char* base = (const char*)m;
+		const char* p = base;
+		const char* end = p + st.st_size;
+
+		start(true);
+		log_text_clock clk;
+		while(p < end)
+		{
+			const char* eol = (const char*)memchr(p, '\n', end - p);
+			if(!eol)
+			{
+				eol = end;
+			}
+			int64_t ts = log_text_time(p, eol, clk);
+			if(ts >= 0)
+			{
+				add(ts * 1000000, p - base);
+			}
+			p = eol + 1;
+		}
+		head.blocks = block.size();
+		munmap(m, st.st_size);
+		return true;
+	}
+
+	bool read(const string& _path)
+	{
+		FILE* f = fopen(_path.c_str(), "rb");
+		if(!f)
+		{
+			return false;
+		}
+		bool ok = fread(&head, sizeof(head), 1, f) == 1 && memcmp(head.magic, LOG_INDEX_MAGIC, sizeof(head.magic)) == 0
+			&& head.version == LOG_INDEX_VERSION && head.block == LOG_INDEX_BLOCK;
+		if(ok)
+		{
+			block.resize(head.blocks);
+			ok = block.empty() || fread(block.data(), sizeof(log_index_block), block.size(), f) == block.size();
+		}
+		fclose(f);
+		return ok;
+	}
+
+	// written to a temporary file and renamed, an index is only a cache so a failure is not reported
+	void write(const string& _path)
+	{
+		string tmp = _path + ".tmp";
+		FILE* f = fopen(tmp.c_str(), "wb");
+		if(!f)
+		{
+			return;
+		}
+		bool ok = fwrite(&head, sizeof(head), 1, f) == 1 && (block.empty() || fwrite(block.data(), sizeof(log_index_block), block.size(), f) == block.size());
+		ok = (fclose(f) == 0) && ok;
+		if(!ok || rename(tmp.c_str(), _path.c_str()) == -1)
+		{
+			unlink(tmp.c_str());
+		}
+	}
+
+	log_index_header head;
+	vector< log_index_block > block;
+	bool built = false;
+};
+
+
+// ###############################################		FUNCTIONS	#################################################### //
+
+	/*! @brief Reads the values of one channel in the text log _log that lie between _from_us and _to_us, only the
+	*	blocks of the index that overlap are parsed
+	*
+	*
+	*
+	* @param const string& _log, const LOG_INDEX& _idx, const string& _channel, int64_t _from_us, int64_t _to_us,
+	*	vector< log_sample >& _out, log_query_stats& _st
+	*
+	* @returns void
+	*
+	*/
+void log_query_text(const string& _log, const LOG_INDEX& _idx, const string& _channel, int64_t _from_us, int64_t _to_us, vector< log_sample >& _out, log_query_stats& _st)
+{
+	int fd = open(_log.c_str(), O_RDONLY);
+	if(fd == -1)
+	{
+		return;
+	}
+	struct stat st;
+	if(fstat(fd, &st) == -1 || st.st_size == 0)
+	{
+		close(fd);
+		return;
+	}
+	void* m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(m == MAP_FAILED)
+	{
+		perror("mmap()");
+		return;
+	}
+	const char* base = (const char*)m;
+	const char* end = base + st.st_size;
+	const char* p = base;
+	int column = log_text_header(p, end, _channel);
+
+	const vector< log_index_block >& blocks = _idx.blocks();
+	for(size_t b = 0; b < blocks.size() && column >= 0; b++)
+	{
+		if(blocks[b].min_us > _to_us || blocks[b].max_us < _from_us)
+		{
+			continue;
+		}
+		_st.blocks++;
+		log_text_clock clk;
+		p = base + blocks[b].offset;
+		for(uint32_t rows = 0; rows < blocks[b].count && p < end; )
+		{
+			const char* eol = (const char*)memchr(p, '\n', end - p);
+			if(!eol)
+			{
+				eol = end;
+			}
+			int64_t ts = log_text_time(p, eol, clk);
+			if(ts >= 0)
+			{
+				rows++;
+				_st.rows++;
+				int64_t us = ts * 1000000;
+				float v;
+				if(us >= _from_us && us <= _to_us && !isnan(v = log_text_field(p, eol, column)))
+				{
+					log_sample s;
+					s.epoch_us = us;
+					s.value = v;
+					_out.push_back(s);
+				}
+			}
+			p = eol + 1;
+		}
+	}
+	munmap(m, st.st_size);
+}
+
+	/*! @brief Reads the values of one channel between two times from one log, in the order they are in the log
+	*
+	*
+	*
+	* @param const string& _log, const string& _channel, int64_t _from_us, int64_t _to_us (both included),
+	*	vector< log_sample >& _out, log_query_stats& _st
+	*
+	* @returns void
+	*
+	*/
+void log_query_file(const string& _log, const string& _channel, int64_t _from_us, int64_t _to_us, vector< log_sample >& _out, log_query_stats& _st)
+{
+	_st.files++;
+	LOG_INDEX idx;
+	if(!idx.load(_log))
+	{
+		return;
+	}
+	_st.built += idx.was_built();
+	if(!idx.overlaps(_from_us, _to_us))
+	{
+		return;
+	}
+	_st.opened++;
+
+	if(idx.header().text)
+	{
+		log_query_text(_log, idx, _channel, _from_us, _to_us, _out, _st);
+		return;
+	}
+	LOG_READER lr;
+	int c;
+	if(!lr.open(_log) || (c = lr.channel(_channel)) < 0)
+	{
+		return;
+	}
+	const vector< log_index_block >& blocks = idx.blocks();
+	for(size_t b = 0; b < blocks.size(); b++)
+	{
+		if(blocks[b].min_us <= _to_us && blocks[b].max_us >= _from_us)
+		{
+			_st.blocks++;
+			_st.rows += blocks[b].count;
+			lr.samples(blocks[b].offset, blocks[b].count, c, _from_us, _to_us, _out);
+		}
+	}
+}
+
+	/*! @brief Reads the values of one channel between two times from every log in a folder, oldest first
+	*
+	*
+	*
+	* @param const string& _dir, const string& _channel, int64_t _from_us, int64_t _to_us (both included),
+	*	vector< log_sample >& _out, log_query_stats* _st (optional)
+	*
+	* @returns long, the number of values found
+	*
+	*/
+long log_query_range(const string& _dir, const string& _channel, int64_t _from_us, int64_t _to_us, vector< log_sample >& _out, log_query_stats* _st = NULL)
+{
+	log_query_stats st;
+	size_t before = _out.size();
+	vector< string > files = log_list_files(_dir);
+	for(size_t f = 0; f < files.size(); f++)
+	{
+		log_query_file(files[f], _channel, _from_us, _to_us, _out, st);
+	}
+
+	// logs are in time order, only a clock that was set back leaves the values out of order
+	bool sorted = true;
+	for(size_t i = before + 1; i < _out.size() && sorted; i++)
+	{
+		sorted = _out[i - 1].epoch_us <= _out[i].epoch_us;
+	}
+	if(!sorted)
+	{
+		stable_sort(_out.begin() + before, _out.end(), [](const log_sample& a, const log_sample& b)
+		{
+			return a.epoch_us < b.epoch_us;
+		});
+	}
+	if(_st)
+	{
+		*_st = st;
+	}
+	return _out.size() - before;
+}
@@ -0,0 +1,341 @@
+#pragma once
+
+/*
+* logquery.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:26
+* Modified:		19/10-2026 04:45
+* Version:		1.3
+*
+* Description:
+*	This header includes functions to read the log files written by LOGGER back in, for the tools that analyse the
+*	measurements afterwards. Both the binary logs and the text logs of older versions are read, the logs are memory
+*	mapped and only the requested channel is looked at.
+*
+* NOTE:
+*	The time stamps in the text logs are local time, they are turned into unix time with one mktime() per hour.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "binlog.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define LOG_TIME_HEADER		"TimeStamp_DateTime"
+
+// sum of the measurements in one hour
+struct log_hour_sum
+{
+	double sum = 0;
+	unsigned long n = 0;
+};
+
+// turns the local time stamps of a text log into unix time, remembers the last hour so mktime() runs once an hour
+struct log_text_clock
+{
+	char hour_key[13] = {0};		// "YYYY-MM-DD HH"
+	time_t hour_start = 0;
+};
+
+
+// ###############################################		FUNCTIONS	#################################################### //
+
+	/*! @brief Lists the log files in a folder, also the ones in the subfolder with old logs, oldest first
+	*
+	*
+	*
+	* @param const string& _dir
+	*
+	* @returns vector< string >
+	*
+	*/
+vector< string > log_list_files(const string& _dir = LOG_DIR)
+{
+	vector< string > files;
+	vector< string > dirs(1, _dir);
+	for(size_t d = 0; d < dirs.size(); d++)
+	{
+		DIR* dir = opendir(dirs[d].c_str());
+		if(!dir)
+		{
+			continue;
+		}
+		struct dirent* ent;
+		while((ent = readdir(dir)) != NULL)
+		{
+			string name = ent->d_name;
+			if(name == "." || name == "..")
+			{
+				continue;
+			}
+			string path = dirs[d] + (dirs[d].empty() || dirs[d][dirs[d].size() - 1] == '/' ? "" : "/") + name;
+			// the type from readdir() saves a stat() per log, not every file system fills it in
+			struct stat st;
+			if(ent->d_type == DT_DIR || (ent->d_type == DT_UNKNOWN && stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)))
+			{
+				dirs.push_back(path);
+			}
+			else if(name.compare(0, 7, "logdata") == 0 && (log_ends_with(name, ".txt") || log_is_binary(name)))
+			{
+				files.push_back(path);
+			}
+		}
+		closedir(dir);
+	}
+
+	// by log number, logdata2 comes before logdata10 and logdata9.ecl.gz
+	sort(files.begin(), files.end(), [](const string& a, const string& b)
+	{
+		long na = atol(a.c_str() + a.rfind("logdata") + 7);
+		long nb = atol(b.c_str() + b.rfind("logdata") + 7);
+		return na != nb ? na < nb : a < b;
+	});
+	return files;
+}
+
+	/*! @brief Parses a decimal number like "-12.3125", stops at the first character that is not part of it
+	*
+	*
+	*
+	* @param const char*& _p, const char* _end
+	*
+	* @returns float, NAN if there is no number
+	*
+	*/
+float log_to_float(const char*& _p, const char* _end)
+{
+	bool neg = false;
+	if(_p < _end && (*_p == '-' || *_p == '+'))
+	{
+		neg = (*_p == '-');
+		_p++;
+	}
+	double v = 0;
+	double scale = 1;
+	bool digits = false;
+	while(_p < _end && *_p >= '0' && *_p <= '9')
+	{
+		v = v * 10 + (*_p++ - '0');
+		digits = true;
+	}
+	if(_p < _end && *_p == '.')
+	{
+		_p++;
+		while(_p < _end && *_p >= '0' && *_p <= '9')
+		{
+			v = v * 10 + (*_p++ - '0');
+			scale *= 10;
+			digits = true;
+		}
+	}
+	if(!digits)
+	{
+		return NAN;
+	}
+	return (float)((neg ? -v : v) / scale);
+}
+
+	/*! @brief Finds the header row of a text log and the column of a channel, the time stamp is column 0
+	*
+	*
+	*
+	* @param const char*& _p (moved to the row after the header), const char* _end, const string& _channel
+	*
+	* @returns int, the column, -1 if there is no header or no such channel
+	*
+	*/
+int log_text_header(const char*& _p, const char* _end, const string& _channel)
+{
+	while(_p < _end)
+	{
+		const char* eol = (const char*)memchr(_p, '\n', _end - _p);
+		if(!eol)
+		{
+			eol = _end;
+		}
+		const char* row = _p;
+		_p = eol + 1;
+		if((size_t)(eol - row) >= strlen(LOG_TIME_HEADER) && memcmp(row, LOG_TIME_HEADER, strlen(LOG_TIME_HEADER)) == 0)
+		{
+			int c = 0;
+			const char* f = row;
+			while(f < eol)
+			{
+				const char* tab = (const char*)memchr(f, '\t', eol - f);
+				const char* fend = tab ? tab : eol;
+				if((size_t)(fend - f) == _channel.size() && memcmp(f, _channel.data(), _channel.size()) == 0)
+				{
+					return c;
+				}
+				c++;
+				f = fend + 1;
+			}
+			return -1;
+		}
+	}
+	return -1;
+}
+
+	/*! @brief Time stamp of a text log row, rows are "YYYY-MM-DD HH:MM:SS\tvalue\tvalue..."
+	*
+	*
+	*
+	* @param const char* _p, const char* _eol, log_text_clock& _clk
+	*
+	* @returns int64_t [unix time], -1 if the row does not start with a time stamp
+	*
+	*/
+int64_t log_text_time(const char* _p, const char* _eol, log_text_clock& _clk)
+{
+	if(_eol - _p < 19 || _p[4] != '-' || _p[10] != ' ')
+	{
+		return -1;
+	}
+	if(memcmp(_clk.hour_key, _p, sizeof(_clk.hour_key)) != 0)
+	{
+		struct tm t;
+		memset(&t, 0, sizeof(t));
+		t.tm_year = atoi(_p) - 1900;
+		t.tm_mon = atoi(_p + 5) - 1;
+		t.tm_mday = atoi(_p + 8);
+		t.tm_hour = atoi(_p + 11);
+		t.tm_isdst = -1;
+		_clk.hour_start = mktime(&t);
+		memcpy(_clk.hour_key, _p, sizeof(_clk.hour_key));
+	}
+	return _clk.hour_start + atoi(_p + 14) * 60 + atoi(_p + 17);
+}
+
+	/*! @brief Value of a column in a text log row
+	*
+	*
+	*
+	* @param const char* _p, const char* _eol, int _column
+	*
+	* @returns float, NAN if the row has no such column or no number in it
+	*
+	*/
+float log_text_field(const char* _p, const char* _eol, int _column)
+{
+	for(int c = 0; c < _column && _p; c++)
+	{
+		_p = (const char*)memchr(_p, '\t', _eol - _p);
+		_p = _p ? _p + 1 : NULL;
+	}
+	return _p ? log_to_float(_p, _eol) : NAN;
+}
+
+	/*! @brief Reads one channel from a log file and adds every value to the hour it belongs to. _hour_of maps a unix
+	*	time to an hour number, so the caller decides where the hours start.
+	*
+	*
+	*
+	* @param const string& _fpath, const string& _channel, int64_t (*_hour_of)(int64_t),
+	*	unordered_map< int64_t, log_hour_sum >& _hours
+	*
+	* @returns long, the number of values read, -1 if the file or the channel was not found
+	*
+	*/
+long log_read_hourly(const string& _fpath, const string& _channel, int64_t (*_hour_of)(int64_t), unordered_map< int64_t, log_hour_sum >& _hours)
+{
+	if(log_is_binary(_fpath))
+	{
+		LOG_READER lr;
+		int c;
+		if(!lr.open(_fpath) || (c = lr.channel(_channel)) < 0)
+		{
+			return -1;
+		}
+		long count = 0;
+		for(size_t i = 0; i < lr.size(); i++)
+		{
+			float v = lr.value(i, c);
+			if(!isnan(v))
+			{
+				log_hour_sum& h = _hours[_hour_of(lr.epoch_us(i) / 1000000)];
+				h.sum += v;
+				h.n++;
+				count++;
+			}
+		}
+		return count;
+	}
+
+	int fd = open(_fpath.c_str(), O_RDONLY);
+	if(fd == -1)
+	{
+		return -1;
+	}
+	struct stat st;
+	if(fstat(fd, &st) == -1 || st.st_size == 0)
+	{
+		close(fd);
+		return -1;
+	}
+	void* m = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(m == MAP_FAILED)
+	{
+		perror("mmap()");
+		return -1;
+	}
+	madvise(m, st.st_size, MADV_SEQUENTIAL);
+	const char* p = (const char*)m;
+	const char* end = p + st.st_size;
+
+	// find the header row and the column of the channel
+	int column = log_text_header(p, end, _channel);
+	if(column < 0)
+	{
+		munmap(m, st.st_size);
+		return -1;
+	}
+
+	log_text_clock clk;
+	long count = 0;
+	while(p < end)
+	{
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		if(!eol)
+		{
+			eol = end;
+		}
+		int64_t ts = log_text_time(p, eol, clk);
+		if(ts >= 0)
+		{
+			float v = log_text_field(p, eol, column);
+			if(!isnan(v))
+			{
+				log_hour_sum& h = _hours[_hour_of(ts)];
+				h.sum += v;
+				h.n++;
+				count++;
+			}
+		}
+		p = eol + 1;
+	}
+
+	munmap(m, st.st_size);
+	return count;
+}
@@ -0,0 +1,901 @@
+#pragma once
+
+/*
+* logwriter.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:38
+* Modified:		19/10-2026 06:04
+* Version:		1.4
+*
+* Description:
+*	This header includes the background writer behind LOGGER. Records are collected in 4 KiB pages in memory and a
+*	thread writes the full pages with pwrite() at page aligned offsets, so the SD card gets few, aligned writes and a
+*	slow card never stalls the tick that logs. Every sync interval the unfinished page is written as well and the
+*	file is flushed with fdatasync(), which bounds what a power cut can lose.
+*	Optionally every record is also appended to a copy in a staging folder on a tmpfs (e.g. /run/ecodome). If the
+*	program dies, the copy is moved to the SD card by log_recover_staged() at the next start.
+*	Logs that are closed are gzip compressed by LOG_COMPRESSOR, a thread with the lowest CPU and I/O priority.
+*
+* NOTE:
+*	append() never waits for the card. When all LOG_QUEUE_PAGES pages are waiting to be written the record is
+*	dropped and counted in the statistics.
+*	A power cut loses at most the last sync interval plus the time the card needs for the write, a crash of the
+*	program loses nothing when staging is used.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <zlib.h>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include "mythread.h"
+#include "binlog.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define LOG_PAGE			4096		// bytes written to the card at a time
+#define LOG_QUEUE_PAGES		64			// pages that can wait for the card, 256 KiB
+#define LOG_SYNC_INTERVAL	60			// default seconds between fdatasync(), the most a power cut can lose
+#define LOG_LATENCY_BUCKETS	24			// bucket b of the latency histogram counts 2^b to 2^(b+1) us
+#define LOG_GZIP_LEVEL		6			// zlib level of closed logs
+
+// what the writer has done, see LOG_ASYNC_WRITER::get_stats()
+struct log_writer_stats
+{
+	unsigned long records = 0;			// records accepted
+	unsigned long dropped = 0;			// records dropped because every page was waiting for the card
+	unsigned long long bytes = 0;		// bytes accepted, including the header
+	unsigned long writes = 0;			// pwrite() calls on the log
+	unsigned long syncs = 0;			// fdatasync() calls on the log
+	unsigned long errors = 0;			// rounds where a write or sync failed
+	unsigned long staged = 0;			// write() calls on the staging copy
+	unsigned queued_max = 0;			// most pages waiting at once
+	double append_max = 0;				// longest append() [s]
+	double flush_max = 0;				// longest round of pwrite() and fdatasync() [s]
+	unsigned long flush_hist[LOG_LATENCY_BUCKETS] = {0};	// rounds by duration
+};
+
+
+// ###############################################		FUNCTIONS	#################################################### //
+
+	/*! @brief Upper bound of a percentile of the flush latency, from the histogram
+	*
+	*
+	*
+	* @param const log_writer_stats& _s, double _p (0 to 1)
+	*
+	* @returns double [s], 0 if nothing has been flushed
+	*
+	*/
+double log_flush_percentile(const log_writer_stats& _s, double _p)
+{
+	unsigned long total = 0;
+	for(int b = 0; b < LOG_LATENCY_BUCKETS; b++)
+	{
+		total += _s.flush_hist[b];
+	}
+	unsigned long seen = 0;
+	for(int b = 0; b < LOG_LATENCY_BUCKETS && total; b++)
+	{
+		seen += _s.flush_hist[b];
+		if(seen >= _p * total)
+		{
+			return (2 << b) / 1e6;
+		}
+	}
+	return 0;
+}
+
+	/*! @brief Moves the logs left in the staging folder by a run that did not close its log to the log folder. The
+	*	part of a log that is missing on the card is copied, then the staged copy is deleted.
+	*
+	*
+	*
+	* @param const string& _staging, const string& _dir
+	*
+	* @returns int, the number of logs recovered
+	*
+	*/
+int log_recover_staged(const string& _staging, const string& _dir)
+{
+	DIR* dir = opendir(_staging.c_str());
+	if(!dir)
+	{
+		return 0;
+	}
+	int recovered = 0;
+	struct dirent* ent;
+	while((ent = readdir(dir)) != NULL)
+	{
+		string name = ent->d_name;
+		if(!log_ends_with(name, LOG_EXTENSION))
+		{
+			continue;
+		}
+		string from = _staging + "/" + name;
+		string to = _dir + (_dir.empty() || _dir[_dir.size() - 1] == '/' ? "" : "/") + name;
+
+		int in = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+		int out = open(to.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+		struct stat si, so;
+		bool ok = in != -1 && out != -1 && fstat(in, &si) == 0 && fstat(out, &so) == 0;
+
+		// the card holds a prefix of the staged copy, whatever it has is already right
+		off_t off = ok ? so.st_size : 0;
+		char buf[LOG_PAGE];
+		while(ok && off < si.st_size)
+		{
+			ssize_t r = pread(in, buf, sizeof(buf), off);
+			ok = r > 0 && pwrite(out, buf, r, off) == r;
+			off += ok ? r : 0;
+		}
+		ok = ok && fdatasync(out) == 0;
+		if(in != -1)
+		{
+			close(in);
+		}
+		if(out != -1)
+		{
+			close(out);
+		}
+		if(!ok)
+		{
+			perror(("log_recover_staged() " + from).c_str());
+			continue;
+		}
+		unlink(from.c_str());
+		recovered++;
+	}
+	closedir(dir);
+	return recovered;
+}
+
+	/*! @brief Compresses a closed log to _fpath + LOG_COMPRESSED and deletes the log. The records are shuffled
+	*	first, see log_shuffle(), a torn last record is left out. The compressed file is written under a temporary
+	*	name and synced before it replaces the log, so a power cut leaves one of the two.
+	*
+	*
+	*
+	* @param const string& _fpath, int _level, unsigned long long* _in, unsigned long long* _out (bytes, optional)
+	*
+	* @returns bool
+	*
+	*/
+bool log_compress(const string& _fpath, int _level = LOG_GZIP_LEVEL, unsigned long long* _in = NULL, unsigned long long* _out = NULL)
+{
+	string gzpath = _fpath + LOG_COMPRESSED;
+	string tmp = gzpath + ".tmp";
+
+	// a closed log is at most a few MB, it is read in one go
+	vector< uint8_t > buf;
+	int in = open(_fpath.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	bool ok = in != -1 && fstat(in, &st) == 0;
+	if(ok)
+	{
+		buf.resize(st.st_size);
+		size_t got = 0;
+		while(ok && got < buf.size())
+		{
+			ssize_t r = read(in, buf.data() + got, buf.size() - got);
+			ok = r > 0 || (r == -1 && errno == EINTR);
+			got += r > 0 ? r : 0;
+		}
+	}
+	if(in != -1)
+	{
+		close(in);
+	}
+	if(!ok)
+	{
+		perror(("log_compress() " + _fpath).c_str());
+		return false;
+	}
+
+	log_file_header h;
+	if(buf.size() >= sizeof(h))
+	{
+		memcpy(&h, buf.data(), sizeof(h));
+		if(memcmp(h.magic, LOG_MAGIC, sizeof(h.magic)) == 0 && h.header_size <= buf.size() && h.record_size && !(h.flags & LOG_FLAG_SHUFFLED))
+		{
+			size_t n = (buf.size() - h.header_size) / h.record_size;
+			buf.resize(h.header_size + n * h.record_size);
+			log_shuffle(buf.data() + h.header_size, n, h.record_size, true);
+			h.flags |= LOG_FLAG_SHUFFLED;
+			memcpy(buf.data(), &h, sizeof(h));
+		}
+	}
+
+	int out = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	char mode[8];
+	snprintf(mode, sizeof(mode), "wb%d", _level);
+	gzFile gz = out == -1 ? NULL : gzdopen(dup(out), mode);
+	ok = gz != NULL && (buf.empty() || gzwrite(gz, buf.data(), buf.size()) == (int)buf.size());
+	if(gz)
+	{
+		ok = (gzclose(gz) == Z_OK) && ok;
+	}
+	ok = ok && fdatasync(out) == 0 && fstat(out, &st) == 0;
+	if(out != -1)
+	{
+		close(out);
+	}
+	if(!ok || rename(tmp.c_str(), gzpath.c_str()) == -1)
+	{
+		perror(("log_compress() " + _fpath).c_str());
+		unlink(tmp.c_str());
+		return false;
+	}
+	unlink(_fpath.c_str());
+	if(_in)
+	{
+		*_in += buf.size();
+	}
+	if(_out)
+	{
+		*_out += st.st_size;
+	}
+	return true;
+}
+
+
+// ###############################################		THREADS 	#################################################### //
+
+	/*! @brief	Writes a binary log from a background thread in page sized, page aligned blocks
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	LOG_ASYNC_WRITER lw(60, "/run/ecodome");		// fdatasync() every minute, staged on a tmpfs
+	*	lw.open("./logs/logdata0.ecl", ch, 10);
+	*	lw.append(v, 2);								// copies the record, never waits for the card
+	*	lw.close();										// writes and syncs the rest
+	* @endcode
+	*
+	*/
+class LOG_ASYNC_WRITER : public MyThreadClass
+{
+public:
+	/*! @brief Constructor
+	*
+	*
+	*
+	* @param int _sync_interval [s], const string& _staging (empty for no staging)
+	*
+	* @returns void
+	*
+	*/
+	LOG_ASYNC_WRITER(int _sync_interval = LOG_SYNC_INTERVAL, const string& _staging = "") : sync_interval(_sync_interval > 0 ? _sync_interval : LOG_SYNC_INTERVAL), staging(_staging), ring(LOG_QUEUE_PAGES * LOG_PAGE)
+	{
+
+	}
+
+	~LOG_ASYNC_WRITER()
+	{
+		close();
+	}
+
+	/*! @brief creates the log, queues the header and starts the writer thread. With _append a log with the same
+	*	schema is continued instead, a torn last record is cut off; a log with another schema is moved aside with
+	*	move_aside() and started over. Appended logs are not staged.
+	*
+	*
+	*
+	* @param const string& _fpath, const vector< log_channel >& _channels, int _time_step, bool _append
+	*
+	* @returns bool
+	*
+	*/
+	bool open(const string& _fpath, const vector< log_channel >& _channels, int _time_step, bool _append = false)
+	{
+		close();
+		const vector< uint8_t >& h = packer.prepare(_channels, _time_step);
+		uint64_t keep = _append ? resume_size(_fpath, h) : 0;
+		if(_append && !keep && !move_aside(_fpath))
+		{
+			return false;
+		}
+		fd = ::open(_fpath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (keep ? 0 : O_TRUNC), 0644);
+		if(fd == -1)
+		{
+			perror("open()");
+			return false;
+		}
+		if(!staging.empty() && !keep)
+		{
+			size_t slash = _fpath.rfind('/');
+			stage_path = staging + "/" + (slash == string::npos ? _fpath : _fpath.substr(slash + 1));
+			mkdir(staging.c_str(), 0755);
+			stage_fd = ::open(stage_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+			if(stage_fd == -1)
+			{
+				perror(("open() " + stage_path).c_str());
+			}
+		}
+
+		head = 0;
+		written = 0;
+		synced = 0;
+		stats = log_writer_stats();
+		running = true;
+		next_sync = chrono::steady_clock::now() + chrono::seconds(sync_interval);
+
+		if(keep)
+		{
+			// continue after the last whole record, the unfinished page is read back as it is written again in full
+			written = keep - keep % LOG_PAGE;
+			if(ftruncate(fd, keep) == -1 || pread(fd, ring.data() + written % ring.size(), keep - written, written) != (ssize_t)(keep - written))
+			{
+				perror("LOG_ASYNC_WRITER::open() append");
+				::close(fd);
+				fd = -1;
+				return false;
+			}
+			head = keep;
+			synced = keep;
+		}
+		else
+		{
+			put(h.data(), h.size(), false);
+			stage(h.data(), h.size());
+		}
+
+		if(!StartInternalThread())
+		{
+			perror("LOG_ASYNC_WRITER::open()");
+			::close(fd);
+			fd = -1;
+			return false;
+		}
+		started = true;
+		return true;
+	}
+
+	/*! @brief queues one record, see LOG_WRITER::pack()
+	*
+	*
+	*
+	* @param const float* _values, size_t _n, int64_t _epoch_us (the time stamp, the clock is used if < 0)
+	*
+	* @returns bool, false if the record was dropped
+	*
+	*/
+	bool append(const float* _values, size_t _n, int64_t _epoch_us = -1)
+	{
+		if(!started)
+		{
+			return false;
+		}
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		const vector< uint8_t >& rec = packer.pack(_values, _n, _epoch_us);
+		bool ok = put(rec.data(), rec.size(), true);
+		if(ok)
+		{
+			stage(rec.data(), rec.size());
+		}
+		double dt = chrono::duration< double >(chrono::steady_clock::now() - t0).count();
+
+		lock_guard <mutex> log_lock(log_mutex);
+		if(dt > stats.append_max)
+		{
+			stats.append_max = dt;
+		}
+		return ok;
+	}
+
+	/*! @brief stops the thread after it has written and synced everything, the staged copy is deleted when that
+	*	succeeded
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void close(void)
+	{
+		if(!started)
+		{
+			return;
+		}
+		log_mutex.lock();
+		running = false;
+		log_mutex.unlock();
+		log_cond.notify_all();
+		WaitForInternalThreadToExit();
+		started = false;
+
+		::close(fd);
+		fd = -1;
+		if(stage_fd != -1)
+		{
+			::close(stage_fd);
+			stage_fd = -1;
+			if(final_ok)
+			{
+				unlink(stage_path.c_str());
+			}
+		}
+	}
+
+	log_writer_stats get_stats(void)
+	{
+		lock_guard <mutex> log_lock(log_mutex);
+		return stats;
+	}
+
+	size_t record_size(void) const
+	{
+		return packer.record_size();
+	}
+
+	// bytes queued so far, the size the log will have
+	uint64_t size(void)
+	{
+		lock_guard <mutex> log_lock(log_mutex);
+		return head;
+	}
+
+protected:
+	/** Implement this method in your subclass with the code you want your thread to run. */
+	void InternalThreadEntry()
+	{
+		unique_lock<mutex> log_lock(log_mutex);
+		while(true)
+		{
+			// wait for a full page, the next sync or close()
+			while(running && head - head % LOG_PAGE == written && chrono::steady_clock::now() < next_sync)
+			{
+				log_cond.wait_until(log_lock, next_sync);
+			}
+			bool stop = !running;
+			bool sync = stop || chrono::steady_clock::now() >= next_sync;
+			if(sync)
+			{
+				next_sync = chrono::steady_clock::now() + chrono::seconds(sync_interval);
+			}
+			uint64_t h = head;
+			uint64_t w = written;
+			uint64_t full = h - h % LOG_PAGE;
+			unsigned queued = (full - w) / LOG_PAGE + (h != full);
+			if(queued > stats.queued_max)
+			{
+				stats.queued_max = queued;
+			}
+			// nothing new since the last sync
+			if(sync && h == synced)
+			{
+				sync = false;
+			}
+			log_lock.unlock();
+
+			// the bytes before head are not touched by append(), so they are written without the lock
+			chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+			unsigned long calls = 0;
+			bool ok = write_range(w, full, calls);
+			if(sync)
+			{
+				// the unfinished page, it is written again in full once it fills up
+				ok = write_range(full, h, calls) && ok;
+				if(fdatasync(fd) == -1)
+				{
+					perror("fdatasync()");
+					ok = false;
+				}
+			}
+			double dt = chrono::duration< double >(chrono::steady_clock::now() - t0).count();
+
+			log_lock.lock();
+			written = full;
+			if(sync)
+			{
+				synced = h;
+				stats.syncs++;
+			}
+			stats.writes += calls;
+			stats.errors += !ok;
+			if(calls || sync)
+			{
+				int b = 0;
+				for(double us = dt * 1e6; us >= 2 && b < LOG_LATENCY_BUCKETS - 1; us /= 2)
+				{
+					b++;
+				}
+				stats.flush_hist[b]++;
+				if(dt > stats.flush_max)
+				{
+					stats.flush_max = dt;
+				}
+			}
+			if(stop)
+			{
+				final_ok = ok && synced == head;
+				break;
+			}
+		}
+	}
+
+private:
+	/*! @brief how much of an existing log can be continued: the header up to the last whole record, if the log
+	*	has the schema of _header. Only the start time may differ.
+	*
+	*
+	*
+	* @param const string& _fpath, const vector< uint8_t >& _header
+	*
+	* @returns uint64_t, bytes to keep, 0 to start over
+	*
+	*/
+	static uint64_t resume_size(const string& _fpath, const vector< uint8_t >& _header)
+	{
+		int in = ::open(_fpath.c_str(), O_RDONLY | O_CLOEXEC);
+		if(in == -1)
+		{
+			return 0;
+		}
+		struct stat st;
+		vector< uint8_t > old(_header.size());
+		bool ok = fstat(in, &st) == 0 && (uint64_t)st.st_size >= _header.size() && pread(in, old.data(), old.size(), 0) == (ssize_t)old.size();
+		::close(in);
+		size_t started = offsetof(log_file_header, started);
+		if(!ok || memcmp(old.data(), _header.data(), started) != 0
+			|| memcmp(old.data() + started + sizeof(int64_t), _header.data() + started + sizeof(int64_t), _header.size() - started - sizeof(int64_t)) != 0)
+		{
+			return 0;
+		}
+		log_file_header h;
+		memcpy(&h, _header.data(), sizeof(h));
+		return h.header_size + (st.st_size - h.header_size) / h.record_size * h.record_size;
+	}
+
+	/*! @brief renames a log that cannot be continued to the first free name with a number before the extension
+	*	(rollup_1h.ecl to rollup_1h.1.ecl, rollup_1h.2.ecl, ...), so its records are kept like those of a rotated log.
+	*	A missing or empty file is left as it is.
+	*
+	*
+	*
+	* @param const string& _fpath
+	*
+	* @returns bool, false if the log is still in the way
+	*
+	*/
+	static bool move_aside(const string& _fpath)
+	{
+		struct stat st;
+		if(stat(_fpath.c_str(), &st) == -1 || st.st_size == 0)
+		{
+			return true;
+		}
+		size_t slash = _fpath.rfind('/');
+		size_t dot = _fpath.rfind('.');
+		if(dot == string::npos || (slash != string::npos && dot < slash))
+		{
+			dot = _fpath.size();
+		}
+		string to;
+		for(unsigned long n = 1; ; n++)
+		{
+			to = _fpath.substr(0, dot) + "." + to_string(n) + _fpath.substr(dot);
+			if(stat(to.c_str(), &st) == -1 && stat((to + LOG_COMPRESSED).c_str(), &st) == -1)
+			{
+				break;
+			}
+		}
+		if(rename(_fpath.c_str(), to.c_str()) == -1)
+		{
+			perror(("rename() " + _fpath).c_str());
+			return false;
+		}
+		cout << _fpath << " has another schema, it is kept as " << to << endl;
+		return true;
+	}
+
+	/*! @brief copies bytes into the pages, wakes the thread when a page is full
+	*
+	*
+	*
+	* @param const uint8_t* _p, size_t _n, bool _record
+	*
+	* @returns bool, false if there was no room
+	*
+	*/
+	bool put(const uint8_t* _p, size_t _n, bool _record)
+	{
+		unique_lock<mutex> log_lock(log_mutex);
+		if(head + _n - written > ring.size())
+		{
+			stats.dropped++;
+			return false;
+		}
+		size_t off = head % ring.size();
+		size_t first = _n < ring.size() - off ? _n : ring.size() - off;
+		memcpy(ring.data() + off, _p, first);
+		memcpy(ring.data(), _p + first, _n - first);
+		bool page_full = (head + _n) / LOG_PAGE != head / LOG_PAGE;
+		head += _n;
+		stats.bytes += _n;
+		stats.records += _record;
+		log_lock.unlock();
+
+		if(page_full)
+		{
+			log_cond.notify_all();
+		}
+		return true;
+	}
+
+	// the staging copy is on a tmpfs, so the write is a memory copy
+	void stage(const uint8_t* _p, size_t _n)
+	{
+		if(stage_fd == -1)
+		{
+			return;
+		}
+		if(write(stage_fd, _p, _n) != (ssize_t)_n)
+		{
+			perror("write() staging");
+		}
+		lock_guard <mutex> log_lock(log_mutex);
+		stats.staged++;
+	}
+
+	/*! @brief writes the bytes _from to _to of the log, at their offset in the file
+	*
+	*
+	*
+	* @param uint64_t _from, uint64_t _to, unsigned long& _calls
+	*
+	* @returns bool
+	*
+	*/
+	bool write_range(uint64_t _from, uint64_t _to, unsigned long& _calls)
+	{
+		while(_from < _to)
+		{
+			size_t off = _from % ring.size();
+			size_t n = _to - _from < ring.size() - off ? _to - _from : ring.size() - off;
+			ssize_t w = pwrite(fd, ring.data() + off, n, _from);
+			_calls++;
+			if(w == -1 && errno == EINTR)
+			{
+				continue;
+			}
+			if(w <= 0)
+			{
+				perror("pwrite()");
+				return false;
+			}
+			_from += w;
+		}
+		return true;
+	}
+
+	int sync_interval;
+	string staging;
+	string stage_path;
+	int fd = -1;
+	int stage_fd = -1;
+	bool started = false;
+	bool final_ok = false;
+	LOG_WRITER packer;
+
+	// the log as a stream of bytes, byte i is at ring[i % ring.size()]
+	vector< uint8_t > ring;
+	uint64_t head = 0;				// bytes queued
+	uint64_t written = 0;			// bytes on the card, always at a page boundary
+	uint64_t synced = 0;			// bytes on the card at the last fdatasync()
+	bool running = false;
+	chrono::steady_clock::time_point next_sync;
+	log_writer_stats stats;
+
+	std::mutex log_mutex;
+	std::condition_variable log_cond;
+};
+
+
+	/*! @brief	Closes logs and compresses them in the background, with the lowest CPU and I/O priority so it never
+	*	competes with the control loop or the log writer
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	LOG_COMPRESSOR lc;
+	*	lc.StartInternalThread();
+	*	lc.add(old_writer, "./logs/logdata3.ecl");		// closes old_writer, deletes it and compresses the log
+	*	lc.add(old_writer, "./logs/logdata4.ecl", false);	// only closes and deletes old_writer
+	*	lc.stop();										// finishes the queue first
+	* @endcode
+	*
+	*/
+class LOG_COMPRESSOR : public MyThreadClass
+{
+public:
+	LOG_COMPRESSOR(int _level = LOG_GZIP_LEVEL) : level(_level)
+	{
+
+	}
+
+	~LOG_COMPRESSOR()
+	{
+		stop();
+	}
+
+	/*! @brief Starts the thread
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns bool
+	*
+	*/
+	bool start(void)
+	{
+		lock_guard <mutex> gz_lock(gz_mutex);
+		if(started)
+		{
+			return true;
+		}
+		running = true;
+		started = StartInternalThread();
+		return started;
+	}
+
+	/*! @brief queues a log, the writer (if any) is closed and deleted by the thread before the log is compressed
+	*
+	*
+	*
+	* @param LOG_ASYNC_WRITER* _writer (may be NULL), const string& _fpath, bool _compress, false to only close the
+	*	writer
+	*
+	* @returns void
+	*
+	*/
+	void add(LOG_ASYNC_WRITER* _writer, const string& _fpath, bool _compress = true)
+	{
+		gz_mutex.lock();
+		if(!started)
+		{
+			// no thread, the writer is closed here so it does not stay open until stop()
+			gz_mutex.unlock();
+			delete _writer;
+			_writer = NULL;
+			gz_mutex.lock();
+		}
+		queue.push_back(job(_writer, _fpath, _compress));
+		gz_mutex.unlock();
+		gz_cond.notify_all();
+	}
+
+	/*! @brief compresses what is queued and stops the thread
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void stop(void)
+	{
+		gz_mutex.lock();
+		bool was = started;
+		running = false;
+		started = false;
+		gz_mutex.unlock();
+		gz_cond.notify_all();
+		if(was)
+		{
+			WaitForInternalThreadToExit();
+		}
+		// without a thread the writers still have to be closed
+		for(size_t i = 0; i < queue.size(); i++)
+		{
+			delete queue[i].writer;
+		}
+		queue.clear();
+	}
+
+	unsigned long get_done(void)
+	{
+		lock_guard <mutex> gz_lock(gz_mutex);
+		return done;
+	}
+
+	// bytes before and after compression
+	void get_bytes(unsigned long long& _in, unsigned long long& _out)
+	{
+		lock_guard <mutex> gz_lock(gz_mutex);
+		_in = bytes_in;
+		_out = bytes_out;
+	}
+
+protected:
+	/** Implement this method in your subclass with the code you want your thread to run. */
+	void InternalThreadEntry()
+	{
+		// nice 19 and the idle I/O class, for this thread only
+		setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+		syscall(SYS_ioprio_set, 1, 0, (3 << 13));
+
+		unique_lock<mutex> gz_lock(gz_mutex);
+		while(true)
+		{
+			while(running && queue.empty())
+			{
+				gz_cond.wait(gz_lock);
+			}
+			if(queue.empty())
+			{
+				break;
+			}
+			job j = queue.front();
+			queue.pop_front();
+			gz_lock.unlock();
+
+			// the final sync of the writer happens here rather than in the tick that rotated the log
+			delete j.writer;
+			if(!j.compress)
+			{
+				gz_lock.lock();
+				continue;
+			}
+			unsigned long long in = 0, out = 0;
+			bool ok = log_compress(j.fpath, level, &in, &out);
+
+			gz_lock.lock();
+			done += ok;
+			bytes_in += in;
+			bytes_out += out;
+		}
+	}
+
+private:
+	struct job
+	{
+		LOG_ASYNC_WRITER* writer;
+		string fpath;
+		bool compress;
+
+		job(LOG_ASYNC_WRITER* _writer, const string& _fpath, bool _compress) : writer(_writer), fpath(_fpath), compress(_compress)
+		{
+
+		}
+	};
+
+	int level;
+	bool running = false;
+	bool started = false;
+	deque< job > queue;
+	unsigned long done = 0;
+	unsigned long long bytes_in = 0;
+	unsigned long long bytes_out = 0;
+
+	std::mutex gz_mutex;
+	std::condition_variable gz_cond;
+};
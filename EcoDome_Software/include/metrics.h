@@ -0,0 +1,771 @@
+#pragma once
+
+/*
+* metrics.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:18
+* Modified:		19/10-2026 05:58
+* Version:		1.1
+*
+* Description:
+*	This header includes a registry of counters, gauges and histograms of the running program, the sensors, the
+*	controller, the actuators and how long the stages of a control step take, and METRICS_SERVER that serves them
+*	in the Prometheus text format on a local TCP port or Unix socket, e.g. curl http://localhost:9105/metrics
+*
+* NOTE:
+*	Updating a metric is a relaxed atomic on a cache line of the updating thread (one of METRIC_SHARDS), it takes
+*	no lock and does not share a line with the other threads. A scrape adds the shards up while the threads go on,
+*	so the values of one scrape may be a step apart but every value is whole.
+*	The registry lock is only taken when a metric is registered (at start) and by a scrape, never by an update.
+*	Metrics are never freed before the registry, the pointers can be kept.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "mythread.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define METRIC_SHARDS			8			// cache lines per counter, threads beyond that share them
+#define METRIC_LINE				8			// uint64_t per cache line
+#define METRICS_PORT			"9105"
+#define METRICS_MAX_REQUEST		2048
+
+enum
+{
+	METRIC_COUNTER_TYPE = 0,
+	METRIC_GAUGE_TYPE,
+	METRIC_HISTOGRAM_TYPE
+};
+const char* const metric_type_names[] = {"counter", "gauge", "histogram"};
+
+// the shard of the calling thread, threads are given shards in the order they first update a metric
+inline unsigned metric_shard(void)
+{
+	static atomic<unsigned> next(0);
+	static thread_local unsigned shard = next.fetch_add(1, memory_order_relaxed) % METRIC_SHARDS;
+	return shard;
+}
+
+// _lines zeroed cache lines of counters
+inline atomic<uint64_t>* metric_alloc(size_t _lines)
+{
+	static_assert(sizeof(atomic<uint64_t>) == sizeof(uint64_t), "atomic<uint64_t> must be a plain uint64_t");
+	void* p = NULL;
+	if(posix_memalign(&p, 64, _lines * 64) != 0)
+	{
+		perror("metric_alloc()");
+		exit(1);
+	}
+	memset(p, 0, _lines * 64);
+	return (atomic<uint64_t>*)p;
+}
+
+inline uint64_t metric_bits(double _v)
+{
+	uint64_t b;
+	memcpy(&b, &_v, sizeof(b));
+	return b;
+}
+
+inline double metric_double(uint64_t _b)
+{
+	double v;
+	memcpy(&v, &_b, sizeof(v));
+	return v;
+}
+
+// a value as the text format wants it
+inline void metric_format(string& _out, double _v)
+{
+	char buf[32];
+	if(isnan(_v))				strcpy(buf, "NaN");
+	else if(isinf(_v))			strcpy(buf, _v > 0 ? "+Inf" : "-Inf");
+	else						snprintf(buf, sizeof(buf), "%.9g", _v);
+	_out += buf;
+}
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	A counter that only goes up, e.g. sensor read errors
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	METRIC_COUNTER* c = metrics().counter("ecodome_steps_total", "Control steps");
+	*	c->inc();
+	* @endcode
+	*
+	*/
+class METRIC_COUNTER
+{
+public:
+	METRIC_COUNTER() : cells(metric_alloc(METRIC_SHARDS))
+	{
+
+	}
+
+	~METRIC_COUNTER()
+	{
+		free(cells);
+	}
+
+	void inc(uint64_t _n = 1)
+	{
+		cells[metric_shard() * METRIC_LINE].fetch_add(_n, memory_order_relaxed);
+	}
+
+	uint64_t value(void) const
+	{
+		uint64_t v = 0;
+		for(int s = 0; s < METRIC_SHARDS; s++)
+		{
+			v += cells[s * METRIC_LINE].load(memory_order_relaxed);
+		}
+		return v;
+	}
+
+private:
+	METRIC_COUNTER(const METRIC_COUNTER&);
+	METRIC_COUNTER& operator=(const METRIC_COUNTER&);
+
+	atomic<uint64_t>* cells;
+};
+
+
+	/*! @brief	A value that is set, e.g. a temperature. The last set() wins, so it has one cache line of its own.
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	METRIC_GAUGE* g = metrics().gauge("ecodome_control_u", "Control signal");
+	*	g->set(u);
+	* @endcode
+	*
+	*/
+class METRIC_GAUGE
+{
+public:
+	METRIC_GAUGE() : cell(metric_alloc(1))
+	{
+		cell->store(metric_bits(NAN), memory_order_relaxed);
+	}
+
+	~METRIC_GAUGE()
+	{
+		free(cell);
+	}
+
+	void set(double _v)
+	{
+		cell->store(metric_bits(_v), memory_order_relaxed);
+	}
+
+	double value(void) const
+	{
+		return metric_double(cell->load(memory_order_relaxed));
+	}
+
+private:
+	METRIC_GAUGE(const METRIC_GAUGE&);
+	METRIC_GAUGE& operator=(const METRIC_GAUGE&);
+
+	atomic<uint64_t>* cell;
+};
+
+
+	/*! @brief	Counts observations in buckets with fixed upper bounds, e.g. how long a stage took
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	vector< double > b = {0.001, 0.01, 0.1, 1};
+	*	METRIC_HISTOGRAM* h = metrics().histogram("ecodome_stage_seconds", "Stage time", b);
+	*	h->observe(0.004);
+	* @endcode
+	*
+	*/
+class METRIC_HISTOGRAM
+{
+public:
+	METRIC_HISTOGRAM(const vector< double >& _bounds) : bounds(_bounds)
+	{
+		// per shard: a count per bound, one for +Inf and the sum, rounded up to whole cache lines
+		stride = ((bounds.size() + 2 + METRIC_LINE - 1) / METRIC_LINE) * METRIC_LINE;
+		cells = metric_alloc(METRIC_SHARDS * stride / METRIC_LINE);
+	}
+
+	~METRIC_HISTOGRAM()
+	{
+		free(cells);
+	}
+
+	void observe(double _v)
+	{
+		size_t b = 0;
+		while(b < bounds.size() && _v > bounds[b])
+		{
+			b++;
+		}
+		atomic<uint64_t>* sh = cells + metric_shard() * stride;
+		sh[b].fetch_add(1, memory_order_relaxed);
+
+		// the sum is a double, the shard is only shared if there are more threads than shards
+		atomic<uint64_t>& sum = sh[bounds.size() + 1];
+		uint64_t old = sum.load(memory_order_relaxed);
+		while(!sum.compare_exchange_weak(old, metric_bits(metric_double(old) + _v), memory_order_relaxed))
+		{
+		}
+	}
+
+	const vector< double >& get_bounds(void) const
+	{
+		return bounds;
+	}
+
+	/*! @brief the counts of the buckets (not cumulative, the last one is +Inf) and the sum, all shards added up
+	*
+	*
+	*
+	* @param vector< uint64_t >& _counts, double& _sum
+	*
+	* @returns void
+	*
+	*/
+	void value(vector< uint64_t >& _counts, double& _sum) const
+	{
+		_counts.assign(bounds.size() + 1, 0);
+		_sum = 0;
+		for(int s = 0; s < METRIC_SHARDS; s++)
+		{
+			const atomic<uint64_t>* sh = cells + s * stride;
+			for(size_t b = 0; b <= bounds.size(); b++)
+			{
+				_counts[b] += sh[b].load(memory_order_relaxed);
+			}
+			_sum += metric_double(sh[bounds.size() + 1].load(memory_order_relaxed));
+		}
+	}
+
+private:
+	METRIC_HISTOGRAM(const METRIC_HISTOGRAM&);
+	METRIC_HISTOGRAM& operator=(const METRIC_HISTOGRAM&);
+
+	vector< double > bounds;
+	size_t stride;
+	atomic<uint64_t>* cells;
+};
+
+
+	/*! @brief	All metrics of the program, by name and labels
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	METRIC_GAUGE* g = metrics().gauge("ecodome_temperature_celsius", "Sensor temperature", "device=\"28-0317200e5cff\"");
+	*	string text;
+	*	metrics().scrape(text);
+	* @endcode
+	*
+	*/
+class METRICS_REGISTRY
+{
+public:
+	METRICS_REGISTRY()
+	{
+
+	}
+
+	~METRICS_REGISTRY()
+	{
+		for(size_t i = 0; i < series.size(); i++)
+		{
+			switch(series[i].type)
+			{
+				case METRIC_COUNTER_TYPE:	delete (METRIC_COUNTER*)series[i].metric; break;
+				case METRIC_GAUGE_TYPE:		delete (METRIC_GAUGE*)series[i].metric; break;
+				default:					delete (METRIC_HISTOGRAM*)series[i].metric; break;
+			}
+		}
+	}
+
+	/*! @brief the counter of _name and _labels, it is made the first time
+	*
+	*
+	*
+	* @param const string& _name, const string& _help, const string& _labels (e.g. device="28-0317200e5cff", may be empty)
+	*
+	* @returns METRIC_COUNTER*
+	*
+	*/
+	METRIC_COUNTER* counter(const string& _name, const string& _help, const string& _labels = "")
+	{
+		lock_guard <mutex> reg_lock(reg_mutex);
+		void* m = find(_name, _labels, METRIC_COUNTER_TYPE);
+		if(!m)
+		{
+			m = add(_name, _help, _labels, METRIC_COUNTER_TYPE, new METRIC_COUNTER());
+		}
+		return (METRIC_COUNTER*)m;
+	}
+
+	/*! @brief the gauge of _name and _labels, it is made the first time with the value NaN
+	*
+	*
+	*
+	* @param const string& _name, const string& _help, const string& _labels
+	*
+	* @returns METRIC_GAUGE*
+	*
+	*/
+	METRIC_GAUGE* gauge(const string& _name, const string& _help, const string& _labels = "")
+	{
+		lock_guard <mutex> reg_lock(reg_mutex);
+		void* m = find(_name, _labels, METRIC_GAUGE_TYPE);
+		if(!m)
+		{
+			m = add(_name, _help, _labels, METRIC_GAUGE_TYPE, new METRIC_GAUGE());
+		}
+		return (METRIC_GAUGE*)m;
+	}
+
+	/*! @brief the histogram of _name and _labels, it is made the first time
+	*
+	*
+	*
+	* @param const string& _name, const string& _help, const vector< double >& _bounds (increasing upper bounds), const string& _labels
+	*
+	* @returns METRIC_HISTOGRAM*
+	*
+	*/
+	METRIC_HISTOGRAM* histogram(const string& _name, const string& _help, const vector< double >& _bounds, const string& _labels = "")
+	{
+		lock_guard <mutex> reg_lock(reg_mutex);
+		void* m = find(_name, _labels, METRIC_HISTOGRAM_TYPE);
+		if(!m)
+		{
+			m = add(_name, _help, _labels, METRIC_HISTOGRAM_TYPE, new METRIC_HISTOGRAM(_bounds));
+		}
+		return (METRIC_HISTOGRAM*)m;
+	}
+
+	/*! @brief all metrics in the Prometheus text format, grouped by name in the order they were registered
+	*
+	*
+	*
+	* @param string& _out
+	*
+	* @returns void
+	*
+	*/
+	void scrape(string& _out)
+	{
+		_out.clear();
+		vector< uint64_t > counts;
+		lock_guard <mutex> reg_lock(reg_mutex);
+		for(size_t f = 0; f < families.size(); f++)
+		{
+			const family& fam = families[f];
+			_out += "# HELP " + fam.name + " " + fam.help + "\n";
+			_out += "# TYPE " + fam.name + " " + metric_type_names[fam.type] + "\n";
+			for(size_t k = 0; k < fam.members.size(); k++)
+			{
+				const metric_series& s = series[fam.members[k]];
+				if(s.type == METRIC_COUNTER_TYPE)
+				{
+					line(_out, fam.name, s.labels, "", (double)((METRIC_COUNTER*)s.metric)->value());
+				}
+				else if(s.type == METRIC_GAUGE_TYPE)
+				{
+					line(_out, fam.name, s.labels, "", ((METRIC_GAUGE*)s.metric)->value());
+				}
+				else
+				{
+					const METRIC_HISTOGRAM* h = (METRIC_HISTOGRAM*)s.metric;
+					double sum;
+					h->value(counts, sum);
+					uint64_t cum = 0;
+					string le;
+					for(size_t b = 0; b < counts.size(); b++)
+					{
+						cum += counts[b];
+						le = s.labels.empty() ? "le=\"" : s.labels + ",le=\"";
+						if(b < h->get_bounds().size())
+						{
+							metric_format(le, h->get_bounds()[b]);
+						}
+						else
+						{
+							le += "+Inf";
+						}
+						le += "\"";
+						line(_out, fam.name + "_bucket", le, "", (double)cum);
+					}
+					line(_out, fam.name + "_sum", s.labels, "", sum);
+					line(_out, fam.name + "_count", s.labels, "", (double)cum);
+				}
+			}
+		}
+	}
+
+	// number of series
+	size_t size(void)
+	{
+		lock_guard <mutex> reg_lock(reg_mutex);
+		return series.size();
+	}
+
+private:
+	struct metric_series
+	{
+		string labels;
+		int type;
+		void* metric;
+	};
+
+	struct family
+	{
+		string name;
+		string help;
+		int type;
+		vector< size_t > members;
+	};
+
+	void* find(const string& _name, const string& _labels, int _type)
+	{
+		map< string, size_t >::iterator it = by_name.find(_name);
+		if(it == by_name.end())
+		{
+			return NULL;
+		}
+		const family& fam = families[it->second];
+		for(size_t k = 0; k < fam.members.size(); k++)
+		{
+			const metric_series& s = series[fam.members[k]];
+			if(s.labels == _labels && s.type == _type)
+			{
+				return s.metric;
+			}
+		}
+		return NULL;
+	}
+
+	void* add(const string& _name, const string& _help, const string& _labels, int _type, void* _metric)
+	{
+		map< string, size_t >::iterator it = by_name.find(_name);
+		if(it == by_name.end())
+		{
+			family fam;
+			fam.name = _name;
+			fam.help = _help;
+			fam.type = _type;
+			families.push_back(fam);
+			it = by_name.insert(make_pair(_name, families.size() - 1)).first;
+		}
+		metric_series s;
+		s.labels = _labels;
+		s.type = _type;
+		s.metric = _metric;
+		series.push_back(s);
+		families[it->second].members.push_back(series.size() - 1);
+		return _metric;
+	}
+
+	static void line(string& _out, const string& _name, const string& _labels, const char* _suffix, double _v)
+	{
+		_out += _name;
+		_out += _suffix;
+		if(!_labels.empty())
+		{
+			_out += "{" + _labels + "}";
+		}
+		_out += " ";
+		metric_format(_out, _v);
+		_out += "\n";
+	}
+
+	vector< metric_series > series;
+	vector< family > families;
+	map< string, size_t > by_name;	// family of a name
+
+	mutex reg_mutex;
+};
+
+// the metrics of the program
+inline METRICS_REGISTRY& metrics(void)
+{
+	static METRICS_REGISTRY registry;
+	return registry;
+}
+
+
+	/*! @brief	Serves the registry over HTTP: GET /metrics gives the text format, one request per connection
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	METRICS_SERVER ms;
+	*	ms.open("9105");				// 127.0.0.1:9105, or a path for a Unix socket
+	*	...
+	*	ms.close();
+	* @endcode
+	*
+	*/
+class METRICS_SERVER : public MyThreadClass
+{
+public:
+	METRICS_SERVER(METRICS_REGISTRY& _reg = metrics()) : reg(_reg)
+	{
+
+	}
+
+	~METRICS_SERVER()
+	{
+		close();
+	}
+
+	/*! @brief starts listening, on 127.0.0.1 if _listen is a port and on a Unix socket if it is a path
+	*
+	*
+	*
+	* @param const string& _listen
+	*
+	* @returns bool, false if the socket could not be opened
+	*
+	*/
+	bool open(const string& _listen)
+	{
+		if(_listen.find('/') != string::npos)
+		{
+			struct sockaddr_un addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sun_family = AF_UNIX;
+			strncpy(addr.sun_path, _listen.c_str(), sizeof(addr.sun_path) - 1);
+			unlink(addr.sun_path);
+			fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if(fd == -1 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+			{
+				return fail("METRICS_SERVER bind() " + _listen);
+			}
+			path = _listen;
+		}
+		else
+		{
+			struct sockaddr_in addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_port = htons(atoi(_listen.c_str()));
+			addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			int one = 1;
+			fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if(fd != -1)
+			{
+				setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+			}
+			if(fd == -1 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1)
+			{
+				return fail("METRICS_SERVER bind() 127.0.0.1:" + _listen);
+			}
+		}
+		if(listen(fd, 4) == -1 || pipe2(stop_pipe, O_CLOEXEC) == -1)
+		{
+			return fail("METRICS_SERVER listen()");
+		}
+		if(!StartInternalThread())
+		{
+			return fail("METRICS_SERVER thread");
+		}
+		started = true;
+		return true;
+	}
+
+	/*! @brief stops the thread and closes the socket
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void close(void)
+	{
+		if(started)
+		{
+			char c = 0;
+			if(write(stop_pipe[1], &c, 1) == -1)
+			{
+				perror("METRICS_SERVER close()");
+			}
+			WaitForInternalThreadToExit();
+			started = false;
+		}
+		cleanup();
+	}
+
+	// scrapes served so far
+	unsigned long get_scrapes(void) const
+	{
+		return scrapes;
+	}
+
+protected:
+	/** Implement this method in your subclass with the code you want your thread to run. */
+	void InternalThreadEntry()
+	{
+		struct pollfd p[2];
+		p[0].fd = fd;
+		p[0].events = POLLIN;
+		p[1].fd = stop_pipe[0];
+		p[1].events = POLLIN;
+		string text;
+		while(true)
+		{
+			if(poll(p, 2, -1) == -1)
+			{
+				if(errno == EINTR)
+				{
+					continue;
+				}
+				perror("METRICS_SERVER poll()");
+				return;
+			}
+			if(p[1].revents)
+			{
+				return;
+			}
+			int c = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+			if(c == -1)
+			{
+				continue;
+			}
+			serve(c, text);
+			::close(c);
+		}
+	}
+
+private:
+	// answers one request, a slow client is given up after a second
+	void serve(int _c, string& _text)
+	{
+		struct timeval tv = {1, 0};
+		setsockopt(_c, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(_c, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+		// the request line is enough, the rest of the header is not looked at
+		char req[METRICS_MAX_REQUEST];
+		size_t n = 0;
+		while(n < sizeof(req) - 1)
+		{
+			ssize_t r = recv(_c, req + n, sizeof(req) - 1 - n, 0);
+			if(r <= 0)
+			{
+				break;
+			}
+			n += r;
+			req[n] = 0;
+			if(strstr(req, "\r\n\r\n") || strstr(req, "\n\n"))
+			{
+				break;
+			}
+		}
+		req[n] = 0;
+
+		string head;
+		if(!strncmp(req, "GET /metrics ", 13) || !strncmp(req, "GET / ", 6))
+		{
+			reg.scrape(_text);
+			scrapes++;
+			head = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + to_string(_text.size()) + "\r\n\r\n";
+		}
+		else
+		{
+			_text = "Only GET /metrics\n";
+			head = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: " + to_string(_text.size()) + "\r\n\r\n";
+		}
+		if(send_all(_c, head.data(), head.size()))
+		{
+			send_all(_c, _text.data(), _text.size());
+		}
+	}
+
+	static bool send_all(int _c, const char* _p, size_t _n)
+	{
+		while(_n)
+		{
+			ssize_t w = send(_c, _p, _n, MSG_NOSIGNAL);
+			if(w <= 0)
+			{
+				return false;
+			}
+			_p += w;
+			_n -= w;
+		}
+		return true;
+	}
+
+	bool fail(const string& _what)
+	{
+		perror(_what.c_str());
+		cleanup();
+		return false;
+	}
+
+	void cleanup(void)
+	{
+		if(fd != -1)
+		{
+			::close(fd);
+		}
+		for(int i = 0; i < 2; i++)
+		{
+			if(stop_pipe[i] != -1)
+			{
+				::close(stop_pipe[i]);
+			}
+			stop_pipe[i] = -1;
+		}
+		if(!path.empty())
+		{
+			unlink(path.c_str());
+		}
+		fd = -1;
+		path.clear();
+	}
+
+	METRICS_REGISTRY& reg;
+	int fd = -1;
+	int stop_pipe[2] = {-1, -1};
+	string path;					// of the Unix socket
+	bool started = false;
+	unsigned long scrapes = 0;
+};
@@ -0,0 +1,319 @@
+#pragma once
+
+/*
+* nowcast.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:31
+* Modified:		19/10-2026 06:02
+* Version:		1.1
+*
+* Description:
+*	This header includes a nowcaster for the outside temperature: Holt-Winters (additive, damped trend) with a daily
+*	season on 5 minute means of the measured temperature. For the next few hours its output is blended into the
+*	prognosis, so the controller sees short term trends between the forecast steps.
+*	The season is learned from the deviation from the mean of the last 24 hours rather than from the level, as with
+*	5 minute steps the level follows the daily swing so closely that the season would never be learned.
+*
+* NOTE:
+*	The state is a fixed number of floats, a tick costs a few additions and a finished 5 minute step one update.
+*	The state is saved to NOWCAST_FILE once an hour so the daily season survives a restart, by the thread of
+*	statesave.h. A temperature of NAN, e.g. from a sensor that could not be read, is left out.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+
+#include "yrparse.h"
+#include "panalysis.h"
+#include "statesave.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define NOWCAST_FILE		"./data/nowcast.bin"
+#define NOWCAST_MAGIC		0x574F4E48		// "HNOW"
+#define NOWCAST_STEP		300				// length of a step [s]
+#define NOWCAST_SEASON		288				// steps in a day
+#define NOWCAST_ALPHA		0.3f			// smoothing of the level
+#define NOWCAST_BETA		0.05f			// smoothing of the trend
+#define NOWCAST_GAMMA		0.1f			// smoothing of the season
+#define NOWCAST_PHI			0.97f			// damping of the trend per step
+#define NOWCAST_WARMUP		12				// steps before the nowcast is used
+#define NOWCAST_GAP			12				// steps without measurements after which level and trend start over
+#define NOWCAST_HORIZON		10800			// how far ahead the nowcast is blended into the prognosis [s]
+#define NOWCAST_BLEND_STEP	900				// spacing of the blended points [s]
+
+// everything the nowcaster knows, also what is saved
+struct nowcast_state
+{
+	uint32_t magic = NOWCAST_MAGIC;
+	int64_t step = -1;				// number of the last finished step, t / NOWCAST_STEP
+	uint32_t steps = 0;				// steps seen since the level was last started over
+	uint32_t season_updates = 0;	// times the season has been updated
+	float level = 0;				// without the season
+	float trend = 0;				// per step
+	float season[NOWCAST_SEASON];	// indexed by step % NOWCAST_SEASON, 0 until learned
+	float day[NOWCAST_SEASON];		// means of the last day of steps, indexed the same way
+	uint32_t day_n = 0;				// valid entries in day
+	double day_sum = 0;				// sum of the valid entries in day
+};
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Holt-Winters nowcaster of the outside temperature
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	NOWCASTER nc;
+	*	nc.update(time(0), T_outmean);					// every control tick
+	*	float T1h = nc.nowcast(time(0) + 3600);			// NAN until warmed up
+	*	nc.blend(prognosis, time(0), blended);			// nowcast for the next 3 hours, prognosis after that
+	* @endcode
+	*
+	*/
+class NOWCASTER
+{
+public:
+	/*! @brief Constructor, loads the state saved by an earlier run if there is one
+	*
+	*
+	*
+	* @param const string& _fpath
+	*
+	* @returns void
+	*
+	*/
+	NOWCASTER(const string& _fpath = NOWCAST_FILE) : fpath(_fpath)
+	{
+		memset(st.season, 0, sizeof(st.season));
+		memset(st.day, 0, sizeof(st.day));
+		load();
+	}
+
+	/*! @brief adds a measurement, when a step is complete its mean updates level, trend and season
+	*
+	*
+	*
+	* @param time_t _now, float _T
+	*
+	* @returns void
+	*
+	*/
+	void update(time_t _now, float _T)
+	{
+		if(isnan(_T))
+		{
+			return;
+		}
+		int64_t s = _now / NOWCAST_STEP;
+		if(s != cur_step)
+		{
+			if(cur_n)
+			{
+				finish_step(cur_step, cur_sum / cur_n);
+			}
+			cur_step = s;
+			cur_sum = 0;
+			cur_n = 0;
+		}
+		cur_sum += _T;
+		cur_n++;
+	}
+
+	/*! @brief the nowcast for time _at
+	*
+	*
+	*
+	* @param time_t _at
+	*
+	* @returns float, NAN until NOWCAST_WARMUP steps have been seen
+	*
+	*/
+	float nowcast(time_t _at) const
+	{
+		if(!ready())
+		{
+			return NAN;
+		}
+		// steps are represented by their middle
+		int64_t h = (_at - NOWCAST_STEP / 2) / NOWCAST_STEP - st.step;
+		if(h < 0)
+		{
+			h = 0;
+		}
+		// damped trend: phi + phi^2 + ... + phi^h
+		float damp = NOWCAST_PHI * (1 - powf(NOWCAST_PHI, (float)h)) / (1 - NOWCAST_PHI);
+		return st.level + damp * st.trend + st.season[(st.step + h) % NOWCAST_SEASON];
+	}
+
+	bool ready(void) const
+	{
+		return st.steps >= NOWCAST_WARMUP;
+	}
+
+	/*! @brief replaces the first NOWCAST_HORIZON seconds of a prognosis with a blend of nowcast and prognosis, the
+	*	weight of the nowcast falls linearly from 1 now to 0 at the horizon
+	*
+	*
+	*
+	* @param const vector< prognosis_record >& _in, time_t _now, vector< prognosis_record >& _out
+	*
+	* @returns void
+	*
+	*/
+	void blend(const vector< prognosis_record >& _in, time_t _now, vector< prognosis_record >& _out) const
+	{
+		_out.clear();
+		PROG_SERIES ps(_in.data(), _in.size());
+		if(!ready() || ps.size() == 0)
+		{
+			_out = _in;
+			return;
+		}
+
+		size_t i = 0;
+		for(; i < _in.size() && _in[i].from < _now; i++)
+		{
+			_out.push_back(_in[i]);
+		}
+		size_t cursor = 0;
+		for(time_t t = _now; t <= _now + NOWCAST_HORIZON; t += NOWCAST_BLEND_STEP)
+		{
+			float w = 1 - (float)(t - _now) / NOWCAST_HORIZON;
+			prognosis_record r;
+			r.from = t;
+			r.to = t + NOWCAST_BLEND_STEP;
+			r.temperature = w * nowcast(t) + (1 - w) * ps.at(t, cursor);
+			r.fields = PREC_TEMPERATURE;
+			_out.push_back(r);
+		}
+		for(; i < _in.size(); i++)
+		{
+			if(_in[i].from > _now + NOWCAST_HORIZON)
+			{
+				_out.push_back(_in[i]);
+			}
+		}
+	}
+
+	const nowcast_state& get_state(void) const
+	{
+		return st;
+	}
+
+private:
+	/*! @brief the Holt-Winters update with the mean of step _s
+	*
+	*
+	*
+	* @param int64_t _s, float _y
+	*
+	* @returns void
+	*
+	*/
+	void finish_step(int64_t _s, float _y)
+	{
+		int slot = _s % NOWCAST_SEASON;
+		float& season = st.season[slot];
+		if(st.step < 0 || _s - st.step > NOWCAST_GAP || _s < st.step)
+		{
+			// first step, or too long without measurements for the trend or the day mean to mean anything
+			st.level = _y - season;
+			st.trend = 0;
+			st.steps = 0;
+			st.day_n = 0;
+			st.day_sum = 0;
+		}
+		else
+		{
+			float last = st.level;
+			st.level = NOWCAST_ALPHA * (_y - season) + (1 - NOWCAST_ALPHA) * (last + NOWCAST_PHI * st.trend);
+			st.trend = NOWCAST_BETA * (st.level - last) + (1 - NOWCAST_BETA) * NOWCAST_PHI * st.trend;
+
+			// steps without measurements get this step's mean in the day mean
+			for(int64_t k = st.step + 1; k < _s; k++)
+			{
+				day_add(k % NOWCAST_SEASON, _y);
+			}
+		}
+		day_add(slot, _y);
+
+		// the season is the deviation from the day mean, averaged over the first days and smoothed after that
+		if(st.day_n == NOWCAST_SEASON)
+		{
+			float g = NOWCAST_GAMMA;
+			uint32_t seen = st.season_updates / NOWCAST_SEASON + 1;
+			if(1.0f / seen > g)
+			{
+				g = 1.0f / seen;
+			}
+			season = g * (_y - (float)(st.day_sum / NOWCAST_SEASON)) + (1 - g) * season;
+			st.season_updates++;
+		}
+		st.step = _s;
+		st.steps++;
+
+		if(_s % (3600 / NOWCAST_STEP) == 0)
+		{
+			save();
+		}
+	}
+
+	// running mean of the last day, the step a day ago drops out as this one comes in
+	void day_add(int _slot, float _y)
+	{
+		if(st.day_n == NOWCAST_SEASON)
+		{
+			st.day_sum -= st.day[_slot];
+		}
+		else
+		{
+			st.day_n++;
+		}
+		st.day[_slot] = _y;
+		st.day_sum += _y;
+	}
+
+	void load(void)
+	{
+		FILE* f = fopen(fpath.c_str(), "rb");
+		if(!f)
+		{
+			return;
+		}
+		nowcast_state s;
+		if(fread(&s, sizeof(s), 1, f) == 1 && s.magic == NOWCAST_MAGIC)
+		{
+			st = s;
+		}
+		fclose(f);
+	}
+
+	// only copies the state, the file is written in the background (temporary file and rename, so a power cut
+	// leaves either the old or the new state)
+	void save(void)
+	{
+		vector< uint8_t > buf(sizeof(st));
+		memcpy(buf.data(), &st, sizeof(st));
+		state_saver().save(fpath, buf);
+	}
+
+	string fpath;
+	nowcast_state st;
+	int64_t cur_step = -1;
+	double cur_sum = 0;
+	unsigned long cur_n = 0;
+};
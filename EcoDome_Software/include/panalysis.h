@@ -4,11 +4,13 @@
 * panalysis.h
 * Author:		Hans V. Rasmussen
 * Created:		07/03-2018 13:00
-* Modified:		01/04-2018 14:30
-* Version:		1.0
+* Modified:		19/10-2026 06:12
+* Version:		1.3
 *
 * Description:
 *	This library includes everything one needs to analyse prognoses from weather stations for use with control systems.
+*	Since version 1.3 the prognoses are downloaded in the background and kept in one memory mapped store, all datasets
+*	are fused and looked up by time, and a smoothed reference trajectory is computed over the horizon.
 *
 * NOTE:
 *	For the code to compile one needs to install 'python3' and 'libconfig++-dev' on their system
@@ -22,7 +24,19 @@
 #include <fstream>
 #include <unistd.h>
 #include <string>
+#include <memory>
 #include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <math.h>
+#include <algorithm>
+
+#include "yrparse.h"
 
 using namespace std;
 
@@ -33,159 +47,441 @@ using namespace std;
 #define	DEBUGSTATE		0		// Debugstate describes if there should happen debugging, 0 for minimal, 1 for maximal
 
 
-struct structureintegrity
-{
-	bool dirExists = 0;
-	bool wdatExists[100] = {0};
-};
+#define PROG_STORE_MAGIC	"ECOPROG"	// first bytes of a prognosis store file
+#define PROG_STORE_VERSION	2			// increase when prog_store_header or prognosis_record changes
+
+// shaping of the reference trajectory
+#define TRAJ_SMOOTH			3600		// width of the moving average over the trajectory [s]
+#define TRAJ_MAX_RATE		1.0			// fastest change of the reference [celsius/hour]
+
+// interpolation used by PROG_SERIES
+#define PROG_LINEAR			0
+#define PROG_CUBIC			1			// monotone cubic, never overshoots the forecast values
 
 struct prognosis_downlaod_structure
 {
 	string url;
 	string file_path;
 	string file_name;
+	float weight = 1;			// weight of the dataset in the ensemble
 };
 
 struct prognosis_data_structure
 {
-	string valid;
+	time_t valid = 0;			// start of validity [unix time]
 	float wind_dir = 0;
 	float wind_speed = 0;
 	float temperature = 0;
+	float temperature_spread = 0;
 	float air_pressure = 0;
 };
 
+// header of the prognosis store file, followed by 'count' prognosis_record's
+struct prog_store_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;		// sizeof(prognosis_record) of the writer
+	uint64_t count;				// number of records
+	int64_t lastupdate;			// when the forecast was made [unix time]
+	int64_t nextupdate;			// when the next forecast is expected [unix time]
+	int64_t written;			// when the file was written [unix time]
+};
+
 
 
 // ###############################################		FUNCTIONS		#################################################### //
 
-	/*! @brief Downlaods the files used by PROGLOAD
+	// Downloading is done by PROGFETCHER in progfetch.h
+
+	/*! @brief Fuses several forecasts into one ensemble. The records are aligned on their validity time, every field
+	*	becomes the weighted mean of the datasets that have it, and the temperature also gets the weighted spread.
 	*
 	* 
 	*
-	* @param 
-	*		vector< vector<string> > _progdown_v
+	* @param const vector< yr_forecast >& _fc, const vector< float >& _w, yr_forecast& _out
 	*
 	* @returns void
 	*
 	*/
-void progdownload(vector< prognosis_downlaod_structure > _progdown_v)
+void prog_ensemble(const vector< yr_forecast >& _fc, const vector< float >& _w, yr_forecast& _out)
 {
-    // Make a string to hold the command for the DataDown python script
-    string DDpy;
+	_out = yr_forecast();
+	if(_fc.empty())
+	{
+		return;
+	}
 
-    // Read out the data if debugstate is true
-    #if DEBUGSTATE
-		for(int i=0; i<_progdown_v.size(); ++i)
+	// every validity time found in any of the datasets
+	vector< int64_t > times;
+	for(size_t k = 0; k < _fc.size(); k++)
+	{
+		for(size_t i = 0; i < _fc[k].records.size(); i++)
 		{
-			cout << "_progdown is " << i << endl;
-			cout << "\t" << _progdown_v[i].url << "\n";
-			cout << "\t" << _progdown_v[i].file_path << "\n";
-			cout << "\t" << _progdown_v[i].file_name << "\n";
-			cout << endl;
+			times.push_back(_fc[k].records[i].from);
 		}
-	#endif	// DEBUGSTATE
-		
-	// Prepare the string that holds the command to run the DataDown Python script
-	for(int i=0; i<_progdown_v.size(); ++i)
+		_out.lastupdate = max(_out.lastupdate, _fc[k].lastupdate);
+		if(_fc[k].nextupdate && (!_out.nextupdate || _fc[k].nextupdate < _out.nextupdate))
+		{
+			_out.nextupdate = _fc[k].nextupdate;
+		}
+	}
+	sort(times.begin(), times.end());
+	times.erase(unique(times.begin(), times.end()), times.end());
+
+	// the records of each dataset are in time order, so one cursor per dataset is enough
+	vector< size_t > cursor(_fc.size(), 0);
+	for(size_t t = 0; t < times.size(); t++)
+	{
+		prognosis_record rec;
+		rec.from = times[t];
+		rec.members = 0;
+
+		const float* src[5];
+		float* dst[5] = {&rec.wind_dir, &rec.wind_speed, &rec.temperature, &rec.air_pressure, &rec.precipitation};
+		static const uint32_t flag[5] = {PREC_WIND_DIR, PREC_WIND_SPEED, PREC_TEMPERATURE, PREC_PRESSURE, PREC_PRECIPITATION};
+		double sum[5] = {0}, wsum[5] = {0}, tsq = 0;
+
+		for(size_t k = 0; k < _fc.size(); k++)
+		{
+			const vector< prognosis_record >& r = _fc[k].records;
+			while(cursor[k] < r.size() && r[cursor[k]].from < times[t])
+			{
+				cursor[k]++;
+			}
+			if(cursor[k] >= r.size() || r[cursor[k]].from != times[t])
+			{
+				continue;
+			}
+
+			const prognosis_record& m = r[cursor[k]];
+			src[0] = &m.wind_dir; src[1] = &m.wind_speed; src[2] = &m.temperature; src[3] = &m.air_pressure; src[4] = &m.precipitation;
+			for(int f = 0; f < 5; f++)
+			{
+				if(m.fields & flag[f])
+				{
+					sum[f] += _w[k] * *src[f];
+					wsum[f] += _w[k];
+				}
+			}
+			if(m.fields & PREC_TEMPERATURE)
+			{
+				tsq += _w[k] * m.temperature * m.temperature;
+			}
+			rec.to = max(rec.to, m.to);
+			rec.members++;
+		}
+
+		for(int f = 0; f < 5; f++)
+		{
+			if(wsum[f] > 0)
+			{
+				*dst[f] = sum[f] / wsum[f];
+				rec.fields |= flag[f];
+			}
+		}
+		if(wsum[2] > 0)
+		{
+			double var = tsq / wsum[2] - (double)rec.temperature * rec.temperature;
+			rec.temperature_spread = var > 0 ? sqrt(var) : 0;
+		}
+		_out.records.push_back(rec);
+	}
+}
+
+	/*! @brief Writes a parsed forecast to the prognosis store, the file is written next to the old one and renamed over
+	*	it, so readers see either the old or the new store, never half of one.
+	*
+	* 
+	*
+	* @param const string& _fpath, const yr_forecast& _fc
+	*
+	* @returns bool
+	*
+	*/
+bool prog_store_write(const string& _fpath, const yr_forecast& _fc)
+{
+	prog_store_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, PROG_STORE_MAGIC, sizeof(h.magic));
+	h.version = PROG_STORE_VERSION;
+	h.record_size = sizeof(prognosis_record);
+	h.count = _fc.records.size();
+	h.lastupdate = _fc.lastupdate;
+	h.nextupdate = _fc.nextupdate;
+	h.written = time(0);
+
+	string tmp = _fpath + ".tmp";
+	FILE* f = fopen(tmp.c_str(), "wb");
+	if(!f)
 	{
-		// Call the python script
-		DDpy = "python3 ./DataDown.py ";
-		// Add the arguments
-		DDpy += "-wl " + _progdown_v[i].url + " -dn " + _progdown_v[i].file_path + _progdown_v[i].file_name;
-		#if !DEBUGSTATE
-			// Suppress output
-			DDpy += " > /dev/null"; 
-		#endif	// DEBUGSTATE
-
-		// Write out complete script before running it
-		#if DEBUGSTATE
-			cout << "Running command:\n" << DDpy << "\n\n\n";
-		#endif	// DEBUGSTATE
-	}
-	// Forward the DataDown Python command to the system and wait for it to finish
-	system(DDpy.c_str());
+		perror(("Unable to write " + tmp).c_str());
+		return false;
+	}
+	bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+	if(h.count)
+	{
+		ok = ok && fwrite(_fc.records.data(), sizeof(prognosis_record), h.count, f) == h.count;
+	}
+	ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+	ok = (fclose(f) == 0) && ok;
+
+	if(!ok || rename(tmp.c_str(), _fpath.c_str()) == -1)
+	{
+		perror(("Unable to write " + _fpath).c_str());
+		unlink(tmp.c_str());
+		return false;
+	}
+	return true;
 }
 
 
 // ###############################################		CLASSES		#################################################### //
 
-	/*! @brief	Class that contains the code for doing the actual analysis
-	*	https://github.com/hyperrealm/libconfig
+	/*! @brief	The forecast temperature as a time series sorted on validity time, answers "what is the temperature at
+	*	time t" by interpolating between the forecast points. Lookups are O(log n), or amortized O(1) when a cursor is
+	*	used for increasing times.
 	*
 	*
 	*	@use	
 	*
 	@code{.cpp}
+	*	PROG_SERIES ps(map->records, map->count);
+	*	float t_in_6h = ps.at(time(0) + 6*3600);
 	*
+	*	size_t cur = 0;
+	*	for(time_t t = now; t < now + 86400; t += TIME_STEP) ps.at(t, cur);
 	* @endcode
 	*
 	*/
-class PANALYSIS
+class PROG_SERIES
 {
 public:
+	PROG_SERIES() : mode(PROG_CUBIC)
+	{
 
-	/*! @brief Constructor
+	}
+
+	/*! @brief Constructor, takes the temperatures of the records that have one
 	*
 	* 
 	*
-	* @param 
-	*		void
+	* @param const prognosis_record* _rec, size_t _n, int _mode
 	*
 	* @returns void
 	*
 	*/
-	PANALYSIS(float _tmi, float tma, float tde) : Tmin(_tmi), Tmax(tma), Tdes(tde)
+	PROG_SERIES(const prognosis_record* _rec, size_t _n, int _mode = PROG_CUBIC) : mode(_mode)
 	{
+		for(size_t i = 0; i < _n; i++)
+		{
+			if((_rec[i].fields & PREC_TEMPERATURE) && (t.empty() || _rec[i].from > t.back()))
+			{
+				t.push_back(_rec[i].from);
+				y.push_back(_rec[i].temperature);
+			}
+		}
+		prepare_slopes();
+	}
 
+	/*! @brief temperature at time _at, clamped to the first and last forecast point
+	*
+	* 
+	*
+	* @param time_t _at
+	*
+	* @returns float, NAN if the series is empty
+	*
+	*/
+	float at(time_t _at) const
+	{
+		if(t.empty())
+		{
+			return NAN;
+		}
+		size_t i = upper_bound(t.begin(), t.end(), (int64_t)_at) - t.begin();
+		return interpolate(i, _at);
 	}
 
-	/*! @brief takes in the prognoses, does some magic, and returns result
+	/*! @brief temperature at time _at, starting the search from _cursor, which is moved along. O(1) amortized when
+	*	_at only increases between calls.
 	*
 	* 
 	*
-	* @param vector< vector<float> > _progin_v, int _pn
+	* @param time_t _at, size_t& _cursor
 	*
-	* @returns void
+	* @returns float, NAN if the series is empty
 	*
 	*/
-	float panalyse(vector< prognosis_data_structure > _progin_v, float _Tin, float _Tout, int _pn)
+	float at(time_t _at, size_t& _cursor) const
 	{
-		if (_progin_v[_pn-1].temperature > (Tmax-(_Tin - _Tout)))
+		if(t.empty())
 		{
-			Tref = Tdes - ((Tmax - (_Tin - _Tout)) + _progin_v[_pn-1].temperature);
-			if(Tref < (Tmin + 0.5))
-			{
-				Tref = Tmin + 1;
-			}
+			return NAN;
 		}
-		else if (_progin_v[_pn-1].temperature < (Tmin + (_Tin - _Tout)))
+		// _cursor is the index of the first point after _at
+		if(_cursor > t.size() || (_cursor > 0 && t[_cursor-1] > _at))
 		{
-			Tref = Tdes + ((Tmin + (_Tin - _Tout)) - _progin_v[_pn-1].temperature);
-			if(Tref > (Tmax - 0.5))
-			{
-				Tref = Tmax - 1;
-			}
+			_cursor = 0;
 		}
-		else
+		while(_cursor < t.size() && t[_cursor] <= _at)
 		{
-			Tref = Tdes;
+			_cursor++;
 		}
-		return Tref;
+		return interpolate(_cursor, _at);
 	}
 
-protected:
+	size_t size(void) const
+	{
+		return t.size();
+	}
+
+	time_t first(void) const
+	{
+		return t.empty() ? 0 : t.front();
+	}
+
+	time_t last(void) const
+	{
+		return t.empty() ? 0 : t.back();
+	}
 
 private:
-	float Tmin;
-	float Tmax;
-	float Tdes;
-	float Tref;
+	/*! @brief interpolates between point _i-1 and _i
+	*
+	* 
+	*
+	* @param size_t _i, time_t _at
+	*
+	* @returns float
+	*
+	*/
+	float interpolate(size_t _i, time_t _at) const
+	{
+		if(_i == 0)
+		{
+			return y.front();
+		}
+		if(_i >= t.size())
+		{
+			return y.back();
+		}
+
+		double h = t[_i] - t[_i-1];
+		double s = (_at - t[_i-1]) / h;
+		if(mode == PROG_LINEAR)
+		{
+			return y[_i-1] + s * (y[_i] - y[_i-1]);
+		}
+
+		// cubic Hermite
+		double s2 = s*s;
+		double s3 = s2*s;
+		return (2*s3 - 3*s2 + 1) * y[_i-1] + (s3 - 2*s2 + s) * h * m[_i-1] + (-2*s3 + 3*s2) * y[_i] + (s3 - s2) * h * m[_i];
+	}
+
+	/*! @brief calculates the slopes for the monotone cubic interpolation (Fritsch-Carlson)
+	*
+	* 
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void prepare_slopes(void)
+	{
+		size_t n = t.size();
+		m.assign(n, 0);
+		if(n < 2)
+		{
+			return;
+		}
+
+		vector< double > d(n-1);
+		for(size_t i = 0; i < n-1; i++)
+		{
+			d[i] = (y[i+1] - y[i]) / (double)(t[i+1] - t[i]);
+		}
+		m[0] = d[0];
+		m[n-1] = d[n-2];
+		for(size_t i = 1; i < n-1; i++)
+		{
+			// flat at local extremes so the curve never goes beyond the forecast values
+			m[i] = (d[i-1] * d[i] <= 0) ? 0 : (d[i-1] + d[i]) / 2;
+		}
+		for(size_t i = 0; i < n-1; i++)
+		{
+			if(d[i] == 0)
+			{
+				m[i] = 0;
+				m[i+1] = 0;
+				continue;
+			}
+			double a = m[i] / d[i];
+			double b = m[i+1] / d[i];
+			double r = a*a + b*b;
+			if(r > 9)
+			{
+				double tau = 3 / sqrt(r);
+				m[i] = tau * a * d[i];
+				m[i+1] = tau * b * d[i];
+			}
+		}
+	}
 
+	int mode;
+	vector< int64_t > t;		// validity times [unix time]
+	vector< float > y;			// temperatures [celsius]
+	vector< double > m;			// slopes at the points [celsius/s]
 };
 
 
-	/*! @brief	
+	/*! @brief	Reference temperature for every control tick over the prognosis horizon, made by PANALYSIS::trajectory()
+	*
+	*
+	*	@use	
+	*
+	@code{.cpp}
+	*	REF_TRAJECTORY traj;
+	*	p_analyser.trajectory(ps, T_in, T_out, time(0), lead, TIME_STEP, r, traj);
+	*	r = traj.at(time(0));
+	* @endcode
+	*
+	*/
+struct REF_TRAJECTORY
+{
+	time_t start = 0;			// time of r[0]
+	int step = 1;				// seconds between the points
+	vector< float > r;			// reference [celsius]
+
+	/*! @brief the reference at time _t, O(1). Before the start the first point is used, after the end the last.
+	*
+	* 
+	*
+	* @param time_t _t
+	*
+	* @returns float, NAN if the trajectory is empty
+	*
+	*/
+	float at(time_t _t) const
+	{
+		if(r.empty())
+		{
+			return NAN;
+		}
+		if(_t <= start)
+		{
+			return r.front();
+		}
+		size_t i = (_t - start) / step;
+		return i < r.size() ? r[i] : r.back();
+	}
+};
+
+
+	/*! @brief	Class that contains the code for doing the actual analysis
+	*	https://github.com/hyperrealm/libconfig
 	*
 	*
 	*	@use	
@@ -195,275 +491,408 @@ private:
 	* @endcode
 	*
 	*/
-class PROGLOAD
+class PANALYSIS
 {
 public:
 
-
-    /*! @brief Constructor
+	/*! @brief Constructor
 	*
 	* 
 	*
 	* @param 
-	*		string _directoryName = "./Data/", 
-	*		string _fileName = "wData", 
-	*		int _items = 38
+	*		void
 	*
 	* @returns void
 	*
 	*/
-    PROGLOAD() : _structureintegrityPass(0), _items(0)
-	{   
+	PANALYSIS(float _tmi, float tma, float tde) : Tmin(_tmi), Tmax(tma), Tdes(tde)
+	{
 
 	}
 
-	void initiate(prognosis_downlaod_structure _pcf, int _i)
+	/*! @brief changes the temperatures the reference is kept within, used from the next analysis on
+	*
+	* 
+	*
+	* @param float _tmi, float _tma, float _tde
+	*
+	* @returns void
+	*
+	*/
+	void set_limits(float _tmi, float _tma, float _tde)
 	{
-		
-		_pconf = _pcf;
-		_items = _i;
-		self_check();
+		Tmin = _tmi;
+		Tmax = _tma;
+		Tdes = _tde;
 	}
 
-	/*! @brief Updates the contents of the vector containing the data
+	/*! @brief takes in the prognosis, does some magic, and returns result
 	*
 	* 
 	*
-	* @param void
+	* @param const PROG_SERIES& _ps, float _Tin, float _Tout, time_t _at
+	*		_at is the time the prognosis should be looked at
+	*
+	* @returns float
+	*
+	*/
+	float panalyse(const PROG_SERIES& _ps, float _Tin, float _Tout, time_t _at)
+	{
+		Tref = reference(_ps.at(_at), _Tin, _Tout);
+		return Tref;
+	}
+
+	/*! @brief makes the reference for every tick from _t0 until the prognosis runs out, in one pass.
+	*	The raw references are smoothed with a moving average of TRAJ_SMOOTH seconds, and then rate limited to
+	*	TRAJ_MAX_RATE starting from _rnow, so the controller never sees a step in the reference.
+	*
+	* 
+	*
+	* @param const PROG_SERIES& _ps, float _Tin, float _Tout, time_t _t0, time_t _lead, int _step, float _rnow,
+	*		REF_TRAJECTORY& _out
+	*		_lead is how far ahead of each tick the prognosis is looked at, _rnow is the reference in use now
 	*
 	* @returns void
 	*
 	*/
-	void update(void)
+	void trajectory(const PROG_SERIES& _ps, float _Tin, float _Tout, time_t _t0, time_t _lead, int _step, float _rnow, REF_TRAJECTORY& _out) const
 	{
-	    // check the integrity
-	    self_check();
-	    // Check if the integrity check passed, if not give a headsup
-		if(_structureintegrityPass == false)
+		_out.start = _t0;
+		_out.step = _step;
+		_out.r.clear();
+		if(!_ps.size() || _step <= 0)
+		{
+			return;
+		}
+
+		size_t n = (_ps.last() > _t0 + _lead) ? (_ps.last() - _t0 - _lead) / _step + 1 : 1;
+		vector< float > raw(n);
+
+		// prognosis at every tick, the cursor makes this O(n)
+		size_t cursor = 0;
+		for(size_t i = 0; i < n; i++)
 		{
-			cout << "Previous Data integrity test failed, rerunning test..." << endl;
+			raw[i] = _ps.at(_t0 + _lead + (time_t)i * _step, cursor);
 		}
 
-	    // Destroy all elements in the vector containing the prognosis data
-		_pdata.clear();	
-		// fill vector again with the data from the files
-		for(int i = 0; i < _items; i++)
+		// references, no dependencies between the iterations
+		for(size_t i = 0; i < n; i++)
 		{
-			if(_structureintegrity.wdatExists[i])
+			raw[i] = reference(raw[i], _Tin, _Tout);
+		}
+
+		// centered moving average using a running sum
+		int half = TRAJ_SMOOTH / _step / 2;
+		_out.r.resize(n);
+		double sum = 0;
+		int count = 0;
+		for(int i = -half; i < (int)n; i++)
+		{
+			if(i + half < (int)n)
 			{
-				_pdata.push_back(load_file(_pconf.file_path + _pconf.file_name + to_string(i)));
+				sum += raw[i + half];
+				count++;
 			}
-			else
+			if(i - half - 1 >= 0)
 			{
-				_pdata.push_back(load_fallback());
+				sum -= raw[i - half - 1];
+				count--;
+			}
+			if(i >= 0)
+			{
+				_out.r[i] = sum / count;
 			}
 		}
-	}
 
-	void print_data(void)
-	{
- 	   // For debugging, print the contents of the loaded data
-		for(int i=0; i<_pdata.size(); ++i)
+		// rate limit, starting from the reference in use now
+		float max_step = TRAJ_MAX_RATE * _step / 3600.0;
+		float prev = isnan(_rnow) ? _out.r[0] : _rnow;
+		for(size_t i = 0; i < n; i++)
 		{
-			cout << "\nDataset " << i << endl;
-			cout << "\t" << _pdata[i].valid << "\n";
-			cout << "\t" << _pdata[i].wind_dir << "\n";
-			cout << "\t" << _pdata[i].wind_speed << "\n";
-			cout << "\t" << _pdata[i].temperature << "\n";
-			cout << "\t" << _pdata[i].air_pressure << "\n";
+			float d = _out.r[i] - prev;
+			d = d > max_step ? max_step : (d < -max_step ? -max_step : d);
+			prev += d;
+			_out.r[i] = prev;
 		}
 	}
 
-
-	/*! @brief Checks if all neccessary files are present
+	/*! @brief the reference for a given prognosed outside temperature
 	*
 	* 
 	*
-	* @param void
+	* @param float _Tprog, float _Tin, float _Tout
 	*
-	* @returns void
+	* @returns float
 	*
 	*/
-	void self_check(void)
+	float reference(float _Tprog, float _Tin, float _Tout) const
 	{
-		// Check if Directory exists:
-		if(does_exist(_pconf.file_path))
-		{
-			#if DEBUGSTATE
-				cout << "Checking Directory..." << endl;
-				cout << "\t'" << _pconf.file_path << "'" << "\t[PASSED]" << endl;
-				cout << "Checking Files..." << endl;
-			#endif	// DEBUGSTATE
-			_structureintegrity.dirExists = true;
-
-				// If directory does exist, check if individual files exist:
-			int _passTracker = 0;
-			for(int i = 0; i < _items; i++)
-			{
-				if(does_exist(_pconf.file_path + _pconf.file_name + to_string(i)))
-				{
-					_structureintegrity.wdatExists[i] = true;
-	    			_passTracker++;
-					#if DEBUGSTATE
-						cout << "\t'" << _pconf.file_path + _pconf.file_name + to_string(i) << "'" << "\t[PASSED]" << endl;
-					#endif	// DEBUGSTATE
-				}
-				else
-				{
-					#if DEBUGSTATE
-						cout << "\t'" << _pconf.file_path + _pconf.file_name + to_string(i) << "'" << "\t[!FAILED!]" << endl;
-					#endif	// DEBUGSTATE
-					_structureintegrity.wdatExists[i] = false;
-				}
-			}
-	        // if everything 
-			if(_passTracker == (_items))
+		float ref;
+		if (_Tprog > (Tmax-(_Tin - _Tout)))
+		{
+			ref = Tdes - ((Tmax - (_Tin - _Tout)) + _Tprog);
+			if(ref < (Tmin + 0.5))
 			{
-				_structureintegrityPass = true;
+				ref = Tmin + 1;
 			}
-			else
+		}
+		else if (_Tprog < (Tmin + (_Tin - _Tout)))
+		{
+			ref = Tdes + ((Tmin + (_Tin - _Tout)) - _Tprog);
+			if(ref > (Tmax - 0.5))
 			{
-				_structureintegrityPass = false;
+				ref = Tmax - 1;
 			}
 		}
 		else
 		{
-	        // If directory was not found, set integrity to failed
-			#if DEBUGSTATE
-				cout << "Checking Directory..." << endl;
-				cout << "\t'" << _pconf.file_path << "'" << "\t[!FAILED!]" << endl;
-			#endif	// DEBUGSTATE
-			_structureintegrity.dirExists = false;
+			ref = Tdes;
+		}
+		return ref;
+	}
 
-			for(int i = 0; i < _items; i++)
-			{
-				_structureintegrity.wdatExists[i] = false;
-			}
+protected:
 
-			_structureintegrityPass = false;
+private:
+	float Tmin;
+	float Tmax;
+	float Tdes;
+	float Tref;
+
+};
+
+
+	/*! @brief	A mapped prognosis store file, unmapped again when the last user lets go of it
+	*
+	*
+	*	@use	
+	*
+	@code{.cpp}
+	*	shared_ptr<const PROGMAP> m = PROGMAP::open_file("./data/dataset1/wdat.bin");
+	*	for(size_t i = 0; m && i < m->count; i++) cout << m->records[i].temperature << endl;
+	* @endcode
+	*
+	*/
+class PROGMAP
+{
+public:
+	~PROGMAP()
+	{
+		munmap(base, length);
+	}
+
+	/*! @brief maps and validates a store file
+	*
+	* 
+	*
+	* @param const string& _fpath
+	*
+	* @returns shared_ptr<const PROGMAP>, NULL if the file is missing or not a valid store
+	*
+	*/
+	static shared_ptr<const PROGMAP> open_file(const string& _fpath)
+	{
+		int fd = open(_fpath.c_str(), O_RDONLY);
+		if(fd == -1)
+		{
+			return shared_ptr<const PROGMAP>();
+		}
+		struct stat st;
+		if(fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(prog_store_header))
+		{
+			close(fd);
+			return shared_ptr<const PROGMAP>();
+		}
+		void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if(base == MAP_FAILED)
+		{
+			return shared_ptr<const PROGMAP>();
 		}
 
-		#if DEBUGSTATE
-			if(_structureintegrityPass == true)
-			{
-				cout << "\nData integrity test\t[PASSED]\n" << "\n\n";
-			}
-			else
-			{
-				cout << "\nData integrity test\t[!FAILED!]\n" << endl;
-			}
-		#endif // DEBUGSTATE
+		// the file is replaced with rename(), so a mapped file never changes under us
+		shared_ptr<PROGMAP> m(new PROGMAP(base, st.st_size));
+		const prog_store_header* h = m->header;
+		if(memcmp(h->magic, PROG_STORE_MAGIC, sizeof(h->magic)) != 0 ||
+			h->version != PROG_STORE_VERSION ||
+			h->record_size != sizeof(prognosis_record) ||
+			sizeof(prog_store_header) + h->count * sizeof(prognosis_record) > (size_t)st.st_size)
+		{
+			cout << "Prognosis store " << _fpath << " is not valid, ignoring it." << endl;
+			return shared_ptr<const PROGMAP>();
+		}
+		m->records = (const prognosis_record*)((const char*)base + sizeof(prog_store_header));
+		m->count = h->count;
+		return m;
+	}
+
+	const prog_store_header* header;
+	const prognosis_record* records;
+	size_t count;
+
+private:
+	PROGMAP(void* _base, size_t _len) : header((const prog_store_header*)_base), records(NULL), count(0), base(_base), length(_len)
+	{
+
 	}
 
+	void* base;
+	size_t length;
+};
 
-	/*! @brief checks if element exists in filesystem
+
+	/*! @brief	Class that loads the prognosis store written by prog_store_write()
+	*
+	*
+	*	@use	
+	*
+	@code{.cpp}
+	*	PROGLOAD p_loader;
+	*	p_loader.initiate(_down_data[0], _prognosis_number);
+	*	p_loader.update();
+	*	vector< prognosis_data_structure > d = p_loader.get_data();
+	* @endcode
+	*
+	*/
+class PROGLOAD
+{
+public:
+
+
+    /*! @brief Constructor
 	*
 	* 
 	*
-	* @param string _elementPath
+	* @param void
 	*
-	* @returns bool
+	* @returns void
 	*
 	*/
-	static inline bool does_exist (const string& s)
+    PROGLOAD() : _items(0)
+	{   
+
+	}
+
+	void initiate(prognosis_downlaod_structure _pcf, int _i)
 	{
-	    // Check if directory exists
-		struct stat buffer;   
-		return (stat (s.c_str(), &buffer) == 0); 
+		
+		_pconf = _pcf;
+		_items = _i;
 	}
-	
 
-	/*! @brief returns vector containing datasets in float format
-	* 
+	/*! @brief returns the path of the store file
+	*
 	* 
 	*
 	* @param void
 	*
-	* @returns vector< vector<string> >
+	* @returns string
 	*
 	*/
-	vector< prognosis_data_structure > get_data(void)
+	string store_path(void)
 	{
-		return _pdata;
+		return _pconf.file_path + _pconf.file_name + ".bin";
 	}
 
-
-private:
-
-	/*! @brief loads contents of a file
+	/*! @brief Maps the newest store file, the previous mapping stays valid for anyone still holding it
 	*
 	* 
 	*
-	* @param string _elementPath
+	* @param void
 	*
-	* @returns vector<string>
+	* @returns bool, false if the store could not be loaded
 	*
 	*/
-	prognosis_data_structure load_file(const string _fpath)
+	bool update(void)
 	{
-	    // Make a string vector and fill it with the contents of a file
-		prognosis_data_structure _fdata;
-		string line;
-		ifstream _fpointer(_fpath);
-
-		if(_fpointer.is_open())
-		{
-			getline(_fpointer, line);
-			_fdata.valid = line;
-			getline(_fpointer, line);
-			_fdata.wind_dir = stof(line);
-			getline(_fpointer, line);
-			_fdata.wind_speed = stof(line);
-			getline(_fpointer, line);
-			_fdata.temperature = stof(line);
-			getline(_fpointer, line);
-			_fdata.air_pressure = stof(line);
-
-			_fpointer.close();
-		}
-		else
+		shared_ptr<const PROGMAP> m = PROGMAP::open_file(store_path());
+		if(!m || m->count < (size_t)_items)
 		{
-	        // If the file cannot be opened, give a headsup
-			cout << "Unable to open file " << _fpath << endl;
+			cout << "Unable to load prognosis store " << store_path() << endl;
+			return false;
 		}
-
-		return _fdata;
+		_pmap = m;
+		return true;
 	}
 
+	void print_data(void)
+	{
+ 	   // For debugging, print the contents of the loaded data
+		vector< prognosis_data_structure > _pdata = get_data();
+		for(int i=0; i<_pdata.size(); ++i)
+		{
+			cout << "\nDataset " << i << endl;
+			char buf[32];
+			strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", gmtime(&_pdata[i].valid));
+			cout << "\t" << buf << "\n";
+			cout << "\t" << _pdata[i].wind_dir << "\n";
+			cout << "\t" << _pdata[i].wind_speed << "\n";
+			cout << "\t" << _pdata[i].temperature << "\n";
+			cout << "\t" << _pdata[i].air_pressure << "\n";
+		}
+	}
 
-	/*! @brief loads a fallback error message
-	*
+	/*! @brief returns the mapped store
+	* 
 	* 
 	*
 	* @param void
 	*
-	* @returns prognosis_data_structure
+	* @returns shared_ptr<const PROGMAP>, NULL if nothing is loaded
 	*
 	*/
-	prognosis_data_structure load_fallback(void)
+	shared_ptr<const PROGMAP> get_map(void)
 	{
-	    // If it is not possible to get the data from a file, fill it with this instead:
-		prognosis_data_structure _fbdata;
+		return _pmap;
+	}
 
-		_fbdata.valid = "[ERROR!]";
-		_fbdata.wind_dir = 0;
-		_fbdata.wind_speed = 0;
-		_fbdata.temperature = 0;
-		_fbdata.air_pressure = 0;
+	/*! @brief returns vector containing the loaded datasets
+	* 
+	* 
+	*
+	* @param void
+	*
+	* @returns vector< prognosis_data_structure >
+	*
+	*/
+	vector< prognosis_data_structure > get_data(void)
+	{
+		vector< prognosis_data_structure > _pdata;
+		for(size_t i = 0; _pmap && i < _pmap->count; i++)
+		{
+			_pdata.push_back(to_data_structure(_pmap->records[i]));
+		}
+		return _pdata;
+	}
 
-		return _fbdata;
+	/*! @brief converts a stored record to the structure used by PANALYSIS
+	*
+	*
+	*
+	* @param const prognosis_record&
+	*
+	* @returns prognosis_data_structure
+	*
+	*/
+	static prognosis_data_structure to_data_structure(const prognosis_record& _rec)
+	{
+		prognosis_data_structure d;
+		d.valid = _rec.from;
+		d.wind_dir = _rec.wind_dir;
+		d.wind_speed = _rec.wind_speed;
+		d.temperature = _rec.temperature;
+		d.temperature_spread = _rec.temperature_spread;
+		d.air_pressure = _rec.air_pressure;
+		return d;
 	}
 
 
+private:
+
 	// Input
 	prognosis_downlaod_structure _pconf;
-	int _items;								// How many items are there (from 0 to...)?
-
-	// Put-put
-	structureintegrity _structureintegrity;			// Does the path and all files exist?
-	bool _structureintegrityPass;					// If everything is all-right put this bool =1
+	int _items;								// How many items must there at least be?
 
 	// Output
-	vector< prognosis_data_structure > _pdata;	// Vector to hold data
-
+	shared_ptr<const PROGMAP> _pmap;		// The mapped store
 };
\ No newline at end of file
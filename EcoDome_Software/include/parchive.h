@@ -0,0 +1,701 @@
+#pragma once
+
+/*
+* parchive.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:26
+* Modified:		19/10-2026 04:26
+* Version:		1.0
+*
+* Description:
+*	This header includes the forecast archive: every new ensemble prognosis is appended to one file as a block keyed by
+*	its issue time, with each field stored as its own compressed column (delta-of-delta valid times, XOR floats).
+*	A value is XOR'ed with the value the previous forecast had for the same valid time, so the parts of a forecast
+*	that did not change cost one bit per value.
+*	It also includes the accuracy query, which joins the archive with the measured outside temperature.
+*
+* NOTE:
+*	Every PROG_ARCHIVE_KEY_EVERY'th block is a key block that does not refer to the one before it.
+*	A block is written with a single write() and carries a checksum, a block torn by a power cut is cut off the
+*	next time the archive is opened.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "yrparse.h"
+#include "gorilla.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define PROG_ARCHIVE_FILE		"./data/archive/forecast.arc"
+#define PROG_ARCHIVE_MAGIC		"ECOARCH"
+#define PROG_ARCHIVE_VERSION	1
+#define PROG_ARCHIVE_BLOCK		0x4B4C4245		// "EBLK"
+#define PROG_ARCHIVE_KEY_EVERY	48				// blocks between key blocks
+#define PROG_ARCHIVE_KEY		0x0001			// block flag: the block does not refer to the previous block
+
+// the columns of a block, in the order they are stored
+#define PROG_ARC_VALID			0
+#define PROG_ARC_TEMPERATURE	1
+#define PROG_ARC_SPREAD			2
+#define PROG_ARC_WIND_SPEED		3
+#define PROG_ARC_PRECIPITATION	4
+#define PROG_ARC_COLUMNS		5
+
+// masks to select which columns PROG_ARCHIVE_READER decodes
+#define PROG_ARC_COL(c)			(1u << (c))
+#define PROG_ARC_ALL			((1u << PROG_ARC_COLUMNS) - 1)
+
+struct prog_archive_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t block_header;			// sizeof(prog_archive_block) when the file was made
+};
+
+struct prog_archive_block
+{
+	uint32_t magic;					// PROG_ARCHIVE_BLOCK
+	uint16_t count;					// forecast steps in the block
+	uint16_t flags;					// PROG_ARCHIVE_KEY
+	int64_t issue;					// when the forecast was fetched [unix time]
+	int64_t lastupdate;				// when yr.no made the forecast [unix time]
+	uint32_t bytes[PROG_ARC_COLUMNS];	// compressed size of each column, the columns follow the header in order
+	uint32_t check;					// FNV-1a of the columns
+};
+
+// one decoded block, only the requested columns are filled in
+struct prog_archive_entry
+{
+	time_t issue = 0;
+	time_t lastupdate = 0;
+	vector< int64_t > valid;
+	vector< float > temperature;
+	vector< float > temperature_spread;
+	vector< float > wind_speed;
+	vector< float > precipitation;
+};
+
+// forecast error for one lead time bucket, error = forecast - measured
+struct prog_accuracy_row
+{
+	int lead = 0;					// start of the bucket [s]
+	unsigned long n = 0;
+	double sum = 0;
+	double sum2 = 0;
+
+	double bias(void) const
+	{
+		return n ? sum / n : NAN;
+	}
+
+	double rmse(void) const
+	{
+		return n ? sqrt(sum2 / n) : NAN;
+	}
+};
+
+
+// ###############################################		FUNCTIONS	#################################################### //
+
+	/*! @brief FNV-1a hash of a byte buffer, 32 bit
+	*
+	*
+	*
+	* @param const uint8_t* _p, size_t _n, uint32_t _h
+	*
+	* @returns uint32_t
+	*
+	*/
+uint32_t prog_archive_hash(const uint8_t* _p, size_t _n, uint32_t _h = 2166136261u)
+{
+	for(size_t i = 0; i < _n; i++)
+	{
+		_h = (_h ^ _p[i]) * 16777619u;
+	}
+	return _h;
+}
+
+
+	/*! @brief Compresses the columns of one forecast. Without a reference every float is XOR'ed with the value before
+	*	it, with a reference it is XOR'ed with the reference's value at the same valid time when there is one.
+	*
+	*
+	*
+	* @param const prog_archive_entry& _e, const prog_archive_entry* _ref (NULL for a key block),
+	*	BITWRITER _col[PROG_ARC_COLUMNS]
+	*
+	* @returns void
+	*
+	*/
+void prog_archive_encode(const prog_archive_entry& _e, const prog_archive_entry* _ref, BITWRITER _col[PROG_ARC_COLUMNS])
+{
+	DOD_ENCODER valid(_col[PROG_ARC_VALID]);
+	for(size_t i = 0; i < _e.valid.size(); i++)
+	{
+		valid.put(_e.valid[i]);
+	}
+
+	const vector< float >* val[PROG_ARC_COLUMNS] = {NULL, &_e.temperature, &_e.temperature_spread, &_e.wind_speed, &_e.precipitation};
+	const vector< float >* ref[PROG_ARC_COLUMNS] = {NULL};
+	if(_ref)
+	{
+		ref[PROG_ARC_TEMPERATURE] = &_ref->temperature;
+		ref[PROG_ARC_SPREAD] = &_ref->temperature_spread;
+		ref[PROG_ARC_WIND_SPEED] = &_ref->wind_speed;
+		ref[PROG_ARC_PRECIPITATION] = &_ref->precipitation;
+	}
+	for(int c = PROG_ARC_VALID + 1; c < PROG_ARC_COLUMNS; c++)
+	{
+		XOR_ENCODER enc(_col[c]);
+		size_t j = 0;
+		for(size_t i = 0; i < _e.valid.size(); i++)
+		{
+			// both forecasts are sorted by valid time
+			while(_ref && j < _ref->valid.size() && _ref->valid[j] < _e.valid[i])
+			{
+				j++;
+			}
+			if(_ref && j < _ref->valid.size() && _ref->valid[j] == _e.valid[i])
+			{
+				enc.put((*val[c])[i], (*ref[c])[j]);
+			}
+			else
+			{
+				enc.put((*val[c])[i]);
+			}
+		}
+	}
+}
+
+	/*! @brief Counterpart of prog_archive_encode(), _e.valid must be decoded already and only the columns in _columns
+	*	are decoded
+	*
+	*
+	*
+	* @param const uint8_t* _col, const uint32_t _bytes[PROG_ARC_COLUMNS], const prog_archive_entry* _ref,
+	*	unsigned _columns, prog_archive_entry& _e
+	*
+	* @returns void
+	*
+	*/
+void prog_archive_decode(const uint8_t* _col, const uint32_t _bytes[PROG_ARC_COLUMNS], const prog_archive_entry* _ref, unsigned _columns, prog_archive_entry& _e)
+{
+	vector< float >* val[PROG_ARC_COLUMNS] = {NULL, &_e.temperature, &_e.temperature_spread, &_e.wind_speed, &_e.precipitation};
+	const vector< float >* ref[PROG_ARC_COLUMNS] = {NULL};
+	if(_ref)
+	{
+		ref[PROG_ARC_TEMPERATURE] = &_ref->temperature;
+		ref[PROG_ARC_SPREAD] = &_ref->temperature_spread;
+		ref[PROG_ARC_WIND_SPEED] = &_ref->wind_speed;
+		ref[PROG_ARC_PRECIPITATION] = &_ref->precipitation;
+	}
+	_col += _bytes[PROG_ARC_VALID];
+	for(int c = PROG_ARC_VALID + 1; c < PROG_ARC_COLUMNS; c++)
+	{
+		val[c]->clear();
+		if(_columns & PROG_ARC_COL(c))
+		{
+			BITREADER br(_col, _bytes[c]);
+			XOR_DECODER dec(br);
+			val[c]->resize(_e.valid.size());
+			size_t j = 0;
+			for(size_t i = 0; i < _e.valid.size(); i++)
+			{
+				while(_ref && j < _ref->valid.size() && _ref->valid[j] < _e.valid[i])
+				{
+					j++;
+				}
+				if(_ref && j < _ref->valid.size() && _ref->valid[j] == _e.valid[i])
+				{
+					(*val[c])[i] = dec.get((*ref[c])[j]);
+				}
+				else
+				{
+					(*val[c])[i] = dec.get();
+				}
+			}
+		}
+		_col += _bytes[c];
+	}
+}
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Reads the blocks of a forecast archive in the order they were written, the file is memory mapped
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	PROG_ARCHIVE_READER rd;
+	*	prog_archive_entry e;
+	*	if(rd.open(PROG_ARCHIVE_FILE, PROG_ARC_COL(PROG_ARC_TEMPERATURE)))
+	*		while(rd.next(e))
+	*			...
+	* @endcode
+	*
+	*/
+class PROG_ARCHIVE_READER
+{
+public:
+	PROG_ARCHIVE_READER() : base(NULL), len(0), pos(0), columns(PROG_ARC_ALL)
+	{
+
+	}
+
+	~PROG_ARCHIVE_READER()
+	{
+		close();
+	}
+
+	/*! @brief maps an archive and checks its header, only the columns in _columns will be decoded. As blocks refer
+	*	to the block before them, every block is decoded even if the caller skips it.
+	*
+	*
+	*
+	* @param const string& _fpath, unsigned _columns (PROG_ARC_COL() flags)
+	*
+	* @returns bool, false if the file is missing or not an archive
+	*
+	*/
+	bool open(const string& _fpath, unsigned _columns = PROG_ARC_ALL)
+	{
+		close();
+		int fd = ::open(_fpath.c_str(), O_RDONLY);
+		if(fd == -1)
+		{
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(prog_archive_header))
+		{
+			::close(fd);
+			return false;
+		}
+		void* m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if(m == MAP_FAILED)
+		{
+			perror("mmap()");
+			return false;
+		}
+		base = (const uint8_t*)m;
+		len = st.st_size;
+
+		const prog_archive_header* h = (const prog_archive_header*)base;
+		if(memcmp(h->magic, PROG_ARCHIVE_MAGIC, sizeof(h->magic)) != 0 || h->version != PROG_ARCHIVE_VERSION || h->block_header != sizeof(prog_archive_block))
+		{
+			close();
+			return false;
+		}
+		pos = sizeof(prog_archive_header);
+		columns = _columns;
+		have_prev = false;
+		return true;
+	}
+
+	void close(void)
+	{
+		if(base)
+		{
+			munmap((void*)base, len);
+		}
+		base = NULL;
+		len = 0;
+		pos = 0;
+	}
+
+	/*! @brief decodes the next block
+	*
+	*
+	*
+	* @param prog_archive_entry& _e
+	*
+	* @returns bool, false at the end of the archive or at the first damaged block
+	*
+	*/
+	bool next(prog_archive_entry& _e)
+	{
+		if(!base || len - pos < sizeof(prog_archive_block))
+		{
+			return false;
+		}
+		prog_archive_block b;
+		memcpy(&b, base + pos, sizeof(b));
+		size_t total = 0;
+		for(int c = 0; c < PROG_ARC_COLUMNS; c++)
+		{
+			total += b.bytes[c];
+		}
+		const uint8_t* col = base + pos + sizeof(b);
+		if(b.magic != PROG_ARCHIVE_BLOCK || total > len - pos - sizeof(b) || prog_archive_hash(col, total) != b.check)
+		{
+			return false;
+		}
+		if(!(b.flags & PROG_ARCHIVE_KEY) && !have_prev)
+		{
+			return false;
+		}
+		pos += sizeof(b) + total;
+
+		_e.issue = b.issue;
+		_e.lastupdate = b.lastupdate;
+		BITREADER br(col, b.bytes[PROG_ARC_VALID]);
+		DOD_DECODER dec(br);
+		_e.valid.resize(b.count);
+		for(uint16_t i = 0; i < b.count; i++)
+		{
+			_e.valid[i] = dec.get();
+		}
+		prog_archive_decode(col, b.bytes, (b.flags & PROG_ARCHIVE_KEY) ? NULL : &prev, columns, _e);
+
+		prev = _e;
+		have_prev = true;
+		return true;
+	}
+
+	// the last block read, the next block is coded against it
+	const prog_archive_entry& last(void) const
+	{
+		return prev;
+	}
+
+	// offset of the first byte after the last block read
+	size_t offset(void) const
+	{
+		return pos;
+	}
+
+	size_t size(void) const
+	{
+		return len;
+	}
+
+private:
+	const uint8_t* base;
+	size_t len;
+	size_t pos;
+	unsigned columns;
+	prog_archive_entry prev;
+	bool have_prev = false;
+};
+
+
+	/*! @brief	Appends forecasts to the archive
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	PROG_ARCHIVE arc;
+	*	arc.append(time(0), fused);
+	* @endcode
+	*
+	*/
+class PROG_ARCHIVE
+{
+public:
+	PROG_ARCHIVE(const string& _fpath = PROG_ARCHIVE_FILE) : fpath(_fpath), checked(false), since_key(PROG_ARCHIVE_KEY_EVERY)
+	{
+
+	}
+
+	/*! @brief appends one forecast as a block and flushes it to the card
+	*
+	*
+	*
+	* @param time_t _issue, const yr_forecast& _fc
+	*
+	* @returns bool
+	*
+	*/
+	bool append(time_t _issue, const yr_forecast& _fc)
+	{
+		if(_fc.records.empty() || !prepare())
+		{
+			return false;
+		}
+
+		prog_archive_entry e;
+		e.issue = _issue;
+		e.lastupdate = _fc.lastupdate;
+		for(size_t i = 0; i < _fc.records.size() && i < 0xFFFF; i++)
+		{
+			const prognosis_record& r = _fc.records[i];
+			e.valid.push_back(r.from);
+			e.temperature.push_back(r.temperature);
+			e.temperature_spread.push_back(r.temperature_spread);
+			e.wind_speed.push_back(r.wind_speed);
+			e.precipitation.push_back(r.precipitation);
+		}
+
+		bool key = since_key >= PROG_ARCHIVE_KEY_EVERY;
+		BITWRITER col[PROG_ARC_COLUMNS];
+		prog_archive_encode(e, key ? NULL : &prev, col);
+
+		prog_archive_block b;
+		memset(&b, 0, sizeof(b));
+		b.magic = PROG_ARCHIVE_BLOCK;
+		b.count = e.valid.size();
+		b.flags = key ? PROG_ARCHIVE_KEY : 0;
+		b.issue = _issue;
+		b.lastupdate = _fc.lastupdate;
+		b.check = 2166136261u;
+
+		vector< uint8_t > buf(sizeof(b));
+		for(int c = 0; c < PROG_ARC_COLUMNS; c++)
+		{
+			const vector< uint8_t >& bytes = col[c].bytes();
+			b.bytes[c] = bytes.size();
+			b.check = prog_archive_hash(bytes.data(), bytes.size(), b.check);
+			buf.insert(buf.end(), bytes.begin(), bytes.end());
+		}
+		memcpy(buf.data(), &b, sizeof(b));
+
+		int fd = ::open(fpath.c_str(), O_WRONLY | O_APPEND);
+		if(fd == -1)
+		{
+			perror("open()");
+			return false;
+		}
+		bool ok = write_all(fd, buf.data(), buf.size()) && fdatasync(fd) == 0;
+		::close(fd);
+		if(!ok)
+		{
+			// the block may be half written, find out where the archive ends again before the next append
+			checked = false;
+			return false;
+		}
+		prev = e;
+		since_key = key ? 1 : since_key + 1;
+		return true;
+	}
+
+private:
+	/*! @brief creates the archive the first time, and cuts off a torn block left by a power cut
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns bool
+	*
+	*/
+	bool prepare(void)
+	{
+		if(checked)
+		{
+			return true;
+		}
+
+		struct stat st;
+		if(stat(fpath.c_str(), &st) == -1 || st.st_size == 0)
+		{
+			// make the folders on the way, ./data/ may not exist yet either
+			for(size_t slash = fpath.find('/', 1); slash != string::npos; slash = fpath.find('/', slash + 1))
+			{
+				mkdir(fpath.substr(0, slash).c_str(), 0755);
+			}
+			int fd = ::open(fpath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if(fd == -1)
+			{
+				perror("open()");
+				return false;
+			}
+			prog_archive_header h;
+			memset(&h, 0, sizeof(h));
+			memcpy(h.magic, PROG_ARCHIVE_MAGIC, sizeof(h.magic));
+			h.version = PROG_ARCHIVE_VERSION;
+			h.block_header = sizeof(prog_archive_block);
+			bool ok = write_all(fd, &h, sizeof(h)) && fsync(fd) == 0;
+			::close(fd);
+			checked = ok;
+			return ok;
+		}
+
+		// read it all to find the end of the last good block and the block the next one is coded against
+		PROG_ARCHIVE_READER rd;
+		if(!rd.open(fpath))
+		{
+			cout << "Forecast archive " << fpath << " is not readable, not archiving" << endl;
+			return false;
+		}
+		prog_archive_entry e;
+		unsigned long blocks = 0;
+		while(rd.next(e))
+		{
+			blocks++;
+		}
+		if(rd.offset() < rd.size() && truncate(fpath.c_str(), rd.offset()) == -1)
+		{
+			perror("truncate()");
+			return false;
+		}
+		prev = rd.last();
+		since_key = blocks ? 1 : PROG_ARCHIVE_KEY_EVERY;
+		checked = true;
+		return true;
+	}
+
+	static bool write_all(int _fd, const void* _buf, size_t _n)
+	{
+		const char* p = (const char*)_buf;
+		while(_n)
+		{
+			ssize_t w = write(_fd, p, _n);
+			if(w == -1 && errno == EINTR)
+			{
+				continue;
+			}
+			if(w <= 0)
+			{
+				perror("write()");
+				return false;
+			}
+			p += w;
+			_n -= w;
+		}
+		return true;
+	}
+
+	string fpath;
+	bool checked;
+	int since_key;					// blocks written since the last key block
+	prog_archive_entry prev;
+};
+
+
+	/*! @brief	Forecast accuracy per lead time: every archived temperature is compared with the measured hourly mean
+	*	around its valid time, and the errors are summed in buckets of _bucket seconds of lead time
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	PROG_ACCURACY acc(3 * 3600);
+	*	acc.add_archive(rd, measured, from, to);
+	*	for(auto& row : acc.rows()) cout << row.lead << " " << row.bias() << " " << row.rmse() << endl;
+	* @endcode
+	*
+	*/
+class PROG_ACCURACY
+{
+public:
+	PROG_ACCURACY(int _bucket = 3600) : bucket(_bucket > 0 ? _bucket : 3600), matched(0), unmatched(0)
+	{
+
+	}
+
+	/*! @brief adds every forecast issued in [_from, _to) to the statistics
+	*
+	*
+	*
+	* @param PROG_ARCHIVE_READER& _rd (opened with at least the temperature column), const unordered_map< int64_t, float >& _hourly (hour number -> measured mean),
+	*	time_t _from, time_t _to
+	*
+	* @returns unsigned long, the number of blocks used
+	*
+	*/
+	unsigned long add_archive(PROG_ARCHIVE_READER& _rd, const unordered_map< int64_t, float >& _hourly, time_t _from, time_t _to)
+	{
+		prog_archive_entry e;
+		unsigned long blocks = 0;
+		while(_rd.next(e))
+		{
+			if(e.issue < _from || e.issue >= _to)
+			{
+				continue;
+			}
+			blocks++;
+			for(size_t i = 0; i < e.valid.size(); i++)
+			{
+				// steps that had already begun when the forecast was fetched are not forecasts
+				int64_t lead = e.valid[i] - e.issue;
+				if(lead < 0 || isnan(e.temperature[i]))
+				{
+					continue;
+				}
+				unordered_map< int64_t, float >::const_iterator m = _hourly.find(prog_hour(e.valid[i]));
+				if(m == _hourly.end())
+				{
+					unmatched++;
+					continue;
+				}
+				size_t b = lead / bucket;
+				if(b >= table.size())
+				{
+					size_t old = table.size();
+					table.resize(b + 1);
+					for(size_t j = old; j < table.size(); j++)
+					{
+						table[j].lead = j * bucket;
+					}
+				}
+				double err = e.temperature[i] - m->second;
+				table[b].n++;
+				table[b].sum += err;
+				table[b].sum2 += err * err;
+				matched++;
+			}
+		}
+		return blocks;
+	}
+
+	// one row per bucket, also the empty ones
+	const vector< prog_accuracy_row >& rows(void) const
+	{
+		return table;
+	}
+
+	unsigned long get_matched(void) const
+	{
+		return matched;
+	}
+
+	unsigned long get_unmatched(void) const
+	{
+		return unmatched;
+	}
+
+	/*! @brief the hour number a measurement or valid time belongs to, the hour is centred on the full hour as the
+	*	forecast values are valid at the full hour
+	*
+	*
+	*
+	* @param int64_t _t [unix time]
+	*
+	* @returns int64_t
+	*
+	*/
+	static int64_t prog_hour(int64_t _t)
+	{
+		int64_t t = _t + 1800;
+		return (t >= 0 ? t : t - 3599) / 3600;
+	}
+
+private:
+	int bucket;
+	vector< prog_accuracy_row > table;
+	unsigned long matched;
+	unsigned long unmatched;
+};
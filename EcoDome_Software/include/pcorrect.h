@@ -0,0 +1,386 @@
+#pragma once
+
+/*
+* pcorrect.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:28
+* Modified:		19/10-2026 06:02
+* Version:		1.1
+*
+* Description:
+*	This header includes the online correction of the prognosis for our site. For every lead time bucket a small
+*	linear model, measured = a + b*forecast + c*sin(hour) + d*cos(hour), is fitted by recursive least squares against
+*	the measured outside temperature, and applied to every new prognosis before it is analysed.
+*
+* NOTE:
+*	All memory is allocated up front, an update is a fixed number of operations per finished hour and bucket.
+*	The models are saved to PCORR_FILE once an hour so they survive a restart, the file is written by the thread of
+*	statesave.h and not by the control step.
+*	A measurement of NAN, e.g. from a sensor that could not be read, is left out.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "yrparse.h"
+#include "statesave.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define PCORR_FILE			"./data/pcorrect.bin"
+#define PCORR_MAGIC			0x52524F43		// "CORR"
+#define PCORR_BUCKET		10800			// width of a lead time bucket [s]
+#define PCORR_BUCKETS		80				// buckets, 80 * 3 hours covers the 9 days yr.no forecasts
+#define PCORR_SLOTS			256				// hours a forecast value can wait for its measurement, > PCORR_BUCKETS * 3
+#define PCORR_FEATURES		4				// 1, forecast, sin(hour of day), cos(hour of day)
+#define PCORR_LAMBDA		0.998			// forgetting factor, about 500 samples of memory
+#define PCORR_DELTA			100.0			// initial variance of the parameters
+#define PCORR_MIN_SAMPLES	24				// samples a bucket needs before its model is used
+#define PCORR_MAX			5.0				// largest correction applied [celsius]
+
+// a forecast value waiting for the measurement of its hour
+struct pcorr_pending
+{
+	int32_t hour = -1;				// hour number of the valid time, -1 if the slot is empty
+	float temperature = 0;
+};
+
+// recursive least squares model of one lead time bucket
+struct pcorr_model
+{
+	double theta[PCORR_FEATURES];
+	double P[PCORR_FEATURES][PCORR_FEATURES];
+	uint32_t n;						// samples used
+	float last_error;				// forecast - measured of the last sample [celsius]
+};
+
+// what is stored in PCORR_FILE
+struct pcorr_file_header
+{
+	uint32_t magic;
+	uint32_t buckets;
+	uint32_t bucket;
+	uint32_t features;
+};
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Online bias correction of the prognosis
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	PROG_CORRECTOR pc;
+	*	pc.observe(time(0), T_outmean);							// every control tick
+	*	pc.forecast(records, n, issued);						// for every new prognosis
+	*	pc.correct(records, n, issued, corrected);				// before it is analysed
+	* @endcode
+	*
+	*/
+class PROG_CORRECTOR
+{
+public:
+	/*! @brief Constructor, loads the models saved by an earlier run if there are any
+	*
+	*
+	*
+	* @param const string& _fpath
+	*
+	* @returns void
+	*
+	*/
+	PROG_CORRECTOR(const string& _fpath = PCORR_FILE) : fpath(_fpath), models(PCORR_BUCKETS), pending(PCORR_BUCKETS * PCORR_SLOTS)
+	{
+		for(size_t b = 0; b < models.size(); b++)
+		{
+			reset(models[b]);
+		}
+		load();
+	}
+
+	/*! @brief adds a measurement of the outside temperature, when an hour is complete its mean is compared with what
+	*	was forecast for it and the models are updated
+	*
+	*
+	*
+	* @param time_t _now, float _Tout
+	*
+	* @returns void
+	*
+	*/
+	void observe(time_t _now, float _Tout)
+	{
+		if(isnan(_Tout))
+		{
+			return;
+		}
+		int32_t h = hour_of(_now);
+		if(h != cur_hour)
+		{
+			if(cur_n)
+			{
+				finish_hour(cur_hour, cur_sum / cur_n);
+			}
+			cur_hour = h;
+			cur_sum = 0;
+			cur_n = 0;
+		}
+		cur_sum += _Tout;
+		cur_n++;
+	}
+
+	/*! @brief remembers the values of a new prognosis, so they can be compared with the measurement later
+	*
+	*
+	*
+	* @param const prognosis_record* _rec, size_t _n, time_t _issued
+	*
+	* @returns void
+	*
+	*/
+	void forecast(const prognosis_record* _rec, size_t _n, time_t _issued)
+	{
+		for(size_t i = 0; i < _n; i++)
+		{
+			int b = bucket_of(_rec[i].from - _issued);
+			if(b < 0 || !(_rec[i].fields & PREC_TEMPERATURE))
+			{
+				continue;
+			}
+			int32_t h = hour_of(_rec[i].from);
+			pcorr_pending& p = pending[b * PCORR_SLOTS + (h % PCORR_SLOTS)];
+			p.hour = h;
+			p.temperature = _rec[i].temperature;
+		}
+	}
+
+	/*! @brief corrects the temperatures of a prognosis with the model of their lead time, buckets without enough
+	*	samples are left as they are
+	*
+	*
+	*
+	* @param const prognosis_record* _rec, size_t _n, time_t _issued, vector< prognosis_record >& _out
+	*
+	* @returns void
+	*
+	*/
+	void correct(const prognosis_record* _rec, size_t _n, time_t _issued, vector< prognosis_record >& _out) const
+	{
+		_out.assign(_rec, _rec + _n);
+		for(size_t i = 0; i < _n; i++)
+		{
+			int b = bucket_of(_rec[i].from - _issued);
+			if(b < 0 || !(_rec[i].fields & PREC_TEMPERATURE) || models[b].n < PCORR_MIN_SAMPLES)
+			{
+				continue;
+			}
+			double x[PCORR_FEATURES];
+			features(_rec[i].temperature, hour_of(_rec[i].from), x);
+			double y = 0;
+			for(int k = 0; k < PCORR_FEATURES; k++)
+			{
+				y += models[b].theta[k] * x[k];
+			}
+			double c = y - _rec[i].temperature;
+			c = c > PCORR_MAX ? PCORR_MAX : (c < -PCORR_MAX ? -PCORR_MAX : c);
+			_out[i].temperature = _rec[i].temperature + c;
+		}
+	}
+
+	/*! @brief returns the model of a bucket, for the terminal and logs
+	*
+	*
+	*
+	* @param int _bucket
+	*
+	* @returns const pcorr_model&
+	*
+	*/
+	const pcorr_model& get_model(int _bucket) const
+	{
+		return models[_bucket];
+	}
+
+	unsigned long get_updates(void) const
+	{
+		return updates;
+	}
+
+	/*! @brief the hour number a time belongs to, centred on the full hour as the forecast values are valid at the
+	*	full hour
+	*
+	*
+	*
+	* @param int64_t _t [unix time]
+	*
+	* @returns int32_t
+	*
+	*/
+	static int32_t hour_of(int64_t _t)
+	{
+		return (int32_t)((_t + 1800) / 3600);
+	}
+
+private:
+	static int bucket_of(int64_t _lead)
+	{
+		if(_lead < 0)
+		{
+			return -1;
+		}
+		int64_t b = _lead / PCORR_BUCKET;
+		return b < PCORR_BUCKETS ? (int)b : -1;
+	}
+
+	static void features(float _T, int32_t _hour, double _x[PCORR_FEATURES])
+	{
+		double a = (_hour % 24) * (2 * M_PI / 24);
+		_x[0] = 1;
+		_x[1] = _T;
+		_x[2] = sin(a);
+		_x[3] = cos(a);
+	}
+
+	static void reset(pcorr_model& _m)
+	{
+		memset(&_m, 0, sizeof(_m));
+		// start out as "the forecast is right"
+		_m.theta[1] = 1;
+		for(int k = 0; k < PCORR_FEATURES; k++)
+		{
+			_m.P[k][k] = PCORR_DELTA;
+		}
+	}
+
+	/*! @brief one recursive least squares step with forgetting
+	*
+	*
+	*
+	* @param pcorr_model& _m, const double _x[PCORR_FEATURES], double _y
+	*
+	* @returns void
+	*
+	*/
+	static void rls_update(pcorr_model& _m, const double _x[PCORR_FEATURES], double _y)
+	{
+		double Px[PCORR_FEATURES];
+		double xPx = 0;
+		for(int i = 0; i < PCORR_FEATURES; i++)
+		{
+			Px[i] = 0;
+			for(int j = 0; j < PCORR_FEATURES; j++)
+			{
+				Px[i] += _m.P[i][j] * _x[j];
+			}
+			xPx += _x[i] * Px[i];
+		}
+
+		double denom = PCORR_LAMBDA + xPx;
+		double err = _y;
+		for(int i = 0; i < PCORR_FEATURES; i++)
+		{
+			err -= _m.theta[i] * _x[i];
+		}
+		for(int i = 0; i < PCORR_FEATURES; i++)
+		{
+			_m.theta[i] += Px[i] / denom * err;
+		}
+		// P = (P - Px Px' / denom) / lambda, P stays symmetric
+		for(int i = 0; i < PCORR_FEATURES; i++)
+		{
+			for(int j = 0; j < PCORR_FEATURES; j++)
+			{
+				_m.P[i][j] = (_m.P[i][j] - Px[i] * Px[j] / denom) / PCORR_LAMBDA;
+			}
+		}
+		_m.n++;
+	}
+
+	/*! @brief updates every bucket that had a forecast for hour _h with its measured mean
+	*
+	*
+	*
+	* @param int32_t _h, float _measured
+	*
+	* @returns void
+	*
+	*/
+	void finish_hour(int32_t _h, float _measured)
+	{
+		unsigned long before = updates;
+		for(int b = 0; b < PCORR_BUCKETS; b++)
+		{
+			pcorr_pending& p = pending[b * PCORR_SLOTS + (_h % PCORR_SLOTS)];
+			if(p.hour != _h)
+			{
+				continue;
+			}
+			double x[PCORR_FEATURES];
+			features(p.temperature, _h, x);
+			rls_update(models[b], x, _measured);
+			models[b].last_error = p.temperature - _measured;
+			p.hour = -1;
+			updates++;
+		}
+		if(updates != before)
+		{
+			save();
+		}
+	}
+
+	void load(void)
+	{
+		FILE* f = fopen(fpath.c_str(), "rb");
+		if(!f)
+		{
+			return;
+		}
+		pcorr_file_header h;
+		vector< pcorr_model > m(PCORR_BUCKETS);
+		if(fread(&h, sizeof(h), 1, f) == 1 && h.magic == PCORR_MAGIC && h.buckets == PCORR_BUCKETS && h.bucket == PCORR_BUCKET && h.features == PCORR_FEATURES
+			&& fread(m.data(), sizeof(pcorr_model), m.size(), f) == m.size())
+		{
+			models = m;
+		}
+		fclose(f);
+	}
+
+	// only copies the models, the file is written in the background (temporary file and rename, so a power cut
+	// leaves either the old or the new models)
+	void save(void)
+	{
+		pcorr_file_header h;
+		h.magic = PCORR_MAGIC;
+		h.buckets = PCORR_BUCKETS;
+		h.bucket = PCORR_BUCKET;
+		h.features = PCORR_FEATURES;
+		vector< uint8_t > buf(sizeof(h) + models.size() * sizeof(pcorr_model));
+		memcpy(buf.data(), &h, sizeof(h));
+		memcpy(buf.data() + sizeof(h), models.data(), models.size() * sizeof(pcorr_model));
+		state_saver().save(fpath, buf);
+	}
+
+	string fpath;
+	vector< pcorr_model > models;
+	vector< pcorr_pending > pending;	// [bucket][valid hour % PCORR_SLOTS]
+	int32_t cur_hour = -1;
+	double cur_sum = 0;
+	unsigned long cur_n = 0;
+	unsigned long updates = 0;
+};
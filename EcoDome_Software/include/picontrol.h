@@ -4,11 +4,14 @@
 * picontrol.h
 * Author:		Hans V. Rasmussen
 * Created:		13/04-2018 15:00
-* Modified:		25/04-2018 16:30
-* Version:		1.5
+* Modified:		19/10-2026 06:12
+* Version:		1.6
 *
 * Description:
 *	This header includes the control system for the EcoDome project, complete with pin control for the Raspberry Pi 3
+*	Since version 1.6 the prognoses are fetched in the background (progfetch.h), corrected for the site (pcorrect.h)
+*	and blended with a nowcast (nowcast.h), and the controller follows a reference trajectory, takes overrides from
+*	the control socket (ctlserver.h) and publishes its metrics, flight records and telemetry.
 *
 * NOTE:
 *
@@ -23,7 +26,6 @@
 #include <errno.h>
 #include <stdlib.h>
 #include <wiringPi.h>
-#include <softPwm.h>
 #include <mutex>
 #include <thread>
 #include<semaphore.h>
@@ -33,6 +35,14 @@
 #include "ECO_DS18B20.h"
 #include "debug_logger.h"
 #include "panalysis.h"
+#include "progfetch.h"
+#include "pcorrect.h"
+#include "nowcast.h"
+#include "pwm.h"
+#include "flightrec.h"
+#include "telemetry.h"
+#include "ctlserver.h"
+#include "metrics.h"
 
 
 // ###############################################		DEFINES		#################################################### //
@@ -225,7 +235,7 @@ public:
 	* @returns void
 	*
 	*/
-	L298N_Driver(int _IN1, int _IN2) : IN1(_IN1), IN2(_IN2), EN(0)
+	L298N_Driver(int _IN1, int _IN2) : IN1(_IN1), IN2(_IN2), pwm(NULL)
 	{
 		// Prepare pins for choosing direction
 		pinMode(IN1, OUTPUT);
@@ -235,16 +245,17 @@ public:
 		set_dir(off);
 	}
 
-	/*! @brief alternative constructor, containing support for duty cycle.
+	/*! @brief alternative constructor with support for duty cycle, taking a PWM output for the enable pin, e.g.
+	*	pwm_create(L298N_3_ENA) or MOCK_PWM, the driver takes ownership.
 	*
 	* 
 	*
-	* @param void
+	* @param int _IN1, int _IN2, PWM_DRIVER* _pwm
 	*
 	* @returns void
 	*
 	*/
-	L298N_Driver(int _IN1, int _IN2,int _EN) : IN1(_IN1), IN2(_IN2), EN(_EN)
+	L298N_Driver(int _IN1, int _IN2, PWM_DRIVER* _pwm) : IN1(_IN1), IN2(_IN2), pwm(_pwm)
 	{
 		// Prepare pins for choosing direction
 		pinMode(IN1, OUTPUT);
@@ -253,11 +264,16 @@ public:
 		digitalWrite(IN2, LOW);
 		set_dir(off);
 
-		// Prepare PWM
-		softPwmCreate(EN, 0, 500);
+		// Start with the motor stopped
+		pwm->set_duty(0);
+	}
+
+	~L298N_Driver()
+	{
+		delete pwm;
 	}
 
-	/*! @brief sets motor direction and speed (speed currently not working)
+	/*! @brief sets motor direction, use set_duty() for the speed
 	*
 	* 
 	*
@@ -296,21 +312,39 @@ public:
 	*
 	* 
 	*
-	* @param int(1-100)
+	* @param int(0-100)
 	*
 	* @returns void
 	*
 	*/
 	void set_duty(int _duty)
 	{
-		if(!EN)
+		if(!pwm)
 		{
 			cout << "No PWM output set, please use the constructor to intialize the PWM!\n";
 		}
 		else
 		{
-			softPwmWrite(EN, _duty*5);
+			pwm->set_duty(_duty);
+		}
+	}
+
+	/*! @brief returns duty cycle accuracy and CPU use of the PWM output
+	*
+	* 
+	*
+	* @param void
+	*
+	* @returns pwm_stats
+	*
+	*/
+	pwm_stats get_pwm_stats(void)
+	{
+		if(!pwm)
+		{
+			return pwm_stats();
 		}
+		return pwm->get_stats();
 	}
 
 
@@ -319,9 +353,12 @@ protected:
 
 private:
 
+	L298N_Driver(const L298N_Driver&);
+	L298N_Driver& operator=(const L298N_Driver&);
+
 	int IN1;
 	int IN2;
-	int EN;
+	PWM_DRIVER* pwm;
 };
 
 // ###############################################		THREADS 	#################################################### //
@@ -491,7 +528,7 @@ public:
 	* @returns void
 	*
 	*/
-    Main_Controller(TERMINAL_CONTROLLER* _tc, DS18B20* _tm, sem_t* _sc, sem_t* _str, vector< prognosis_downlaod_structure > _dstruct, int _pn, float _tmax, float _tmin, float _topt) : 
+    Main_Controller(TERMINAL_CONTROLLER* _tc, DS18B20* _tm, sem_t* _sc, sem_t* _str, vector< prognosis_downlaod_structure > _dstruct, int _pn, float _tmax, float _tmin, float _topt, FLIGHT_RECORDER* _fr = NULL, TELEMETRY_WRITER* _tw = NULL, CONTROL_SERVER* _cs = NULL) : 
 		tercon(_tc),
 		tempobj(_tm),
 		sem_control(_sc),
@@ -504,12 +541,40 @@ public:
 		window(tercon, L298N_3_IN1, L298N_3_IN2, WINDOW_FEEDBACK), 
 		inTempQ(),
 		p_analyser(Tmin, Tmax, Tdes),
-		p_loader()
+		p_fetcher(_tc, _dstruct, _pn),
+		recorder(_fr),
+		telemetry(_tw),
+		control(_cs)
     {
+		// Hold the desired temperature until the first prognosis has been downloaded
+		r = Tdes;
 
-		progdownload(_down_data);
-		p_loader.initiate(_down_data[0], _prognosis_number);
+		// prog_number picks the 6 hour step of the prognosis to look at, look at the middle of it
+		_prog_lead = (_prognosis_number > 1) ? (time_t)((_prognosis_number - 1.5) * 6 * 3600) : 0;
 		
+		// The state of the controller for the metrics endpoint
+		m_u = metrics().gauge("ecodome_control_u", "Control signal u of the PI controller");
+		m_r = metrics().gauge("ecodome_control_reference_celsius", "Reference temperature r");
+		m_y = metrics().gauge("ecodome_control_measurement_celsius", "Measured inside temperature y");
+		m_integral = metrics().gauge("ecodome_control_integral", "Integral of the PI controller");
+		m_nowcast = metrics().gauge("ecodome_nowcast_1h_celsius", "Nowcast of the outside temperature one hour ahead");
+		m_forecast_age = metrics().gauge("ecodome_forecast_age_seconds", "Age of the prognosis in use, NaN before the first one");
+		m_actuators[0] = metrics().gauge("ecodome_actuator_on", "State of an actuator, 1 for on", "actuator=\"stone_fan\"");
+		m_actuators[1] = metrics().gauge("ecodome_actuator_on", "State of an actuator, 1 for on", "actuator=\"main_fan\"");
+		m_actuators[2] = metrics().gauge("ecodome_actuator_on", "State of an actuator, 1 for on", "actuator=\"fan_high\"");
+		m_steps = metrics().counter("ecodome_control_steps_total", "Control steps taken");
+		vector< double > bounds;
+		for(double b = 0.00001; b < 20; b *= 10)
+		{
+			bounds.push_back(b);
+			bounds.push_back(b * 5);
+		}
+		for(int st = 0; st < FLIGHT_STAGES; st++)
+		{
+			m_stages[st] = metrics().histogram("ecodome_stage_seconds", "Time of a stage of the control step", bounds,
+				string("stage=\"") + flight_stage_names[st] + "\"");
+		}
+
 		// Prepare the Main Fan
     	pinMode(RELAY_1_P1, OUTPUT);
 		digitalWrite(RELAY_1_P1, LOW);
@@ -519,6 +584,7 @@ public:
 		digitalWrite(L298N_STONE, LOW);
 
 		window.StartInternalThread();
+		p_fetcher.StartInternalThread();
 
     }
 
@@ -567,6 +633,21 @@ public:
 		return mainFAN;
 	}
 
+	/*! @brief Function to acquire the nowcast of the outside temperature one hour ahead for logging purposes
+	*
+	* 
+	*
+	* @param void
+	*
+	* @returns float, NAN while the nowcaster warms up
+	*
+	*/
+	float get_nowcast(void)
+	{
+		lock_guard <mutex> r_lock(r_mutex);
+		return nowcast_1h;
+	}
+
 	/*! @brief Function to acquire termperature reference for logging purposes
 	*
 	* 
@@ -598,48 +679,248 @@ protected:
 		while(tercon->pos())
 		{
 			sem_wait(sem_control);
+			stage_start(-1);
 
+			// Commands from the control socket take effect in this step
+			apply_commands();
 
-
-			// Do prognosis analysis if need be
+			// Pick up the newest prognosis, the fetcher downloads it in the background so this never waits
 			_prog_counter++;
-			if(_prog_counter > (1800/TIME_STEP))
+			shared_ptr<const prognosis_snapshot> snap = p_fetcher.get_snapshot();
+			if(snap && snap->version != _prog_version)
 			{
-				// Update the prognosis
-        		progdownload(_down_data);
-
-        		// read the prognosis for changes
-   				p_loader.update();
-
-        		// Load data:
-				_prog_anal_data = p_loader.get_data();
+				_prog_snapshot = snap;
+				_prog_version = snap->version;
+				_prog_counter = (1800/TIME_STEP) + 1;
+				p_corrector.forecast(snap->store->records, snap->store->count, snap->fetched);
 			}
+			stage_start(FLIGHT_STAGE_PROGNOSIS);
 
 			// Wait for the temperature to finish its iteration and load the updated temperature
 			sem_wait(sem_temp_ready);
+			stage_start(FLIGHT_STAGE_SENSORS);
 			get_temp();
-
-			if(_prog_counter > (1800/TIME_STEP))
+			// a failed read is not a temperature, the models leave it out
+			float T_out = tm.T_out_failed ? NAN : tm.T_outmean;
+			p_corrector.observe(time(0), T_out);
+			p_nowcaster.update(time(0), T_out);
+			r_mutex.lock();
+			nowcast_1h = p_nowcaster.nowcast(time(0) + 3600);
+			r_mutex.unlock();
+			stage_start(FLIGHT_STAGE_MODELS);
+
+			// with a nowcast the near future changes every step, not just with the prognosis
+			int recompute = p_nowcaster.ready() ? (NOWCAST_STEP/TIME_STEP) : (1800/TIME_STEP);
+			if(_prog_snapshot && _prog_counter > recompute)
 			{
-				// Let the Prognosis analyser do its magic:
-				r = p_analyser.panalyse(_prog_anal_data, tm.T_inside, tm.T_outmean, _prognosis_number);
+				// Correct the prognosis for our site with what the models have learned so far
+				p_corrector.correct(_prog_snapshot->store->records, _prog_snapshot->store->count, _prog_snapshot->fetched, _prog_corrected);
+				// and use the local nowcast for the next hours
+				p_nowcaster.blend(_prog_corrected, time(0), _prog_blended);
+				PROG_SERIES series(_prog_blended.data(), _prog_blended.size());
+
+				// Let the Prognosis analyser do its magic for the whole prognosis at once
+				p_analyser.trajectory(series, tm.T_inside, tm.T_outmean, time(0), _prog_lead, TIME_STEP, _ref_restart ? NAN : get_ref(), _ref_traj);
+				_ref_restart = false;
 				// Reset counter
 				_prog_counter = 0;
 			}
 
+			// Follow the reference trajectory
+			if(!_ref_traj.r.empty())
+			{
+				r_mutex.lock();
+				r = _ref_traj.at(time(0));
+				r_mutex.unlock();
+			}
+			stage_start(FLIGHT_STAGE_TRAJECTORY);
+
 			// Do regular controlling jobs
 			y = tm.T_inside;
 			controller();
+			stage_start(FLIGHT_STAGE_CONTROL);
 			plant();
+			stage_start(FLIGHT_STAGE_PLANT);
+
+			// the whole state of this step to the flight recorder
+			record();
 		}
 		digitalWrite(RELAY_1_P1, LOW);
 		digitalWrite(L298N_STONE, LOW);
 		window.WaitForInternalThreadToExit();
+		p_fetcher.WaitForInternalThreadToExit();
 
     }
 	
 
 private:
+	/*! @brief Ends the current stage of the step and starts the next one, -1 starts the step
+	*
+	* 
+	*
+	* @param int _stage, the FLIGHT_STAGE_* that just ended
+	*
+	* @returns void
+	*
+	*/
+	void stage_start(int _stage)
+	{
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		if(_stage < 0)
+		{
+			_step_start = now;
+			_flight.epoch_us = chrono::duration_cast< chrono::microseconds >(chrono::system_clock::now().time_since_epoch()).count();
+			_flight.mono_ns = chrono::duration_cast< chrono::nanoseconds >(now.time_since_epoch()).count();
+		}
+		else
+		{
+			_flight.stage_us[_stage] = chrono::duration_cast< chrono::microseconds >(now - _stage_start).count();
+		}
+		_stage_start = now;
+	}
+
+	/*! @brief Function that commits the state of this step to the flight recorder, the telemetry segment and the metrics
+	*
+	* 
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void record(void)
+	{
+		_flight.stage_us[FLIGHT_STAGE_STEP] = chrono::duration_cast< chrono::microseconds >(chrono::steady_clock::now() - _step_start).count();
+		_flight.T_inside = tm.T_inside;
+		_flight.T_in_window = tm.T_in_window;
+		_flight.T_out1 = tm.T_out1;
+		_flight.T_out2 = tm.T_out2;
+		_flight.T_outmean = tm.T_outmean;
+		_flight.T_stone1 = tm.T_stone1;
+		_flight.T_stone2 = tm.T_stone2;
+		_flight.T_stoneF = tm.T_stoneF;
+		_flight.T_stonemean = tm.T_stonemean;
+		_flight.T_extra1 = tm.T_extra1;
+		lock_guard <mutex> u_lock(u_mutex);
+		lock_guard <mutex> r_lock(r_mutex);
+		_flight.u = u;
+		_flight.r = r;
+		_flight.y = y;
+		_flight.integral = Integral;
+		_flight.nowcast_1h = nowcast_1h;
+		_flight.actuators = (stoneFAN ? FLIGHT_STONE_FAN : 0) | (mainFAN ? FLIGHT_MAIN_FAN : 0) | (fanHIGH ? FLIGHT_FAN_HIGH : 0);
+
+		m_u->set(u);
+		m_r->set(r);
+		m_y->set(y);
+		m_integral->set(Integral);
+		m_nowcast->set(nowcast_1h);
+		m_forecast_age->set(_prog_snapshot ? (double)(time(0) - _prog_snapshot->fetched) : NAN);
+		m_actuators[0]->set(stoneFAN);
+		m_actuators[1]->set(mainFAN);
+		m_actuators[2]->set(fanHIGH);
+		for(int st = 0; st < FLIGHT_STAGES; st++)
+		{
+			m_stages[st]->observe(_flight.stage_us[st] * 1e-6);
+		}
+		m_steps->inc();
+
+		if(recorder)
+		{
+			recorder->commit(_flight);
+		}
+		if(telemetry)
+		{
+			telemetry->publish(_flight);
+		}
+		if(control)
+		{
+			_status.step = _flight;
+			_status.step.seq_begin = _status.step.seq_end = ++_steps;
+			_status.Tdes = Tdes;
+			_status.Tmax = Tmax;
+			_status.Tmin = Tmin;
+			_status.K = K;
+			_status.Ke = Ke;
+			_status.stone_fan = stone_override;
+			_status.main_fan = main_override;
+			control->publish(_status);
+		}
+	}
+
+	/*! @brief Function that applies the commands that came in on the control socket since the last step and answers them
+	*
+	* 
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void apply_commands(void)
+	{
+		if(!control || !control->take(_commands))
+		{
+			return;
+		}
+		for(size_t i = 0; i < _commands.size(); i++)
+		{
+			const control_command& c = _commands[i];
+			string name = control_target_names[c.target];
+			char value[32];
+			snprintf(value, sizeof(value), "%.3f", c.value);
+
+			if(c.type == CONTROL_SET && (c.target == CONTROL_K || c.target == CONTROL_KE))
+			{
+				lock_guard <mutex> u_lock(u_mutex);
+				(c.target == CONTROL_K ? K : Ke) = c.value;
+				control->reply(c.client, "ok " + name + "=" + value);
+			}
+			else if(c.type == CONTROL_SET)
+			{
+				float tdes = c.target == CONTROL_TDES ? c.value : Tdes;
+				float tmin = c.target == CONTROL_TMIN ? c.value : Tmin;
+				float tmax = c.target == CONTROL_TMAX ? c.value : Tmax;
+				if(!(tmin < tmax && tmin <= tdes && tdes <= tmax))
+				{
+					char limits[96];
+					snprintf(limits, sizeof(limits), "err tmin <= tdes <= tmax and tmin < tmax must hold, now %.2f %.2f %.2f", Tmin, Tdes, Tmax);
+					control->reply(c.client, limits);
+					continue;
+				}
+				Tdes = tdes;
+				Tmin = tmin;
+				Tmax = tmax;
+				p_analyser.set_limits(Tmin, Tmax, Tdes);
+				if(_prog_snapshot)
+				{
+					// the reference trajectory is made again in this step, starting from the new setpoints and
+					// not rate limited from the old reference
+					_prog_counter = (1800/TIME_STEP) + 1;
+					_ref_restart = true;
+				}
+				else
+				{
+					// without a prognosis the reference is the desired temperature
+					lock_guard <mutex> r_lock(r_mutex);
+					r = Tdes;
+				}
+				control->reply(c.client, "ok " + name + "=" + value);
+			}
+			else if(c.type == CONTROL_OVERRIDE)
+			{
+				lock_guard <mutex> u_lock(u_mutex);
+				(c.target == CONTROL_STONE_FAN ? stone_override : main_override) = c.value;
+				control->reply(c.client, "ok override " + name + " " + control_override_name(c.value));
+			}
+			else
+			{
+				p_fetcher.refresh();
+				control->reply(c.client, "ok refresh started");
+			}
+		}
+	}
+
 	/*! @brief Function to ask DS18B20 class for temperature structure
 	*
 	* 
@@ -707,8 +988,22 @@ private:
 	{
 		lock_guard <mutex> u_lock(u_mutex);
 
-		// main fan & window
-		if((u > 20) && (tm.T_outmean > tm.T_inside))
+		// main fan & window, an override from the control socket comes first
+		if(main_override != CONTROL_AUTO)
+		{
+			digitalWrite(RELAY_1_P1, LOW);
+			fanHIGH = false;
+			if(main_override == CONTROL_ON)
+			{
+				window.open();
+			}
+			else
+			{
+				window.close();
+			}
+			mainFAN = main_override == CONTROL_ON;
+		}
+		else if((u > 20) && (tm.T_outmean > tm.T_inside))
 		{
 			window.open();
 			mainFAN = true;
@@ -716,10 +1011,12 @@ private:
 			if(u > 40)
 			{
 				digitalWrite(RELAY_1_P1, HIGH);
+				fanHIGH = true;
 			}
 			else
 			{
 				digitalWrite(RELAY_1_P1, LOW);
+				fanHIGH = false;
 			}
 		}
 		else if((u < -20) || (tm.T_inside > Tmax))
@@ -730,21 +1027,29 @@ private:
 			if(u < -40)
 			{
 				digitalWrite(RELAY_1_P1, HIGH);
+				fanHIGH = true;
 			}
 			else
 			{
 				digitalWrite(RELAY_1_P1, LOW);
+				fanHIGH = false;
 			}
 		}
 		else 
 		{
 			digitalWrite(RELAY_1_P1, LOW);
+			fanHIGH = false;
 			window.close();
 			mainFAN = false;
 		}
 		
 		// stonebed
-		if(((r > Tdes) || (u < -5)) && (tm.T_stonemean < tm.T_inside))
+		if(stone_override != CONTROL_AUTO)
+		{
+			digitalWrite(L298N_STONE, stone_override == CONTROL_ON ? HIGH : LOW);
+			stoneFAN = stone_override == CONTROL_ON;
+		}
+		else if(((r > Tdes) || (u < -5)) && (tm.T_stonemean < tm.T_inside))
 		{
 			digitalWrite(L298N_STONE, HIGH);
 			stoneFAN = true;
@@ -767,7 +1072,7 @@ private:
 	Queue < float, 10 > Y;
 	bool Qsetup = true;
 	float Integral = 0;
-	int _prog_counter = 1800/TIME_STEP;
+	int _prog_counter = 0;
 
 	// Constants
 	float K = 1.2;
@@ -786,11 +1091,38 @@ private:
 	Temp_measurement tm;
 	WINDOW_CONTROLLER window;
 	PANALYSIS p_analyser;
-	PROGLOAD p_loader;
+	PROGFETCHER p_fetcher;
+	PROG_CORRECTOR p_corrector;
+	NOWCASTER p_nowcaster;
 	Queue < float, 10 > inTempQ;
 	vector< prognosis_downlaod_structure > _down_data;
 	int _prognosis_number;
-	vector< prognosis_data_structure > _prog_anal_data;
+	time_t _prog_lead;				// how far ahead the prognosis is looked at [s]
+	shared_ptr<const prognosis_snapshot> _prog_snapshot;
+	REF_TRAJECTORY _ref_traj;
+	bool _ref_restart = false;		// the setpoints were changed, the next trajectory is not rate limited from r
+	vector< prognosis_record > _prog_corrected;
+	vector< prognosis_record > _prog_blended;
+	float nowcast_1h = NAN;
+	unsigned long _prog_version = 0;
+	FLIGHT_RECORDER* recorder;		// NULL for no flight recorder
+	TELEMETRY_WRITER* telemetry;	// NULL for no telemetry segment
+	CONTROL_SERVER* control;		// NULL for no control socket
+	vector< control_command > _commands;
+	control_status _status;
+	uint64_t _steps = 0;
+	flight_record _flight = flight_record();
+	chrono::steady_clock::time_point _step_start;
+	chrono::steady_clock::time_point _stage_start;
+	METRIC_GAUGE* m_u;				// metrics, see metrics.h
+	METRIC_GAUGE* m_r;
+	METRIC_GAUGE* m_y;
+	METRIC_GAUGE* m_integral;
+	METRIC_GAUGE* m_nowcast;
+	METRIC_GAUGE* m_forecast_age;
+	METRIC_GAUGE* m_actuators[3];
+	METRIC_COUNTER* m_steps;
+	METRIC_HISTOGRAM* m_stages[FLIGHT_STAGES];
 
 	
 	mutex u_mutex;
@@ -798,4 +1130,7 @@ private:
 
 	bool stoneFAN = false;
 	bool mainFAN = false;
+	bool fanHIGH = false;
+	int stone_override = CONTROL_AUTO;	// set from the control socket
+	int main_override = CONTROL_AUTO;
 };
\ No newline at end of file
@@ -0,0 +1,580 @@
+#pragma once
+
+/*
+* progfetch.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:13
+* Modified:		19/10-2026 05:58
+* Version:		1.5
+*
+* Description:
+*	This header includes the thread that retrieves the weather prognoses in the background and publishes them as
+*	immutable snapshots, so that the controller never has to wait for the network.
+*	All configured datasets are downloaded at the same time and fused into one ensemble prognosis.
+*	Downloads are conditional (ETag/Last-Modified) and are skipped entirely until yr.no's 'nextupdate' or the
+*	'Expires' time has passed, so most refreshes cost no traffic and no reload.
+*	Every new ensemble prognosis is also appended to the forecast archive, see parchive.h.
+*
+* NOTE:
+*	The download itself is still done by DataDown.py, but it is run with a hard time limit and only saves the
+*	document, which is then parsed in-process by YR_PARSER and written to the prognosis store.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <fstream>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "mythread.h"
+#include "panalysis.h"
+#include "debug_logger.h"
+#include "yrparse.h"
+#include "parchive.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define PROG_FETCH_INTERVAL		1800	// seconds between prognosis downloads
+#define PROG_FETCH_TIMEOUT		60		// seconds a download may take before it is killed
+#define PROG_FETCH_RETRY		120		// seconds to wait before retrying a failed download
+#define PROG_ENSEMBLE_PATH		"./data/ensemble/"
+#define PROG_FRESH_MAX			21600	// seconds a downloaded prognosis is trusted at most without asking again
+
+// result of one download
+#define PROG_DL_OK				0
+#define PROG_DL_FAILED			1
+#define PROG_DL_TIMEOUT			2
+#define PROG_DL_NOT_MODIFIED	3		// DataDown.py exit code when the server answered 304
+#define PROG_DL_SKIPPED			4		// no request made, the last download is still fresh
+
+// one complete prognosis as seen by the controller, never changed once published
+struct prognosis_snapshot
+{
+	vector< prognosis_data_structure > data;
+	shared_ptr<const PROGMAP> store;		// the mapped ensemble store, data is made from this
+	PROG_SERIES series;					// the ensemble temperature as a time series
+	time_t fetched = 0;					// when the download finished
+	time_t nextupdate = 0;				// when yr.no expects to publish the next forecast
+	unsigned long version = 0;			// increases by one for every published snapshot
+};
+
+// statistics of the fetcher
+struct progfetch_stats
+{
+	unsigned long fetches = 0;			// downloads started, one per dataset
+	unsigned long failures = 0;			// downloads that returned an error
+	unsigned long timeouts = 0;			// downloads that had to be killed
+	unsigned long not_modified = 0;		// downloads answered with 304
+	unsigned long skipped = 0;			// downloads not made because the prognosis was still fresh
+	unsigned long reloads = 0;			// new snapshots published
+	unsigned long reloads_skipped = 0;	// refreshes where nothing had changed
+	unsigned long long bytes = 0;		// document bytes transferred
+	double last_duration = 0;			// seconds the last refresh took, all datasets together
+	vector< double > source_duration;	// seconds the last download of each dataset took
+};
+
+// what the fetcher remembers about each dataset between refreshes
+struct prog_source_state
+{
+	yr_forecast fc;						// last parsed forecast
+	bool have = false;					// fc is valid
+	uint64_t hash = 0;					// hash of fc, to see if a new download changed anything
+	time_t expires = 0;					// 'Expires' header of the last answer
+	time_t fresh_until = 0;				// no request is made before this time
+};
+
+
+// ###############################################		FUNCTIONS	#################################################### //
+
+	/*! @brief Starts DataDown.py for one dataset without waiting for it, the document is saved to
+	*	file_path + file_name + ".xml"
+	*
+	*
+	*
+	* @param prognosis_downlaod_structure _pconf, int _timeout
+	*
+	* @returns pid_t of the download, -1 on error
+	*
+	*/
+pid_t progdownload_start(const prognosis_downlaod_structure& _pconf, int _timeout)
+{
+	string target = _pconf.file_path + _pconf.file_name + ".xml";
+	string timeout = to_string(_timeout);
+
+	pid_t pid = fork();
+	if(pid == -1)
+	{
+		perror("fork()");
+		return -1;
+	}
+	if(pid == 0)
+	{
+		// put the child in its own process group so it can be killed together with anything it starts
+		setpgid(0, 0);
+		// the signals blocked for the signalfd of the main loop would stay blocked in DataDown.py
+		sigset_t empty;
+		sigemptyset(&empty);
+		pthread_sigmask(SIG_SETMASK, &empty, NULL);
+		#if !DEBUGSTATE
+			// Suppress output
+			int devnull = open("/dev/null", O_WRONLY);
+			dup2(devnull, STDOUT_FILENO);
+			dup2(devnull, STDERR_FILENO);
+		#endif	// DEBUGSTATE
+		execlp("python3", "python3", "./DataDown.py", "-wl", _pconf.url.c_str(), "-dn", target.c_str(), "-to", timeout.c_str(), "-raw", "-cache", (char*)NULL);
+		_exit(127);
+	}
+	return pid;
+}
+
+	/*! @brief Waits for downloads started with progdownload_start(), anything still running after _timeout seconds is
+	*	killed. _result and _duration get one entry per pid, a pid of 0 means the download was skipped.
+	*
+	*
+	*
+	* @param const vector< pid_t >& _pids, int _timeout, vector< int >& _result, vector< double >& _duration
+	*
+	* @returns void
+	*
+	*/
+void progdownload_wait(const vector< pid_t >& _pids, int _timeout, vector< int >& _result, vector< double >& _duration)
+{
+	struct timespec start, now;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	_result.assign(_pids.size(), PROG_DL_TIMEOUT);
+	_duration.assign(_pids.size(), _timeout);
+	vector< bool > done(_pids.size(), false);
+	size_t remaining = _pids.size();
+
+	for(size_t i = 0; i < _pids.size(); i++)
+	{
+		if(_pids[i] <= 0)
+		{
+			_result[i] = _pids[i] ? PROG_DL_FAILED : PROG_DL_SKIPPED;
+			_duration[i] = 0;
+			done[i] = true;
+			remaining--;
+		}
+	}
+
+	// poll the children until they are done or the time is up
+	double elapsed = 0;
+	while(remaining && elapsed < _timeout)
+	{
+		for(size_t i = 0; i < _pids.size(); i++)
+		{
+			int status = 0;
+			if(!done[i] && waitpid(_pids[i], &status, WNOHANG) == _pids[i])
+			{
+				_result[i] = PROG_DL_FAILED;
+				if(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+				{
+					_result[i] = PROG_DL_OK;
+				}
+				else if(WIFEXITED(status) && WEXITSTATUS(status) == PROG_DL_NOT_MODIFIED)
+				{
+					_result[i] = PROG_DL_NOT_MODIFIED;
+				}
+				_duration[i] = elapsed;
+				done[i] = true;
+				remaining--;
+			}
+		}
+		if(remaining)
+		{
+			usleep(100000);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		elapsed = (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+	}
+
+	for(size_t i = 0; i < _pids.size(); i++)
+	{
+		if(!done[i])
+		{
+			int status;
+			kill(-_pids[i], SIGKILL);
+			while(waitpid(_pids[i], &status, 0) == -1 && errno == EINTR);
+		}
+	}
+}
+
+	/*! @brief Reads the expiry time and size of the last download from the cache file DataDown.py writes next to the
+	*	document
+	*
+	*
+	*
+	* @param const string& _fpath, time_t& _expires, unsigned long long& _bytes
+	*
+	* @returns bool
+	*
+	*/
+bool prog_cache_read(const string& _fpath, time_t& _expires, unsigned long long& _bytes)
+{
+	ifstream cache(_fpath);
+	string line;
+	_expires = 0;
+	_bytes = 0;
+	if(!cache.is_open())
+	{
+		return false;
+	}
+	while(getline(cache, line))
+	{
+		if(line.compare(0, 8, "expires=") == 0)
+		{
+			_expires = strtoll(line.c_str() + 8, NULL, 10);
+		}
+		else if(line.compare(0, 6, "bytes=") == 0)
+		{
+			_bytes = strtoull(line.c_str() + 6, NULL, 10);
+		}
+	}
+	return true;
+}
+
+	/*! @brief FNV-1a hash of a parsed forecast
+	*
+	*
+	*
+	* @param const yr_forecast&
+	*
+	* @returns uint64_t
+	*
+	*/
+uint64_t prog_hash(const yr_forecast& _fc)
+{
+	uint64_t h = 14695981039346656037ULL;
+	const unsigned char* c = (const unsigned char*)_fc.records.data();
+	size_t n = _fc.records.size() * sizeof(prognosis_record);
+	for(size_t i = 0; i < n; i++)
+	{
+		h = (h ^ c[i]) * 1099511628211ULL;
+	}
+	return (h ^ (uint64_t)_fc.lastupdate) * 1099511628211ULL;
+}
+
+
+// ###############################################		THREADS 	#################################################### //
+
+	/*! @brief	Thread that downloads the prognoses on its own timer and publishes them as a snapshot.
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	PROGFETCHER fetcher(tercon, _down_data, _prognosis_number);
+	*	fetcher.StartInternalThread();
+	*	shared_ptr<const prognosis_snapshot> snap = fetcher.get_snapshot();	// NULL until the first download is done
+	* @endcode
+	*
+	*/
+class PROGFETCHER : public MyThreadClass
+{
+public:
+	/*! @brief Constructor
+	*
+	*
+	*
+	* @param TERMINAL_CONTROLLER* _tc, vector< prognosis_downlaod_structure > _sources, int _items
+	*
+	* @returns void
+	*
+	*/
+	PROGFETCHER(TERMINAL_CONTROLLER* _tc, vector< prognosis_downlaod_structure > _sources, int _items, int _interval = PROG_FETCH_INTERVAL, int _timeout = PROG_FETCH_TIMEOUT) :
+		tercon(_tc),
+		sources(_sources),
+		items(_items),
+		interval(_interval),
+		timeout(_timeout)
+	{
+		ensemble.file_path = PROG_ENSEMBLE_PATH;
+		ensemble.file_name = "wdat";
+		p_loader.initiate(ensemble, items);
+
+		// remember what every dataset had last time, so a restart does not download what is still fresh
+		state.resize(sources.size());
+		for(size_t i = 0; i < sources.size(); i++)
+		{
+			string fpath = sources[i].file_path + sources[i].file_name;
+			shared_ptr<const PROGMAP> m = PROGMAP::open_file(fpath + ".bin");
+			if(m)
+			{
+				unsigned long long bytes;
+				state[i].fc.records.assign(m->records, m->records + m->count);
+				state[i].fc.lastupdate = m->header->lastupdate;
+				state[i].fc.nextupdate = m->header->nextupdate;
+				state[i].have = true;
+				state[i].hash = prog_hash(state[i].fc);
+				prog_cache_read(fpath + ".xml.cache", state[i].expires, bytes);
+				update_freshness(i, (time_t)m->header->written);
+			}
+		}
+
+		// start out with the store from the last run if there is one
+		if(p_loader.update())
+		{
+			publish(0);
+		}
+	}
+
+	/*! @brief returns the newest snapshot, never blocks on the download
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns shared_ptr<const prognosis_snapshot>, NULL if nothing has been downloaded yet
+	*
+	*/
+	shared_ptr<const prognosis_snapshot> get_snapshot(void)
+	{
+		return atomic_load(&snapshot);
+	}
+
+	/*! @brief downloads all datasets within a second, also those that are still fresh
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void refresh(void)
+	{
+		refresh_now.store(true);
+	}
+
+	/*! @brief returns the download statistics
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns progfetch_stats
+	*
+	*/
+	progfetch_stats get_stats(void)
+	{
+		lock_guard <mutex> stats_lock(stats_mutex);
+		return stats;
+	}
+
+protected:
+	/** Implement this method in your subclass with the code you want your thread to run. */
+	void InternalThreadEntry()
+	{
+		// the first download happens right away
+		time_t next_fetch = 0;
+		while(tercon->pos())
+		{
+			if(time(0) < next_fetch && !refresh_now.load())
+			{
+				sleep(1);
+				continue;
+			}
+			bool force = refresh_now.exchange(false);
+			next_fetch = time(0) + (fetch(force) ? interval : PROG_FETCH_RETRY);
+		}
+	}
+
+private:
+	/*! @brief downloads all datasets at once, fuses them and publishes the result if at least one succeeded
+	*
+	*
+	*
+	* @param bool _force, also the datasets that are still fresh
+	*
+	* @returns bool
+	*
+	*/
+	bool fetch(bool _force = false)
+	{
+		struct timespec start, end;
+		vector< pid_t > pids;
+		vector< int > result;
+		vector< double > duration;
+		time_t now = time(0);
+
+		// all downloads run at the same time, so a refresh takes as long as the slowest dataset
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for(size_t i = 0; i < sources.size(); i++)
+		{
+			pids.push_back((!_force && state[i].have && now < state[i].fresh_until) ? 0 : progdownload_start(sources[i], timeout));
+		}
+		progdownload_wait(pids, timeout, result, duration);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		// parse what was downloaded, every dataset also keeps its own store
+		bool changed = false;
+		unsigned long long bytes = 0;
+		for(size_t i = 0; i < sources.size(); i++)
+		{
+			string fpath = sources[i].file_path + sources[i].file_name;
+			if(result[i] == PROG_DL_OK || result[i] == PROG_DL_NOT_MODIFIED)
+			{
+				unsigned long long b;
+				prog_cache_read(fpath + ".xml.cache", state[i].expires, b);
+				bytes += b;
+			}
+
+			yr_forecast fc;
+			if(result[i] == PROG_DL_OK && YR_PARSER::parse_file(fpath + ".xml", fc))
+			{
+				// the server may send the same forecast again if it does not support validators
+				uint64_t h = prog_hash(fc);
+				if(!state[i].have || h != state[i].hash)
+				{
+					prog_store_write(fpath + ".bin", fc);
+					state[i].fc = fc;
+					state[i].hash = h;
+					state[i].have = true;
+					changed = true;
+				}
+				update_freshness(i, now);
+			}
+			else if(result[i] == PROG_DL_NOT_MODIFIED)
+			{
+				update_freshness(i, now);
+			}
+			else if(result[i] == PROG_DL_OK)
+			{
+				tercon->term_write("Downloaded prognosis could not be parsed: " + sources[i].url);
+			}
+			else if(result[i] != PROG_DL_SKIPPED)
+			{
+				tercon->term_write(string(result[i] == PROG_DL_TIMEOUT ? "Prognosis download timed out: " : "Prognosis download failed: ") + sources[i].url);
+			}
+		}
+
+		// nothing new, the current snapshot stays
+		bool reload = changed || !get_snapshot();
+
+		stats_mutex.lock();
+		for(size_t i = 0; i < result.size(); i++)
+		{
+			stats.fetches += (result[i] != PROG_DL_SKIPPED);
+			stats.timeouts += (result[i] == PROG_DL_TIMEOUT);
+			stats.failures += (result[i] == PROG_DL_FAILED);
+			stats.not_modified += (result[i] == PROG_DL_NOT_MODIFIED);
+			stats.skipped += (result[i] == PROG_DL_SKIPPED);
+		}
+		stats.bytes += bytes;
+		stats.last_duration = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+		stats.source_duration = duration;
+		stats.reloads_skipped += !reload;
+		stats_mutex.unlock();
+
+		if(!reload)
+		{
+			return true;
+		}
+
+		vector< yr_forecast > fcs;
+		vector< float > weights;
+		for(size_t i = 0; i < sources.size(); i++)
+		{
+			if(state[i].have)
+			{
+				fcs.push_back(state[i].fc);
+				weights.push_back(sources[i].weight);
+			}
+		}
+
+		yr_forecast fused;
+		prog_ensemble(fcs, weights, fused);
+		if((int)fused.records.size() < items)
+		{
+			tercon->term_write("No usable prognosis downloaded, keeping the previous prognosis.");
+			return false;
+		}
+
+		mkdir(ensemble.file_path.c_str(), 0755);
+		if(!prog_store_write(p_loader.store_path(), fused) || !p_loader.update())
+		{
+			return false;
+		}
+		publish(time(0));
+
+		// keep the forecast for the accuracy statistics, a failure here does not affect the controller
+		if(!archive.append(now, fused))
+		{
+			tercon->term_write("Could not append the prognosis to the forecast archive.");
+		}
+
+		stats_mutex.lock();
+		stats.reloads++;
+		stats_mutex.unlock();
+		return true;
+	}
+
+	/*! @brief works out until when dataset _i does not need to be downloaded again: the later of yr.no's
+	*	'nextupdate' and the 'Expires' header, but never more than PROG_FRESH_MAX after the last download
+	*
+	*
+	*
+	* @param size_t _i, time_t _downloaded
+	*
+	* @returns void
+	*
+	*/
+	void update_freshness(size_t _i, time_t _downloaded)
+	{
+		time_t fresh = max((time_t)state[_i].fc.nextupdate, state[_i].expires);
+		state[_i].fresh_until = min(fresh, _downloaded + PROG_FRESH_MAX);
+	}
+
+	/*! @brief publishes what p_loader has mapped as a new snapshot
+	*
+	*
+	*
+	* @param time_t _fetched
+	*
+	* @returns void
+	*
+	*/
+	void publish(time_t _fetched)
+	{
+		shared_ptr<prognosis_snapshot> snap(new prognosis_snapshot);
+		snap->store = p_loader.get_map();
+		snap->data = p_loader.get_data();
+		snap->series = PROG_SERIES(snap->store->records, snap->store->count);
+		snap->fetched = _fetched ? _fetched : (time_t)snap->store->header->written;
+		snap->nextupdate = snap->store->header->nextupdate;
+		snap->version = ++version;
+		atomic_store(&snapshot, shared_ptr<const prognosis_snapshot>(snap));
+	}
+
+	TERMINAL_CONTROLLER* tercon;
+	vector< prognosis_downlaod_structure > sources;
+	prognosis_downlaod_structure ensemble;
+	PROGLOAD p_loader;
+	PROG_ARCHIVE archive;
+	int items;
+	int interval;
+	int timeout;
+	unsigned long version = 0;
+	vector< prog_source_state > state;
+
+	shared_ptr<const prognosis_snapshot> snapshot;
+	atomic<bool> refresh_now{false};	// set by refresh()
+
+	progfetch_stats stats;
+	mutex stats_mutex;
+};
@@ -0,0 +1,493 @@
+#pragma once
+
+/*
+* pwm.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:11
+* Modified:		19/10-2026 06:12
+* Version:		1.3
+*
+* Description:
+*	This header includes the PWM outputs used by the motor drivers: a timer based software PWM, an output on the
+*	kernel PWM chip (/sys/class/pwm) and a mock output for running the code without hardware.
+*
+* NOTE:
+*	pwm_create() only makes the timer based PWM. The kernel PWM chip output has not been measured on the Pi yet, so
+*	it is only used when made by hand, and requires 'dtoverlay=pwm-2chan' in /boot/config.txt on the Raspberry Pi 3.
+*	The interface is called PWM_DRIVER, as wiringPi.h defines PWM_OUTPUT as a pin mode.
+*	Compile with -DPWM_MOCK=1 to replace every output with the mock.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <mutex>
+#include <condition_variable>
+#include <wiringPi.h>
+
+#include "mythread.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#ifndef PWM_MOCK
+#define PWM_MOCK		0		// Set to 1 to use the mock output for all PWM pins
+#endif
+
+#define PWM_SYSFS_PATH	"/sys/class/pwm/pwmchip"
+#define PWM_PERIOD_US	10000	// default PWM period, 100 Hz is well within what the fans can follow
+#define PWM_MOCK_HISTORY	1000	// duty cycles kept by MOCK_PWM, the oldest are dropped
+
+// statistics used for comparing the backends
+struct pwm_stats
+{
+	float duty_set = 0;				// last duty cycle requested [%]
+	float duty_measured = 0;		// duty cycle actually achieved [%]
+	double cpu_seconds = 0;			// CPU time spent generating the signal
+	unsigned long periods = 0;		// number of periods generated (software backends only)
+	unsigned long writes = 0;		// number of duty cycle changes
+};
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Interface for a single PWM output
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	PWM_DRIVER* fan = pwm_create(26);
+	*	fan->set_duty(40);
+	* @endcode
+	*
+	*/
+class PWM_DRIVER
+{
+public:
+	virtual ~PWM_DRIVER() {/* empty */}
+
+	/*! @brief sets the duty cycle in percent, values outside 0-100 are clamped
+	*
+	* @param float
+	*
+	* @returns void
+	*
+	*/
+	virtual void set_duty(float _duty) = 0;
+
+	/*! @brief returns the statistics of the output
+	*
+	* @param void
+	*
+	* @returns pwm_stats
+	*
+	*/
+	virtual pwm_stats get_stats(void) = 0;
+
+protected:
+	static float clamp_duty(float _duty)
+	{
+		if(_duty < 0) return 0;
+		if(_duty > 100) return 100;
+		return _duty;
+	}
+};
+
+
+	/*! @brief	PWM output using the kernel PWM chip, the signal is generated in hardware so no CPU is used. Not
+	*	measured on the Pi yet, so pwm_create() does not make it, see pwm_hw_channel() for the pins it can drive.
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	SYSFS_PWM pwm(0, 1);	// pwmchip0, channel 1
+	*	pwm.set_duty(25);
+	* @endcode
+	*
+	*/
+class SYSFS_PWM : public PWM_DRIVER
+{
+public:
+	/*! @brief Constructor, exports and enables the channel
+	*
+	* @param int _chip, int _channel, unsigned long _period_us
+	*
+	* @returns void
+	*
+	*/
+	SYSFS_PWM(int _chip, int _channel, unsigned long _period_us = PWM_PERIOD_US) : period_ns(_period_us*1000), duty_fd(-1), ok(false)
+	{
+		string chip = PWM_SYSFS_PATH + to_string(_chip) + "/";
+		path = chip + "pwm" + to_string(_channel) + "/";
+
+		// export the channel if it is not already exported
+		if(!exists(path))
+		{
+			write_file(chip + "export", to_string(_channel));
+			// udev needs a moment to fix the permissions of the new directory
+			for(int i = 0; i < 100 && access((path + "enable").c_str(), W_OK); i++)
+			{
+				usleep(10000);
+			}
+		}
+
+		// duty cycle must never be larger than the period, so clear it before changing the period
+		write_file(path + "duty_cycle", "0");
+		ok = write_file(path + "period", to_string(period_ns)) && write_file(path + "enable", "1");
+
+		duty_fd = open((path + "duty_cycle").c_str(), O_WRONLY | O_CLOEXEC);
+		if(!ok || duty_fd == -1)
+		{
+			perror(("Unable to set up " + path).c_str());
+			ok = false;
+		}
+	}
+
+	~SYSFS_PWM()
+	{
+		set_duty(0);
+		write_file(path + "enable", "0");
+		if(duty_fd != -1)
+		{
+			close(duty_fd);
+		}
+	}
+
+	void set_duty(float _duty)
+	{
+		lock_guard <mutex> pwm_lock(pwm_mutex);
+		stats.duty_set = clamp_duty(_duty);
+		stats.writes++;
+		if(!ok)
+		{
+			return;
+		}
+
+		string val = to_string((unsigned long)(period_ns * (stats.duty_set / 100.0)));
+		if(pwrite(duty_fd, val.c_str(), val.size(), 0) == -1)
+		{
+			perror("pwm duty_cycle");
+		}
+	}
+
+	pwm_stats get_stats(void)
+	{
+		lock_guard <mutex> pwm_lock(pwm_mutex);
+
+		// read back what the hardware was actually programmed with
+		unsigned long duty_ns = 0;
+		if(ok && read_file(path + "duty_cycle", duty_ns))
+		{
+			stats.duty_measured = 100.0 * duty_ns / period_ns;
+		}
+		return stats;
+	}
+
+	/*! @brief returns true if the channel was set up correctly
+	*
+	* @param void
+	*
+	* @returns bool
+	*
+	*/
+	bool is_ok(void)
+	{
+		return ok;
+	}
+
+private:
+	static bool exists(const string& _s)
+	{
+		struct stat buffer;
+		return (stat(_s.c_str(), &buffer) == 0);
+	}
+
+	static bool write_file(const string& _fpath, const string& _val)
+	{
+		int fd = open(_fpath.c_str(), O_WRONLY);
+		if(fd == -1)
+		{
+			return false;
+		}
+		bool ret = (write(fd, _val.c_str(), _val.size()) == (ssize_t)_val.size());
+		close(fd);
+		return ret;
+	}
+
+	static bool read_file(const string& _fpath, unsigned long& _val)
+	{
+		char buf[32] = {0};
+		int fd = open(_fpath.c_str(), O_RDONLY);
+		if(fd == -1)
+		{
+			return false;
+		}
+		ssize_t n = read(fd, buf, sizeof(buf)-1);
+		close(fd);
+		if(n <= 0)
+		{
+			return false;
+		}
+		_val = strtoul(buf, NULL, 10);
+		return true;
+	}
+
+	string path;
+	unsigned long period_ns;
+	int duty_fd;
+	bool ok;
+	pwm_stats stats;
+	mutex pwm_mutex;
+};
+
+
+	/*! @brief	Software PWM driven by absolute timer deadlines.
+	*	Unlike softPwm the thread sleeps with clock_nanosleep(TIMER_ABSTIME) between edges instead of spinning, so the
+	*	edges do not drift and the thread is idle at 0% and 100% duty.
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	TIMER_PWM pwm(L298N_3_ENA);
+	*	pwm.set_duty(60);
+	* @endcode
+	*
+	*/
+class TIMER_PWM : public PWM_DRIVER, public MyThreadClass
+{
+public:
+	/*! @brief Constructor, starts the timer thread
+	*
+	* @param int _pin, unsigned long _period_us
+	*
+	* @returns void
+	*
+	*/
+	TIMER_PWM(int _pin, unsigned long _period_us = PWM_PERIOD_US) : pin(_pin), period_ns(_period_us*1000), running(true)
+	{
+		pinMode(pin, OUTPUT);
+		digitalWrite(pin, LOW);
+		StartInternalThread();
+	}
+
+	~TIMER_PWM()
+	{
+		pwm_mutex.lock();
+		running = false;
+		pwm_mutex.unlock();
+		pwm_cond.notify_all();
+		WaitForInternalThreadToExit();
+		digitalWrite(pin, LOW);
+	}
+
+	void set_duty(float _duty)
+	{
+		lock_guard <mutex> pwm_lock(pwm_mutex);
+		stats.duty_set = clamp_duty(_duty);
+		stats.writes++;
+		pwm_cond.notify_all();
+	}
+
+	pwm_stats get_stats(void)
+	{
+		lock_guard <mutex> pwm_lock(pwm_mutex);
+		pwm_stats ret = stats;
+		ret.duty_measured = total_ns ? (float)(100.0 * high_ns / total_ns) : ret.duty_set;
+		return ret;
+	}
+
+protected:
+	/** Implement this method in your subclass with the code you want your thread to run. */
+	void InternalThreadEntry()
+	{
+		struct timespec next;
+		clock_gettime(CLOCK_MONOTONIC, &next);
+
+		unique_lock<mutex> pwm_lock(pwm_mutex);
+		while(running)
+		{
+			float duty = stats.duty_set;
+
+			// fully on or fully off, no edges to generate so wait for a change instead
+			if(duty <= 0 || duty >= 100)
+			{
+				digitalWrite(pin, duty >= 100 ? HIGH : LOW);
+				account(duty >= 100 ? period_ns : 0, period_ns);
+				pwm_cond.wait(pwm_lock);
+				clock_gettime(CLOCK_MONOTONIC, &next);
+				continue;
+			}
+
+			// the duty cycle is latched for the whole period
+			unsigned long on_ns = (unsigned long)(period_ns * (duty / 100.0));
+			pwm_lock.unlock();
+
+			struct timespec rise;
+			digitalWrite(pin, HIGH);
+			clock_gettime(CLOCK_MONOTONIC, &rise);
+			add_ns(next, on_ns);
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+			struct timespec fall;
+			digitalWrite(pin, LOW);
+			clock_gettime(CLOCK_MONOTONIC, &fall);
+			add_ns(next, period_ns - on_ns);
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+			pwm_lock.lock();
+			account(diff_ns(rise, fall), period_ns);
+		}
+		digitalWrite(pin, LOW);
+	}
+
+private:
+	void account(unsigned long _high, unsigned long _total)
+	{
+		high_ns += _high;
+		total_ns += _total;
+		stats.periods++;
+
+		struct timespec cpu;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+		stats.cpu_seconds = cpu.tv_sec + cpu.tv_nsec / 1e9;
+	}
+
+	static void add_ns(struct timespec& _ts, unsigned long _ns)
+	{
+		_ts.tv_nsec += _ns;
+		while(_ts.tv_nsec >= 1000000000L)
+		{
+			_ts.tv_nsec -= 1000000000L;
+			_ts.tv_sec++;
+		}
+	}
+
+	static unsigned long diff_ns(const struct timespec& _a, const struct timespec& _b)
+	{
+		return (_b.tv_sec - _a.tv_sec) * 1000000000L + (_b.tv_nsec - _a.tv_nsec);
+	}
+
+	int pin;
+	unsigned long period_ns;
+	bool running;
+	unsigned long long high_ns = 0;
+	unsigned long long total_ns = 0;
+	pwm_stats stats;
+
+	mutex pwm_mutex;
+	condition_variable pwm_cond;
+};
+
+
+	/*! @brief	PWM output that only records what it is told, for running without hardware.
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	MOCK_PWM pwm;
+	*	pwm.set_duty(60);
+	*	pwm.history();	// {60}
+	* @endcode
+	*
+	*/
+class MOCK_PWM : public PWM_DRIVER
+{
+public:
+	MOCK_PWM(int _pin = -1) : pin(_pin)
+	{
+
+	}
+
+	void set_duty(float _duty)
+	{
+		lock_guard <mutex> pwm_lock(pwm_mutex);
+		stats.duty_set = clamp_duty(_duty);
+		stats.duty_measured = stats.duty_set;
+		stats.writes++;
+		if(duty_history.size() >= PWM_MOCK_HISTORY)
+		{
+			duty_history.erase(duty_history.begin());
+		}
+		duty_history.push_back(stats.duty_set);
+	}
+
+	pwm_stats get_stats(void)
+	{
+		lock_guard <mutex> pwm_lock(pwm_mutex);
+		return stats;
+	}
+
+	/*! @brief returns the last PWM_MOCK_HISTORY duty cycles that have been set, get_stats().writes counts them all
+	*
+	* @param void
+	*
+	* @returns vector< float >
+	*
+	*/
+	vector< float > history(void)
+	{
+		lock_guard <mutex> pwm_lock(pwm_mutex);
+		return duty_history;
+	}
+
+private:
+	int pin;
+	pwm_stats stats;
+	vector< float > duty_history;
+	mutex pwm_mutex;
+};
+
+
+// ###############################################		FUNCTIONS	#################################################### //
+
+	/*! @brief returns the kernel PWM channel of a wiringPi pin, or -1 if the pin cannot be driven by the PWM chip
+	*
+	* @param int _wpin
+	*
+	* @returns int
+	*
+	*/
+int pwm_hw_channel(int _wpin)
+{
+	switch(_wpin)
+	{
+		case 1:		// BCM18
+		case 26:	// BCM12
+			return 0;
+		case 23:	// BCM13
+		case 24:	// BCM19
+			return 1;
+	}
+	return -1;
+}
+
+	/*! @brief makes the PWM output for a wiringPi pin, the timer based one (or the mock with PWM_MOCK)
+	*
+	*
+	*
+	* @param int _wpin
+	*
+	* @returns PWM_DRIVER*
+	*
+	*/
+PWM_DRIVER* pwm_create(int _wpin)
+{
+	#if PWM_MOCK
+		return new MOCK_PWM(_wpin);
+	#else
+		return new TIMER_PWM(_wpin);
+	#endif	// PWM_MOCK
+}
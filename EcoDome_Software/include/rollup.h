@@ -0,0 +1,326 @@
+#pragma once
+
+/*
+* rollup.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:50
+* Modified:		19/10-2026 05:58
+* Version:		1.1
+*
+* Description:
+*	This header includes the rollups LOGGER keeps while logging: for every channel the count, minimum, mean, maximum
+*	and standard deviation (Welford) over 1 minute, 1 hour and 1 day windows, and for the bool channels the fraction
+*	of the time they were on. When a window is over its record is appended to the rollup log of its level, so
+*	reports over months read one record per hour or day instead of every 10 second record.
+*
+* NOTE:
+*	A rollup log is an ordinary binary log (see binlog.h) with the columns "<channel>.n", ".min", ".mean", ".max"
+*	and ".std", or ".n" and ".duty" for a bool channel, time stamped with the start of the window. logconv,
+*	logrange and LOG_READER read them like any other log.
+*	Windows are aligned to UTC. The windows that are not over yet are saved by close() and continued at the next
+*	start if they are still current.
+*	When the channels change, the rollup logs of the old channels are renamed to rollup_1m.1.ecl, rollup_1h.1.ecl
+*	and so on (see LOG_ASYNC_WRITER::move_aside()) and new ones are started, the history is never truncated.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "binlog.h"
+#include "logwriter.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define ROLLUP_DIR			LOG_DIR "rollup/"
+#define ROLLUP_STATE_NAME	"rollup.state"	// the windows that were not over at close()
+#define ROLLUP_SYNC_INTERVAL	600			// seconds between fdatasync(), rollups can be made again from the logs
+#define ROLLUP_MAGIC		0x4C4C4F52		// "ROLL"
+#define ROLLUP_LEVELS		3
+#define ROLLUP_FLOAT_STATS	5				// n, min, mean, max, std
+#define ROLLUP_BOOL_STATS	2				// n, duty
+
+// window lengths [s] and the names of their logs
+const int rollup_seconds[ROLLUP_LEVELS] = {60, 3600, 86400};
+const char* const rollup_names[ROLLUP_LEVELS] = {"rollup_1m", "rollup_1h", "rollup_1d"};
+
+// running statistics of one channel in one window
+struct rollup_acc
+{
+	uint32_t n;
+	float min;
+	float max;
+	double mean;
+	double m2;						// sum of squared deviations from the mean
+
+	void clear(void)
+	{
+		n = 0;
+		min = INFINITY;
+		max = -INFINITY;
+		mean = 0;
+		m2 = 0;
+	}
+
+	// Welford's update, numerically stable for long windows
+	void add(float _v)
+	{
+		n++;
+		double d = _v - mean;
+		mean += d / n;
+		m2 += d * (_v - mean);
+		min = _v < min ? _v : min;
+		max = _v > max ? _v : max;
+	}
+};
+
+// start of ROLLUP_STATE_NAME, followed by the accumulators of every level, [level][channel]
+struct rollup_state_header
+{
+	uint32_t magic;
+	uint32_t levels;
+	uint32_t channels;
+	uint32_t reserved;
+	int64_t window[ROLLUP_LEVELS];	// start of the current window of every level [unix time]
+};
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Rollups of the logged channels at 1 minute, 1 hour and 1 day
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	LOG_ROLLUP ru(channels);
+	*	ru.add(time(0), values, n);			// with every log record
+	*	ru.close();							// saves the windows that are not over yet
+	* @endcode
+	*
+	*/
+class LOG_ROLLUP
+{
+public:
+	/*! @brief Constructor, opens the rollup logs and loads the windows saved by close()
+	*
+	*
+	*
+	* @param const vector< log_channel >& _channels, int _sync_interval [s], const string& _dir
+	*
+	* @returns void
+	*
+	*/
+	LOG_ROLLUP(const vector< log_channel >& _channels, int _sync_interval = ROLLUP_SYNC_INTERVAL, const string& _dir = ROLLUP_DIR) : channels(_channels), dir(_dir)
+	{
+		if(mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST)
+		{
+			perror(("mkdir() " + dir).c_str());
+		}
+
+		// the columns of the rollup logs
+		vector< log_channel > cols;
+		for(size_t c = 0; c < channels.size(); c++)
+		{
+			const char* f[] = {".n", ".min", ".mean", ".max", ".std"};
+			const char* b[] = {".n", ".duty"};
+			bool is_bool = channels[c].type == LOG_BOOL;
+			for(int k = 0; k < (is_bool ? ROLLUP_BOOL_STATS : ROLLUP_FLOAT_STATS); k++)
+			{
+				cols.push_back(log_channel(channels[c].name + (is_bool ? b[k] : f[k])));
+			}
+		}
+		values.resize(cols.size());
+
+		for(int l = 0; l < ROLLUP_LEVELS; l++)
+		{
+			acc[l].resize(channels.size());
+			for(size_t c = 0; c < channels.size(); c++)
+			{
+				acc[l][c].clear();
+			}
+			window[l] = -1;
+			writer[l] = new LOG_ASYNC_WRITER(_sync_interval);
+			if(!writer[l]->open(dir + rollup_names[l] + LOG_EXTENSION, cols, rollup_seconds[l], true))
+			{
+				cout << "Could not open the rollup log " << rollup_names[l] << endl;
+			}
+		}
+		load();
+	}
+
+	~LOG_ROLLUP()
+	{
+		close();
+		for(int l = 0; l < ROLLUP_LEVELS; l++)
+		{
+			delete writer[l];
+		}
+	}
+
+	/*! @brief adds one record of the log, the windows that are over are written first
+	*
+	*
+	*
+	* @param time_t _now, const float* _values (in schema order), size_t _n
+	*
+	* @returns void
+	*
+	*/
+	void add(time_t _now, const float* _values, size_t _n)
+	{
+		for(int l = 0; l < ROLLUP_LEVELS; l++)
+		{
+			int64_t w = _now - _now % rollup_seconds[l];
+			if(w != window[l])
+			{
+				finish(l);
+				window[l] = w;
+			}
+			for(size_t c = 0; c < channels.size() && c < _n; c++)
+			{
+				if(!isnan(_values[c]))
+				{
+					acc[l][c].add(channels[c].type == LOG_BOOL ? (_values[c] != 0) : _values[c]);
+				}
+			}
+		}
+	}
+
+	/*! @brief saves the windows that are not over yet and closes the rollup logs
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void close(void)
+	{
+		if(closed)
+		{
+			return;
+		}
+		closed = true;
+		save();
+		for(int l = 0; l < ROLLUP_LEVELS; l++)
+		{
+			writer[l]->close();
+		}
+	}
+
+	// records written to the rollup log of a level
+	unsigned long get_written(int _level) const
+	{
+		return written[_level];
+	}
+
+private:
+	// writes the record of the window that is over, windows without values are left out
+	void finish(int _l)
+	{
+		bool any = false;
+		size_t k = 0;
+		for(size_t c = 0; c < channels.size(); c++)
+		{
+			const rollup_acc& a = acc[_l][c];
+			any = any || a.n;
+			values[k++] = a.n;
+			if(channels[c].type == LOG_BOOL)
+			{
+				values[k++] = a.n ? (float)a.mean : NAN;
+			}
+			else
+			{
+				values[k++] = a.n ? a.min : NAN;
+				values[k++] = a.n ? (float)a.mean : NAN;
+				values[k++] = a.n ? a.max : NAN;
+				values[k++] = a.n ? (float)sqrt(a.m2 / a.n) : NAN;
+			}
+			acc[_l][c].clear();
+		}
+		if(any && window[_l] >= 0)
+		{
+			writer[_l]->append(values.data(), values.size(), window[_l] * 1000000);
+			written[_l]++;
+		}
+	}
+
+	void load(void)
+	{
+		FILE* f = fopen((dir + ROLLUP_STATE_NAME).c_str(), "rb");
+		if(!f)
+		{
+			return;
+		}
+		rollup_state_header h;
+		vector< rollup_acc > a(ROLLUP_LEVELS * channels.size());
+		if(fread(&h, sizeof(h), 1, f) == 1 && h.magic == ROLLUP_MAGIC && h.levels == ROLLUP_LEVELS && h.channels == channels.size()
+			&& fread(a.data(), sizeof(rollup_acc), a.size(), f) == a.size())
+		{
+			// a window that is over by now is written when the first record comes in
+			for(int l = 0; l < ROLLUP_LEVELS; l++)
+			{
+				window[l] = h.window[l];
+				for(size_t c = 0; c < channels.size(); c++)
+				{
+					acc[l][c] = a[l * channels.size() + c];
+				}
+			}
+		}
+		fclose(f);
+		unlink((dir + ROLLUP_STATE_NAME).c_str());
+	}
+
+	void save(void)
+	{
+		string path = dir + ROLLUP_STATE_NAME;
+		FILE* f = fopen((path + ".tmp").c_str(), "wb");
+		if(!f)
+		{
+			return;
+		}
+		rollup_state_header h;
+		memset(&h, 0, sizeof(h));
+		h.magic = ROLLUP_MAGIC;
+		h.levels = ROLLUP_LEVELS;
+		h.channels = channels.size();
+		for(int l = 0; l < ROLLUP_LEVELS; l++)
+		{
+			h.window[l] = window[l];
+		}
+		bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+		for(int l = 0; l < ROLLUP_LEVELS && ok; l++)
+		{
+			ok = acc[l].empty() || fwrite(acc[l].data(), sizeof(rollup_acc), acc[l].size(), f) == acc[l].size();
+		}
+		ok = (fclose(f) == 0) && ok;
+		if(!ok || rename((path + ".tmp").c_str(), path.c_str()) == -1)
+		{
+			perror("LOG_ROLLUP::save()");
+		}
+	}
+
+	vector< log_channel > channels;
+	string dir;
+	vector< rollup_acc > acc[ROLLUP_LEVELS];		// [level][channel]
+	int64_t window[ROLLUP_LEVELS];				// start of the current window, -1 before the first record
+	LOG_ASYNC_WRITER* writer[ROLLUP_LEVELS];
+	unsigned long written[ROLLUP_LEVELS] = {0};
+	vector< float > values;						// one record of a rollup log
+	bool closed = false;
+};
@@ -0,0 +1,389 @@
+#pragma once
+
+/*
+* slidewin.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:15
+* Modified:		19/10-2026 05:15
+* Version:		1.0
+*
+* Description:
+*	This header includes rolling statistics of the sensors over time windows, e.g. the maximum inside temperature of
+*	the last hour or the mean outside temperature of the last 24 hours, for rules that should not react to a single
+*	measurement. Count, sum, mean, minimum and maximum of a window cost O(1) per measurement (amortized): the sum is
+*	kept running and the minimum and maximum come from monotonic deques.
+*
+* NOTE:
+*	Long windows are kept in buckets of several time steps (SLIDE_MAX_BUCKETS at most), so a 7 day window is a few
+*	KB and not 60480 values, its start then moves one bucket at a time. Windows up to SLIDE_MAX_BUCKETS time steps
+*	are exact.
+*	All memory is allocated by the constructor, adding a measurement never allocates.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define SLIDE_MAX_BUCKETS		2048		// buckets of a window at most, longer windows get longer buckets
+
+// a window of a channel as given in the config
+struct slide_spec
+{
+	string channel;
+	int seconds = 3600;				// length of the window
+	int resolution = 0;				// length of a bucket [s], 0 to choose it from the length
+};
+
+// statistics of a window
+struct slide_stats
+{
+	unsigned long n = 0;
+	double sum = 0;
+	float mean = NAN;
+	float min = NAN;
+	float max = NAN;
+	int64_t first = 0;				// start of the oldest bucket in the window [unix time]
+};
+
+// the measurements of one bucket
+struct slide_bucket
+{
+	int64_t start = 0;				// [unix time]
+	uint32_t n = 0;
+	float min = INFINITY;
+	float max = -INFINITY;
+	double sum = 0;
+
+	void add(float _v)
+	{
+		n++;
+		sum += _v;
+		min = _v < min ? _v : min;
+		max = _v > max ? _v : max;
+	}
+};
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Count, sum, mean, minimum and maximum of one channel over a time window
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	SLIDING_WINDOW w(3600, 0, TIME_STEP);
+	*	w.add(time(0), tm.T_inside);
+	*	slide_stats s = w.stats();
+	* @endcode
+	*
+	*/
+class SLIDING_WINDOW
+{
+public:
+	/*! @brief Constructor, allocates everything the window will need
+	*
+	*
+	*
+	* @param int _seconds (length of the window), int _resolution (length of a bucket, 0 for automatic) [s],
+	*	int _time_step [s]
+	*
+	* @returns void
+	*
+	*/
+	SLIDING_WINDOW(int _seconds, int _resolution, int _time_step) : length(_seconds > 0 ? _seconds : 1)
+	{
+		int step = _time_step > 0 ? _time_step : 1;
+		res = _resolution;
+		if(res <= 0)
+		{
+			// the shortest bucket of whole time steps that keeps the window within SLIDE_MAX_BUCKETS
+			int per = (length + SLIDE_MAX_BUCKETS * step - 1) / (SLIDE_MAX_BUCKETS * step);
+			res = step * (per > 0 ? per : 1);
+		}
+		cap = length / res + 2;
+		ring.resize(cap);
+		minq.resize(cap);
+		maxq.resize(cap);
+	}
+
+	/*! @brief adds a measurement, NAN only moves the window on. _t must not go back in time.
+	*
+	*
+	*
+	* @param int64_t _t [unix time], float _v
+	*
+	* @returns void
+	*
+	*/
+	void add(int64_t _t, float _v)
+	{
+		if(isnan(_v))
+		{
+			expire(_t);
+			return;
+		}
+		int64_t start = _t - ((_t % res) + res) % res;
+		if(cur.n && start != cur.start)
+		{
+			push(cur);
+			cur = slide_bucket();
+		}
+		cur.start = start;
+		cur.add(_v);
+		expire(_t);
+	}
+
+	/*! @brief the statistics of the window, ending at the last measurement
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns slide_stats
+	*
+	*/
+	slide_stats stats(void) const
+	{
+		slide_stats s;
+		s.n = n + cur.n;
+		s.sum = sum + cur.sum;
+		if(!s.n)
+		{
+			return s;
+		}
+		s.mean = s.sum / s.n;
+		float lo = cur.n ? cur.min : INFINITY;
+		float hi = cur.n ? cur.max : -INFINITY;
+		if(qlen_min)
+		{
+			lo = min(lo, ring[minq[qhead_min] % cap].min);
+			hi = max(hi, ring[maxq[qhead_max] % cap].max);
+		}
+		s.min = lo;
+		s.max = hi;
+		s.first = size ? ring[first % cap].start : cur.start;
+		return s;
+	}
+
+	int get_seconds(void) const
+	{
+		return length;
+	}
+
+	int get_resolution(void) const
+	{
+		return res;
+	}
+
+	// buckets that had to be dropped before they left the window, measurements came faster than the time step
+	unsigned long get_overflows(void) const
+	{
+		return overflows;
+	}
+
+private:
+	// a finished bucket enters the window
+	void push(const slide_bucket& _b)
+	{
+		if(size == cap)
+		{
+			overflows++;
+			drop();
+		}
+		uint64_t seq = first + size;
+		ring[seq % cap] = _b;
+		size++;
+		n += _b.n;
+		sum += _b.sum;
+
+		// the deques keep the buckets that can still become the minimum or maximum, their values are monotonic
+		while(qlen_min && ring[minq[(qhead_min + qlen_min - 1) % cap] % cap].min >= _b.min)
+		{
+			qlen_min--;
+		}
+		minq[(qhead_min + qlen_min++) % cap] = seq;
+		while(qlen_max && ring[maxq[(qhead_max + qlen_max - 1) % cap] % cap].max <= _b.max)
+		{
+			qlen_max--;
+		}
+		maxq[(qhead_max + qlen_max++) % cap] = seq;
+
+		// the running sum is added to and taken from, it is summed again once per round of the ring
+		if(++pushed % cap == 0)
+		{
+			sum = 0;
+			for(size_t i = 0; i < size; i++)
+			{
+				sum += ring[(first + i) % cap].sum;
+			}
+		}
+	}
+
+	// the oldest bucket leaves the window
+	void drop(void)
+	{
+		const slide_bucket& b = ring[first % cap];
+		n -= b.n;
+		sum -= b.sum;
+		if(qlen_min && minq[qhead_min] == first)
+		{
+			qhead_min = (qhead_min + 1) % cap;
+			qlen_min--;
+		}
+		if(qlen_max && maxq[qhead_max] == first)
+		{
+			qhead_max = (qhead_max + 1) % cap;
+			qlen_max--;
+		}
+		first++;
+		size--;
+	}
+
+	void expire(int64_t _now)
+	{
+		while(size && ring[first % cap].start <= _now - length)
+		{
+			drop();
+		}
+	}
+
+	int length;						// [s]
+	int res;						// length of a bucket [s]
+	size_t cap;						// buckets in the ring
+	vector< slide_bucket > ring;	// finished buckets, by number % cap
+	vector< uint64_t > minq;		// numbers of the buckets with increasing minimum
+	vector< uint64_t > maxq;		// numbers of the buckets with decreasing maximum
+	size_t qhead_min = 0;
+	size_t qlen_min = 0;
+	size_t qhead_max = 0;
+	size_t qlen_max = 0;
+	uint64_t first = 0;				// number of the oldest bucket in the ring
+	size_t size = 0;
+	unsigned long n = 0;			// measurements in the ring
+	double sum = 0;
+	slide_bucket cur;				// the bucket that is being filled
+	uint64_t pushed = 0;
+	unsigned long overflows = 0;
+};
+
+
+	/*! @brief	The windows of all channels, fed with one measurement per channel at a time
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	SLIDE_SET sw(names, specs, TIME_STEP);
+	*	sw.add(time(0), values, n);			// in the order of names
+	*	slide_stats s;
+	*	if(sw.get("outside_2", 86400, s)) { ... s.mean ... }
+	* @endcode
+	*
+	*/
+class SLIDE_SET
+{
+public:
+	/*! @brief Constructor, windows of unknown channels are left out with a message
+	*
+	*
+	*
+	* @param const vector< string >& _names (the channels in the order they are added), const vector< slide_spec >& _specs,
+	*	int _time_step [s]
+	*
+	* @returns void
+	*
+	*/
+	SLIDE_SET(const vector< string >& _names, const vector< slide_spec >& _specs, int _time_step)
+	{
+		for(size_t i = 0; i < _specs.size(); i++)
+		{
+			int c = -1;
+			for(size_t k = 0; k < _names.size(); k++)
+			{
+				if(_names[k] == _specs[i].channel)
+				{
+					c = k;
+				}
+			}
+			if(c < 0)
+			{
+				cout << "No sensor channel " << _specs[i].channel << " for a rolling window" << endl;
+				continue;
+			}
+			channel.push_back(c);
+			name.push_back(_specs[i].channel);
+			windows.push_back(new SLIDING_WINDOW(_specs[i].seconds, _specs[i].resolution, _time_step));
+		}
+	}
+
+	~SLIDE_SET()
+	{
+		for(size_t i = 0; i < windows.size(); i++)
+		{
+			delete windows[i];
+		}
+	}
+
+	/*! @brief adds one measurement per channel to the windows of the channel
+	*
+	*
+	*
+	* @param int64_t _t [unix time], const float* _values, size_t _n
+	*
+	* @returns void
+	*
+	*/
+	void add(int64_t _t, const float* _values, size_t _n)
+	{
+		lock_guard <mutex> sw_lock(sw_mutex);
+		for(size_t i = 0; i < windows.size(); i++)
+		{
+			if((size_t)channel[i] < _n)
+			{
+				windows[i]->add(_t, _values[channel[i]]);
+			}
+		}
+	}
+
+	/*! @brief the statistics of the window of _channel with length _seconds
+	*
+	*
+	*
+	* @param const string& _channel, int _seconds, slide_stats& _s
+	*
+	* @returns bool, false if there is no such window
+	*
+	*/
+	bool get(const string& _channel, int _seconds, slide_stats& _s)
+	{
+		lock_guard <mutex> sw_lock(sw_mutex);
+		for(size_t i = 0; i < windows.size(); i++)
+		{
+			if(windows[i]->get_seconds() == _seconds && name[i] == _channel)
+			{
+				_s = windows[i]->stats();
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	vector< int > channel;			// channel of every window
+	vector< string > name;
+	vector< SLIDING_WINDOW* > windows;
+
+	mutex sw_mutex;
+};
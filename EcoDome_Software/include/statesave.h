@@ -0,0 +1,229 @@
+#pragma once
+
+/*
+* statesave.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 06:02
+* Modified:		19/10-2026 06:02
+* Version:		1.0
+*
+* Description:
+*	This header includes the thread that writes the small state files of the models (./data/pcorrect.bin,
+*	./data/nowcast.bin) in the background. The control thread only copies the state into a buffer and queues it, the
+*	file is written, flushed and renamed by the thread, so a slow card never holds up a control step.
+*
+* NOTE:
+*	Only the newest state of a file matters: a state queued for a file that is still waiting replaces the older one.
+*	What is queued when the program ends is written by stop(), which the destructor calls.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "mythread.h"
+
+using namespace std;
+
+
+// ###############################################		FUNCTIONS		#################################################### //
+
+/*! @brief writes _data to a temporary file and renames it to _fpath, so a power cut leaves either the old or the new
+*	file
+*
+*
+*
+* @param const string& _fpath, const vector< uint8_t >& _data
+*
+* @returns bool
+*
+*/
+inline bool state_write_file(const string& _fpath, const vector< uint8_t >& _data)
+{
+	string tmp = _fpath + ".tmp";
+	FILE* f = fopen(tmp.c_str(), "wbe");
+	if(!f)
+	{
+		perror(("fopen() " + tmp).c_str());
+		return false;
+	}
+	bool ok = fwrite(_data.data(), 1, _data.size(), f) == _data.size();
+	ok = (fflush(f) == 0) && ok;
+	fclose(f);
+	if(!ok || rename(tmp.c_str(), _fpath.c_str()) == -1)
+	{
+		perror(("saving " + _fpath).c_str());
+		unlink(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+// ###############################################		THREADS 	#################################################### //
+
+	/*! @brief	Writes state files in the background, see state_saver()
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	vector< uint8_t > buf(sizeof(st));
+	*	memcpy(buf.data(), &st, sizeof(st));
+	*	state_saver().save("./data/nowcast.bin", buf);	// returns at once
+	* @endcode
+	*
+	*/
+class STATE_SAVER : public MyThreadClass
+{
+public:
+	STATE_SAVER()
+	{
+
+	}
+
+	~STATE_SAVER()
+	{
+		stop();
+	}
+
+	/*! @brief queues _data to be written to _fpath, the thread is started the first time
+	*
+	*
+	*
+	* @param const string& _fpath, const vector< uint8_t >& _data
+	*
+	* @returns void
+	*
+	*/
+	void save(const string& _fpath, const vector< uint8_t >& _data)
+	{
+		unique_lock<mutex> ss_lock(ss_mutex);
+		for(size_t i = 0; i < queue.size(); i++)
+		{
+			if(queue[i].fpath == _fpath)
+			{
+				queue[i].data = _data;
+				replaced++;
+				return;
+			}
+		}
+		queue.push_back(job(_fpath, _data));
+		if(!started && !stopped)
+		{
+			running = true;
+			started = StartInternalThread();
+			if(!started)
+			{
+				perror("STATE_SAVER thread");
+			}
+		}
+		if(!started)
+		{
+			// no thread, the caller has to wait for the file after all
+			job j = queue.front();
+			queue.pop_front();
+			ss_lock.unlock();
+			state_write_file(j.fpath, j.data) ? written++ : failed++;
+			return;
+		}
+		ss_lock.unlock();
+		ss_cond.notify_all();
+	}
+
+	/*! @brief writes what is queued and stops the thread, later saves are written by save() itself
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void stop(void)
+	{
+		ss_mutex.lock();
+		bool was = started;
+		running = false;
+		started = false;
+		stopped = true;
+		ss_mutex.unlock();
+		ss_cond.notify_all();
+		if(was)
+		{
+			WaitForInternalThreadToExit();
+		}
+	}
+
+	// files written and files that could not be written
+	void get_counts(unsigned long& _written, unsigned long& _failed)
+	{
+		lock_guard <mutex> ss_lock(ss_mutex);
+		_written = written;
+		_failed = failed;
+	}
+
+protected:
+	/** Implement this method in your subclass with the code you want your thread to run. */
+	void InternalThreadEntry()
+	{
+		unique_lock<mutex> ss_lock(ss_mutex);
+		while(true)
+		{
+			while(running && queue.empty())
+			{
+				ss_cond.wait(ss_lock);
+			}
+			if(queue.empty())
+			{
+				break;
+			}
+			job j = queue.front();
+			queue.pop_front();
+			ss_lock.unlock();
+			bool ok = state_write_file(j.fpath, j.data);
+			ss_lock.lock();
+			ok ? written++ : failed++;
+		}
+	}
+
+private:
+	struct job
+	{
+		job(const string& _fpath, const vector< uint8_t >& _data) : fpath(_fpath), data(_data) {}
+		string fpath;
+		vector< uint8_t > data;
+	};
+
+	deque< job > queue;
+	bool running = false;
+	bool started = false;
+	bool stopped = false;
+	unsigned long written = 0;
+	unsigned long failed = 0;
+	unsigned long replaced = 0;		// states that were replaced by a newer one before they were written
+	mutex ss_mutex;
+	condition_variable ss_cond;
+};
+
+/*! @brief the state saver shared by the models, its thread writes what is left when the program ends
+*
+*
+*
+* @param void
+*
+* @returns STATE_SAVER&
+*
+*/
+inline STATE_SAVER& state_saver(void)
+{
+	static STATE_SAVER saver;
+	return saver;
+}
@@ -0,0 +1,380 @@
+#pragma once
+
+/*
+* telemetry.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:20
+* Modified:		19/10-2026 05:20
+* Version:		1.0
+*
+* Description:
+*	This header includes the telemetry segment: a POSIX shared memory segment (/dev/shm/ecodome) that the controller
+*	publishes every control step into, the newest step and a short ring of the steps before it, for local tools
+*	such as a dashboard or a data logger. TELEMETRY_READER maps it read only, after open() a read is a copy out of
+*	the mapping, no system call and no lock, so any number of readers can poll it as often as they like without the
+*	controller noticing.
+*
+* NOTE:
+*	A step is the flight_record of flightrec.h. The newest step is behind a seqlock: its number is odd while it is
+*	written, a reader copies it and tries again if the number was odd or changed meanwhile. The ring slots work
+*	like the slots of the flight recorder, see flight_write_slot() and flight_read_ring().
+*	The layout is plain structs of fixed size types, a C reader can map it with the same structs.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "flightrec.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define TELEMETRY_NAME			"/ecodome"	// shm_open() name, /dev/shm/ecodome
+#define TELEMETRY_MAGIC			"ECOTEL1"
+#define TELEMETRY_VERSION		1
+#define TELEMETRY_HEADER_SIZE	4096		// header and newest step, the ring starts on the second page
+#define TELEMETRY_TICKS			60			// steps in the ring
+#define TELEMETRY_RETRIES		1000		// tries of a read of the newest step before giving up
+
+// start of the segment
+struct telemetry_header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t slots;
+	uint32_t time_step;				// [s]
+	int64_t created;				// [unix time]
+	int32_t pid;					// of the writer
+	uint32_t running;				// 0 once the writer has closed the segment
+	uint64_t head;					// number of the newest step in the ring
+	uint8_t pad[64 - 48];
+	uint64_t seq;					// seqlock of the newest step, odd while it is written
+	uint8_t pad2[64 - 8];
+	flight_record current;			// the newest step
+};
+static_assert(sizeof(telemetry_header) <= TELEMETRY_HEADER_SIZE, "the header must fit its page");
+static_assert(offsetof(telemetry_header, current) % 64 == 0, "the newest step must start a cache line");
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Publishes the control steps to the telemetry segment
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	TELEMETRY_WRITER tw;
+	*	tw.open(TELEMETRY_NAME, TELEMETRY_TICKS, TIME_STEP);
+	*	tw.publish(rec);				// every step
+	*	tw.close();
+	* @endcode
+	*
+	*/
+class TELEMETRY_WRITER
+{
+public:
+	TELEMETRY_WRITER()
+	{
+
+	}
+
+	~TELEMETRY_WRITER()
+	{
+		close();
+	}
+
+	/*! @brief makes the segment, an old one of the same name is replaced
+	*
+	*
+	*
+	* @param const string& _name (shm_open() name, starts with /), int _ticks (steps in the ring), int _time_step [s]
+	*
+	* @returns bool
+	*
+	*/
+	bool open(const string& _name, int _ticks, int _time_step)
+	{
+		close();
+		uint32_t slots = _ticks < 2 ? 2 : _ticks;
+		size_t len = TELEMETRY_HEADER_SIZE + slots * sizeof(flight_record);
+
+		// readers of an old segment keep their mapping, they see running = 0 and open the new one
+		shm_unlink(_name.c_str());
+		int fd = shm_open(_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+		if(fd == -1)
+		{
+			perror(("shm_open() " + _name).c_str());
+			return false;
+		}
+		if(ftruncate(fd, len) == -1)
+		{
+			perror("TELEMETRY_WRITER::open()");
+			::close(fd);
+			shm_unlink(_name.c_str());
+			return false;
+		}
+		void* m = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if(m == MAP_FAILED)
+		{
+			perror("mmap()");
+			shm_unlink(_name.c_str());
+			return false;
+		}
+		base = (uint8_t*)m;
+		map_len = len;
+		name = _name;
+		hdr = (telemetry_header*)base;
+		ring = (flight_record*)(base + TELEMETRY_HEADER_SIZE);
+
+		// the segment is zero from ftruncate(), the magic is written last so a reader never sees half a header
+		hdr->version = TELEMETRY_VERSION;
+		hdr->record_size = sizeof(flight_record);
+		hdr->slots = slots;
+		hdr->time_step = _time_step;
+		hdr->created = time(0);
+		hdr->pid = getpid();
+		hdr->running = 1;
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		memcpy(hdr->magic, TELEMETRY_MAGIC, sizeof(hdr->magic));
+		seq = 0;
+		return true;
+	}
+
+	/*! @brief publishes one step, plain stores into the segment and no system call. The numbers of the step in
+	*	_rec are ignored.
+	*
+	*
+	*
+	* @param const flight_record& _rec
+	*
+	* @returns uint64_t, the number of the step, 0 if the segment is not open
+	*
+	*/
+	uint64_t publish(const flight_record& _rec)
+	{
+		if(!hdr)
+		{
+			return 0;
+		}
+		uint64_t s = seq + 1;
+
+		// the newest step behind the seqlock
+		__atomic_store_n(&hdr->seq, 2 * s - 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		memcpy(&hdr->current, &_rec, sizeof(_rec));
+		hdr->current.seq_begin = hdr->current.seq_end = s;
+		__atomic_store_n(&hdr->seq, 2 * s, __ATOMIC_RELEASE);
+
+		// and into the ring
+		flight_write_slot(ring + s % hdr->slots, s, _rec);
+		__atomic_store_n(&hdr->head, s, __ATOMIC_RELEASE);
+		seq = s;
+		return s;
+	}
+
+	/*! @brief marks the segment as closed and removes it, readers that have it mapped keep the last steps
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void close(void)
+	{
+		if(base)
+		{
+			__atomic_store_n(&hdr->running, 0, __ATOMIC_RELEASE);
+			munmap(base, map_len);
+			shm_unlink(name.c_str());
+		}
+		base = NULL;
+		hdr = NULL;
+		ring = NULL;
+		map_len = 0;
+	}
+
+private:
+	TELEMETRY_WRITER(const TELEMETRY_WRITER&);
+	TELEMETRY_WRITER& operator=(const TELEMETRY_WRITER&);
+
+	string name;
+	uint8_t* base = NULL;
+	size_t map_len = 0;
+	telemetry_header* hdr = NULL;
+	flight_record* ring = NULL;
+	uint64_t seq = 0;				// number of the newest step, only used by the publishing thread
+};
+
+
+	/*! @brief	Reads the telemetry segment, the reader library for tools
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	TELEMETRY_READER rd;
+	*	rd.open(TELEMETRY_NAME);
+	*	flight_record now;
+	*	if(rd.current(now)) { ... now.T_inside ... }
+	*	vector< flight_record > ticks;
+	*	rd.read(0, ticks);				// the ring, oldest first
+	* @endcode
+	*
+	*/
+class TELEMETRY_READER
+{
+public:
+	TELEMETRY_READER()
+	{
+
+	}
+
+	~TELEMETRY_READER()
+	{
+		close();
+	}
+
+	/*! @brief maps the segment read only and checks its header
+	*
+	*
+	*
+	* @param const string& _name
+	*
+	* @returns bool, false if there is no segment (the controller is not running) or it is not a telemetry segment
+	*
+	*/
+	bool open(const string& _name)
+	{
+		close();
+		int fd = shm_open(_name.c_str(), O_RDONLY, 0);
+		if(fd == -1)
+		{
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) == -1 || (size_t)st.st_size < TELEMETRY_HEADER_SIZE)
+		{
+			::close(fd);
+			return false;
+		}
+		void* m = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd);
+		if(m == MAP_FAILED)
+		{
+			perror("mmap()");
+			return false;
+		}
+		base = (const uint8_t*)m;
+		map_len = st.st_size;
+		hdr = (const telemetry_header*)base;
+		if(memcmp(hdr->magic, TELEMETRY_MAGIC, sizeof(hdr->magic)) != 0)
+		{
+			close();
+			return false;
+		}
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(hdr->version != TELEMETRY_VERSION || hdr->record_size != sizeof(flight_record)
+			|| TELEMETRY_HEADER_SIZE + (size_t)hdr->slots * sizeof(flight_record) > map_len)
+		{
+			cout << _name << " is not a telemetry segment of this version" << endl;
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close(void)
+	{
+		if(base)
+		{
+			munmap((void*)base, map_len);
+		}
+		base = NULL;
+		hdr = NULL;
+		map_len = 0;
+	}
+
+	/*! @brief copies the newest step
+	*
+	*
+	*
+	* @param flight_record& _out
+	*
+	* @returns bool, false if nothing has been published yet or the writer kept writing for TELEMETRY_RETRIES tries
+	*
+	*/
+	bool current(flight_record& _out) const
+	{
+		for(int i = 0; i < TELEMETRY_RETRIES; i++)
+		{
+			uint64_t s = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+			if(s & 1)
+			{
+				continue;
+			}
+			memcpy(&_out, &hdr->current, sizeof(_out));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if(__atomic_load_n(&hdr->seq, __ATOMIC_RELAXED) == s)
+			{
+				return s != 0;
+			}
+		}
+		return false;
+	}
+
+	/*! @brief copies the whole steps of the ring newer than _after, oldest first, see flight_read_ring()
+	*
+	*
+	*
+	* @param uint64_t _after, vector< flight_record >& _out
+	*
+	* @returns size_t, the number of torn slots that were left out
+	*
+	*/
+	size_t read(uint64_t _after, vector< flight_record >& _out) const
+	{
+		return flight_read_ring((const flight_record*)(base + TELEMETRY_HEADER_SIZE), hdr->slots, _after, _out);
+	}
+
+	const telemetry_header& header(void) const
+	{
+		return *hdr;
+	}
+
+	// number of the newest step
+	uint64_t head(void) const
+	{
+		return __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+	}
+
+	// false once the writer has closed the segment
+	bool running(void) const
+	{
+		return __atomic_load_n(&hdr->running, __ATOMIC_ACQUIRE) != 0;
+	}
+
+private:
+	const uint8_t* base = NULL;
+	size_t map_len = 0;
+	const telemetry_header* hdr = NULL;
+};
@@ -0,0 +1,509 @@
+#pragma once
+
+/*
+* termqueue.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:37
+* Modified:		19/10-2026 05:57
+* Version:		1.1
+*
+* Description:
+*	This header includes the output queue of the terminal: the threads put their messages in a lock-free queue and
+*	one thread writes them to stdout, so a slow terminal (an SSH session over a bad link, a serial console, a full
+*	pipe) only holds up that thread and never the sensors or the controller.
+*	The output thread limits the terminal to TERMQ_RATE lines a second and prints a message that comes again within
+*	TERMQ_COALESCE seconds only once, with a note of how often it came. What is left out is counted, in the notes
+*	and in the metrics as ecodome_terminal_messages_total{result="dropped|suppressed|coalesced"}.
+*
+* NOTE:
+*	push() never waits: it takes a slot with one compare and swap, and if all TERMQ_SLOTS slots are waiting for the
+*	terminal the message is dropped and counted. The output thread is only woken (eventfd) when it sleeps.
+*	A message is at most TERMQ_TEXT bytes, longer ones are cut.
+*	Without the output thread (before start() and after close()) push() prints the message itself, one thread at a
+*	time. close() waits for the pushes that still saw the thread and prints what they put in the queue, so no
+*	message is left behind.
+*
+*/
+
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include "mythread.h"
+#include "metrics.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define TERMQ_SLOTS				256			// messages waiting for the terminal at most, a power of two
+#define TERMQ_SLOT_SIZE			512			// bytes of a slot
+#define TERMQ_TEXT				(TERMQ_SLOT_SIZE - 16)
+#define TERMQ_RATE				20			// lines a second to the terminal
+#define TERMQ_BURST				50			// lines at once after a quiet time
+#define TERMQ_COALESCE			10			// [s] a message that comes again within this is counted, not printed
+
+// how a message is put on the terminal
+enum
+{
+	TERMQ_WRITE = 0,				// over the "> " prompt
+	TERMQ_CONTROL					// after the prompt, answers to commands
+};
+
+// a message waiting in the queue
+struct termq_slot
+{
+	atomic<uint64_t> seq;			// position + 1 once the message is in, position + TERMQ_SLOTS once it is taken
+	uint16_t len;
+	uint8_t kind;
+	uint8_t pad[5];
+	char text[TERMQ_TEXT];
+};
+static_assert(sizeof(termq_slot) == TERMQ_SLOT_SIZE, "a slot must be TERMQ_SLOT_SIZE bytes");
+static_assert((TERMQ_SLOTS & (TERMQ_SLOTS - 1)) == 0, "TERMQ_SLOTS must be a power of two");
+
+
+// ###############################################		THREADS 	#################################################### //
+
+	/*! @brief	Lock-free queue of terminal messages from any number of threads, and the thread that prints them
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	TERM_QUEUE tq(true);			// true: framed around the "> " prompt
+	*	tq.start();
+	*	tq.push("Prognosis download failed", TERMQ_WRITE);
+	*	tq.close();						// prints what is left
+	* @endcode
+	*
+	*/
+class TERM_QUEUE : public MyThreadClass
+{
+public:
+	/*! @brief Constructor, allocates the slots and registers the counters
+	*
+	*
+	*
+	* @param bool _interactive, false for plain lines without the prompt
+	*
+	* @returns void
+	*
+	*/
+	TERM_QUEUE(bool _interactive) : interactive(_interactive), running(false), sleeping(false), started(false), tail(0), pushing(0), pending_drops(0)
+	{
+		void* p = NULL;
+		if(posix_memalign(&p, 64, TERMQ_SLOTS * sizeof(termq_slot)) != 0)
+		{
+			perror("TERM_QUEUE");
+			exit(1);
+		}
+		memset(p, 0, TERMQ_SLOTS * sizeof(termq_slot));
+		slots = (termq_slot*)p;
+		for(uint64_t i = 0; i < TERMQ_SLOTS; i++)
+		{
+			slots[i].seq.store(i, memory_order_relaxed);
+		}
+		const char* help = "Terminal messages by what became of them";
+		m_printed = metrics().counter("ecodome_terminal_messages_total", help, "result=\"printed\"");
+		m_dropped = metrics().counter("ecodome_terminal_messages_total", help, "result=\"dropped\"");
+		m_suppressed = metrics().counter("ecodome_terminal_messages_total", help, "result=\"suppressed\"");
+		m_coalesced = metrics().counter("ecodome_terminal_messages_total", help, "result=\"coalesced\"");
+	}
+
+	~TERM_QUEUE()
+	{
+		close();
+		free(slots);
+	}
+
+	/*! @brief starts the output thread, until then and if it fails the messages are printed by push()
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns bool
+	*
+	*/
+	bool start(void)
+	{
+		wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(wake == -1)
+		{
+			perror("TERM_QUEUE eventfd");
+			return false;
+		}
+		running = true;
+		if(!StartInternalThread())
+		{
+			perror("TERM_QUEUE thread");
+			running = false;
+			::close(wake);
+			wake = -1;
+			return false;
+		}
+		started = true;
+		return true;
+	}
+
+	/*! @brief stops the output thread and prints what is in the queue, later messages are printed by push()
+	*
+	*
+	*
+	* @param void
+	*
+	* @returns void
+	*
+	*/
+	void close(void)
+	{
+		if(started)
+		{
+			running = false;
+			signal();
+			WaitForInternalThreadToExit();
+
+			// pushes from now on print themselves, the ones that still saw the thread are waited for and what
+			// they and the last pushes before the join put in the queue is printed here
+			started = false;
+			while(pushing.load() != 0)
+			{
+				this_thread::yield();
+			}
+			lock_guard <mutex> print_lock(print_mutex);
+			while(take())
+			{
+
+			}
+			notes(true);
+			cout.flush();
+			::close(wake);
+			wake = -1;
+		}
+	}
+
+	/*! @brief puts a message in the queue, never waits for the terminal
+	*
+	*
+	*
+	* @param const string& _str, int _kind (TERMQ_WRITE or TERMQ_CONTROL)
+	*
+	* @returns bool, false if the queue was full and the message was dropped
+	*
+	*/
+	bool push(const string& _str, int _kind)
+	{
+		// close() waits for the pushes that see the output thread, the seq_cst pair with the one in close()
+		pushing.fetch_add(1);
+		if(!started)
+		{
+			pushing.fetch_sub(1, memory_order_release);
+
+			// no output thread (yet or any more) or it failed to start, the threads take turns at the terminal
+			lock_guard <mutex> print_lock(print_mutex);
+			print(_str.data(), _str.size(), _kind);
+			m_printed->inc();
+			return true;
+		}
+
+		// take the slot at the tail, the slot is free when its seq is the position
+		termq_slot* s;
+		uint64_t pos = tail.load(memory_order_relaxed);
+		while(true)
+		{
+			s = &slots[pos & (TERMQ_SLOTS - 1)];
+			int64_t diff = (int64_t)(s->seq.load(memory_order_acquire) - pos);
+			if(diff == 0)
+			{
+				if(tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if(diff < 0)
+			{
+				// the slot still holds the message of a round ago, the terminal is behind
+				pending_drops.fetch_add(1, memory_order_relaxed);
+				m_dropped->inc();
+				pushing.fetch_sub(1, memory_order_release);
+				return false;
+			}
+			else
+			{
+				pos = tail.load(memory_order_relaxed);
+			}
+		}
+
+		size_t len = _str.size();
+		if(len > TERMQ_TEXT)
+		{
+			len = TERMQ_TEXT;
+			memcpy(s->text, _str.data(), len - 3);
+			memcpy(s->text + len - 3, "...", 3);
+		}
+		else
+		{
+			memcpy(s->text, _str.data(), len);
+		}
+		s->len = len;
+		s->kind = _kind;
+		s->seq.store(pos + 1, memory_order_release);
+
+		// wake the output thread if it sleeps, the fences pair with the ones in InternalThreadEntry()
+		atomic_thread_fence(memory_order_seq_cst);
+		if(sleeping.load(memory_order_relaxed) && sleeping.exchange(false))
+		{
+			signal();
+		}
+		pushing.fetch_sub(1, memory_order_release);
+		return true;
+	}
+
+	uint64_t get_printed(void) const
+	{
+		return m_printed->value();
+	}
+
+	// messages dropped because the queue was full
+	uint64_t get_dropped(void) const
+	{
+		return m_dropped->value();
+	}
+
+	// messages left out by the rate limit
+	uint64_t get_suppressed(void) const
+	{
+		return m_suppressed->value();
+	}
+
+	// repeated messages that were counted instead of printed
+	uint64_t get_coalesced(void) const
+	{
+		return m_coalesced->value();
+	}
+
+protected:
+	/** Implement this method in your subclass with the code you want your thread to run. */
+	void InternalThreadEntry()
+	{
+		tokens = TERMQ_BURST;
+		refilled = chrono::steady_clock::now();
+		while(true)
+		{
+			bool stopping = !running;
+			while(take())
+			{
+
+			}
+			notes(stopping);
+			if(stopping)
+			{
+				cout.flush();
+				return;
+			}
+			cout.flush();
+
+			// sleep until push() or close() wakes us, or a note of repeats or left out messages is due
+			sleeping.store(true);
+			atomic_thread_fence(memory_order_seq_cst);
+			if(ready() || !running)
+			{
+				sleeping.store(false);
+				continue;
+			}
+			struct pollfd p = {wake, POLLIN, 0};
+			poll(&p, 1, (repeats || suppressed) ? 1000 : -1);
+			sleeping.store(false);
+			uint64_t v;
+			if(read(wake, &v, sizeof(v)) == -1 && errno != EAGAIN)
+			{
+				perror("TERM_QUEUE eventfd");
+			}
+		}
+	}
+
+private:
+	TERM_QUEUE(const TERM_QUEUE&);
+	TERM_QUEUE& operator=(const TERM_QUEUE&);
+
+	void signal(void)
+	{
+		uint64_t one = 1;
+		if(wake != -1 && write(wake, &one, sizeof(one)) == -1 && errno != EAGAIN)
+		{
+			perror("TERM_QUEUE eventfd");
+		}
+	}
+
+	// whether the message at the head is in
+	bool ready(void) const
+	{
+		return slots[head & (TERMQ_SLOTS - 1)].seq.load(memory_order_acquire) == head + 1;
+	}
+
+	// takes the message at the head, coalesces and rate limits it and prints it, false if there is none
+	bool take(void)
+	{
+		if(!ready())
+		{
+			return false;
+		}
+		termq_slot& s = slots[head & (TERMQ_SLOTS - 1)];
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+		if(s.kind == last_kind && s.len == last.size() && memcmp(s.text, last.data(), s.len) == 0
+			&& now - last_time < chrono::seconds(TERMQ_COALESCE))
+		{
+			repeats++;
+			m_coalesced->inc();
+		}
+		else
+		{
+			note_repeats();
+			refill(now);
+			if(tokens < 1)
+			{
+				suppressed++;
+				m_suppressed->inc();
+			}
+			else
+			{
+				tokens -= 1;
+				note_suppressed();
+				print(s.text, s.len, s.kind);
+				m_printed->inc();
+				last.assign(s.text, s.len);
+				last_kind = s.kind;
+				last_time = now;
+			}
+		}
+
+		// the slot is free for the next round
+		s.seq.store(head + TERMQ_SLOTS, memory_order_release);
+		head++;
+		return true;
+	}
+
+	// the notes of what was left out, repeats once TERMQ_COALESCE is over or when stopping
+	void notes(bool _stopping)
+	{
+		if(repeats && (_stopping || chrono::steady_clock::now() - last_time >= chrono::seconds(TERMQ_COALESCE)))
+		{
+			note_repeats();
+			last.clear();
+		}
+		refill(chrono::steady_clock::now());
+		if(suppressed && (_stopping || tokens >= 1))
+		{
+			note_suppressed();
+		}
+		unsigned long d = pending_drops.exchange(0, memory_order_relaxed);
+		if(d)
+		{
+			note("(" + to_string(d) + " messages dropped, the terminal was too slow)");
+		}
+	}
+
+	// the token bucket of the rate limit
+	void refill(chrono::steady_clock::time_point _now)
+	{
+		tokens += chrono::duration< double >(_now - refilled).count() * TERMQ_RATE;
+		tokens = tokens > TERMQ_BURST ? TERMQ_BURST : tokens;
+		refilled = _now;
+	}
+
+	void note_repeats(void)
+	{
+		if(repeats)
+		{
+			note("(last message repeated " + to_string(repeats) + " times)");
+			repeats = 0;
+		}
+	}
+
+	void note_suppressed(void)
+	{
+		if(suppressed)
+		{
+			note("(" + to_string(suppressed) + " messages suppressed, more than " + to_string(TERMQ_RATE) + " a second)");
+			suppressed = 0;
+		}
+	}
+
+	void note(const string& _str)
+	{
+		print(_str.data(), _str.size(), TERMQ_WRITE);
+	}
+
+	void print(const char* _text, size_t _len, int _kind)
+	{
+		if(!interactive)
+		{
+			if(_kind == TERMQ_CONTROL)
+			{
+				cout << endl;
+			}
+			cout.write(_text, _len);
+			cout << '\n';
+		}
+		else if(_kind == TERMQ_CONTROL)
+		{
+			cout << endl;
+			cout.write(_text, _len);
+			cout << endl << "> ";
+		}
+		else
+		{
+			cout << '\b' << '\b';
+			cout.write(_text, _len);
+			cout << "\n> ";
+		}
+		if(!started)
+		{
+			cout.flush();
+		}
+	}
+
+	bool interactive;
+	termq_slot* slots;
+	int wake = -1;					// eventfd, wakes the output thread
+	atomic<bool> running;
+	atomic<bool> sleeping;			// the output thread waits for the eventfd
+	atomic<bool> started;
+
+	uint8_t pad[64];
+	atomic<uint64_t> tail;			// next position to put a message, shared by the producers
+	atomic<unsigned long> pushing;	// pushes that saw the output thread and are not done yet
+	atomic<unsigned long> pending_drops;	// dropped since the last note
+	uint8_t pad2[64];
+
+	// only used by the output thread
+	uint64_t head = 0;				// next position to print
+	double tokens = 0;				// lines that may be printed now
+	chrono::steady_clock::time_point refilled;
+	string last;					// the last printed message, for coalescing
+	int last_kind = -1;
+	chrono::steady_clock::time_point last_time;
+	unsigned long repeats = 0;		// of last, not printed yet
+	unsigned long suppressed = 0;	// by the rate limit, not noted yet
+
+	mutex print_mutex;				// the terminal without the output thread
+
+	METRIC_COUNTER* m_printed;
+	METRIC_COUNTER* m_dropped;
+	METRIC_COUNTER* m_suppressed;
+	METRIC_COUNTER* m_coalesced;
+};
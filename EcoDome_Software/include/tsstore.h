@@ -0,0 +1,486 @@
+#pragma once
+
+/*
+* tsstore.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:13
+* Modified:		19/10-2026 05:13
+* Version:		1.0
+*
+* Description:
+*	This header includes an in-memory history of the logged channels for queries on the Pi itself, e.g. trends and
+*	daily statistics. Every channel is kept in chunks of TS_CHUNK_SECONDS that are compressed with the encoders of
+*	gorilla.h while they are filled: delta-of-delta time stamps and XOR floats, about 1 byte per value for the
+*	temperatures, so weeks of all channels fit in a few MB. Chunks older than the retention are dropped.
+*
+* NOTE:
+*	A finished chunk is never changed, iterators share it with the store, so a query does not hold the lock while
+*	it decodes. The chunk that is being filled is copied for the query (at most a few KB).
+*	Every chunk also keeps the count, sum, minimum and maximum of its values, so statistics over whole chunks do
+*	not decode them.
+*
+*/
+
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "gorilla.h"
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define TS_CHUNK_SECONDS		7200		// time covered by one chunk, 720 values at a 10 second time step
+#define TS_RETENTION_DAYS		14			// how far back the history goes
+
+// one value of a channel
+struct ts_point
+{
+	int64_t t;						// [unix time]
+	float v;
+};
+
+// count, sum, minimum and maximum of the values of a chunk or a query
+struct ts_summary
+{
+	unsigned long n = 0;
+	double sum = 0;
+	float min = INFINITY;
+	float max = -INFINITY;
+
+	void add(float _v)
+	{
+		n++;
+		sum += _v;
+		min = _v < min ? _v : min;
+		max = _v > max ? _v : max;
+	}
+
+	void add(const ts_summary& _s)
+	{
+		n += _s.n;
+		sum += _s.sum;
+		min = _s.min < min ? _s.min : min;
+		max = _s.max > max ? _s.max : max;
+	}
+
+	float mean(void) const
+	{
+		return n ? sum / n : NAN;
+	}
+};
+
+// a compressed chunk of one channel, time stamp and value after each other in one bit stream
+struct ts_block
+{
+	int64_t first = 0;				// time of the first value [unix time]
+	int64_t last = 0;				// time of the last value [unix time]
+	ts_summary summary;
+	vector< uint8_t > bytes;
+};
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	The chunk of a channel that is being filled
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	TS_OPEN_CHUNK c;
+	*	c.put(t, v);
+	*	shared_ptr< const ts_block > b = c.copy();
+	* @endcode
+	*
+	*/
+class TS_OPEN_CHUNK
+{
+public:
+	TS_OPEN_CHUNK() : ts_enc(bw), val_enc(bw)
+	{
+
+	}
+
+	void put(int64_t _t, float _v)
+	{
+		if(block.summary.n == 0)
+		{
+			block.first = _t;
+		}
+		block.last = _t;
+		block.summary.add(_v);
+		ts_enc.put(_t);
+		val_enc.put(_v);
+	}
+
+	// the chunk as it is now, the bit stream is copied
+	shared_ptr< const ts_block > copy(void) const
+	{
+		shared_ptr< ts_block > b = make_shared< ts_block >(block);
+		b->bytes = bw.bytes();
+		return b;
+	}
+
+	const ts_block& get_block(void) const
+	{
+		return block;
+	}
+
+	size_t bytes(void) const
+	{
+		return bw.bytes().size();
+	}
+
+private:
+	BITWRITER bw;
+	DOD_ENCODER ts_enc;
+	XOR_ENCODER val_enc;
+	ts_block block;					// everything but the bytes
+};
+
+
+	/*! @brief	Walks through the values of one channel between two times, oldest first
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	TS_ITERATOR it = store.iterate(channel, from, to);
+	*	ts_point p;
+	*	while(it.next(p)) { ... }
+	* @endcode
+	*
+	*/
+class TS_ITERATOR
+{
+public:
+	TS_ITERATOR(const vector< shared_ptr< const ts_block > >& _blocks, int64_t _from, int64_t _to) : blocks(_blocks), from(_from), to(_to)
+	{
+
+	}
+
+	TS_ITERATOR(const TS_ITERATOR& _it) : blocks(_it.blocks), from(_it.from), to(_it.to)
+	{
+		// the decoders point into the block, a copy starts from the beginning
+	}
+
+	~TS_ITERATOR()
+	{
+		delete rd;
+	}
+
+	/*! @brief the next value
+	*
+	*
+	*
+	* @param ts_point& _p
+	*
+	* @returns bool, false when there are no more values
+	*
+	*/
+	bool next(ts_point& _p)
+	{
+		while(true)
+		{
+			if(rd && rd->left > 0)
+			{
+				rd->left--;
+				_p.t = rd->ts_dec.get();
+				_p.v = rd->val_dec.get();
+				if(_p.t > to)
+				{
+					rd->left = 0;
+					cur = blocks.size();
+					return false;
+				}
+				if(_p.t >= from)
+				{
+					return true;
+				}
+				continue;
+			}
+			if(cur >= blocks.size())
+			{
+				return false;
+			}
+			delete rd;
+			rd = new block_reader(*blocks[cur++]);
+		}
+	}
+
+	// number of chunks the query touches
+	size_t chunks(void) const
+	{
+		return blocks.size();
+	}
+
+private:
+	struct block_reader
+	{
+		block_reader(const ts_block& _b) : br(_b.bytes.data(), _b.bytes.size()), ts_dec(br), val_dec(br), left(_b.summary.n)
+		{
+
+		}
+
+		BITREADER br;
+		DOD_DECODER ts_dec;
+		XOR_DECODER val_dec;
+		unsigned long left;
+	};
+
+	TS_ITERATOR& operator=(const TS_ITERATOR&);
+
+	vector< shared_ptr< const ts_block > > blocks;
+	int64_t from;
+	int64_t to;
+	size_t cur = 0;
+	block_reader* rd = NULL;
+};
+
+
+	/*! @brief	In-memory history of a set of channels
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	vector< string > names;
+	*	names.push_back("in_soil__");
+	*	TS_STORE st(names, 14 * 86400);
+	*	float v[] = {21.5};
+	*	st.append(time(0), v, 1);
+	*	ts_summary s;
+	*	st.summary(0, time(0) - 86400, time(0), s);
+	* @endcode
+	*
+	*/
+class TS_STORE
+{
+public:
+	/*! @brief Constructor
+	*
+	*
+	*
+	* @param const vector< string >& _names, int64_t _retention [s], int64_t _chunk [s]
+	*
+	* @returns void
+	*
+	*/
+	TS_STORE(const vector< string >& _names, int64_t _retention = TS_RETENTION_DAYS * 86400, int64_t _chunk = TS_CHUNK_SECONDS) :
+		names(_names), retention(_retention), chunk(_chunk > 0 ? _chunk : TS_CHUNK_SECONDS), channels(_names.size())
+	{
+
+	}
+
+	~TS_STORE()
+	{
+		for(size_t c = 0; c < channels.size(); c++)
+		{
+			delete channels[c].open;
+		}
+	}
+
+	/*! @brief adds one value per channel, NAN values are left out. A chunk is finished when _t is in the next
+	*	TS_CHUNK_SECONDS window, and the chunks that are older than the retention are dropped.
+	*
+	*
+	*
+	* @param int64_t _t [unix time, increasing], const float* _values (in the order of the names), size_t _n
+	*
+	* @returns void
+	*
+	*/
+	void append(int64_t _t, const float* _values, size_t _n)
+	{
+		lock_guard <mutex> ts_lock(ts_mutex);
+		for(size_t c = 0; c < channels.size() && c < _n; c++)
+		{
+			if(isnan(_values[c]))
+			{
+				continue;
+			}
+			channel& ch = channels[c];
+			if(ch.open && (_t / chunk != ch.open->get_block().first / chunk || _t < ch.open->get_block().last))
+			{
+				finish(ch);
+			}
+			if(!ch.open)
+			{
+				ch.open = new TS_OPEN_CHUNK();
+			}
+			ch.open->put(_t, _values[c]);
+		}
+
+		// old chunks are dropped
+		for(size_t c = 0; c < channels.size(); c++)
+		{
+			deque< shared_ptr< const ts_block > >& d = channels[c].blocks;
+			while(!d.empty() && d.front()->last < _t - retention)
+			{
+				held -= d.front()->bytes.capacity();
+				d.pop_front();
+			}
+		}
+	}
+
+	/*! @brief the values of a channel between _from and _to (both included)
+	*
+	*
+	*
+	* @param int _channel, int64_t _from, int64_t _to [unix time]
+	*
+	* @returns TS_ITERATOR
+	*
+	*/
+	TS_ITERATOR iterate(int _channel, int64_t _from, int64_t _to)
+	{
+		vector< shared_ptr< const ts_block > > b;
+		lock_guard <mutex> ts_lock(ts_mutex);
+		if(_channel >= 0 && (size_t)_channel < channels.size())
+		{
+			const channel& ch = channels[_channel];
+			for(size_t i = 0; i < ch.blocks.size(); i++)
+			{
+				if(ch.blocks[i]->last >= _from && ch.blocks[i]->first <= _to)
+				{
+					b.push_back(ch.blocks[i]);
+				}
+			}
+			if(ch.open && ch.open->get_block().last >= _from && ch.open->get_block().first <= _to)
+			{
+				b.push_back(ch.open->copy());
+			}
+		}
+		return TS_ITERATOR(b, _from, _to);
+	}
+
+	/*! @brief count, sum, minimum and maximum of a channel between _from and _to (both included). Chunks that lie
+	*	completely inside are not decoded.
+	*
+	*
+	*
+	* @param int _channel, int64_t _from, int64_t _to [unix time], ts_summary& _s
+	*
+	* @returns void
+	*
+	*/
+	void summary(int _channel, int64_t _from, int64_t _to, ts_summary& _s)
+	{
+		_s = ts_summary();
+		vector< shared_ptr< const ts_block > > edge;
+		{
+			lock_guard <mutex> ts_lock(ts_mutex);
+			if(_channel < 0 || (size_t)_channel >= channels.size())
+			{
+				return;
+			}
+			const channel& ch = channels[_channel];
+			for(size_t i = 0; i < ch.blocks.size(); i++)
+			{
+				const ts_block& b = *ch.blocks[i];
+				if(b.first >= _from && b.last <= _to)
+				{
+					_s.add(b.summary);
+				}
+				else if(b.last >= _from && b.first <= _to)
+				{
+					edge.push_back(ch.blocks[i]);
+				}
+			}
+			if(ch.open && ch.open->get_block().summary.n)
+			{
+				const ts_block& b = ch.open->get_block();
+				if(b.first >= _from && b.last <= _to)
+				{
+					_s.add(b.summary);
+				}
+				else if(b.last >= _from && b.first <= _to)
+				{
+					edge.push_back(ch.open->copy());
+				}
+			}
+		}
+		TS_ITERATOR it(edge, _from, _to);
+		ts_point p;
+		while(it.next(p))
+		{
+			_s.add(p.v);
+		}
+	}
+
+	// the number of a channel, -1 if there is no such channel
+	int channel_index(const string& _name) const
+	{
+		for(size_t c = 0; c < names.size(); c++)
+		{
+			if(names[c] == _name)
+			{
+				return c;
+			}
+		}
+		return -1;
+	}
+
+	// bytes of compressed values held, finished chunks and the chunks being filled
+	size_t bytes(void)
+	{
+		lock_guard <mutex> ts_lock(ts_mutex);
+		size_t b = held;
+		for(size_t c = 0; c < channels.size(); c++)
+		{
+			b += channels[c].open ? channels[c].open->bytes() : 0;
+		}
+		return b;
+	}
+
+	// values held, all channels
+	unsigned long values(void)
+	{
+		lock_guard <mutex> ts_lock(ts_mutex);
+		unsigned long n = 0;
+		for(size_t c = 0; c < channels.size(); c++)
+		{
+			for(size_t i = 0; i < channels[c].blocks.size(); i++)
+			{
+				n += channels[c].blocks[i]->summary.n;
+			}
+			n += channels[c].open ? channels[c].open->get_block().summary.n : 0;
+		}
+		return n;
+	}
+
+private:
+	struct channel
+	{
+		deque< shared_ptr< const ts_block > > blocks;	// finished chunks, oldest first
+		TS_OPEN_CHUNK* open = NULL;
+	};
+
+	// turns the chunk that is being filled into a finished one
+	void finish(channel& _ch)
+	{
+		shared_ptr< const ts_block > b = _ch.open->copy();
+		held += b->bytes.capacity();
+		_ch.blocks.push_back(b);
+		delete _ch.open;
+		_ch.open = NULL;
+	}
+
+	vector< string > names;
+	int64_t retention;
+	int64_t chunk;
+	vector< channel > channels;
+	size_t held = 0;				// bytes of the finished chunks
+
+	mutex ts_mutex;
+};
@@ -0,0 +1,514 @@
+#pragma once
+
+/*
+* yrparse.h
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:14
+* Modified:		19/10-2026 06:13
+* Version:		1.1
+*
+* Description:
+*	This header includes a streaming parser for the forecast.xml documents from yr.no. The document is scanned once,
+*	in place, and every <time> element of the tabular forecast becomes one prognosis_record.
+*
+* NOTE:
+*	Nothing is copied out of the buffer while parsing, names and attribute values are handed to the handler as
+*	xml_span's pointing into the buffer.
+*
+*/
+
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+
+// ###############################################		DEFINES		#################################################### //
+
+#define XML_MAX_ATTRIBUTES	8		// attributes beyond this are skipped, yr.no uses at most 5
+
+// which fields of a prognosis_record were present in the document
+#define PREC_WIND_DIR		0x01
+#define PREC_WIND_SPEED		0x02
+#define PREC_TEMPERATURE	0x04
+#define PREC_PRESSURE		0x08
+#define PREC_PRECIPITATION	0x10
+#define PREC_ALL			0x1F
+
+// piece of the buffer, not null terminated
+struct xml_span
+{
+	const char* p = NULL;
+	size_t n = 0;
+
+	bool operator==(const char* _s) const
+	{
+		return strlen(_s) == n && memcmp(p, _s, n) == 0;
+	}
+};
+
+struct xml_attribute
+{
+	xml_span name;
+	xml_span value;
+};
+
+// one forecast step, fixed layout so it can be stored as is
+struct prognosis_record
+{
+	int64_t from = 0;				// start of validity [unix time]
+	int64_t to = 0;					// end of validity [unix time]
+	float wind_dir = NAN;			// [deg]
+	float wind_speed = NAN;			// [m/s]
+	float temperature = NAN;		// [celsius]
+	float air_pressure = NAN;		// [hPa]
+	float precipitation = NAN;		// [mm]
+	uint32_t fields = 0;			// PREC_* flags of the fields found in the document
+	float temperature_spread = 0;	// standard deviation of the temperature between datasets [celsius]
+	uint32_t members = 1;			// number of datasets the record was made from
+};
+
+// everything we use from one forecast.xml
+struct yr_forecast
+{
+	vector< prognosis_record > records;
+	int64_t lastupdate = 0;			// when yr.no made the forecast [unix time]
+	int64_t nextupdate = 0;			// when yr.no expects to publish the next one [unix time]
+	int utc_offset = 0;				// offset of the local times in the document [s]
+};
+
+
+// ###############################################		FUNCTIONS	#################################################### //
+
+	/*! @brief parses a decimal number from a span, returns NAN if it is not a number
+	*
+	*
+	*
+	* @param xml_span
+	*
+	* @returns float
+	*
+	*/
+float xml_to_float(xml_span _s)
+{
+	const char* c = _s.p;
+	const char* end = _s.p + _s.n;
+	bool neg = false;
+	float val = 0;
+	float scale = 1;
+	bool digits = false;
+
+	if(c < end && (*c == '-' || *c == '+'))
+	{
+		neg = (*c == '-');
+		c++;
+	}
+	for(; c < end && *c >= '0' && *c <= '9'; c++)
+	{
+		val = val*10 + (*c - '0');
+		digits = true;
+	}
+	if(c < end && (*c == '.' || *c == ','))
+	{
+		for(c++; c < end && *c >= '0' && *c <= '9'; c++)
+		{
+			scale /= 10;
+			val += (*c - '0') * scale;
+			digits = true;
+		}
+	}
+	if(!digits || c != end)
+	{
+		return NAN;
+	}
+	return neg ? -val : val;
+}
+
+	/*! @brief parses a span of the form 'YYYY-MM-DDThh:mm:ss' given in local time with the offset _utc_offset
+	*
+	*
+	*
+	* @param xml_span _s, int _utc_offset
+	*
+	* @returns int64_t unix time, or -1 if the timestamp is malformed
+	*
+	*/
+int64_t xml_to_time(xml_span _s, int _utc_offset)
+{
+	// fixed positions of the digits in 'YYYY-MM-DDThh:mm:ss'
+	static const int pos[6][2] = {{0, 4}, {5, 2}, {8, 2}, {11, 2}, {14, 2}, {17, 2}};
+	int val[6];
+
+	if(_s.n < 19)
+	{
+		return -1;
+	}
+	for(int i = 0; i < 6; i++)
+	{
+		val[i] = 0;
+		for(int k = 0; k < pos[i][1]; k++)
+		{
+			char c = _s.p[pos[i][0] + k];
+			if(c < '0' || c > '9')
+			{
+				return -1;
+			}
+			val[i] = val[i]*10 + (c - '0');
+		}
+	}
+
+	struct tm t;
+	memset(&t, 0, sizeof(t));
+	t.tm_year = val[0] - 1900;
+	t.tm_mon = val[1] - 1;
+	t.tm_mday = val[2];
+	t.tm_hour = val[3];
+	t.tm_min = val[4];
+	t.tm_sec = val[5];
+	return (int64_t)timegm(&t) - _utc_offset;
+}
+
+	/*! @brief SAX-style scanner, calls the handler for every element, end of element and piece of text.
+	*	Comments, processing instructions and DOCTYPE's are skipped.
+	*
+	*	The handler must implement:
+	*		void start_element(xml_span _name, const xml_attribute* _attr, int _nattr);
+	*		void end_element(xml_span _name);
+	*		void text(xml_span _text);
+	*
+	* @param const char* _buf, size_t _len, H& _handler
+	*
+	* @returns bool, false if the document ended in the middle of a tag
+	*
+	*/
+template<class H>
+bool xml_sax_parse(const char* _buf, size_t _len, H& _handler)
+{
+	const char* c = _buf;
+	const char* end = _buf + _len;
+	xml_attribute attr[XML_MAX_ATTRIBUTES];
+
+	while(c < end)
+	{
+		// text up to the next tag
+		const char* lt = (const char*)memchr(c, '<', end - c);
+		if(!lt)
+		{
+			lt = end;
+		}
+		if(lt > c)
+		{
+			xml_span t;
+			t.p = c;
+			t.n = lt - c;
+			_handler.text(t);
+		}
+		if(lt == end)
+		{
+			break;
+		}
+		c = lt + 1;
+		if(c >= end)
+		{
+			return false;
+		}
+
+		// comments, '<?...?>' and '<!...>'
+		if(*c == '!' || *c == '?')
+		{
+			const char* close;
+			if(end - c >= 3 && c[0] == '!' && c[1] == '-' && c[2] == '-')
+			{
+				close = (const char*)memmem(c + 3, end - c - 3, "-->", 3);
+				if(!close)
+				{
+					return false;
+				}
+				c = close + 3;
+			}
+			else
+			{
+				close = (const char*)memchr(c, '>', end - c);
+				if(!close)
+				{
+					return false;
+				}
+				c = close + 1;
+			}
+			continue;
+		}
+
+		// end of an element
+		bool closing = (*c == '/');
+		if(closing)
+		{
+			c++;
+		}
+
+		xml_span name;
+		name.p = c;
+		while(c < end && *c != '>' && *c != '/' && *c != ' ' && *c != '\t' && *c != '\n' && *c != '\r')
+		{
+			c++;
+		}
+		name.n = c - name.p;
+
+		// attributes
+		int nattr = 0;
+		bool empty = false;
+		while(c < end && *c != '>')
+		{
+			if(*c == '/')
+			{
+				empty = true;
+				c++;
+				continue;
+			}
+			if(*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r')
+			{
+				c++;
+				continue;
+			}
+
+			xml_attribute a;
+			a.name.p = c;
+			while(c < end && *c != '=' && *c != '>' && *c != '/' && *c != ' ')
+			{
+				c++;
+			}
+			a.name.n = c - a.name.p;
+			if(c >= end || c + 1 >= end)
+			{
+				return false;
+			}
+			if(*c != '=')
+			{
+				continue;
+			}
+			char quote = c[1];
+			if(quote != '"' && quote != '\'')
+			{
+				c++;
+				continue;
+			}
+			a.value.p = c + 2;
+			const char* q = (const char*)memchr(a.value.p, quote, end - a.value.p);
+			if(!q)
+			{
+				return false;
+			}
+			a.value.n = q - a.value.p;
+			c = q + 1;
+
+			if(nattr < XML_MAX_ATTRIBUTES)
+			{
+				attr[nattr++] = a;
+			}
+		}
+		if(c >= end)
+		{
+			return false;
+		}
+		c++;
+
+		if(closing)
+		{
+			_handler.end_element(name);
+		}
+		else
+		{
+			_handler.start_element(name, attr, nattr);
+			if(empty)
+			{
+				_handler.end_element(name);
+			}
+		}
+	}
+	return true;
+}
+
+
+// ###############################################		CLASSES		#################################################### //
+
+	/*! @brief	Handler for xml_sax_parse that turns a yr.no forecast.xml into a yr_forecast.
+	*	Every <time> element inside <tabular> is one record, so a missing tag only leaves that field empty.
+	*
+	*
+	*	@use
+	*
+	@code{.cpp}
+	*	yr_forecast fc;
+	*	YR_PARSER::parse_file("./data/dataset1/wdat.xml", fc);
+	* @endcode
+	*
+	*/
+class YR_PARSER
+{
+public:
+	YR_PARSER(yr_forecast& _out) : out(_out), in_tabular(false), in_time(false), text_target(NULL)
+	{
+		out.records.clear();
+	}
+
+	/*! @brief parses a complete document in memory
+	*
+	*
+	*
+	* @param const char* _buf, size_t _len, yr_forecast& _out
+	*
+	* @returns bool
+	*
+	*/
+	static bool parse(const char* _buf, size_t _len, yr_forecast& _out)
+	{
+		YR_PARSER handler(_out);
+		return xml_sax_parse(_buf, _len, handler) && !_out.records.empty();
+	}
+
+	/*! @brief maps a file and parses it
+	*
+	*
+	*
+	* @param const string& _fpath, yr_forecast& _out
+	*
+	* @returns bool
+	*
+	*/
+	static bool parse_file(const string& _fpath, yr_forecast& _out)
+	{
+		int fd = open(_fpath.c_str(), O_RDONLY);
+		if(fd == -1)
+		{
+			return false;
+		}
+		struct stat st;
+		if(fstat(fd, &st) == -1 || st.st_size == 0)
+		{
+			close(fd);
+			return false;
+		}
+		void* buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if(buf == MAP_FAILED)
+		{
+			return false;
+		}
+		bool ret = parse((const char*)buf, st.st_size, _out);
+		munmap(buf, st.st_size);
+		return ret;
+	}
+
+	void start_element(xml_span _name, const xml_attribute* _attr, int _nattr)
+	{
+		if(in_time)
+		{
+			if(_name == "windDirection")
+			{
+				set_field(rec.wind_dir, PREC_WIND_DIR, find(_attr, _nattr, "deg"));
+			}
+			else if(_name == "windSpeed")
+			{
+				set_field(rec.wind_speed, PREC_WIND_SPEED, find(_attr, _nattr, "mps"));
+			}
+			else if(_name == "temperature")
+			{
+				set_field(rec.temperature, PREC_TEMPERATURE, find(_attr, _nattr, "value"));
+			}
+			else if(_name == "pressure")
+			{
+				set_field(rec.air_pressure, PREC_PRESSURE, find(_attr, _nattr, "value"));
+			}
+			else if(_name == "precipitation")
+			{
+				set_field(rec.precipitation, PREC_PRECIPITATION, find(_attr, _nattr, "value"));
+			}
+		}
+		else if(in_tabular && _name == "time")
+		{
+			rec = prognosis_record();
+			rec.from = xml_to_time(find(_attr, _nattr, "from"), out.utc_offset);
+			rec.to = xml_to_time(find(_attr, _nattr, "to"), out.utc_offset);
+			in_time = (rec.from != -1);
+		}
+		else if(_name == "tabular")
+		{
+			in_tabular = true;
+		}
+		else if(_name == "timezone")
+		{
+			float offset = xml_to_float(find(_attr, _nattr, "utcoffsetMinutes"));
+			out.utc_offset = isnan(offset) ? 0 : (int)offset * 60;
+		}
+		else if(_name == "lastupdate")
+		{
+			text_target = &out.lastupdate;
+		}
+		else if(_name == "nextupdate")
+		{
+			text_target = &out.nextupdate;
+		}
+	}
+
+	void end_element(xml_span _name)
+	{
+		text_target = NULL;
+		if(in_time && _name == "time")
+		{
+			out.records.push_back(rec);
+			in_time = false;
+		}
+		else if(_name == "tabular")
+		{
+			in_tabular = false;
+		}
+	}
+
+	void text(xml_span _text)
+	{
+		if(text_target)
+		{
+			int64_t t = xml_to_time(_text, out.utc_offset);
+			if(t != -1)
+			{
+				*text_target = t;
+			}
+		}
+	}
+
+private:
+	static xml_span find(const xml_attribute* _attr, int _nattr, const char* _name)
+	{
+		for(int i = 0; i < _nattr; i++)
+		{
+			if(_attr[i].name == _name)
+			{
+				return _attr[i].value;
+			}
+		}
+		return xml_span();
+	}
+
+	void set_field(float& _field, uint32_t _flag, xml_span _value)
+	{
+		_field = xml_to_float(_value);
+		if(!isnan(_field))
+		{
+			rec.fields |= _flag;
+		}
+	}
+
+	yr_forecast& out;
+	prognosis_record rec;
+	bool in_tabular;
+	bool in_time;
+	int64_t* text_target;
+};
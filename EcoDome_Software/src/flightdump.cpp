@@ -0,0 +1,159 @@
+/*
+* flightdump.cpp
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:11
+* Modified:		19/10-2026 05:20
+* Version:		1.1
+*
+* Description:
+*	Tool that prints the control steps kept by the flight recorder (flightrec.h), oldest first, to see what the
+*	controller did right before a crash or what it is doing now.
+*
+*	./flightdump [-csv] [-n steps] [-f] [flight.rec]
+*	./flightdump -shm [-csv] [-n steps] [-f] [/ecodome]
+*
+* NOTE:
+*	With -f the newest steps are printed as they come in, like tail -f. It only reads the ring, it can be run while
+*	Eco_Soft writes it.
+*	With -shm the steps come from the telemetry segment (telemetry.h) of the running Eco_Soft instead, the last
+*	minutes only but without going through the card.
+*
+*/
+
+
+// Standard Libraries
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+
+
+// Custom Libraries
+#include "../include/flightrec.h"
+#include "../include/telemetry.h"
+
+// Define namespaces
+using namespace std;
+
+void print_header(bool _csv)
+{
+	const char* sep = _csv ? "," : "\t";
+	printf("step%stime%sT_inside%sT_in_window%sT_out1%sT_out2%sT_outmean%sT_stone1%sT_stone2%sT_stoneF%sT_stonemean%sT_extra1"
+		"%su%sr%sy%sintegral%snowcast_1h%sstone_fan%smain_fan%sfan_high",
+		sep, sep, sep, sep, sep, sep, sep, sep, sep, sep, sep, sep, sep, sep, sep, sep, sep, sep, sep);
+	for(int s = 0; s < FLIGHT_STAGES; s++)
+	{
+		printf("%s%s_us", sep, flight_stage_names[s]);
+	}
+	printf("\n");
+}
+
+void print_step(const flight_record& _r, bool _csv)
+{
+	const char* sep = _csv ? "," : "\t";
+	char stamp[64];
+	time_t s = _r.epoch_us / 1000000;
+	struct tm t;
+	localtime_r(&s, &t);
+	size_t n = strftime(stamp, sizeof(stamp), "%Y-%m-%d %X", &t);
+	snprintf(stamp + n, sizeof(stamp) - n, ".%03d", (int)(_r.epoch_us / 1000 % 1000));
+
+	printf("%llu%s%s%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%.3f%s%d%s%d%s%d",
+		(unsigned long long)_r.seq_end, sep, stamp, sep, _r.T_inside, sep, _r.T_in_window, sep, _r.T_out1, sep, _r.T_out2,
+		sep, _r.T_outmean, sep, _r.T_stone1, sep, _r.T_stone2, sep, _r.T_stoneF, sep, _r.T_stonemean, sep, _r.T_extra1,
+		sep, _r.u, sep, _r.r, sep, _r.y, sep, _r.integral, sep, _r.nowcast_1h,
+		sep, (_r.actuators & FLIGHT_STONE_FAN) != 0, sep, (_r.actuators & FLIGHT_MAIN_FAN) != 0, sep, (_r.actuators & FLIGHT_FAN_HIGH) != 0);
+	for(int st = 0; st < FLIGHT_STAGES; st++)
+	{
+		printf("%s%u", sep, _r.stage_us[st]);
+	}
+	printf("\n");
+}
+
+// prints the steps of a FLIGHT_READER or a TELEMETRY_READER, they read their rings the same way
+template< class READER >
+int dump(READER& rd, const string& path, bool csv, bool follow, size_t last)
+{
+	vector< flight_record > steps;
+	size_t torn = rd.read(0, steps);
+	size_t first = (last && last < steps.size()) ? steps.size() - last : 0;
+	time_t created = rd.header().created;
+	fprintf(stderr, "%s: %u slots of %u s, created %s", path.c_str(), rd.header().slots, rd.header().time_step, ctime(&created));
+	fprintf(stderr, "%zu steps, %zu torn slots left out, newest step %llu\n", steps.size(), torn, (unsigned long long)rd.head());
+
+	print_header(csv);
+	uint64_t seen = 0;
+	for(size_t i = first; i < steps.size(); i++)
+	{
+		print_step(steps[i], csv);
+		seen = steps[i].seq_end;
+	}
+	fflush(stdout);
+
+	while(follow)
+	{
+		sleep(1);
+		if(rd.head() == seen)
+		{
+			continue;
+		}
+		rd.read(seen, steps);
+		for(size_t i = 0; i < steps.size(); i++)
+		{
+			print_step(steps[i], csv);
+			seen = steps[i].seq_end;
+		}
+		fflush(stdout);
+	}
+	return 0;
+}
+
+// Main
+int main(int argc, char** argv)
+{
+	string path;
+	bool csv = false;
+	bool follow = false;
+	bool shm = false;
+	size_t last = 0;
+
+	for(int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if(arg == "-csv")						csv = true;
+		else if(arg == "-f")					follow = true;
+		else if(arg == "-shm")					shm = true;
+		else if(arg == "-n" && i + 1 < argc)	last = atol(argv[++i]);
+		else if(arg[0] != '-')					path = arg;
+		else
+		{
+			cout << "usage: " << argv[0] << " [-shm] [-csv] [-n steps] [-f] [" << FLIGHT_FILE << " | " << TELEMETRY_NAME << "]" << endl;
+			return 1;
+		}
+	}
+
+	if(shm)
+	{
+		path = path.empty() ? TELEMETRY_NAME : path;
+		TELEMETRY_READER rd;
+		if(!rd.open(path))
+		{
+			cout << "Could not open the telemetry segment " << path << ", is Eco_Soft running?" << endl;
+			return 1;
+		}
+		return dump(rd, path, csv, follow, last);
+	}
+
+	path = path.empty() ? FLIGHT_FILE : path;
+	FLIGHT_READER rd;
+	if(!rd.open(path))
+	{
+		cout << "Could not open the flight recorder ring " << path << endl;
+		return 1;
+	}
+	return dump(rd, path, csv, follow, last);
+}
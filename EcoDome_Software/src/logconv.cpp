@@ -0,0 +1,167 @@
+/*
+* logconv.cpp
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:33
+* Modified:		19/10-2026 04:42
+* Version:		1.1
+*
+* Description:
+*	Tool that turns binary logs into text. TSV gives the same layout as the text logs of older versions, CSV gives
+*	both time stamps in full and is meant for spreadsheets and scripts.
+*
+*	./logconv [-csv] [-o output] logdata0.ecl [logdata1.ecl ...]
+*
+* NOTE:
+*	Without -o the text is written to the terminal. Compressed logs (logdataN.ecl.gz) are read as they are.
+*
+*/
+
+
+// Standard Libraries
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <time.h>
+
+
+// Custom Libraries
+#include "../include/binlog.h"
+
+// Define namespaces
+using namespace std;
+
+	/*! @brief Writes one log as TSV or CSV
+	*
+	*
+	*
+	* @param const LOG_READER& _lr, bool _csv, FILE* _out
+	*
+	* @returns void
+	*
+	*/
+void convert(const LOG_READER& _lr, bool _csv, FILE* _out)
+{
+	char sep = _csv ? ',' : '\t';
+	char buf[64];
+	struct tm t;
+
+	// header, the TSV one is what LOGGER wrote before the logs became binary
+	if(_csv)
+	{
+		fputs("epoch_s,monotonic_s", _out);
+	}
+	else
+	{
+		time_t started = _lr.header().started;
+		localtime_r(&started, &t);
+		strftime(buf, sizeof(buf), "%Y-%m-%d %X", &t);
+		fprintf(_out, "Test started at %s\nTime step is %u\nTimeStamp_DateTime", buf, _lr.header().time_step);
+	}
+	for(size_t c = 0; c < _lr.channels(); c++)
+	{
+		fprintf(_out, "%c%s", sep, _lr.get_channel(c).name);
+	}
+	fputc('\n', _out);
+
+	time_t last = -1;
+	char stamp[64] = {0};
+	for(size_t i = 0; i < _lr.size(); i++)
+	{
+		int64_t us = _lr.epoch_us(i);
+		if(_csv)
+		{
+			fprintf(_out, "%lld.%06lld,%.9f", (long long)(us / 1000000), (long long)(us % 1000000), _lr.mono_ns(i) / 1e9);
+		}
+		else
+		{
+			// the time stamp only changes once a second
+			time_t s = us / 1000000;
+			if(s != last)
+			{
+				localtime_r(&s, &t);
+				strftime(stamp, sizeof(stamp), "%Y-%m-%d %X", &t);
+				last = s;
+			}
+			fputs(stamp, _out);
+		}
+		for(size_t c = 0; c < _lr.channels(); c++)
+		{
+			if(_lr.get_channel(c).type == LOG_BOOL)
+			{
+				fprintf(_out, "%c%d", sep, (int)_lr.value(i, c));
+			}
+			else
+			{
+				fprintf(_out, "%c%f", sep, _lr.value(i, c));
+			}
+		}
+		fputc('\n', _out);
+	}
+}
+
+// Main
+int main(int argc, char** argv)
+{
+	bool csv = false;
+	string output;
+	vector< string > files;
+
+	for(int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if(arg == "-csv")
+		{
+			csv = true;
+		}
+		else if(arg == "-o" && i + 1 < argc)
+		{
+			output = argv[++i];
+		}
+		else if(arg[0] == '-')
+		{
+			files.clear();
+			break;
+		}
+		else
+		{
+			files.push_back(arg);
+		}
+	}
+	if(files.empty())
+	{
+		cout << "usage: " << argv[0] << " [-csv] [-o output] logdata0" << LOG_EXTENSION << " [logdata1" << LOG_EXTENSION << LOG_COMPRESSED << " ...]" << endl;
+		return 1;
+	}
+
+	FILE* out = stdout;
+	if(!output.empty() && (out = fopen(output.c_str(), "w")) == NULL)
+	{
+		perror("fopen()");
+		return 1;
+	}
+	// large writes, the output is often a pipe or the SD card
+	static char outbuf[1 << 16];
+	setvbuf(out, outbuf, _IOFBF, sizeof(outbuf));
+
+	int ret = 0;
+	for(size_t f = 0; f < files.size(); f++)
+	{
+		LOG_READER lr;
+		if(!lr.open(files[f]))
+		{
+			cerr << "Not a binary log: " << files[f] << endl;
+			ret = 1;
+			continue;
+		}
+		convert(lr, csv, out);
+	}
+
+	if(out != stdout)
+	{
+		fclose(out);
+	}
+	return ret;
+}
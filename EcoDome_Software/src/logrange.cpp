@@ -0,0 +1,169 @@
+/*
+* logrange.cpp
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:45
+* Modified:		19/10-2026 04:50
+* Version:		1.1
+*
+* Description:
+*	Tool that prints one channel of the logs between two times, for looking into what happened at a certain time
+*	without going through the logs by hand. Uses the sparse time index of logindex.h, so only the logs and blocks
+*	in the range are read.
+*
+*	./logrange [-l log folder] [-r 1m|1h|1d] [-csv] [-s] -c channel -from "YYYY-MM-DD[ HH:MM[:SS]]" -to "YYYY-MM-DD[ HH:MM[:SS]]"
+*
+*	With -r the rollup log of that level is read instead of the logs, the channels are then named like
+*	"outside_2.mean" or "M_F.duty", see rollup.h.
+*
+* NOTE:
+*	Times are local time. With -s only the count, minimum, mean and maximum are printed.
+*	How long the query took is written to stderr, so it does not end up in the output.
+*
+*/
+
+
+// Standard Libraries
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <time.h>
+
+
+// Custom Libraries
+#include "../include/logindex.h"
+#include "../include/rollup.h"
+
+// Define namespaces
+using namespace std;
+
+double seconds_since(const struct timespec& _start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - _start.tv_sec) + (now.tv_nsec - _start.tv_nsec) / 1e9;
+}
+
+time_t parse_time(const char* _s)
+{
+	struct tm t;
+	memset(&t, 0, sizeof(t));
+	if(sscanf(_s, "%d-%d-%d %d:%d:%d", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec) < 3)
+	{
+		cout << "Times are given as \"YYYY-MM-DD HH:MM:SS\", the time of day is optional, not " << _s << endl;
+		exit(1);
+	}
+	t.tm_year -= 1900;
+	t.tm_mon -= 1;
+	t.tm_isdst = -1;
+	return mktime(&t);
+}
+
+// Main
+int main(int argc, char** argv)
+{
+	string logdir = LOG_DIR;
+	string channel;
+	string level;
+	bool csv = false;
+	bool summary = false;
+	time_t from = -1;
+	time_t to = -1;
+
+	for(int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if(arg == "-csv")						csv = true;
+		else if(arg == "-s")					summary = true;
+		else if(arg == "-l" && i + 1 < argc)	logdir = argv[++i];
+		else if(arg == "-c" && i + 1 < argc)	channel = argv[++i];
+		else if(arg == "-r" && i + 1 < argc)	level = argv[++i];
+		else if(arg == "-from" && i + 1 < argc)	from = parse_time(argv[++i]);
+		else if(arg == "-to" && i + 1 < argc)	to = parse_time(argv[++i]);
+		else
+		{
+			channel.clear();
+			break;
+		}
+	}
+	// the rollup log of the level, rollup_1h for 1h
+	string rollup;
+	for(int l = 0; l < ROLLUP_LEVELS; l++)
+	{
+		if(level.size() && "rollup_" + level == rollup_names[l])
+		{
+			rollup = logdir + (logdir[logdir.size() - 1] == '/' ? "" : "/") + "rollup/" + rollup_names[l] + LOG_EXTENSION;
+		}
+	}
+	if(channel.empty() || from < 0 || to < 0 || (level.size() && rollup.empty()))
+	{
+		cout << "usage: " << argv[0] << " [-l log folder] [-r 1m|1h|1d] [-csv] [-s] -c channel -from \"YYYY-MM-DD[ HH:MM[:SS]]\" -to \"YYYY-MM-DD[ HH:MM[:SS]]\"" << endl;
+		return 1;
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	vector< log_sample > out;
+	log_query_stats st;
+	if(rollup.empty())
+	{
+		log_query_range(logdir, channel, (int64_t)from * 1000000, (int64_t)to * 1000000, out, &st);
+	}
+	else
+	{
+		log_query_file(rollup, channel, (int64_t)from * 1000000, (int64_t)to * 1000000, out, st);
+	}
+	double t_query = seconds_since(start);
+
+	static char outbuf[1 << 16];
+	setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+	if(summary)
+	{
+		double sum = 0;
+		float lo = INFINITY, hi = -INFINITY;
+		for(size_t i = 0; i < out.size(); i++)
+		{
+			sum += out[i].value;
+			lo = out[i].value < lo ? out[i].value : lo;
+			hi = out[i].value > hi ? out[i].value : hi;
+		}
+		printf("%s: %zu values", channel.c_str(), out.size());
+		if(!out.empty())
+		{
+			printf(", min %.3f, mean %.3f, max %.3f", lo, sum / out.size(), hi);
+		}
+		printf("\n");
+	}
+	else
+	{
+		char sep = csv ? ',' : '\t';
+		printf("%s%c%s\n", csv ? "epoch_s" : LOG_TIME_HEADER, sep, channel.c_str());
+		time_t last = -1;
+		char stamp[64] = {0};
+		for(size_t i = 0; i < out.size(); i++)
+		{
+			int64_t us = out[i].epoch_us;
+			if(csv)
+			{
+				printf("%lld.%06lld%c%f\n", (long long)(us / 1000000), (long long)(us % 1000000), sep, out[i].value);
+				continue;
+			}
+			time_t s = us / 1000000;
+			if(s != last)
+			{
+				struct tm t;
+				localtime_r(&s, &t);
+				strftime(stamp, sizeof(stamp), "%Y-%m-%d %X", &t);
+				last = s;
+			}
+			printf("%s%c%f\n", stamp, sep, out[i].value);
+		}
+	}
+	fflush(stdout);
+
+	fprintf(stderr, "%zu values in %.2f ms: %lu logs, %lu in range, %lu indexes built, %lu blocks, %lu rows decoded\n",
+		out.size(), t_query * 1000, st.files, st.opened, st.built, st.blocks, st.rows);
+	return 0;
+}
@@ -0,0 +1,127 @@
+/*
+* logreport.cpp
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:53
+* Modified:		19/10-2026 04:53
+* Version:		1.0
+*
+* Description:
+*	Tool that reports every day of the logs: outside and inside temperature, heating degree-hours, run time of the
+*	stone and main fan and the heat that went into and came out of the stone beds, see loganalysis.h. The logs are
+*	read by a pool of threads, one per core unless -j says otherwise.
+*
+*	./logreport [-l log folder] [-j threads] [-b base temperature] [-csv] [-from YYYY-MM-DD] [-to YYYY-MM-DD]
+*
+* NOTE:
+*	Dates are local dates. All logs are read, -from and -to only select the days that are printed.
+*	How much was read and how fast is written to stderr, so it does not end up in the report.
+*
+*/
+
+
+// Standard Libraries
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+
+
+// Custom Libraries
+#include "../include/loganalysis.h"
+
+// Define namespaces
+using namespace std;
+
+double seconds_since(const struct timespec& _start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - _start.tv_sec) + (now.tv_nsec - _start.tv_nsec) / 1e9;
+}
+
+int parse_day(const char* _s)
+{
+	int y, m, d;
+	if(sscanf(_s, "%d-%d-%d", &y, &m, &d) != 3)
+	{
+		cout << "Dates are given as YYYY-MM-DD, not " << _s << endl;
+		exit(1);
+	}
+	return y * 10000 + m * 100 + d;
+}
+
+// Main
+int main(int argc, char** argv)
+{
+	string logdir = LOG_DIR;
+	int threads = sysconf(_SC_NPROCESSORS_ONLN);
+	double base = ANALYSIS_BASE_TEMP;
+	bool csv = false;
+	int from = 0;
+	int to = 99999999;
+
+	for(int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if(arg == "-csv")						csv = true;
+		else if(arg == "-l" && i + 1 < argc)	logdir = argv[++i];
+		else if(arg == "-j" && i + 1 < argc)	threads = atoi(argv[++i]);
+		else if(arg == "-b" && i + 1 < argc)	base = atof(argv[++i]);
+		else if(arg == "-from" && i + 1 < argc)	from = parse_day(argv[++i]);
+		else if(arg == "-to" && i + 1 < argc)	to = parse_day(argv[++i]);
+		else
+		{
+			cout << "usage: " << argv[0] << " [-l log folder] [-j threads] [-b base temperature] [-csv] [-from YYYY-MM-DD] [-to YYYY-MM-DD]" << endl;
+			return 1;
+		}
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	vector< string > files = log_list_files(logdir);
+	log_days days;
+	log_analysis_stats st;
+	log_analyse(files, threads, base, days, st);
+	double t_total = seconds_since(start);
+
+	static char outbuf[1 << 16];
+	setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+	const char* sep = csv ? "," : "\t";
+	printf("date%srows%sout_mean%sout_min%sout_max%sin_mean%sin_min%sin_max%shdh_%g%sstone_fan_h%smain_fan_h%scharge_Kh%sdischarge_Kh%sstone_eff\n",
+		sep, sep, sep, sep, sep, sep, sep, sep, base, sep, sep, sep, sep, sep);
+	log_day total;
+	for(log_days::const_iterator it = days.begin(); it != days.end(); ++it)
+	{
+		if(it->first < from || it->first > to)
+		{
+			continue;
+		}
+		const log_day& d = it->second;
+		total.add(d);
+		printf("%04d-%02d-%02d%s%lu%s%.2f%s%.2f%s%.2f%s%.2f%s%.2f%s%.2f%s%.1f%s%.2f%s%.2f%s%.2f%s%.2f%s%.2f\n",
+			it->first / 10000, it->first / 100 % 100, it->first % 100, sep, d.rows,
+			sep, d.out_n ? d.out_sum / d.out_n : NAN, sep, d.out_n ? d.out_min : NAN, sep, d.out_n ? d.out_max : NAN,
+			sep, d.in_n ? d.in_sum / d.in_n : NAN, sep, d.in_n ? d.in_min : NAN, sep, d.in_n ? d.in_max : NAN,
+			sep, d.hdh, sep, d.stone_fan_s / 3600, sep, d.main_fan_s / 3600,
+			sep, d.charge_kh, sep, d.discharge_kh, sep, d.charge_kh > 0 ? d.discharge_kh / d.charge_kh : NAN);
+	}
+	if(!csv)
+	{
+		printf("total\t%lu\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f\t%.1f\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f\n", total.rows,
+			total.out_n ? total.out_sum / total.out_n : NAN, total.out_n ? total.out_min : NAN, total.out_n ? total.out_max : NAN,
+			total.in_n ? total.in_sum / total.in_n : NAN, total.in_n ? total.in_min : NAN, total.in_n ? total.in_max : NAN,
+			total.hdh, total.stone_fan_s / 3600, total.main_fan_s / 3600, total.charge_kh, total.discharge_kh,
+			total.charge_kh > 0 ? total.discharge_kh / total.charge_kh : NAN);
+	}
+	fflush(stdout);
+
+	double mb = (st.text_bytes + st.binary_bytes) / 1e6;
+	fprintf(stderr, "%lu logs (%lu not read), %lu rows, %.1f MB text + %.1f MB binary in %.3f s with %d threads: %.0f MB/s, %.0f MB/s per thread\n",
+		st.files, st.failed, st.rows, st.text_bytes / 1e6, st.binary_bytes / 1e6, t_total, threads,
+		mb / t_total, st.busy_s > 0 ? mb / st.busy_s : 0);
+	return 0;
+}
@@ -2,11 +2,13 @@
 * main.cpp
 * Author:		Hans V. Rasmussen
 * Created:		13/04-2018 15:00
-* Modified:		23/05-2018 15:00
-* Version:		1.7
+* Modified:		19/10-2026 06:12
+* Version:		1.8
 *
 * Description:
 *	main file for the EcoDome prototype code.
+*	Since version 1.8 the main loop sleeps on a signalfd, -d runs it as a service and -l sends the output to a log
+*	file that SIGHUP opens again, see daemon.h.
 *
 * NOTE:
 *
@@ -21,7 +23,6 @@
 #include <vector>
 #include <string>
 #include <wiringPi.h>		// Library that includes classes to interface with the RPi's sorroundings
-#include <softPwm.h>
 #include <signal.h>
 #include <time.h>
 #include <string>
@@ -34,6 +35,7 @@
 #include "../include/picontrol.h"
 #include "../include/ECO_DS18B20.h"
 #include "../include/debug_logger.h"
+#include "../include/daemon.h"
 
 // Define namespaces
 using namespace std;
@@ -48,51 +50,98 @@ TERMINAL_CONTROLLER* tercon_object;
 DS18B20* DS18B20_object;
 Main_Controller* Main_Controller_object;
 LOGGER* LOGGER_object;
+FLIGHT_RECORDER* FLIGHT_object;
+SLIDE_SET* SLIDE_object;
+METRICS_SERVER* METRICS_object;
+TELEMETRY_WRITER* TELEMETRY_object;
+CONTROL_SERVER* CONTROL_object;
 
 // Main
-int main(void)
+int main(int argc, char** argv)
 {
+    // before anything is printed
+    daemon_stdio();
+
+    //  ########## Command line ##########   //
+    // -d runs without the terminal (as a service), -l sends the output to a log file that SIGHUP opens again
+    bool daemon_mode = false;
+    string daemon_log;
+    for(int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if(arg == "-d")                         daemon_mode = true;
+        else if(arg == "-l" && i + 1 < argc)    daemon_log = argv[++i];
+        else
+        {
+            cout << "usage: " << argv[0] << " [-d] [-l logfile]" << endl;
+            return 1;
+        }
+    }
+    if(!daemon_log.empty() && !daemon_log_open(daemon_log))
+    {
+        return 1;
+    }
+
+    // the signals go to the main loop below, before any thread is started so that none of them gets one
+    int sig_fd = daemon_signals();
+    if(sig_fd == -1)
+    {
+        return 1;
+    }
+
     //  ########## Preparing Configuration ##########   //
     vector< prognosis_downlaod_structure > _progconf_data;
     int prog_number = 0;
     destemp t_evalues;
+    log_settings log_conf;
 
     CONFLOAD cfgload("./Config.cfg");
     cfgload.get_progdata(_progconf_data);
     cfgload.get_prog_number(prog_number);
     cfgload.get_minmaxdes(t_evalues);
+    cfgload.get_logsettings(log_conf);
+    vector< slide_spec > window_conf;
+    cfgload.get_windows(window_conf);
+    string metrics_listen;
+    cfgload.get_metrics(metrics_listen);
+    string telemetry_name;
+    int telemetry_ticks = TELEMETRY_TICKS;
+    cfgload.get_telemetry(telemetry_name, telemetry_ticks);
+    string control_socket;
+    cfgload.get_control(control_socket);
     cout << "t_evalues are \nmax: " << t_evalues.T_max << "\ndes: " << t_evalues.T_des << "\nmin: " << t_evalues.T_min << endl;
 
 
     // Preparing temperature and general logging
     vector < string > DS18B20_Devices;
-	vector < string > log_Descriptions;
+	vector < log_channel > log_Channels;
 
     DS18B20_Devices.push_back("28-0317200e5cff");
-	log_Descriptions.push_back("in_soil__");
+	log_Channels.push_back(log_channel("in_soil__"));
 
     DS18B20_Devices.push_back("28-031730398bff");
-	log_Descriptions.push_back("in_window");
+	log_Channels.push_back(log_channel("in_window"));
 
 	DS18B20_Devices.push_back("28-051685213dff");
-    log_Descriptions.push_back("StoneFan");
+    log_Channels.push_back(log_channel("StoneFan"));
 
     DS18B20_Devices.push_back("28-041720a4a2ff");
-	log_Descriptions.push_back("outside_2");
+	log_Channels.push_back(log_channel("outside_2"));
 
     DS18B20_Devices.push_back("28-0416850db6ff");
-	log_Descriptions.push_back("stone_close");
+	log_Channels.push_back(log_channel("stone_close"));
 
     DS18B20_Devices.push_back("28-031645884cff");
-	log_Descriptions.push_back("stone_far");
+	log_Channels.push_back(log_channel("stone_far"));
 
     //DS18B20_Devices.push_back("28-0417207ba2ff");
-	//log_Descriptions.push_back("Freddy_ex");
+	//log_Channels.push_back(log_channel("Freddy_ex"));
 
-    log_Descriptions.push_back("___u____");
-    log_Descriptions.push_back("__Tref__");
-    log_Descriptions.push_back("Sb_F");
-    log_Descriptions.push_back("M_F");
+    log_Channels.push_back(log_channel("___u____"));
+    log_Channels.push_back(log_channel("__Tref__"));
+    log_Channels.push_back(log_channel("Sb_F", LOG_BOOL));
+    log_Channels.push_back(log_channel("M_F", LOG_BOOL));
+    log_Channels.push_back(log_channel("Tnow_1h_"));
 
 
     // prepare real-world interfaces
@@ -105,28 +154,125 @@ int main(void)
     sem_init(&sem_temp_ready, 0, 0);
 
     // make objects
-    tercon_object = new TERMINAL_CONTROLLER();
-    DS18B20_object = new DS18B20(tercon_object, &sem_DS18B20, &sem_temp_ready, &DS18B20_Devices);
-    Main_Controller_object = new Main_Controller(tercon_object, DS18B20_object, &sem_controller, &sem_temp_ready, _progconf_data, prog_number, t_evalues.T_max, t_evalues.T_des, t_evalues.T_min);
-    LOGGER_object = new LOGGER(&log_Descriptions);
+    tercon_object = new TERMINAL_CONTROLLER(!daemon_mode);
+    LOGGER_object = new LOGGER(log_Channels, log_conf);
+    FLIGHT_object = NULL;
+    if(log_conf.flight_minutes > 0)
+    {
+        FLIGHT_object = new FLIGHT_RECORDER(log_conf.flight_sync);
+        if(!FLIGHT_object->open(FLIGHT_FILE, log_conf.flight_minutes, TIME_STEP))
+        {
+            delete FLIGHT_object;
+            FLIGHT_object = NULL;
+        }
+    }
+    TELEMETRY_object = NULL;
+    if(!telemetry_name.empty())
+    {
+        TELEMETRY_object = new TELEMETRY_WRITER();
+        if(!TELEMETRY_object->open(telemetry_name, telemetry_ticks, TIME_STEP))
+        {
+            delete TELEMETRY_object;
+            TELEMETRY_object = NULL;
+        }
+    }
+    CONTROL_object = NULL;
+    if(!control_socket.empty())
+    {
+        CONTROL_object = new CONTROL_SERVER(LOGGER_object->get_history());
+        if(!CONTROL_object->open(control_socket))
+        {
+            delete CONTROL_object;
+            CONTROL_object = NULL;
+        }
+    }
+    vector < string > sensor_names;
+    for(size_t i = 0; i < DS18B20_Devices.size(); i++)
+    {
+        sensor_names.push_back(log_Channels[i].name);
+    }
+    SLIDE_object = new SLIDE_SET(sensor_names, window_conf, TIME_STEP);
+    DS18B20_object = new DS18B20(tercon_object, &sem_DS18B20, &sem_temp_ready, &DS18B20_Devices, SLIDE_object);
+    Main_Controller_object = new Main_Controller(tercon_object, DS18B20_object, &sem_controller, &sem_temp_ready, _progconf_data, prog_number, t_evalues.T_max, t_evalues.T_min, t_evalues.T_des, FLIGHT_object, TELEMETRY_object, CONTROL_object);
+    
+    METRICS_object = new METRICS_SERVER();
+    if(!metrics_listen.empty() && METRICS_object->open(metrics_listen))
+    {
+        cout << "Metrics served on " << metrics_listen << endl;
+    }
     
     // starts threads
     DS18B20_object->StartInternalThread();
     Main_Controller_object->StartInternalThread();
-    tercon_object->StartInternalThread();
+    if(!daemon_mode)
+    {
+        tercon_object->StartInternalThread();
+    }
 
     // Giving the other threads time to start
-    int p_counter = 0;
     alarm(5);
+    daemon_notify("READY=1");
+    bool watchdog = daemon_watchdog();
+
+    // Main loop, sleeps until a signal: SIGALRM every TIME_STEP starts a step, SIGTERM and SIGINT stop the program
+    // and SIGHUP opens the log file again
     while(tercon_object->pos())
     {
-        signal(SIGALRM, alarm_handle);
+        struct signalfd_siginfo si;
+        ssize_t r = read(sig_fd, &si, sizeof(si));
+        if(r != sizeof(si))
+        {
+            if(r == -1 && errno != EINTR)
+            {
+                perror("read() signalfd");
+                tercon_object->stop();
+            }
+            continue;
+        }
+        if(si.ssi_signo == SIGALRM)
+        {
+            alarm_handle(SIGALRM);
+            if(watchdog)
+            {
+                daemon_notify("WATCHDOG=1");
+            }
+        }
+        else if(si.ssi_signo == SIGHUP)
+        {
+            if(!daemon_log.empty())
+            {
+                daemon_log_open(daemon_log);
+            }
+            tercon_object->term_write("SIGHUP, log file opened again");
+        }
+        else
+        {
+            tercon_object->term_write(string(strsignal(si.ssi_signo)) + ", shutting down");
+            tercon_object->stop();
+        }
     }
+    daemon_notify("STOPPING=1");
 
+    // one last step lets the threads see that the program stops
+    alarm_handle(SIGALRM);
    DS18B20_object->WaitForInternalThreadToExit();
    Main_Controller_object->WaitForInternalThreadToExit();
-   tercon_object->WaitForInternalThreadToExit();
-    
+   if(!daemon_mode)
+   {
+       tercon_object->WaitForInternalThreadToExit();
+   }
+
+   // no more rows, write the rest of the log to the card
+   alarm(0);
+   LOGGER_object->close();
+   delete FLIGHT_object;
+   delete SLIDE_object;
+   delete METRICS_object;
+   delete TELEMETRY_object;
+   delete CONTROL_object;
+
+   // the last messages to the terminal
+   tercon_object->term_flush();
     
     return 0;
 }
@@ -139,24 +285,26 @@ void alarm_handle(int sig)
 
     // prepare variables to be used for data preparations
     Temp_measurement tm;
-    vector < string > data;
 
-    // acquire data and put it into a string vector for the logger
+    // acquire data, in the order of log_Channels
     DS18B20_object->meas_get(&tm);
-    data.push_back(to_string(tm.T_inside));
-    data.push_back(to_string(tm.T_in_window));
-    data.push_back(to_string(tm.T_stoneF));
-    data.push_back(to_string(tm.T_out2));
-    data.push_back(to_string(tm.T_stone1));
-    data.push_back(to_string(tm.T_stone2));
-    //data.push_back(to_string(tm.T_extra1));
-    data.push_back(to_string(Main_Controller_object->get_u()));
-    data.push_back(to_string(Main_Controller_object->get_ref()));
-    data.push_back(to_string(Main_Controller_object->get_stoneFAN()));
-    data.push_back(to_string(Main_Controller_object->get_mainFAN()));
-
-    // pass string vector to logger
-    LOGGER_object->update(data);
+    float data[] = {
+        tm.T_inside,
+        tm.T_in_window,
+        tm.T_stoneF,
+        tm.T_out2,
+        tm.T_stone1,
+        tm.T_stone2,
+        //tm.T_extra1,
+        Main_Controller_object->get_u(),
+        Main_Controller_object->get_ref(),
+        (float)Main_Controller_object->get_stoneFAN(),
+        (float)Main_Controller_object->get_mainFAN(),
+        Main_Controller_object->get_nowcast()
+    };
+
+    // pass the values to the logger
+    LOGGER_object->update(data, sizeof(data)/sizeof(data[0]));
 
     // signal other threads that they can start their part of this iterations work
     sem_post(&sem_DS18B20);
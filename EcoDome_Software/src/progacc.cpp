@@ -0,0 +1,137 @@
+/*
+* progacc.cpp
+* Author:		EcoDome Team
+* Created:		19/10-2026 04:26
+* Modified:		19/10-2026 04:26
+* Version:		1.0
+*
+* Description:
+*	Tool that reports how good the archived prognoses were: the forecast temperature is compared with the measured
+*	outside temperature from the logs, and the bias and RMSE are printed per lead time.
+*
+*	./progacc [-a archive] [-l log folder] [-c channel] [-b bucket hours] [-from YYYY-MM-DD] [-to YYYY-MM-DD]
+*
+* NOTE:
+*	Run it from the folder Eco_Soft runs in, the defaults are the paths Eco_Soft uses.
+*
+*/
+
+
+// Standard Libraries
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <time.h>
+
+
+// Custom Libraries
+#include "../include/parchive.h"
+#include "../include/logquery.h"
+
+// Define namespaces
+using namespace std;
+
+double seconds_since(const struct timespec& _start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - _start.tv_sec) + (now.tv_nsec - _start.tv_nsec) / 1e9;
+}
+
+time_t parse_date(const char* _s)
+{
+	struct tm t;
+	memset(&t, 0, sizeof(t));
+	if(sscanf(_s, "%d-%d-%d", &t.tm_year, &t.tm_mon, &t.tm_mday) != 3)
+	{
+		cout << "Dates are given as YYYY-MM-DD, not " << _s << endl;
+		exit(1);
+	}
+	t.tm_year -= 1900;
+	t.tm_mon -= 1;
+	t.tm_isdst = -1;
+	return mktime(&t);
+}
+
+// Main
+int main(int argc, char** argv)
+{
+	string archive = PROG_ARCHIVE_FILE;
+	string logdir = LOG_DIR;
+	string channel = "outside_2";
+	int bucket = 3;
+	time_t from = 0;
+	time_t to = INT64_MAX;
+
+	for(int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		if(i + 1 >= argc)
+		{
+			cout << "Missing value for " << arg << endl;
+			return 1;
+		}
+		if(arg == "-a")				archive = argv[++i];
+		else if(arg == "-l")		logdir = argv[++i];
+		else if(arg == "-c")		channel = argv[++i];
+		else if(arg == "-b")		bucket = atoi(argv[++i]);
+		else if(arg == "-from")		from = parse_date(argv[++i]);
+		else if(arg == "-to")		to = parse_date(argv[++i]);
+		else
+		{
+			cout << "usage: " << argv[0] << " [-a archive] [-l log folder] [-c channel] [-b bucket hours] [-from YYYY-MM-DD] [-to YYYY-MM-DD]" << endl;
+			return 1;
+		}
+	}
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// hourly means of the measured temperature
+	unordered_map< int64_t, log_hour_sum > sums;
+	vector< string > files = log_list_files(logdir);
+	long values = 0;
+	for(size_t i = 0; i < files.size(); i++)
+	{
+		long n = log_read_hourly(files[i], channel, PROG_ACCURACY::prog_hour, sums);
+		values += n > 0 ? n : 0;
+	}
+	unordered_map< int64_t, float > hourly;
+	hourly.reserve(sums.size());
+	for(unordered_map< int64_t, log_hour_sum >::iterator it = sums.begin(); it != sums.end(); ++it)
+	{
+		hourly[it->first] = it->second.sum / it->second.n;
+	}
+	double t_logs = seconds_since(start);
+
+	PROG_ARCHIVE_READER rd;
+	if(!rd.open(archive, PROG_ARC_COL(PROG_ARC_TEMPERATURE)))
+	{
+		cout << "Could not open the forecast archive " << archive << endl;
+		return 1;
+	}
+	PROG_ACCURACY acc(bucket * 3600);
+	unsigned long blocks = acc.add_archive(rd, hourly, from, to);
+	double t_total = seconds_since(start);
+
+	cout << "Log files:  " << files.size() << ", " << values << " values of " << channel << " in " << hourly.size() << " hours" << endl;
+	cout << "Archive:    " << rd.size() << " bytes, " << blocks << " forecasts used" << endl;
+	cout << "Matched:    " << acc.get_matched() << " forecast values, " << acc.get_unmatched() << " without measurements" << endl;
+	cout << "Time:       " << t_logs << " s reading logs, " << t_total << " s in total" << endl << endl;
+
+	printf("lead [h]\t     n\tbias [C]\trmse [C]\n");
+	const vector< prog_accuracy_row >& rows = acc.rows();
+	for(size_t i = 0; i < rows.size(); i++)
+	{
+		if(rows[i].n)
+		{
+			printf("%3d-%-3d \t%6lu\t%8.2f\t%8.2f\n", rows[i].lead / 3600, (rows[i].lead + bucket * 3600) / 3600, rows[i].n, rows[i].bias(), rows[i].rmse());
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,441 @@
+/*
+* main.cpp
+* Author:		EcoDome Team
+* Created:		19/10-2026 06:17
+* Modified:		19/10-2026 06:17
+* Version:		1.0
+*
+* Description:
+*	Load test of CONTROL_SERVER in ctlserver.h. A stand-in controller takes the queued commands once per step as
+*	Main_Controller does, applies 'set tdes', answers and publishes its status. Client threads connect to the socket
+*	and alternate status and set tdes, each waiting for its answer:
+*	- one client alone, for the time of a status answer without load
+*	- 100 clients with a 100 ms and a 10 ms step: every answer is the right one, every set is applied and answered
+*	  within the step after it was sent
+*	- malformed commands get their err lines, a client past CONTROL_MAX_CLIENTS is turned away
+*	- a client that streams but does not read has its stream lines dropped and is told how many, while the other
+*	  clients are still answered
+*
+* NOTE:
+*	make test, ends with 0 if every case passed. The socket is made in a scratch directory under /tmp that is
+*	removed at the end. The times depend on the machine, the limits are loose enough for a Raspberry Pi 3.
+*
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../../../EcoDome_Software/include/ctlserver.h"
+
+using namespace std;
+
+int failures = 0;
+string sock_path;
+
+void check(bool _ok, const string& _what)
+{
+	cout << (_ok ? "ok   " : "FAIL ") << _what << endl;
+	failures += !_ok;
+}
+
+double now_mono(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// the _p percentile of _v in milliseconds, sorts _v
+double percentile(vector< double >& _v, int _p)
+{
+	if(_v.empty())
+	{
+		return 0;
+	}
+	sort(_v.begin(), _v.end());
+	return _v[min(_v.size() - 1, _v.size() * _p / 100)] * 1000;
+}
+
+// the answer the controller gives to set tdes _v
+string set_answer(float _v)
+{
+	char value[32];
+	snprintf(value, sizeof(value), "%.3f", _v);
+	return string("ok tdes=") + value;
+}
+
+	/*! @brief	Takes the commands once per step, applies set tdes and publishes the status, like Main_Controller
+	*
+	*/
+class STAND_IN_CONTROLLER
+{
+public:
+	STAND_IN_CONTROLLER(CONTROL_SERVER& _cs, int _step_ms) : cs(_cs), step_ms(_step_ms), running(true), applied(0), steps(0)
+	{
+		th = thread(&STAND_IN_CONTROLLER::loop, this);
+	}
+
+	~STAND_IN_CONTROLLER()
+	{
+		running = false;
+		th.join();
+	}
+
+	CONTROL_SERVER& cs;
+	int step_ms;
+	atomic<bool> running;
+	atomic<unsigned long> applied;		// set tdes applied
+	atomic<unsigned long> steps;
+
+private:
+	void loop(void)
+	{
+		vector< control_command > cmds;
+		control_status st;
+		st.Tdes = 22;
+		st.Tmax = 30;
+		st.Tmin = 15;
+		st.K = 1.2;
+		st.Ke = 0.32;
+		while(running)
+		{
+			if(cs.take(cmds))
+			{
+				for(size_t i = 0; i < cmds.size(); i++)
+				{
+					if(cmds[i].type == CONTROL_SET && cmds[i].target == CONTROL_TDES)
+					{
+						st.Tdes = cmds[i].value;
+						applied++;
+						cs.reply(cmds[i].client, set_answer(cmds[i].value));
+					}
+					else
+					{
+						cs.reply(cmds[i].client, "ok");
+					}
+				}
+			}
+			st.step.seq_end = ++steps;
+			st.step.epoch_us = (int64_t)time(0) * 1000000;
+			st.step.T_inside = 21.5;
+			cs.publish(st);
+			usleep(step_ms * 1000);
+		}
+	}
+
+	thread th;
+};
+
+	/*! @brief	A client of the control socket that sends a line and reads the answer
+	*
+	*/
+class LINE_CLIENT
+{
+public:
+	LINE_CLIENT() : fd(-1)
+	{
+
+	}
+
+	~LINE_CLIENT()
+	{
+		if(fd != -1)
+		{
+			close(fd);
+		}
+	}
+
+	bool connect_to(const string& _path)
+	{
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, _path.c_str());
+		return fd != -1 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+	}
+
+	bool send_line(const string& _line)
+	{
+		string l = _line + "\n";
+		return send(fd, l.data(), l.size(), MSG_NOSIGNAL) == (ssize_t)l.size();
+	}
+
+	// the next line, false if none came within _ms
+	bool read_line(string& _line, int _ms = 2000)
+	{
+		double end = now_mono() + _ms / 1000.0;
+		size_t nl;
+		while((nl = in.find('\n')) == string::npos)
+		{
+			int left = (int)((end - now_mono()) * 1000);
+			struct pollfd p;
+			p.fd = fd;
+			p.events = POLLIN;
+			if(left <= 0 || poll(&p, 1, left) <= 0)
+			{
+				return false;
+			}
+			char buf[4096];
+			ssize_t r = recv(fd, buf, sizeof(buf), 0);
+			if(r <= 0)
+			{
+				return false;
+			}
+			in.append(buf, r);
+		}
+		_line = in.substr(0, nl);
+		in.erase(0, nl + 1);
+		return true;
+	}
+
+	// sends _line and returns the answer, "" if there was none
+	string ask(const string& _line)
+	{
+		string a;
+		if(!send_line(_line) || !read_line(a))
+		{
+			return "";
+		}
+		return a;
+	}
+
+	int fd;
+	string in;
+};
+
+// what the clients of a round measured
+struct load_result
+{
+	vector< double > status_s;
+	vector< double > set_s;
+	unsigned long wrong = 0;
+	unsigned long sets = 0;
+	mutex lr_mutex;
+};
+
+void client_loop(int _id, int _rounds, load_result& _res)
+{
+	LINE_CLIENT c;
+	vector< double > st, se;
+	unsigned long wrong = 0, sets = 0;
+	if(!c.connect_to(sock_path))
+	{
+		wrong++;
+	}
+	for(int i = 0; wrong == 0 && i < _rounds; i++)
+	{
+		double a = now_mono();
+		string s = c.ask("status");
+		double b = now_mono();
+		st.push_back(b - a);
+		wrong += s.compare(0, 8, "ok step=") != 0;
+
+		float v = 20.0f + (_id * _rounds + i) % 1000 * 0.005f;
+		s = c.ask("set tdes " + to_string(v));
+		se.push_back(now_mono() - b);
+		wrong += s != set_answer(v);
+		sets++;
+	}
+	lock_guard <mutex> lr_lock(_res.lr_mutex);
+	_res.status_s.insert(_res.status_s.end(), st.begin(), st.end());
+	_res.set_s.insert(_res.set_s.end(), se.begin(), se.end());
+	_res.wrong += wrong;
+	_res.sets += sets;
+}
+
+	/*! @brief _clients clients alternate status and set tdes _rounds times, the controller steps every _step_ms
+	*
+	*/
+void test_load(int _clients, int _rounds, int _step_ms)
+{
+	cout << "\n== " << _clients << " client(s), " << _step_ms << " ms step" << endl;
+	CONTROL_SERVER cs;
+	if(!cs.open(sock_path))
+	{
+		check(false, "the server opened " + sock_path);
+		return;
+	}
+	load_result res;
+	unsigned long applied;
+	double took;
+	{
+		STAND_IN_CONTROLLER ctl(cs, _step_ms);
+		usleep(2 * _step_ms * 1000);
+		double start = now_mono();
+		vector< thread > th;
+		for(int i = 0; i < _clients; i++)
+		{
+			th.push_back(thread(client_loop, i, _rounds, ref(res)));
+		}
+		for(size_t i = 0; i < th.size(); i++)
+		{
+			th[i].join();
+		}
+		took = now_mono() - start;
+		applied = ctl.applied;
+	}
+	cs.close();
+
+	size_t commands = res.status_s.size() + res.set_s.size();
+	double st50 = percentile(res.status_s, 50), st99 = percentile(res.status_s, 99);
+	double se50 = percentile(res.set_s, 50), se_max = percentile(res.set_s, 100);
+	printf("     %zu commands in %.1f s: status p50 %.2f ms, p99 %.2f ms, set p50 %.1f ms, max %.1f ms\n", commands,
+		took, st50, st99, se50, se_max);
+
+	check(res.wrong == 0, to_string(res.wrong) + " wrong or missing answers");
+	check(commands == (size_t)_clients * _rounds * 2, to_string(commands) + " commands answered of " + to_string(_clients * _rounds * 2));
+	check(applied == res.sets, to_string(applied) + " sets applied of " + to_string(res.sets));
+	// a set is applied by the step after it arrived, so it waits one step and whatever the server is busy with
+	check(se_max < 2 * _step_ms + 100, "every set was answered within the step after it was sent");
+	check(st99 < (_clients > 1 ? 50 : 20), "status p99 under " + string(_clients > 1 ? "50" : "20") + " ms");
+}
+
+	/*! @brief malformed commands and lines, and a client more than CONTROL_MAX_CLIENTS
+	*
+	*/
+void test_errors(void)
+{
+	cout << "\n== malformed commands, too many clients" << endl;
+	CONTROL_SERVER cs;
+	if(!cs.open(sock_path))
+	{
+		check(false, "the server opened " + sock_path);
+		return;
+	}
+	STAND_IN_CONTROLLER ctl(cs, 10);
+	LINE_CLIENT c;
+	c.connect_to(sock_path);
+	check(c.ask("set tdes abc") == "err set tdes|tmax|tmin|k|ke <value>", "set with a value that is not a number");
+	check(c.ask("set tdes nan") == "err set tdes|tmax|tmin|k|ke <value>", "set with nan");
+	check(c.ask("set speed 3") == "err set tdes|tmax|tmin|k|ke <value>", "set of something that cannot be set");
+	check(c.ask("override main_fan maybe") == "err override stone_fan|main_fan on|off|auto", "override with a wrong value");
+	check(c.ask("bogus") == "err unknown command, try help", "unknown command");
+	check(c.ask("history T_inside 1") == "err no history, log.history_days is 0", "history without a history");
+	// without a newline, the server cannot wait for the end of it
+	string longline(CONTROL_MAX_LINE + 100, 'x'), line;
+	bool sent = send(c.fd, longline.data(), longline.size(), MSG_NOSIGNAL) == (ssize_t)longline.size();
+	check(sent && c.read_line(line) && line == "err line too long", "a line longer than CONTROL_MAX_LINE");
+	check(c.ask("status").compare(0, 8, "ok step=") == 0, "the client is still served after the errors");
+	check(c.ask("quit") == "ok bye", "quit");
+	for(int i = 0; i < 100 && cs.get_clients() > 0; i++)
+	{
+		usleep(10000);
+	}
+
+	vector< LINE_CLIENT* > many;
+	for(int i = 0; i < CONTROL_MAX_CLIENTS; i++)
+	{
+		many.push_back(new LINE_CLIENT());
+		many.back()->connect_to(sock_path);
+	}
+	LINE_CLIENT extra;
+	extra.connect_to(sock_path);
+	check(extra.read_line(line) && line == "err too many clients", "client " + to_string(CONTROL_MAX_CLIENTS + 1) + " was turned away");
+	check(many.back()->ask("status").compare(0, 8, "ok step=") == 0, "client " + to_string(CONTROL_MAX_CLIENTS) + " is served");
+	for(size_t i = 0; i < many.size(); i++)
+	{
+		delete many[i];
+	}
+}
+
+	/*! @brief a client streams but does not read, its lines are dropped past CONTROL_MAX_BACKLOG while another client
+	*	is served as usual
+	*
+	*/
+void test_stalled_stream(void)
+{
+	cout << "\n== a streaming client that does not read" << endl;
+	CONTROL_SERVER cs;
+	if(!cs.open(sock_path))
+	{
+		check(false, "the server opened " + sock_path);
+		return;
+	}
+	LINE_CLIENT slow, other;
+	slow.connect_to(sock_path);
+	other.connect_to(sock_path);
+	check(slow.ask("stream on") == "ok stream on", "stream on");
+
+	vector< double > st;
+	unsigned long wrong = 0, steps;
+	{
+		STAND_IN_CONTROLLER ctl(cs, 1);
+		// status needs a step that has been published
+		while(ctl.steps < 2)
+		{
+			usleep(1000);
+		}
+		// the socket buffer and the backlog take about a thousand lines, wait for twice that
+		while(ctl.steps < 3000)
+		{
+			double a = now_mono();
+			wrong += other.ask("status").compare(0, 8, "ok step=") != 0;
+			st.push_back(now_mono() - a);
+			usleep(2000);
+		}
+		steps = ctl.steps;
+	}
+	double st_max = percentile(st, 100);
+	printf("     %lu steps, %zu status answers to the other client, max %.2f ms\n", steps, st.size(), st_max);
+	check(wrong == 0 && st_max < 100, "the other client was answered while the stream stalled");
+
+	// the slow client reads what was sent before the backlog was full
+	string line;
+	unsigned long lines = 0, dropped = 0;
+	while(slow.read_line(line, 500))
+	{
+		lines += line.compare(0, 5, "step ") == 0;
+	}
+
+	// the next step tells it how many lines it missed, then the stream goes on
+	bool resumed = false;
+	{
+		STAND_IN_CONTROLLER ctl(cs, 10);
+		if(slow.read_line(line) && line.compare(0, 8, "dropped ") == 0)
+		{
+			dropped = strtoul(line.c_str() + 8, NULL, 10);
+			resumed = slow.read_line(line) && line.compare(0, 5, "step ") == 0;
+		}
+	}
+	printf("     %lu stream lines read, then told %lu were dropped\n", lines, dropped);
+	check(lines > 0 && dropped > 0 && lines + dropped <= steps, "stream lines were dropped and the client was told how many");
+	check(resumed, "the stream went on after the dropped line");
+	cs.close();
+}
+
+int main(void)
+{
+	char tmpl[] = "/tmp/ctlserver_test.XXXXXX";
+	if(!mkdtemp(tmpl))
+	{
+		perror("mkdtemp()");
+		return 1;
+	}
+	sock_path = string(tmpl) + "/ecodome.sock";
+
+	test_load(1, 50, 100);
+	test_load(100, 35, 100);
+	test_load(100, 35, 10);
+	test_errors();
+	test_stalled_stream();
+
+	unlink(sock_path.c_str());
+	rmdir(tmpl);
+
+	cout << "\n" << (failures ? "FAILED, " : "PASSED, ") << failures << " failures" << endl;
+	return failures ? 1 : 0;
+}
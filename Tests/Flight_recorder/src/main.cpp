@@ -0,0 +1,337 @@
+/*
+* main.cpp
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:54
+* Modified:		19/10-2026 05:54
+* Version:		1.0
+*
+* Description:
+*	Test of flightrec.h: a child process writes the flight recorder ring and is killed with SIGKILL, then the ring
+*	is read and opened again by the parent. The child is killed in the middle of writing a slot, between writing a
+*	slot and moving the head, and at random times while it commits as fast as it can. After every kill the reader
+*	must return only whole steps, in order and with the values they were written with, and the recorder must
+*	continue right after the newest whole step.
+*
+* NOTE:
+*	make test, ends with 0 if the ring came back whole after every kill. The ring is written to a scratch directory
+*	under /tmp that is removed at the end.
+*
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+
+#include "../../../EcoDome_Software/include/flightrec.h"
+
+using namespace std;
+
+#define RING_MINUTES	1
+#define RING_STEP		1
+#define RING_SLOTS		60			// RING_MINUTES * 60 / RING_STEP
+
+int failures = 0;
+string ring_path;
+
+void check(bool _ok, const string& _what)
+{
+	cout << (_ok ? "ok   " : "FAIL ") << _what << endl;
+	failures += !_ok;
+}
+
+// the values of step _s, so a reader can tell a whole step from a torn or mixed one
+flight_record make_record(uint64_t _s)
+{
+	flight_record rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.epoch_us = 1760000000000000LL + _s * 1000000;
+	rec.mono_ns = _s * 1000000000LL;
+	rec.T_inside = _s * 0.5f;
+	rec.T_out2 = -(float)_s;
+	rec.T_extra1 = _s * 0.25f;
+	rec.u = (float)(_s % 1000);
+	rec.r = 22.0f;
+	rec.nowcast_1h = (float)_s;
+	rec.actuators = _s & 7;
+	for(int i = 0; i < FLIGHT_STAGES; i++)
+	{
+		rec.stage_us[i] = (uint32_t)_s + i;
+	}
+	return rec;
+}
+
+bool same_values(const flight_record& _a, const flight_record& _b)
+{
+	return memcmp((const uint8_t*)&_a + 8, (const uint8_t*)&_b + 8, sizeof(flight_record) - 16) == 0;
+}
+
+	/*! @brief reads the ring and checks it: whole steps only, consecutive and ending at _newest, every step with its
+	*	own values
+	*
+	*
+	*
+	* @param uint64_t _newest, newest whole step, size_t _torn, torn slots expected, const string& _what
+	*
+	* @returns void
+	*
+	*/
+void check_ring(uint64_t _newest, size_t _torn, const string& _what)
+{
+	FLIGHT_READER rd;
+	vector< flight_record > steps;
+	if(!rd.open(ring_path))
+	{
+		check(false, _what + ": ring opened");
+		return;
+	}
+	size_t torn = rd.read(0, steps);
+
+	bool order = !steps.empty() && steps.back().seq_end == _newest;
+	bool values = true;
+	for(size_t i = 0; i < steps.size(); i++)
+	{
+		order = order && (i == 0 || steps[i].seq_end == steps[i - 1].seq_end + 1);
+		values = values && same_values(steps[i], make_record(steps[i].seq_end));
+	}
+	// every slot holds a whole step but the torn ones
+	size_t expected = min< uint64_t >(_newest, RING_SLOTS - _torn);
+	check(torn == _torn, _what + ": " + to_string(torn) + " torn slot(s) left out");
+	check(order && steps.size() == expected, _what + ": " + to_string(steps.size()) + " whole steps, consecutive up to " + to_string(_newest));
+	check(values, _what + ": every step has its own values");
+}
+
+	/*! @brief opens the ring again as the program does at the next start, commits _more steps and checks that the
+	*	numbers continue after _newest and that the ring is whole
+	*
+	*/
+void check_reopen(uint64_t _newest, int _more, const string& _what)
+{
+	FLIGHT_RECORDER fr;
+	if(!fr.open(ring_path, RING_MINUTES, RING_STEP))
+	{
+		check(false, _what + ": reopened");
+		return;
+	}
+	check(fr.get_seq() == _newest, _what + ": continues after step " + to_string(_newest) + " (got " + to_string(fr.get_seq()) + ")");
+	for(int i = 1; i <= _more; i++)
+	{
+		fr.commit(make_record(_newest + i));
+	}
+	fr.close();
+	check_ring(_newest + _more, 0, _what + ", reopened and " + to_string(_more) + " more steps");
+}
+
+// how the child dies
+enum
+{
+	KILL_MID_SLOT,			// after the start number and half the values of the next slot
+	KILL_BEFORE_HEAD,		// after the whole next slot, before the head is moved
+};
+
+	/*! @brief the child: commits _steps steps, then writes step _steps + 1 only partly, as flight_write_slot() would
+	*	have when the process died there, tells the parent and waits for SIGKILL
+	*
+	*/
+void child_partial(int _steps, int _how, int _ready)
+{
+	FLIGHT_RECORDER fr;
+	if(!fr.open(ring_path, RING_MINUTES, RING_STEP))
+	{
+		_exit(2);
+	}
+	for(int i = 1; i <= _steps; i++)
+	{
+		fr.commit(make_record(i));
+	}
+
+	// the same pages the recorder has mapped
+	int fd = ::open(ring_path.c_str(), O_RDWR);
+	size_t len = FLIGHT_HEADER_SIZE + RING_SLOTS * sizeof(flight_record);
+	uint8_t* base = (uint8_t*)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(fd == -1 || base == MAP_FAILED)
+	{
+		_exit(2);
+	}
+	uint64_t s = _steps + 1;
+	flight_record* slot = (flight_record*)(base + FLIGHT_HEADER_SIZE) + s % RING_SLOTS;
+	flight_record rec = make_record(s);
+	if(_how == KILL_MID_SLOT)
+	{
+		__atomic_store_n(&slot->seq_begin, s, __ATOMIC_RELAXED);
+		memcpy((uint8_t*)slot + 8, (const uint8_t*)&rec + 8, 56);
+	}
+	else
+	{
+		flight_write_slot(slot, s, rec);
+	}
+
+	char c = 1;
+	if(write(_ready, &c, 1) != 1)
+	{
+		_exit(2);
+	}
+	while(1)
+	{
+		pause();
+	}
+}
+
+// the child: commits as fast as it can until it is killed
+void child_flood(void)
+{
+	FLIGHT_RECORDER fr;
+	if(!fr.open(ring_path, RING_MINUTES, RING_STEP))
+	{
+		_exit(2);
+	}
+	while(1)
+	{
+		uint64_t s = fr.get_seq() + 1;
+		fr.commit(make_record(s));
+	}
+}
+
+void kill_child(pid_t _pid)
+{
+	int status;
+	kill(_pid, SIGKILL);
+	waitpid(_pid, &status, 0);
+	check(WIFSIGNALED(status) && WTERMSIG(status) == SIGKILL, "the writer was killed with SIGKILL");
+}
+
+	/*! @brief the writer is killed right in the middle of a slot or between the slot and the head
+	*
+	*/
+void test_partial(int _how, const string& _name)
+{
+	cout << "\n== " << _name << endl;
+	unlink(ring_path.c_str());
+	const int steps = 150;		// more than the ring holds, so it has wrapped
+
+	int p[2];
+	if(pipe(p) == -1)
+	{
+		perror("pipe()");
+		failures++;
+		return;
+	}
+	pid_t pid = fork();
+	if(pid == 0)
+	{
+		child_partial(steps, _how, p[1]);
+	}
+	char c;
+	bool ready = read(p[0], &c, 1) == 1;
+	close(p[0]);
+	close(p[1]);
+	check(ready, "the writer is in the middle of step " + to_string(steps + 1));
+	kill_child(pid);
+
+	if(_how == KILL_MID_SLOT)
+	{
+		// the torn slot took the place of the oldest step
+		check_ring(steps, 1, "after the kill");
+		check_reopen(steps, 5, "after the kill");
+	}
+	else
+	{
+		// the slot is whole, only the head is behind
+		FLIGHT_READER rd;
+		rd.open(ring_path);
+		check(rd.head() == (uint64_t)steps, "the head is still at step " + to_string(steps));
+		rd.close();
+		check_ring(steps + 1, 0, "after the kill");
+		check_reopen(steps + 1, 5, "after the kill");
+	}
+}
+
+	/*! @brief the writer commits as fast as it can and is killed at a random time, again and again on the same ring
+	*
+	*/
+void test_random_kills(int _kills)
+{
+	cout << "\n== random kills" << endl;
+	unlink(ring_path.c_str());
+	srand(1);
+	int hit = 0, bad = 0;
+
+	// start with a full ring, so every slot holds a step before the first kill
+	FLIGHT_RECORDER first;
+	first.open(ring_path, RING_MINUTES, RING_STEP);
+	for(int i = 1; i <= 2 * RING_SLOTS; i++)
+	{
+		first.commit(make_record(i));
+	}
+	first.close();
+
+	for(int k = 0; k < _kills; k++)
+	{
+		pid_t pid = fork();
+		if(pid == 0)
+		{
+			child_flood();
+		}
+		usleep(5000 + rand() % 20000);
+		int status;
+		kill(pid, SIGKILL);
+		waitpid(pid, &status, 0);
+
+		// check the ring quietly, only failures are printed
+		FLIGHT_READER rd;
+		vector< flight_record > steps;
+		if(!rd.open(ring_path))
+		{
+			bad++;
+			continue;
+		}
+		size_t torn = rd.read(0, steps);
+		hit += (torn != 0);
+		bool ok = torn <= 1 && !steps.empty() && steps.size() + torn == RING_SLOTS;
+		for(size_t i = 0; ok && i < steps.size(); i++)
+		{
+			ok = (i == 0 || steps[i].seq_end == steps[i - 1].seq_end + 1) && same_values(steps[i], make_record(steps[i].seq_end));
+		}
+		uint64_t newest = steps.empty() ? 0 : steps.back().seq_end;
+		rd.close();
+
+		// the next writer must continue right after the newest whole step
+		FLIGHT_RECORDER fr;
+		ok = ok && fr.open(ring_path, RING_MINUTES, RING_STEP) && fr.get_seq() == newest;
+		fr.close();
+		if(!ok)
+		{
+			bad++;
+			cout << "FAIL kill " << k << ": " << torn << " torn, " << steps.size() << " whole steps up to " << newest << endl;
+		}
+	}
+	check(bad == 0, to_string(_kills) + " kills, the ring was whole and continued after each (" + to_string(hit) + " landed inside a slot)");
+}
+
+int main(void)
+{
+	char tmpl[] = "/tmp/flightrec_test.XXXXXX";
+	if(!mkdtemp(tmpl))
+	{
+		perror("mkdtemp()");
+		return 1;
+	}
+	ring_path = string(tmpl) + "/flight.rec";
+
+	test_partial(KILL_MID_SLOT, "killed in the middle of a slot");
+	test_partial(KILL_BEFORE_HEAD, "killed before the head was moved");
+	test_random_kills(200);
+
+	unlink(ring_path.c_str());
+	rmdir(tmpl);
+
+	cout << "\n" << (failures ? "FAILED, " : "PASSED, ") << failures << " failures" << endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+/*
+* main.cpp
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:44
+* Modified:		19/10-2026 05:44
+* Version:		1.0
+*
+* Description:
+*	Round trip test of gorilla.h: timestamps whose delta-of-delta is on both sides of every bucket boundary of
+*	DOD_ENCODER, followed by regular steps that must still decode after them, and float series through XOR_ENCODER.
+*
+* NOTE:
+*	make test, ends with 0 if everything came back unchanged.
+*
+*/
+
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+
+#include "../../../EcoDome_Software/include/gorilla.h"
+
+using namespace std;
+
+int failures = 0;
+
+// encodes _t, decodes it again and compares
+void check_dod(const string& _name, const vector< int64_t >& _t)
+{
+	BITWRITER bw;
+	DOD_ENCODER enc(bw);
+	for(size_t i = 0; i < _t.size(); i++)
+	{
+		enc.put(_t[i]);
+	}
+	BITREADER br(bw.bytes().data(), bw.bytes().size());
+	DOD_DECODER dec(br);
+	for(size_t i = 0; i < _t.size(); i++)
+	{
+		int64_t v = dec.get();
+		if(v != _t[i])
+		{
+			cout << "FAIL " << _name << ": value " << i << " is " << v << ", wrote " << _t[i] << endl;
+			failures++;
+			return;
+		}
+	}
+	cout << "ok   " << _name << " (" << bw.bits() << " bits)" << endl;
+}
+
+// a series 1000, 1010, then one step with delta-of-delta _dod, then 5 regular steps
+vector< int64_t > with_dod(int64_t _dod)
+{
+	vector< int64_t > t;
+	t.push_back(1000);
+	t.push_back(1010);
+	int64_t delta = 10 + _dod;
+	t.push_back(t.back() + delta);
+	for(int i = 0; i < 5; i++)
+	{
+		t.push_back(t.back() + delta);
+	}
+	return t;
+}
+
+void check_xor(const string& _name, const vector< float >& _v)
+{
+	BITWRITER bw;
+	XOR_ENCODER enc(bw);
+	for(size_t i = 0; i < _v.size(); i++)
+	{
+		enc.put(_v[i]);
+	}
+	BITREADER br(bw.bytes().data(), bw.bytes().size());
+	XOR_DECODER dec(br);
+	for(size_t i = 0; i < _v.size(); i++)
+	{
+		float v = dec.get();
+		if(memcmp(&v, &_v[i], sizeof(v)) != 0)
+		{
+			cout << "FAIL " << _name << ": value " << i << " is " << v << ", wrote " << _v[i] << endl;
+			failures++;
+			return;
+		}
+	}
+	cout << "ok   " << _name << " (" << bw.bits() << " bits)" << endl;
+}
+
+int main(void)
+{
+	// both sides of every bucket boundary: 7 bits -64..63, 9 bits -256..255, 12 bits -2048..2047, 64 bits beyond
+	const int64_t dods[] = {0, 1, -1, 63, 64, -64, -65, 255, 256, -256, -257, 2047, 2048, -2048, -2049,
+		1LL << 40, -(1LL << 40)};
+	for(size_t i = 0; i < sizeof(dods) / sizeof(dods[0]); i++)
+	{
+		check_dod("dod " + to_string(dods[i]), with_dod(dods[i]));
+	}
+
+	// the case from the review: 1000, 1010, 1084 (delta-of-delta 64)
+	check_dod("1000 1010 1084", vector< int64_t >{1000, 1010, 1084, 1094});
+
+	// every boundary in one stream, a wrong width would shift everything after it
+	vector< int64_t > all(1, 1000);
+	int64_t delta = 10;
+	for(size_t i = 0; i < sizeof(dods) / sizeof(dods[0]); i++)
+	{
+		delta += dods[i];
+		all.push_back(all.back() + delta);
+		all.push_back(all.back() + delta);
+	}
+	check_dod("all boundaries in one stream", all);
+
+	// floats: repeats, slow changes, jumps, signs, NaN and infinities
+	vector< float > f;
+	for(int i = 0; i < 200; i++)
+	{
+		f.push_back(21.5f + 0.0625f * (i / 7));
+	}
+	f.push_back(-40.0f);
+	f.push_back(85.0f);
+	f.push_back(0.0f);
+	f.push_back(-0.0f);
+	f.push_back(NAN);
+	f.push_back(INFINITY);
+	f.push_back(1e-30f);
+	f.push_back(21.5f);
+	check_xor("floats", f);
+
+	cout << (failures ? "FAILED" : "PASSED") << ", " << failures << " failures" << endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,656 @@
+/*
+* main.cpp
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:50
+* Modified:		19/10-2026 05:54
+* Version:		1.0
+*
+* Description:
+*	Test of PROGFETCHER in progfetch.h against local stand-in servers instead of yr.no. The stand-in server answers
+*	with a generated forecast and can be made to wait before it answers or to send the document one byte at a time.
+*	The cases check that the controller side never waits for a download and that a download that takes too long is
+*	killed after the time limit without touching the published prognosis. Three datasets on three servers with
+*	different delays are downloaded at the same time, so a refresh takes as long as the slowest one. A server with
+*	ETag and Last-Modified checks that unchanged documents are answered with 304 and cost neither bytes nor a reload,
+*	and that nothing is asked before the 'Expires' time.
+*
+* NOTE:
+*	make test, ends with 0 if every case passed. DataDown.py is run with python3 as in the real program, the test
+*	works in a scratch directory under /tmp that is removed at the end.
+*
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../../EcoDome_Software/include/progfetch.h"
+
+using namespace std;
+
+int failures = 0;
+string datadown;			// absolute path of DataDown.py
+string scratch;				// scratch directory, every case works in its own directory under it
+
+void check(bool _ok, const string& _what)
+{
+	cout << (_ok ? "ok   " : "FAIL ") << _what << endl;
+	failures += !_ok;
+}
+
+double now_mono(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// waits up to _seconds for _cond to be true
+bool wait_for(function<bool()> _cond, double _seconds)
+{
+	double end = now_mono() + _seconds;
+	while(!_cond())
+	{
+		if(now_mono() > end)
+		{
+			return false;
+		}
+		usleep(20000);
+	}
+	return true;
+}
+
+string http_date(time_t _t)
+{
+	char buf[64];
+	strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", gmtime(&_t));
+	return buf;
+}
+
+string xml_date(time_t _t)
+{
+	char buf[32];
+	strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", gmtime(&_t));
+	return buf;
+}
+
+// a yr.no style forecast of _hours hourly records from the current hour on, all with the temperature _temp
+string forecast_xml(float _temp, int _hours = 24)
+{
+	time_t t0 = time(0) / 3600 * 3600;
+	char buf[512];
+	string xml = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<weatherdata>\n<meta>\n";
+	xml += "<lastupdate>" + xml_date(t0 - 3600) + "</lastupdate>\n";
+	xml += "<nextupdate>" + xml_date(t0 - 60) + "</nextupdate>\n";
+	xml += "</meta>\n<forecast>\n<tabular>\n";
+	for(int i = 0; i < _hours; i++)
+	{
+		snprintf(buf, sizeof(buf), "<time from=\"%s\" to=\"%s\">\n<precipitation value=\"0\" />\n"
+			"<windDirection deg=\"200.0\" />\n<windSpeed mps=\"3.5\" />\n<temperature unit=\"celsius\" value=\"%.1f\" />\n"
+			"<pressure unit=\"hPa\" value=\"1013.0\" />\n</time>\n",
+			xml_date(t0 + i * 3600).c_str(), xml_date(t0 + (i + 1) * 3600).c_str(), _temp);
+		xml += buf;
+	}
+	xml += "</tabular>\n</forecast>\n</weatherdata>\n";
+	return xml;
+}
+
+// what the stand-in server answers on a path
+struct stand_in_doc
+{
+	string body;
+	string etag;				// empty: no validators are sent
+	string last_modified;
+	time_t expires = 0;			// 0: no Expires header
+	int delay_ms = 0;			// wait before the answer is sent
+	int trickle_ms = 0;			// send the document one byte every trickle_ms
+};
+
+// statistics of the stand-in server
+struct stand_in_stats
+{
+	int requests = 0;
+	int conditional = 0;		// requests with If-None-Match or If-Modified-Since
+	int ok = 0;					// answered with 200
+	int not_modified = 0;		// answered with 304
+	int not_found = 0;
+	int aborted = 0;			// the client closed the connection before the document was sent
+};
+
+	/*! @brief	Minimal HTTP/1.0 server on 127.0.0.1 that stands in for yr.no, every connection is served by its own
+	*	thread so slow answers do not hold each other up
+	*
+	*/
+class STAND_IN_SERVER
+{
+public:
+	STAND_IN_SERVER() : lfd(-1), port(0), running(false) {}
+	~STAND_IN_SERVER() { stop(); }
+
+	bool start(void)
+	{
+		struct sockaddr_in addr = {};
+		socklen_t len = sizeof(addr);
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		lfd = socket(AF_INET, SOCK_STREAM, 0);
+		if(lfd == -1 || bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(lfd, 16) == -1 ||
+			getsockname(lfd, (struct sockaddr*)&addr, &len) == -1)
+		{
+			perror("stand-in server");
+			return false;
+		}
+		port = ntohs(addr.sin_port);
+		running = true;
+		acceptor = thread(&STAND_IN_SERVER::accept_loop, this);
+		return true;
+	}
+
+	void stop(void)
+	{
+		if(!running.exchange(false))
+		{
+			return;
+		}
+		acceptor.join();
+		for(size_t i = 0; i < clients.size(); i++)
+		{
+			clients[i].join();
+		}
+		clients.clear();
+		close(lfd);
+	}
+
+	string url(const string& _path)
+	{
+		return "http://127.0.0.1:" + to_string(port) + _path;
+	}
+
+	void set(const string& _path, const stand_in_doc& _doc)
+	{
+		lock_guard <mutex> lock(m);
+		docs[_path] = _doc;
+	}
+
+	stand_in_stats get_stats(void)
+	{
+		lock_guard <mutex> lock(m);
+		return stats;
+	}
+
+private:
+	void accept_loop(void)
+	{
+		while(running)
+		{
+			struct pollfd p = {lfd, POLLIN, 0};
+			if(poll(&p, 1, 50) == 1)
+			{
+				int fd = accept(lfd, NULL, NULL);
+				if(fd != -1)
+				{
+					clients.push_back(thread(&STAND_IN_SERVER::serve, this, fd));
+				}
+			}
+		}
+	}
+
+	// reads the request head, up to the empty line
+	static string read_head(int _fd)
+	{
+		string head;
+		char buf[1024];
+		while(head.find("\r\n\r\n") == string::npos && head.size() < 65536)
+		{
+			ssize_t r = recv(_fd, buf, sizeof(buf), 0);
+			if(r <= 0)
+			{
+				break;
+			}
+			head.append(buf, r);
+		}
+		return head;
+	}
+
+	// value of header _name in _head, case sensitive as urllib sends them
+	static string header(const string& _head, const string& _name)
+	{
+		size_t p = _head.find("\r\n" + _name + ": ");
+		if(p == string::npos)
+		{
+			return "";
+		}
+		p += _name.size() + 4;
+		return _head.substr(p, _head.find("\r\n", p) - p);
+	}
+
+	bool send_all(int _fd, const char* _buf, size_t _len)
+	{
+		while(_len)
+		{
+			ssize_t w = send(_fd, _buf, _len, MSG_NOSIGNAL);
+			if(w <= 0)
+			{
+				return false;
+			}
+			_buf += w;
+			_len -= w;
+		}
+		return true;
+	}
+
+	// sleeps _ms, but not past stop()
+	void pause(int _ms)
+	{
+		double end = now_mono() + _ms / 1000.0;
+		while(running && now_mono() < end)
+		{
+			usleep(10000);
+		}
+	}
+
+	void serve(int _fd)
+	{
+		string head = read_head(_fd);
+		string path = head.substr(head.find(' ') + 1);
+		path = path.substr(0, path.find(' '));
+		string inm = header(head, "If-None-Match");
+		string ims = header(head, "If-Modified-Since");
+
+		stand_in_doc doc;
+		bool found;
+		{
+			lock_guard <mutex> lock(m);
+			stats.requests++;
+			stats.conditional += (!inm.empty() || !ims.empty());
+			found = docs.count(path);
+			if(found)
+			{
+				doc = docs[path];
+			}
+		}
+
+		pause(doc.delay_ms);
+		string answer;
+		int* counter;
+		if(!found)
+		{
+			answer = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n";
+			counter = &stats.not_found;
+		}
+		else if((!doc.etag.empty() && inm == doc.etag) || (doc.etag.empty() && !doc.last_modified.empty() && ims == doc.last_modified))
+		{
+			answer = "HTTP/1.0 304 Not Modified\r\n";
+			counter = &stats.not_modified;
+		}
+		else
+		{
+			answer = "HTTP/1.0 200 OK\r\nContent-Type: application/xml\r\nContent-Length: " + to_string(doc.body.size()) + "\r\n";
+			answer += doc.etag.empty() ? "" : "ETag: " + doc.etag + "\r\n";
+			answer += doc.last_modified.empty() ? "" : "Last-Modified: " + doc.last_modified + "\r\n";
+			counter = &stats.ok;
+		}
+		answer += doc.expires ? "Expires: " + http_date(doc.expires) + "\r\n" : "";
+		answer += "\r\n";
+
+		bool sent = send_all(_fd, answer.data(), answer.size());
+		if(sent && counter == &stats.ok)
+		{
+			if(doc.trickle_ms)
+			{
+				for(size_t i = 0; sent && i < doc.body.size(); i++)
+				{
+					pause(doc.trickle_ms);
+					sent = running && send_all(_fd, &doc.body[i], 1);
+				}
+			}
+			else
+			{
+				sent = send_all(_fd, doc.body.data(), doc.body.size());
+			}
+		}
+
+		lock_guard <mutex> lock(m);
+		(*counter)++;
+		stats.aborted += !sent;
+		close(_fd);
+	}
+
+	int lfd;
+	int port;
+	atomic<bool> running;
+	thread acceptor;
+	vector< thread > clients;		// only touched by the acceptor and stop()
+	mutex m;
+	map< string, stand_in_doc > docs;
+	stand_in_stats stats;
+};
+
+// one dataset served by _server on _path, saved under the case directory
+prognosis_downlaod_structure source(STAND_IN_SERVER& _server, const string& _path, const string& _name)
+{
+	prognosis_downlaod_structure s;
+	s.url = _server.url(_path);
+	s.file_path = "./data/" + _name + "/";
+	s.file_name = "wdat";
+	return s;
+}
+
+// makes a fresh directory for case _name and works in it, the fetcher uses paths relative to the working directory
+void case_dir(const string& _name)
+{
+	string dir = scratch + "/" + _name;
+	mkdir(dir.c_str(), 0755);
+	if(chdir(dir.c_str()) == -1 || symlink(datadown.c_str(), "DataDown.py") == -1)
+	{
+		perror(dir.c_str());
+	}
+	cout << "\n== " << _name << endl;
+}
+
+// a fetcher with its own terminal, stopped and deleted by fetcher_stop()
+struct fetcher_run
+{
+	TERMINAL_CONTROLLER* tercon;
+	PROGFETCHER* fetcher;
+};
+
+fetcher_run fetcher_start(const vector< prognosis_downlaod_structure >& _sources, int _interval, int _timeout)
+{
+	fetcher_run r;
+	r.tercon = new TERMINAL_CONTROLLER(false);
+	r.fetcher = new PROGFETCHER(r.tercon, _sources, 10, _interval, _timeout);
+	r.fetcher->StartInternalThread();
+	return r;
+}
+
+void fetcher_stop(fetcher_run& _r)
+{
+	_r.tercon->stop();
+	_r.fetcher->WaitForInternalThreadToExit();
+	delete _r.fetcher;
+	_r.tercon->term_flush();
+	delete _r.tercon;
+}
+
+// the longest a call to get_snapshot() and get_stats() took while _busy was true, as the controller would call them
+double controller_wait(PROGFETCHER* _f, function<bool()> _busy, double _seconds)
+{
+	double worst = 0, end = now_mono() + _seconds;
+	while(_busy() && now_mono() < end)
+	{
+		double t = now_mono();
+		shared_ptr<const prognosis_snapshot> snap = _f->get_snapshot();
+		progfetch_stats st = _f->get_stats();
+		worst = max(worst, now_mono() - t);
+		usleep(1000);
+	}
+	return worst;
+}
+
+	/*! @brief A server that waits 3 s before it answers: the controller keeps getting the snapshot at once during the
+	*	download, and the prognosis is published when the answer arrives
+	*
+	*/
+void test_slow_server(STAND_IN_SERVER& _server)
+{
+	case_dir("slow_server");
+	stand_in_doc doc;
+	doc.body = forecast_xml(12.5);
+	doc.delay_ms = 3000;
+	_server.set("/slow.xml", doc);
+
+	vector< prognosis_downlaod_structure > src(1, source(_server, "/slow.xml", "slow"));
+	double t0 = now_mono();
+	fetcher_run r = fetcher_start(src, PROG_FETCH_INTERVAL, 20);
+	PROGFETCHER* f = r.fetcher;
+	check(!f->get_snapshot(), "no snapshot before the first download");
+
+	double worst = controller_wait(f, [f]{ return !f->get_snapshot(); }, 15);
+	double took = now_mono() - t0;
+	shared_ptr<const prognosis_snapshot> snap = f->get_snapshot();
+	// the reload is counted just after the snapshot is published
+	wait_for([f]{ return f->get_stats().reloads == 1; }, 1);
+	progfetch_stats st = f->get_stats();
+	cout << "     download took " << took << " s, slowest controller call " << worst * 1e6 << " us" << endl;
+
+	check(snap && snap->version == 1, "snapshot published after the slow answer");
+	check(took >= 3.0, "the snapshot did not appear before the server answered");
+	check(worst < 0.005, "get_snapshot() and get_stats() never waited for the download (< 5 ms)");
+	check(snap && !snap->data.empty() && snap->data[0].temperature == 12.5f, "the served temperature is in the snapshot");
+	check(st.fetches == 1 && st.reloads == 1 && st.timeouts == 0 && st.failures == 0, "one download, one reload");
+	check(st.last_duration >= 3.0 && st.last_duration < 5.0, "last_duration is the time the server took");
+	fetcher_stop(r);
+}
+
+	/*! @brief A server that sends the document one byte every 200 ms, which never trips the socket timeout of urllib:
+	*	the download is killed after the time limit, the published prognosis stays and the controller never waits
+	*
+	*/
+void test_timeout(STAND_IN_SERVER& _server)
+{
+	case_dir("timeout");
+	stand_in_doc doc;
+	doc.body = forecast_xml(8.0);
+	_server.set("/trickle.xml", doc);
+
+	vector< prognosis_downlaod_structure > src(1, source(_server, "/trickle.xml", "trickle"));
+	fetcher_run r = fetcher_start(src, PROG_FETCH_INTERVAL, 2);
+	PROGFETCHER* f = r.fetcher;
+	check(wait_for([f]{ return (bool)f->get_snapshot(); }, 10), "first download published");
+	shared_ptr<const prognosis_snapshot> first = f->get_snapshot();
+
+	doc.body = forecast_xml(9.0);
+	doc.trickle_ms = 200;
+	_server.set("/trickle.xml", doc);
+	int aborted = _server.get_stats().aborted;
+	double t0 = now_mono();
+	f->refresh();
+
+	double worst = controller_wait(f, [f]{ return f->get_stats().timeouts == 0; }, 15);
+	double took = now_mono() - t0;
+	progfetch_stats st = f->get_stats();
+	cout << "     timed out after " << took << " s, slowest controller call " << worst * 1e6 << " us" << endl;
+
+	check(st.timeouts == 1, "the download was counted as timed out");
+	check(took < 4.0 && st.last_duration >= 2.0 && st.last_duration < 3.0, "killed within the 2 s time limit");
+	check(worst < 0.005, "get_snapshot() and get_stats() never waited for the download (< 5 ms)");
+	check(f->get_snapshot() == first && first->data[0].temperature == 8.0f, "the published prognosis is unchanged");
+	check(st.reloads == 1, "no reload from the half document");
+	check(wait_for([&_server, aborted]{ return _server.get_stats().aborted == aborted + 1; }, 2), "the server saw the connection closed");
+	fetcher_stop(r);
+}
+
+	/*! @brief Three datasets on three servers that answer after 1, 2 and 3 s: the downloads run at the same time, so
+	*	the refresh takes as long as the slowest server and not the sum, and all three are in the ensemble
+	*
+	*/
+void test_concurrent(void)
+{
+	case_dir("concurrent");
+	const int delay[3] = {1000, 2000, 3000};
+	const float temp[3] = {10.0f, 20.0f, 30.0f};
+	STAND_IN_SERVER server[3];
+	vector< prognosis_downlaod_structure > src;
+	for(int i = 0; i < 3; i++)
+	{
+		stand_in_doc doc;
+		doc.body = forecast_xml(temp[i]);
+		doc.delay_ms = delay[i];
+		server[i].start();
+		server[i].set("/forecast.xml", doc);
+		src.push_back(source(server[i], "/forecast.xml", "dataset" + to_string(i + 1)));
+	}
+
+	fetcher_run r = fetcher_start(src, PROG_FETCH_INTERVAL, 20);
+	PROGFETCHER* f = r.fetcher;
+	check(wait_for([f]{ return f->get_stats().reloads == 1; }, 15), "ensemble published");
+	progfetch_stats st = f->get_stats();
+	shared_ptr<const prognosis_snapshot> snap = f->get_snapshot();
+	cout << "     refresh took " << st.last_duration << " s, the datasets " << st.source_duration[0] << ", "
+		<< st.source_duration[1] << ", " << st.source_duration[2] << " s" << endl;
+
+	check(st.fetches == 3 && st.failures == 0 && st.timeouts == 0, "three downloads, none failed");
+	check(st.last_duration >= 3.0 && st.last_duration < 4.5, "the refresh took as long as the slowest server (3 s, not 6 s)");
+	bool each = st.source_duration.size() == 3;
+	for(int i = 0; each && i < 3; i++)
+	{
+		each = st.source_duration[i] >= delay[i] / 1000.0 && st.source_duration[i] < delay[i] / 1000.0 + 1.0;
+	}
+	check(each, "every dataset took as long as its own server");
+	check(snap && snap->data[0].temperature == 20.0f, "the ensemble is the mean of all three datasets");
+	for(int i = 0; i < 3; i++)
+	{
+		check(server[i].get_stats().ok == 1, "server " + to_string(i + 1) + " answered once");
+	}
+	fetcher_stop(r);
+}
+
+	/*! @brief A server with validators: a refresh of an unchanged document is answered with 304 on the ETag and on
+	*	Last-Modified, counts no bytes and publishes no new snapshot. A changed document is downloaded and published,
+	*	and the same document sent again by a server without validators is downloaded but not published again.
+	*
+	*/
+void test_not_modified(STAND_IN_SERVER& _server)
+{
+	case_dir("not_modified");
+	stand_in_doc doc;
+	doc.body = forecast_xml(5.0);
+	doc.etag = "\"v1\"";
+	doc.last_modified = http_date(time(0) - 3600);
+	_server.set("/cached.xml", doc);
+	stand_in_stats s0 = _server.get_stats();
+
+	vector< prognosis_downlaod_structure > src(1, source(_server, "/cached.xml", "cached"));
+	fetcher_run r = fetcher_start(src, PROG_FETCH_INTERVAL, 20);
+	PROGFETCHER* f = r.fetcher;
+	check(wait_for([f]{ return f->get_stats().reloads == 1; }, 10), "first download published");
+	progfetch_stats st = f->get_stats();
+	shared_ptr<const prognosis_snapshot> first = f->get_snapshot();
+	unsigned long long size1 = doc.body.size();
+	check(st.bytes == size1, "the bytes of the first download are counted");
+	check(_server.get_stats().conditional == s0.conditional, "the first request is not conditional");
+
+	// same document, the server answers 304 on the ETag
+	f->refresh();
+	check(wait_for([f]{ return f->get_stats().reloads_skipped == 1; }, 10), "refresh of the unchanged document done");
+	st = f->get_stats();
+	stand_in_stats ss = _server.get_stats();
+	check(ss.conditional == s0.conditional + 1 && ss.not_modified == s0.not_modified + 1, "If-None-Match sent, answered 304");
+	check(st.not_modified == 1 && st.fetches == 2 && st.failures == 0, "the 304 is counted as not modified");
+	check(st.bytes == size1, "a 304 costs no bytes");
+	check(st.reloads == 1 && f->get_snapshot() == first, "a 304 publishes no new snapshot");
+
+	// changed document with a new ETag
+	doc.body = forecast_xml(6.0);
+	doc.etag = "\"v2\"";
+	doc.last_modified = http_date(time(0));
+	_server.set("/cached.xml", doc);
+	f->refresh();
+	check(wait_for([f]{ return f->get_stats().reloads == 2; }, 10), "changed document published");
+	st = f->get_stats();
+	unsigned long long size2 = doc.body.size();
+	check(st.bytes == size1 + size2, "the bytes of the changed document are counted");
+	check(f->get_snapshot()->data[0].temperature == 6.0f, "the snapshot has the changed temperature");
+
+	// the server drops the ETag, the document is still unchanged on Last-Modified
+	doc.etag = "";
+	_server.set("/cached.xml", doc);
+	f->refresh();
+	check(wait_for([f]{ return f->get_stats().reloads_skipped == 2; }, 10), "refresh on Last-Modified done");
+	st = f->get_stats();
+	check(st.not_modified == 2 && st.bytes == size1 + size2 && st.reloads == 2, "If-Modified-Since answered 304, no bytes, no reload");
+
+	// a server without validators sends the same document again, it is parsed but nothing changed
+	doc.last_modified = "";
+	_server.set("/cached.xml", doc);
+	shared_ptr<const prognosis_snapshot> second = f->get_snapshot();
+	f->refresh();
+	check(wait_for([f]{ return f->get_stats().reloads_skipped == 3; }, 10), "refresh without validators done");
+	st = f->get_stats();
+	check(st.not_modified == 2 && st.bytes == size1 + 2 * size2, "the repeated document is downloaded and counted");
+	check(st.reloads == 2 && f->get_snapshot() == second, "the repeated document publishes no new snapshot");
+	fetcher_stop(r);
+}
+
+	/*! @brief A server that sends 'Expires' an hour ahead: the timer refreshes every second but asks the server
+	*	nothing until refresh() forces it
+	*
+	*/
+void test_fresh(STAND_IN_SERVER& _server)
+{
+	case_dir("fresh");
+	stand_in_doc doc;
+	doc.body = forecast_xml(7.0);
+	doc.etag = "\"f1\"";
+	doc.expires = time(0) + 3600;
+	_server.set("/fresh.xml", doc);
+	int requests = _server.get_stats().requests;
+
+	vector< prognosis_downlaod_structure > src(1, source(_server, "/fresh.xml", "fresh"));
+	fetcher_run r = fetcher_start(src, 1, 20);
+	PROGFETCHER* f = r.fetcher;
+	check(wait_for([f]{ return f->get_stats().reloads == 1; }, 10), "first download published");
+	check(wait_for([f]{ return f->get_stats().skipped >= 3; }, 10), "the timer refreshes skip the fresh dataset");
+	progfetch_stats st = f->get_stats();
+	check(_server.get_stats().requests == requests + 1 && st.fetches == 1, "the server was asked once");
+	check(st.reloads == 1 && st.reloads_skipped >= 3, "no reload while fresh");
+
+	f->refresh();
+	check(wait_for([&_server, requests]{ return _server.get_stats().requests == requests + 2; }, 10), "refresh() asks the server anyway");
+	check(wait_for([f]{ return f->get_stats().not_modified == 1; }, 10), "and gets a 304");
+	fetcher_stop(r);
+}
+
+int main(void)
+{
+	char buf[PATH_MAX];
+	if(!realpath("../../EcoDome_Software/DataDown.py", buf))
+	{
+		perror("../../EcoDome_Software/DataDown.py");
+		return 1;
+	}
+	datadown = buf;
+	char tmpl[] = "/tmp/progfetch_test.XXXXXX";
+	if(!mkdtemp(tmpl))
+	{
+		perror("mkdtemp()");
+		return 1;
+	}
+	scratch = tmpl;
+
+	STAND_IN_SERVER server;
+	if(!server.start())
+	{
+		return 1;
+	}
+
+	test_slow_server(server);
+	test_timeout(server);
+	test_concurrent();
+	test_not_modified(server);
+	test_fresh(server);
+
+	server.stop();
+	if(chdir("/") == 0)
+	{
+		system(("rm -rf " + scratch).c_str());
+	}
+
+	cout << "\n" << (failures ? "FAILED, " : "PASSED, ") << failures << " failures" << endl;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+/*
+* main.cpp
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:45
+* Modified:		19/10-2026 05:45
+* Version:		1.0
+*
+* Description:
+*	Test of tsstore.h: stores a series of two channels and reads it back. The time steps are mostly TIME_STEP, but
+*	with gaps and early steps that put the delta-of-delta of the time stamps on both sides of every bucket boundary
+*	of DOD_ENCODER, and with missing (NAN) values. Every value is read back with iterate() over the whole time and
+*	random ranges, and summary() is compared with the same statistics computed directly.
+*
+* NOTE:
+*	make test, ends with 0 if every query matched.
+*
+*/
+
+#include <iostream>
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "../../../EcoDome_Software/include/tsstore.h"
+
+using namespace std;
+
+int failures = 0;
+
+void fail(const string& _what)
+{
+	if(failures++ < 10)
+	{
+		cout << "FAIL " << _what << endl;
+	}
+}
+
+int main(void)
+{
+	// the time steps: regular 10 s, now and then one step of 10 + a jump and back to 10 s, which gives the
+	// delta-of-deltas +jump and -jump, on both sides of every bucket boundary
+	const int64_t jumps[] = {63, 64, 65, 255, 256, 257, 2047, 2048, 2049, 86400};
+	vector< int64_t > t;
+	int64_t now = 1760000000;
+	int64_t step = 10;
+	srand(1);
+	for(int i = 0; i < 20000; i++)
+	{
+		if(i % 97 == 50)
+		{
+			step = 10 + jumps[(i / 97) % (sizeof(jumps) / sizeof(jumps[0]))];
+		}
+		else
+		{
+			step = 10;
+		}
+		now += step;
+		t.push_back(now);
+	}
+
+	// two channels, the second one is missing now and then
+	vector< float > a, b;
+	for(size_t i = 0; i < t.size(); i++)
+	{
+		a.push_back(20.0f + 5.0f * sinf(i / 300.0f) + 0.0625f * (rand() % 8));
+		b.push_back(i % 13 == 0 ? NAN : -3.5f + 0.125f * (rand() % 40));
+	}
+
+	vector< string > names;
+	names.push_back("inside");
+	names.push_back("outside");
+	TS_STORE st(names, 365 * 86400);
+	for(size_t i = 0; i < t.size(); i++)
+	{
+		float v[] = {a[i], b[i]};
+		st.append(t[i], v, 2);
+	}
+	cout << t.size() << " steps, " << st.values() << " values in " << st.bytes() << " bytes" << endl;
+
+	// whole series and random ranges through iterate() and summary()
+	for(int q = 0; q < 2000; q++)
+	{
+		int64_t from = t.front() - 5;
+		int64_t to = t.back() + 5;
+		if(q > 0)
+		{
+			from = t[rand() % t.size()] + (rand() % 3) - 1;
+			to = from + rand() % 200000;
+		}
+		for(int c = 0; c < 2; c++)
+		{
+			const vector< float >& v = c ? b : a;
+			vector< ts_point > want;
+			ts_summary ws;
+			for(size_t i = 0; i < t.size(); i++)
+			{
+				if(t[i] >= from && t[i] <= to && !isnan(v[i]))
+				{
+					ts_point p = {t[i], v[i]};
+					want.push_back(p);
+					ws.add(v[i]);
+				}
+			}
+			TS_ITERATOR it = st.iterate(c, from, to);
+			ts_point p;
+			size_t k = 0;
+			while(it.next(p))
+			{
+				if(k >= want.size() || p.t != want[k].t || p.v != want[k].v)
+				{
+					fail("query " + to_string(q) + " channel " + to_string(c) + ": value " + to_string(k) + " is "
+						+ to_string(p.t) + " " + to_string(p.v));
+					break;
+				}
+				k++;
+			}
+			if(k != want.size() && failures == 0)
+			{
+				fail("query " + to_string(q) + " channel " + to_string(c) + ": " + to_string(k) + " values, want "
+					+ to_string(want.size()));
+			}
+			ts_summary s;
+			st.summary(c, from, to, s);
+			if(s.n != ws.n || (s.n && (s.min != ws.min || s.max != ws.max || fabs(s.sum - ws.sum) > 1e-6 * ws.n)))
+			{
+				fail("summary of query " + to_string(q) + " channel " + to_string(c));
+			}
+		}
+	}
+
+	cout << (failures ? "FAILED" : "PASSED") << ", " << failures << " failures" << endl;
+	return failures ? 1 : 0;
+}
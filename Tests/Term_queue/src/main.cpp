@@ -0,0 +1,329 @@
+/*
+* main.cpp
+* Author:		EcoDome Team
+* Created:		19/10-2026 05:56
+* Modified:		19/10-2026 05:56
+* Version:		1.0
+*
+* Description:
+*	Test of termqueue.h with stdout going to a pipe that the test reads, or does not read to stall the terminal.
+*	- while nobody reads stdout, push() from several threads stays fast and the messages that do not fit are
+*	  dropped and counted instead of waiting
+*	- without the output thread the threads print whole lines, never mixed with each other
+*	- close() while the threads push: every message is printed or counted, none is left in the queue
+*
+* NOTE:
+*	make test, ends with 0 if every case passed. The results are written to the stdout the test was started with.
+*
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include "../../../EcoDome_Software/include/termqueue.h"
+
+using namespace std;
+
+int failures = 0;
+FILE* report;				// the stdout the test was started with
+
+void check(bool _ok, const string& _what)
+{
+	fprintf(report, "%s%s\n", _ok ? "ok   " : "FAIL ", _what.c_str());
+	fflush(report);
+	failures += !_ok;
+}
+
+	/*! @brief	stdout of the program as a small pipe, read by a thread once read() is called
+	*
+	*/
+class PIPE_TERMINAL
+{
+public:
+	PIPE_TERMINAL() : reading(false)
+	{
+		int p[2];
+		if(pipe(p) == -1)
+		{
+			perror("pipe()");
+			exit(1);
+		}
+		// as small as a pipe gets, so it is full after a few lines
+		fcntl(p[1], F_SETPIPE_SZ, 4096);
+		cout.flush();
+		dup2(p[1], STDOUT_FILENO);
+		::close(p[1]);
+		rfd = p[0];
+		reader = thread(&PIPE_TERMINAL::read_loop, this);
+	}
+
+	// starts reading stdout, until then everything written to it waits
+	void read(void)
+	{
+		reading = true;
+	}
+
+	// stdout goes to /dev/null, the lines read are returned
+	vector< string > close(void)
+	{
+		read();
+		cout.flush();
+		int devnull = open("/dev/null", O_WRONLY);
+		dup2(devnull, STDOUT_FILENO);
+		::close(devnull);
+		reader.join();
+		::close(rfd);
+		return lines;
+	}
+
+private:
+	void read_loop(void)
+	{
+		char buf[4096];
+		string part;
+		while(true)
+		{
+			if(!reading)
+			{
+				usleep(1000);
+				continue;
+			}
+			ssize_t r = ::read(rfd, buf, sizeof(buf));
+			if(r <= 0)
+			{
+				return;
+			}
+			part.append(buf, r);
+			size_t nl;
+			while((nl = part.find('\n')) != string::npos)
+			{
+				lines.push_back(part.substr(0, nl));
+				part.erase(0, nl + 1);
+			}
+		}
+	}
+
+	int rfd;
+	atomic<bool> reading;
+	thread reader;
+	vector< string > lines;			// only touched by the reader until close()
+};
+
+// what became of the messages, as a difference of the counters that are shared by all queues
+struct termq_counts
+{
+	uint64_t printed, dropped, suppressed, coalesced;
+
+	termq_counts(const TERM_QUEUE& _q) : printed(_q.get_printed()), dropped(_q.get_dropped()),
+		suppressed(_q.get_suppressed()), coalesced(_q.get_coalesced())
+	{
+
+	}
+
+	uint64_t since(const termq_counts& _before) const
+	{
+		return (printed - _before.printed) + (dropped - _before.dropped) + (suppressed - _before.suppressed)
+			+ (coalesced - _before.coalesced);
+	}
+};
+
+// a message of thread _t, _i, long enough that two mixed lines are seen
+string message(int _t, int _i)
+{
+	return "thread " + to_string(_t) + " message " + to_string(_i) + " " + string(300, 'a' + _t) + " end";
+}
+
+// whether _line is a whole message or a note of the queue
+bool whole_line(const string& _line)
+{
+	if(!_line.empty() && _line[0] == '(')
+	{
+		return true;
+	}
+	int t, i;
+	if(sscanf(_line.c_str(), "thread %d message %d", &t, &i) != 2)
+	{
+		return false;
+	}
+	return _line == message(t, i);
+}
+
+	/*! @brief nobody reads stdout: the output thread hangs in write(), push() from four threads must not wait for it
+	*
+	*/
+void test_stalled(void)
+{
+	fprintf(report, "\n== stdout stalled\n");
+	const int threads = 4, per_thread = 2000;
+	PIPE_TERMINAL term;
+	TERM_QUEUE q(false);
+	q.start();
+	termq_counts before(q);
+
+	vector< vector< double > > lat(threads);
+	vector< thread > th;
+	for(int t = 0; t < threads; t++)
+	{
+		th.push_back(thread([&q, &lat, t, per_thread]
+		{
+			for(int i = 0; i < per_thread; i++)
+			{
+				string msg = message(t, i);
+				chrono::steady_clock::time_point a = chrono::steady_clock::now();
+				q.push(msg, TERMQ_WRITE);
+				lat[t].push_back(chrono::duration< double, micro >(chrono::steady_clock::now() - a).count());
+				usleep(100);
+			}
+		}));
+	}
+	for(size_t t = 0; t < th.size(); t++)
+	{
+		th[t].join();
+	}
+
+	vector< double > all;
+	for(int t = 0; t < threads; t++)
+	{
+		all.insert(all.end(), lat[t].begin(), lat[t].end());
+	}
+	sort(all.begin(), all.end());
+	double p50 = all[all.size() / 2], p99 = all[all.size() * 99 / 100], worst = all.back();
+	termq_counts after(q);
+	fprintf(report, "     %zu pushes: p50 %.2f us, p99 %.2f us, max %.1f us, %lu dropped\n", all.size(), p50, p99, worst,
+		(unsigned long)(after.dropped - before.dropped));
+
+	check(p99 < 50, "push() p99 under 50 us while stdout is stalled");
+	check(worst < 20000, "no push() waited for the terminal (max under 20 ms)");
+	check(after.dropped - before.dropped > 0, "the messages that did not fit were dropped and counted");
+
+	// the terminal comes back: the output thread finishes and close() returns
+	term.read();
+	q.close();
+	termq_counts done(q);
+	vector< string > lines = term.close();
+	bool whole = true;
+	for(size_t i = 0; i < lines.size(); i++)
+	{
+		whole = whole && whole_line(lines[i]);
+	}
+	check(done.since(before) == (uint64_t)threads * per_thread, "every message was printed, dropped, suppressed or coalesced");
+	check(whole && !lines.empty(), "only whole lines came out");
+}
+
+	/*! @brief without the output thread, before start() and after close(), four threads print at the same time
+	*
+	*/
+void test_unstarted(bool _after_close)
+{
+	fprintf(report, "\n== four threads, %s\n", _after_close ? "after close()" : "before start()");
+	const int threads = 4, per_thread = 500;
+	PIPE_TERMINAL term;
+	term.read();
+	TERM_QUEUE q(false);
+	if(_after_close)
+	{
+		q.start();
+		q.close();
+	}
+
+	vector< thread > th;
+	for(int t = 0; t < threads; t++)
+	{
+		th.push_back(thread([&q, t, per_thread]
+		{
+			for(int i = 0; i < per_thread; i++)
+			{
+				q.push(message(t, i), TERMQ_WRITE);
+			}
+		}));
+	}
+	for(size_t t = 0; t < th.size(); t++)
+	{
+		th[t].join();
+	}
+	vector< string > lines = term.close();
+
+	size_t bad = 0;
+	for(size_t i = 0; i < lines.size(); i++)
+	{
+		bad += !whole_line(lines[i]);
+	}
+	check(lines.size() == (size_t)threads * per_thread, to_string(lines.size()) + " lines printed of " + to_string(threads * per_thread));
+	check(bad == 0, to_string(bad) + " lines mixed up");
+}
+
+	/*! @brief close() while three threads push without pause, again and again: what was pushed is printed or counted
+	*	either by the output thread, by close() or by push() itself, nothing stays in the queue
+	*
+	*/
+void test_close_race(int _rounds)
+{
+	fprintf(report, "\n== close() while pushing, %d rounds\n", _rounds);
+	PIPE_TERMINAL term;
+	term.read();
+	const int threads = 3;
+	int lost = 0;
+	for(int r = 0; r < _rounds; r++)
+	{
+		TERM_QUEUE q(false);
+		q.start();
+		termq_counts before(q);
+		atomic<bool> go(true);
+		atomic<uint64_t> pushed(0);
+		vector< thread > th;
+		for(int t = 0; t < threads; t++)
+		{
+			th.push_back(thread([&q, &go, &pushed, t]
+			{
+				// a few more after close(), those are printed by push()
+				int i = 0, after = 0;
+				while(after < 5)
+				{
+					q.push(message(t, i++), TERMQ_WRITE);
+					pushed++;
+					after += !go;
+				}
+			}));
+		}
+		usleep(1000 + (r % 10) * 300);
+		q.close();
+		go = false;
+		for(size_t t = 0; t < th.size(); t++)
+		{
+			th[t].join();
+		}
+		termq_counts after(q);
+		if(after.since(before) != pushed)
+		{
+			lost++;
+			fprintf(report, "     round %d: %lu pushed, %lu printed or counted\n", r, (unsigned long)pushed.load(),
+				(unsigned long)after.since(before));
+		}
+	}
+	term.close();
+	check(lost == 0, "no message was left in the queue in " + to_string(_rounds) + " rounds");
+}
+
+int main(void)
+{
+	report = fdopen(dup(STDOUT_FILENO), "w");
+
+	test_stalled();
+	test_unstarted(false);
+	test_unstarted(true);
+	test_close_race(200);
+
+	fprintf(report, "\n%s%d failures\n", failures ? "FAILED, " : "PASSED, ", failures);
+	return failures ? 1 : 0;
+}